@@ -0,0 +1,308 @@
+//
+//  IngestRingBench.c
+//  MDots
+//
+//  Created by Estela Alvarez on 18/10/26.
+//
+
+/// Stress tests the ingest lane handoff of IngestExecutor off the device: one IngestRing per device lane, a producer
+/// thread standing for the SDK callback and a consumer thread standing for the lane queue. The producer pokes the
+/// consumer like DISPATCH_SOURCE_TYPE_DATA_ADD: pokes merge into one pending count, and each wake up drains whatever
+/// the ring holds. Not part of the app target.
+///
+/// Build and run from the repository root, on Linux or macOS:
+///
+///     cc -O2 -std=c11 -D_DEFAULT_SOURCE -pthread -IMDots/Core/Obj-C/Processing Benchmarks/IngestRingBench.c
+///        MDots/Core/Obj-C/Processing/IngestRing.c -o /tmp/IngestRingBench
+///     /tmp/IngestRingBench
+///
+/// Exits with 1 if a check fails: every item pushed is drained exactly once and in order, with its payload intact,
+/// and every item not pushed is counted as an overflow.
+
+#include "IngestRing.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/// The capacity of IngestExecutor's lanes
+#define kLaneCapacity 1024
+/// One lane per body segment
+#define kLanes 5
+#define kItemsPerLane 2000000
+
+static int failures = 0;
+
+/// The size of an IngestSlot: a SessionSample and its arrival time
+typedef struct
+{
+    uint64_t sequence;
+    uint32_t lane;
+    uint32_t check;
+    double payload[22];
+} Item;
+
+/// One lane: its ring, the DATA_ADD source and the counters of both sides
+typedef struct
+{
+    IngestRing ring;
+    uint32_t index;
+    /// Microseconds the consumer sleeps per drain, to force overflows
+    unsigned drainDelay;
+    /// Whether the producer waits for a free slot instead of dropping the item
+    int retry;
+    pthread_mutex_t mutex;
+    pthread_cond_t condition;
+    /// The merged pokes not handled yet, like the data of a DATA_ADD source
+    _Atomic unsigned long pending;
+    int cancelled;
+    /// Producer side
+    uint64_t pushed;
+    uint64_t overflows;
+    /// Consumer side
+    uint64_t drained;
+    uint64_t drains;
+    uint64_t nextSequence;
+    uint64_t errors;
+} Lane;
+
+static uint32_t Checksum(const Item *item)
+{
+    return (uint32_t)(item->sequence * 2654435761u) ^ item->lane ^ (uint32_t)item->payload[21];
+}
+
+/// dispatch_source_merge_data(source, 1): only the poke that finds no pending data wakes the consumer.
+static void Poke(Lane *lane)
+{
+    if (atomic_fetch_add(&lane->pending, 1) == 0)
+    {
+        pthread_mutex_lock(&lane->mutex);
+        pthread_cond_signal(&lane->condition);
+        pthread_mutex_unlock(&lane->mutex);
+    }
+}
+
+/// IngestLane drain: reads every item in the ring and releases the slots in one step.
+static void Drain(Lane *lane)
+{
+    uint32_t tail;
+    uint32_t head = IngestRingBeginRead(&lane->ring, &tail);
+    if (tail == head)
+    {
+        return;
+    }
+    lane->drains++;
+    for (; tail != head; tail++)
+    {
+        const Item *item = IngestRingSlot(&lane->ring, tail);
+        if (item->lane != lane->index || item->sequence != lane->nextSequence || item->check != Checksum(item))
+        {
+            lane->errors++;
+        }
+        lane->nextSequence = item->sequence + 1;
+        lane->drained++;
+    }
+    if (lane->drainDelay)
+    {
+        struct timespec delay = { 0, (long)lane->drainDelay * 1000 };
+        nanosleep(&delay, NULL);
+    }
+    IngestRingEndRead(&lane->ring, tail);
+}
+
+/// The lane queue: runs the event handler once per batch of merged pokes.
+static void *Consumer(void *context)
+{
+    Lane *lane = context;
+    for (;;)
+    {
+        pthread_mutex_lock(&lane->mutex);
+        while (atomic_load(&lane->pending) == 0 && !lane->cancelled)
+        {
+            pthread_cond_wait(&lane->condition, &lane->mutex);
+        }
+        int cancelled = lane->cancelled;
+        pthread_mutex_unlock(&lane->mutex);
+        // Pokes after the exchange wake the consumer again, the items before it are in the drain
+        if (atomic_exchange(&lane->pending, 0) == 0 && cancelled)
+        {
+            return NULL;
+        }
+        Drain(lane);
+    }
+}
+
+/// The SDK callback thread: one item per sample, dropped and counted when the ring is full unless the lane retries.
+static void *Producer(void *context)
+{
+    Lane *lane = context;
+    Item item;
+    memset(&item, 0, sizeof(item));
+    item.lane = lane->index;
+    for (uint64_t n = 0; n < kItemsPerLane; n++)
+    {
+        item.sequence = lane->pushed;
+        item.payload[21] = (double)(n & 0xffff);
+        item.check = Checksum(&item);
+        int accepted = IngestRingPush(&lane->ring, &item);
+        while (!accepted && lane->retry)
+        {
+            sched_yield();
+            accepted = IngestRingPush(&lane->ring, &item);
+        }
+        if (!accepted)
+        {
+            lane->overflows++;
+            continue;
+        }
+        lane->pushed++;
+        Poke(lane);
+    }
+    return NULL;
+}
+
+/// Prints a check result and counts the failures.
+static void Check(const char *name, int ok)
+{
+    printf("%-60s %s\n", name, ok ? "ok" : "FAIL");
+    if (!ok)
+    {
+        failures++;
+    }
+}
+
+/// Runs every lane at once, returns the seconds taken. The producers wait for a free slot so that every item goes
+/// through the handoff, but with a drain delay the first lane drops its items like IngestExecutor.
+static double RunLanes(Lane *lanes, unsigned drainDelay)
+{
+    pthread_t producers[kLanes], consumers[kLanes];
+    for (uint32_t i = 0; i < kLanes; i++)
+    {
+        Lane *lane = &lanes[i];
+        memset(lane, 0, sizeof(*lane));
+        if (!IngestRingInit(&lane->ring, sizeof(Item), kLaneCapacity))
+        {
+            fprintf(stderr, "Out of memory\n");
+            exit(1);
+        }
+        lane->index = i;
+        // The slow lane stands for a device whose queue falls behind
+        lane->drainDelay = i == 0 ? drainDelay : 0;
+        lane->retry = lane->drainDelay == 0;
+        pthread_mutex_init(&lane->mutex, NULL);
+        pthread_cond_init(&lane->condition, NULL);
+    }
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (uint32_t i = 0; i < kLanes; i++)
+    {
+        pthread_create(&consumers[i], NULL, Consumer, &lanes[i]);
+        pthread_create(&producers[i], NULL, Producer, &lanes[i]);
+    }
+    for (uint32_t i = 0; i < kLanes; i++)
+    {
+        pthread_join(producers[i], NULL);
+        // invalidate: the source is cancelled once the last poke is handled
+        pthread_mutex_lock(&lanes[i].mutex);
+        lanes[i].cancelled = 1;
+        pthread_cond_signal(&lanes[i].condition);
+        pthread_mutex_unlock(&lanes[i].mutex);
+        pthread_join(consumers[i], NULL);
+        // drainWithCompletion: takes what is left in the ring
+        Drain(&lanes[i]);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    return (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) * 1e-9;
+}
+
+/// Checks the counters of a run.
+static void CheckLanes(const char *run, const Lane *lanes, double seconds)
+{
+    uint64_t pushed = 0, overflows = 0, drained = 0, drains = 0, errors = 0;
+    int balanced = 1;
+    for (uint32_t i = 0; i < kLanes; i++)
+    {
+        pushed += lanes[i].pushed;
+        overflows += lanes[i].overflows;
+        drained += lanes[i].drained;
+        drains += lanes[i].drains;
+        errors += lanes[i].errors;
+        balanced &= lanes[i].pushed + lanes[i].overflows == kItemsPerLane && lanes[i].drained == lanes[i].pushed;
+    }
+    char name[96];
+    snprintf(name, sizeof(name), "%s: every item pushed or counted, drained once", run);
+    Check(name, balanced);
+    snprintf(name, sizeof(name), "%s: items in order with their payload", run);
+    Check(name, errors == 0);
+    printf("%s: %d lanes, %llu drained in %llu drains, %llu overflows, %.1f M items/s\n", run, kLanes,
+           (unsigned long long)drained, (unsigned long long)drains, (unsigned long long)overflows, pushed / seconds * 1e-6);
+}
+
+/// A full ring drops the next item and takes one again once a slot is released.
+static void CheckFullRing(void)
+{
+    IngestRing ring;
+    Item item;
+    memset(&item, 0, sizeof(item));
+    if (!IngestRingInit(&ring, sizeof(Item), kLaneCapacity))
+    {
+        fprintf(stderr, "Out of memory\n");
+        exit(1);
+    }
+    int accepted = 1;
+    for (uint32_t n = 0; n < kLaneCapacity; n++)
+    {
+        item.sequence = n;
+        accepted &= IngestRingPush(&ring, &item);
+    }
+    Check("Full ring: capacity items accepted", accepted);
+    Check("Full ring: the next item is dropped", !IngestRingPush(&ring, &item));
+    uint32_t tail;
+    uint32_t head = IngestRingBeginRead(&ring, &tail);
+    Check("Full ring: capacity items readable", head - tail == kLaneCapacity);
+    const Item *first = IngestRingSlot(&ring, tail);
+    Check("Full ring: the oldest item is read first", first->sequence == 0);
+    IngestRingEndRead(&ring, tail + 1);
+    Check("Full ring: one slot released, one item accepted", IngestRingPush(&ring, &item));
+    Check("Full ring: and then full again", !IngestRingPush(&ring, &item));
+    Check("Capacity not a power of two is refused", !IngestRingInit(&ring, sizeof(Item), 1000));
+    IngestRingDestroy(&ring);
+}
+
+int main(void)
+{
+    static Lane lanes[kLanes];
+    CheckFullRing();
+    double seconds = RunLanes(lanes, 0);
+    CheckLanes("Concurrent lanes", lanes, seconds);
+    uint64_t overflows = 0;
+    for (uint32_t i = 0; i < kLanes; i++)
+    {
+        overflows += lanes[i].overflows;
+    }
+    Check("Concurrent lanes: every item delivered", overflows == 0);
+    for (uint32_t i = 0; i < kLanes; i++)
+    {
+        IngestRingDestroy(&lanes[i].ring);
+    }
+    seconds = RunLanes(lanes, 200);
+    CheckLanes("One slow lane", lanes, seconds);
+    Check("One slow lane: the slow lane overflowed", lanes[0].overflows > 0);
+    Check("One slow lane: the other lanes delivered every item", lanes[1].drained + lanes[2].drained + lanes[3].drained + lanes[4].drained == 4ull * kItemsPerLane);
+    for (uint32_t i = 0; i < kLanes; i++)
+    {
+        IngestRingDestroy(&lanes[i].ring);
+    }
+    if (failures > 0)
+    {
+        printf("%d check(s) failed\n", failures);
+        return 1;
+    }
+    printf("All checks passed\n");
+    return 0;
+}
@@ -0,0 +1,194 @@
+//
+//  JointAngleBench.c
+//  MDots
+//
+//  Created by Estela Alvarez on 18/10/26.
+//
+
+/// Checks and benchmarks the joint angles and sensor tilts of JointAngle.c off the device. Not part of the app target.
+///
+/// Build and run from the repository root, on Linux or macOS:
+///
+///     cc -O2 -std=c99 -D_DEFAULT_SOURCE -IMDots/Core/Obj-C/Processing Benchmarks/JointAngleBench.c
+///        MDots/Core/Obj-C/Processing/JointAngle.c -lm -o /tmp/JointAngleBench
+///     /tmp/JointAngleBench
+///
+/// Exits with 1 if a check fails. The benchmark prints frames per second for each computation.
+
+#include "JointAngle.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#define kBenchFrames 1000000
+
+static int failures = 0;
+
+/// Prints a check result and counts the failures.
+static void Check(const char *name, double value, double expected, double tolerance)
+{
+    int ok = fabs(value - expected) <= tolerance;
+    printf("%-52s %10.3f (expected %.3f +- %.3f) %s\n", name, value, expected, tolerance, ok ? "ok" : "FAIL");
+    if (!ok)
+    {
+        failures++;
+    }
+}
+
+/// The rotation of an angle in degrees about a unit axis.
+static void AxisAngle(double x, double y, double z, double degrees, double q[4])
+{
+    double half = degrees * M_PI / 360.0;
+    q[0] = cos(half);
+    q[1] = x * sin(half);
+    q[2] = y * sin(half);
+    q[3] = z * sin(half);
+}
+
+/// out = a * b.
+static void Multiply(const double a[4], const double b[4], double out[4])
+{
+    out[0] = a[0] * b[0] - a[1] * b[1] - a[2] * b[2] - a[3] * b[3];
+    out[1] = a[0] * b[1] + a[1] * b[0] + a[2] * b[3] - a[3] * b[2];
+    out[2] = a[0] * b[2] - a[1] * b[3] + a[2] * b[0] + a[3] * b[1];
+    out[3] = a[0] * b[3] + a[1] * b[2] - a[2] * b[1] + a[3] * b[0];
+}
+
+/// A seated subject facing `heading` degrees, knee bent at 90 degrees and held still, hip turned by `hip` degrees:
+/// the femur points forward, level, and both segments turn about it. The sensors sit on the segments with a slightly
+/// crooked strap, the shank sensor x axis along the femur.
+static void SeatedLeg(double heading, double hip, double thigh[4], double shank[4])
+{
+    double yaw[4], femur[4], strap[4], mount[4], rotated[4];
+    AxisAngle(0, 0, 1, heading, yaw);
+    // The femur axis in the world: x turned by the heading
+    double fx = cos(heading * M_PI / 180.0), fy = sin(heading * M_PI / 180.0);
+    AxisAngle(fx, fy, 0, hip, femur);
+    AxisAngle(0, 1, 0, 8.0, strap);
+    // Shank sensor x axis forward, thigh sensor on the outer side of the thigh
+    Multiply(yaw, strap, mount);
+    Multiply(femur, mount, shank);
+    AxisAngle(1, 0, 0, 90.0, rotated);
+    Multiply(mount, rotated, strap);
+    Multiply(femur, strap, thigh);
+}
+
+/// Hip rotation with the knee held still: the knee angle does not move, the shank tilt follows the hip.
+static void CheckHipRotation(double heading)
+{
+    static const double kHips[] = { 15.0, 30.0, 45.0, -30.0 };
+    double thigh0[4], shank0[4];
+    SeatedLeg(heading, 0.0, thigh0, shank0);
+    JointAngleState knee;
+    JointAngleStateInit(&knee, JointAngleSequenceXYZ);
+    JointAngleAddCalibrationFrame(&knee, thigh0, shank0);
+    JointAngleFinishCalibration(&knee);
+    double neutral[3];
+    JointAngleVerticalInSensor(shank0, neutral);
+    for (size_t i = 0; i < sizeof(kHips) / sizeof(kHips[0]); i++)
+    {
+        double thigh[4], shank[4], angles[3], v[3];
+        char name[64];
+        SeatedLeg(heading, kHips[i], thigh, shank);
+        JointAngleUpdate(&knee, thigh, shank, angles);
+        snprintf(name, sizeof(name), "Heading %.0f, hip %.0f: knee angle (deg)", heading, kHips[i]);
+        Check(name, angles[0], 0.0, 1e-6);
+        JointAngleVerticalInSensor(shank, v);
+        snprintf(name, sizeof(name), "Heading %.0f, hip %.0f: shank tilt (deg)", heading, kHips[i]);
+        Check(name, JointAngleTilt(neutral, v, 0), kHips[i], 1e-6);
+    }
+}
+
+/// A change of heading, e.g. the drift of a filter without magnetometer, does not change the tilt.
+static void CheckHeadingDrift(void)
+{
+    double thigh[4], shank0[4], shank[4], drift[4], drifted[4], neutral[3], v[3];
+    SeatedLeg(20.0, 0.0, thigh, shank0);
+    SeatedLeg(20.0, 30.0, thigh, shank);
+    AxisAngle(0, 0, 1, 25.0, drift);
+    Multiply(drift, shank, drifted);
+    JointAngleVerticalInSensor(shank0, neutral);
+    JointAngleVerticalInSensor(drifted, v);
+    Check("Hip 30 with 25 deg of heading drift: tilt (deg)", JointAngleTilt(neutral, v, 0), 30.0, 1e-6);
+}
+
+/// A knee flexed about its own axis is seen by the joint angles.
+static void CheckKneeFlexion(void)
+{
+    double thigh[4] = { 1, 0, 0, 0 }, shank[4], angles[3];
+    JointAngleState knee;
+    JointAngleStateInit(&knee, JointAngleSequenceXYZ);
+    JointAngleAddCalibrationFrame(&knee, thigh, thigh);
+    JointAngleFinishCalibration(&knee);
+    AxisAngle(1, 0, 0, 40.0, shank);
+    JointAngleUpdate(&knee, thigh, shank, angles);
+    Check("Knee flexed 40 about x: first angle (deg)", angles[0], 40.0, 1e-6);
+}
+
+/// Prints the throughput of a computation.
+static void Report(const char *name, struct timespec start, struct timespec end, double sink)
+{
+    double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) * 1e-9;
+    printf("%-52s %10.2f M frames/s (%.3f)\n", name, kBenchFrames / seconds * 1e-6, sink);
+}
+
+/// Times the joint angles and the tilts of kBenchFrames random frames.
+static void Bench(void)
+{
+    double *prox = malloc(kBenchFrames * 4 * sizeof(double));
+    double *dist = malloc(kBenchFrames * 4 * sizeof(double));
+    double *angles = malloc(kBenchFrames * 3 * sizeof(double));
+    if (!prox || !dist || !angles)
+    {
+        fprintf(stderr, "Out of memory\n");
+        exit(1);
+    }
+    srand(1);
+    for (size_t i = 0; i < kBenchFrames; i++)
+    {
+        AxisAngle(1, 0, 0, rand() % 180, prox + i * 4);
+        AxisAngle(0, 1, 0, rand() % 180, dist + i * 4);
+    }
+    JointAngleState state;
+    JointAngleStateInit(&state, JointAngleSequenceXYZ);
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    JointAngleUpdateBlock(&state, prox, dist, kBenchFrames, angles);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    Report("Joint angles", start, end, angles[(kBenchFrames - 1) * 3]);
+
+    double neutral[3] = { 0, 0, 1 }, v[3], sum = 0;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (size_t i = 0; i < kBenchFrames; i++)
+    {
+        JointAngleVerticalInSensor(dist + i * 4, v);
+        sum += JointAngleTilt(neutral, v, 0);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    Report("Sensor tilts", start, end, sum / kBenchFrames);
+    free(prox);
+    free(dist);
+    free(angles);
+}
+
+int main(void)
+{
+    CheckHipRotation(0.0);
+    CheckHipRotation(135.0);
+    CheckHeadingDrift();
+    CheckKneeFlexion();
+    Bench();
+    if (failures > 0)
+    {
+        printf("%d check(s) failed\n", failures);
+        return 1;
+    }
+    printf("All checks passed\n");
+    return 0;
+}
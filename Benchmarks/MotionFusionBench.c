@@ -0,0 +1,150 @@
+//
+//  MotionFusionBench.c
+//  MDots
+//
+//  Created by Estela Alvarez on 18/10/26.
+//
+
+/// Checks and benchmarks the orientation filters of MotionFusion.c off the device. Not part of the app target.
+///
+/// Build and run from the repository root, on Linux or macOS:
+///
+///     cc -O2 -std=c99 -D_DEFAULT_SOURCE -IMDots/Core/Obj-C/Processing Benchmarks/MotionFusionBench.c
+///        MDots/Core/Obj-C/Processing/MotionFusion.c -lm -o /tmp/MotionFusionBench
+///     /tmp/MotionFusionBench
+///
+/// Exits with 1 if a check fails. The benchmark prints sensor-samples per second for each filter.
+
+#include "MotionFusion.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define kSampleRate 60.0
+#define kBenchSensors 5
+#define kBenchSamples 200000
+
+static int failures = 0;
+
+/// Prints a check result and counts the failures.
+static void Check(const char *name, double value, double expected, double tolerance)
+{
+    int ok = fabs(value - expected) <= tolerance;
+    printf("%-40s %10.3f (expected %.3f +- %.3f) %s\n", name, value, expected, tolerance, ok ? "ok" : "FAIL");
+    if (!ok)
+    {
+        failures++;
+    }
+}
+
+/// A sensor at rest, rolled by an angle, settles to that roll.
+static void CheckStaticTilt(MotionFusionType type)
+{
+    MotionFusionParams params;
+    MotionFusionParamsDefault(&params);
+    params.type = type;
+    MotionFusionState state;
+    MotionFusionStateReset(&state);
+    double roll = 30.0 * M_PI / 180.0;
+    double gyr[3] = { 0, 0, 0 };
+    double acc[3] = { 0, 9.81 * sin(roll), 9.81 * cos(roll) };
+    for (int i = 0; i < 10 * kSampleRate; i++)
+    {
+        MotionFusionUpdate(&params, &state, gyr, acc, 1.0 / kSampleRate);
+    }
+    double euler[3];
+    MotionFusionQuaternionToEuler(state.q, euler);
+    Check(type == MotionFusionMadgwick ? "Madgwick static tilt roll (deg)" : "Mahony static tilt roll (deg)", euler[0], 30.0, 0.5);
+}
+
+/// One second at 90 deg/s about the vertical gives a yaw of 90 degrees.
+static void CheckYawIntegration(MotionFusionType type)
+{
+    MotionFusionParams params;
+    MotionFusionParamsDefault(&params);
+    params.type = type;
+    MotionFusionState state;
+    MotionFusionStateReset(&state);
+    double gyr[3] = { 0, 0, 90.0 * M_PI / 180.0 };
+    double acc[3] = { 0, 0, 9.81 };
+    // The first update only sets the attitude from the accelerometer
+    for (int i = 0; i <= kSampleRate; i++)
+    {
+        MotionFusionUpdate(&params, &state, gyr, acc, 1.0 / kSampleRate);
+    }
+    double euler[3];
+    MotionFusionQuaternionToEuler(state.q, euler);
+    Check(type == MotionFusionMadgwick ? "Madgwick yaw after 1 s at 90 deg/s (deg)" : "Mahony yaw after 1 s at 90 deg/s (deg)", euler[2], 90.0, 0.5);
+}
+
+/// The delta quantities of a constant rotation give back its angular velocity.
+static void CheckDeltas(void)
+{
+    double rate = 45.0 * M_PI / 180.0, dt = 1.0 / kSampleRate;
+    double half = rate * dt / 2;
+    double dq[4] = { cos(half), 0, sin(half), 0 };
+    double dv[3] = { 0, 0, 9.81 * dt };
+    double gyr[3], acc[3];
+    MotionFusionFromDeltas(dq, dv, dt, gyr, acc);
+    Check("Delta quantities angular velocity (deg/s)", gyr[1] * 180.0 / M_PI, 45.0, 1e-6);
+    Check("Delta quantities acceleration (m/s2)", acc[2], 9.81, 1e-6);
+}
+
+/// Fuses a block of kBenchSensors sensors and prints the throughput.
+static void Bench(MotionFusionType type)
+{
+    MotionFusionParams params;
+    MotionFusionParamsDefault(&params);
+    params.type = type;
+    size_t values = (size_t)kBenchSamples * kBenchSensors;
+    double *gyr = malloc(values * 3 * sizeof(double));
+    double *acc = malloc(values * 3 * sizeof(double));
+    double *quat = malloc(values * 4 * sizeof(double));
+    if (!gyr || !acc || !quat)
+    {
+        fprintf(stderr, "Out of memory\n");
+        exit(1);
+    }
+    srand(1);
+    for (size_t i = 0; i < values * 3; i++)
+    {
+        gyr[i] = (rand() / (double)RAND_MAX - 0.5) * 2.0;
+        acc[i] = (i % 3 == 2 ? 9.81 : 0) + (rand() / (double)RAND_MAX - 0.5);
+    }
+    MotionFusionState states[kBenchSensors];
+    for (int s = 0; s < kBenchSensors; s++)
+    {
+        MotionFusionStateReset(&states[s]);
+    }
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    MotionFusionUpdateBlock(&params, states, kBenchSensors, kBenchSamples, gyr, acc, NULL, 1.0 / kSampleRate, quat);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) * 1e-9;
+    printf("%-40s %10.2f M sensor-samples/s (%d sensors x %d samples, q0 %.3f)\n",
+           type == MotionFusionMadgwick ? "Madgwick block" : "Mahony block", values / seconds * 1e-6,
+           kBenchSensors, kBenchSamples, quat[(values - 1) * 4]);
+    free(gyr);
+    free(acc);
+    free(quat);
+}
+
+int main(void)
+{
+    CheckStaticTilt(MotionFusionMadgwick);
+    CheckStaticTilt(MotionFusionMahony);
+    CheckYawIntegration(MotionFusionMadgwick);
+    CheckYawIntegration(MotionFusionMahony);
+    CheckDeltas();
+    Bench(MotionFusionMadgwick);
+    Bench(MotionFusionMahony);
+    if (failures > 0)
+    {
+        printf("%d check(s) failed\n", failures);
+        return 1;
+    }
+    printf("All checks passed\n");
+    return 0;
+}
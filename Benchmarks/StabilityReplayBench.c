@@ -0,0 +1,260 @@
+//
+//  StabilityReplayBench.c
+//  MDots
+//
+//  Created by Estela Alvarez on 18/10/26.
+//
+
+/// Replays synthetic trials through the auto capture detector of StabilityDetector.c off the device and measures
+/// how often it finds a real hold and how often it fires on a trial with no hold. Not part of the app target.
+///
+/// Build and run from the repository root, on Linux or macOS:
+///
+///     cc -O2 -std=c99 -D_DEFAULT_SOURCE -IMDots/Core/Obj-C/Processing Benchmarks/StabilityReplayBench.c
+///        MDots/Core/Obj-C/Processing/StabilityDetector.c -lm -o /tmp/StabilityReplayBench
+///     /tmp/StabilityReplayBench
+///
+/// Exits with 1 if a rate is out of its bound. Trials are sampled at 30 Hz, the output rate PayloadPlanner plans
+/// for every test, with the parameters of each StabilityTrigger kernel.
+
+#include "StabilityDetector.h"
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+/// The output rate of PayloadPlanner
+#define kSampleRate 30.0
+#define kTrials 1000
+/// The most samples of a trial
+#define kMaxSamples 1024
+
+/// Lowest share of real holds found
+static const double kMinHoldRate = 0.99;
+/// Highest share of trials without a hold that trigger, at rest and in slow continuous movement
+static const double kMaxRestRate = 0.0;
+static const double kMaxSlowRate = 0.05;
+
+static int failures = 0;
+
+/// A StabilityTrigger kernel: its parameters and the range of its end positions, in degrees
+typedef struct
+{
+    const char *name;
+    StabilityDetectorParams params;
+    double minTarget;
+    double maxTarget;
+} Kernel;
+
+/// A synthetic trial
+typedef struct
+{
+    double times[kMaxSamples];
+    double values[kMaxSamples];
+    size_t count;
+    /// When the end position is reached, negative if the trial has no hold
+    double holdStart;
+} Trial;
+
+static uint64_t rngState = 88172645463325252ULL;
+
+/// Uniform in [0, 1), xorshift64 so the runs match on every platform.
+static double Uniform(void)
+{
+    rngState ^= rngState << 13;
+    rngState ^= rngState >> 7;
+    rngState ^= rngState << 17;
+    return (rngState >> 11) * (1.0 / 9007199254740992.0);
+}
+
+static double UniformIn(double low, double high)
+{
+    return low + (high - low) * Uniform();
+}
+
+/// Standard normal, Box-Muller.
+static double Gaussian(void)
+{
+    double u = Uniform();
+    double v = Uniform();
+    return sqrt(-2.0 * log(u + 1e-300)) * cos(2.0 * M_PI * v);
+}
+
+/// Fills the sample times of a trial of `duration` seconds at kSampleRate with a little jitter.
+static void FillTimes(Trial *trial, double duration)
+{
+    trial->count = 0;
+    for (size_t i = 0; i < kMaxSamples && i / kSampleRate < duration; i++)
+    {
+        trial->times[i] = (i + UniformIn(-0.1, 0.1)) / kSampleRate;
+        trial->count++;
+    }
+}
+
+/// Postural sway: a slow sine plus sensor noise, in degrees.
+static double Sway(double time, double amplitude, double frequency, double phase)
+{
+    return amplitude * sin(2.0 * M_PI * frequency * time + phase) + 0.2 * Gaussian();
+}
+
+/// Rest, a movement to the end position and a hold.
+static void MakeHold(const Kernel *kernel, Trial *trial)
+{
+    double rest = UniformIn(0.5, 1.5), move = UniformIn(1.0, 3.0), hold = UniformIn(3.0, 5.0);
+    double start = UniformIn(-5.0, 5.0), target = start + UniformIn(kernel->minTarget, kernel->maxTarget) * (Uniform() < 0.5 ? -1 : 1);
+    double phase = UniformIn(0, 2 * M_PI), amplitude = UniformIn(0.2, 0.8);
+    FillTimes(trial, rest + move + hold);
+    trial->holdStart = rest + move;
+    for (size_t i = 0; i < trial->count; i++)
+    {
+        double t = trial->times[i];
+        double x = t < rest ? 0.0 : t < rest + move ? (t - rest) / move : 1.0;
+        // Smooth minimum jerk like profile
+        double s = x * x * x * (10.0 - 15.0 * x + 6.0 * x * x);
+        trial->values[i] = start + (target - start) * s + Sway(t, amplitude, 0.3, phase);
+    }
+}
+
+/// A subject who never settles: rest with a larger sway for the whole trial.
+static void MakeRest(Trial *trial)
+{
+    double start = UniformIn(-5.0, 5.0), phase = UniformIn(0, 2 * M_PI);
+    double amplitude = UniformIn(0.5, 2.0), frequency = UniformIn(0.1, 0.5);
+    FillTimes(trial, 10.0);
+    trial->holdStart = -1.0;
+    for (size_t i = 0; i < trial->count; i++)
+    {
+        trial->values[i] = start + Sway(trial->times[i], amplitude, frequency, phase);
+    }
+}
+
+/// A slow continuous movement through the whole trial, 2 to 10 degrees per second, never held.
+static void MakeSlow(Trial *trial)
+{
+    double start = UniformIn(-5.0, 5.0), rate = UniformIn(2.0, 10.0) * (Uniform() < 0.5 ? -1 : 1);
+    double phase = UniformIn(0, 2 * M_PI);
+    FillTimes(trial, 15.0);
+    trial->holdStart = -1.0;
+    for (size_t i = 0; i < trial->count; i++)
+    {
+        double t = trial->times[i];
+        trial->values[i] = start + rate * t + Sway(t, 0.4, 0.3, phase);
+    }
+}
+
+/// Replays a trial, returns the time of the trigger or a negative value if none.
+static double Replay(const Kernel *kernel, const Trial *trial)
+{
+    StabilityDetectorState state;
+    StabilityDetectorInit(&state, &kernel->params);
+    for (size_t i = 0; i < trial->count; i++)
+    {
+        if (StabilityDetectorAdd(&state, trial->times[i], trial->values[i], NULL))
+        {
+            return trial->times[i];
+        }
+    }
+    return -1.0;
+}
+
+/// Prints a rate and counts it as a failure when out of its bound.
+static void CheckRate(const char *kernel, const char *name, double rate, double low, double high)
+{
+    int ok = rate >= low && rate <= high;
+    printf("%-14s %-34s %6.1f%% (bound %.1f%% - %.1f%%) %s\n", kernel, name, rate * 100.0, low * 100.0, high * 100.0, ok ? "ok" : "FAIL");
+    if (!ok)
+    {
+        failures++;
+    }
+}
+
+/// Replays kTrials trials of each kind through a kernel.
+static void ReplayKernel(const Kernel *kernel)
+{
+    static Trial trial;
+    size_t found = 0, early = 0, rest = 0, slow = 0;
+    double latency = 0.0;
+    for (int n = 0; n < kTrials; n++)
+    {
+        MakeHold(kernel, &trial);
+        double time = Replay(kernel, &trial);
+        if (time >= trial.holdStart)
+        {
+            found++;
+            latency += time - trial.holdStart;
+        }
+        else if (time >= 0)
+        {
+            early++;
+        }
+        MakeRest(&trial);
+        rest += Replay(kernel, &trial) >= 0;
+        MakeSlow(&trial);
+        slow += Replay(kernel, &trial) >= 0;
+    }
+    CheckRate(kernel->name, "real holds found", (double)found / kTrials, kMinHoldRate, 1.0);
+    CheckRate(kernel->name, "triggers before the hold", (double)early / kTrials, 0.0, 1.0 - kMinHoldRate);
+    CheckRate(kernel->name, "false triggers at rest", (double)rest / kTrials, 0.0, kMaxRestRate);
+    CheckRate(kernel->name, "false triggers in slow movement", (double)slow / kTrials, 0.0, kMaxSlowRate);
+    printf("%-14s %-34s %6.2f s\n", kernel->name, "mean delay after the hold starts", found ? latency / found : 0.0);
+}
+
+/// Times the detector over a long signal.
+static void Bench(void)
+{
+    static const size_t kSamples = 10000000;
+    StabilityDetectorParams params;
+    StabilityDetectorParamsDefault(&params);
+    StabilityDetectorState state;
+    StabilityDetectorInit(&state, &params);
+    size_t triggers = 0;
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (size_t i = 0; i < kSamples; i++)
+    {
+        // A slow sweep, moving and turning in turn
+        triggers += StabilityDetectorAdd(&state, i / kSampleRate, 20.0 * sin(i * 0.01), NULL);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) * 1e-9;
+    printf("%-49s %6.1f ns/sample (%zu)\n", "Detector update", seconds / kSamples * 1e9, triggers);
+}
+
+int main(void)
+{
+    Kernel kernels[3];
+    // The parameters of StabilityTrigger triggerForTestType:
+    for (int k = 0; k < 3; k++)
+    {
+        StabilityDetectorParamsDefault(&kernels[k].params);
+    }
+    kernels[0].name = "Sit and Reach";
+    kernels[0].params.window = 2.0;
+    kernels[0].minTarget = 20.0;
+    kernels[0].maxTarget = 40.0;
+    kernels[1].name = "Lunge";
+    kernels[1].minTarget = 25.0;
+    kernels[1].maxTarget = 50.0;
+    kernels[2].name = "Hip Rotation";
+    kernels[2].params.minExcursion = 5.0;
+    kernels[2].minTarget = 15.0;
+    kernels[2].maxTarget = 45.0;
+    for (int k = 0; k < 3; k++)
+    {
+        ReplayKernel(&kernels[k]);
+    }
+    Bench();
+    if (failures > 0)
+    {
+        printf("%d check(s) failed\n", failures);
+        return 1;
+    }
+    printf("All checks passed\n");
+    return 0;
+}
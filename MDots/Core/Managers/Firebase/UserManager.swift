@@ -211,8 +211,74 @@ final class UserManager {
             } else {
                 var updatedData = data
                 updatedData.removeAll { $0.id == item.id }
+                // Min, max, the trend and the asymmetry pairs cannot be undone, the test type is rebuilt from the remaining history
+                self.rebuildRollup(patientRef: patientRef, testType: testType, data: updatedData)
                 completion(updatedData)
             }
         }
     }
+
+    /// Fetches the rollup summary of a patient, series and asymmetry, with a single document read.
+    ///
+    /// - Parameters:
+    ///   - patient_id: The ID of the patient.
+    ///   - completion: Called with the summary, `nil` if there is none yet.
+    func fetchRollupSummary(patient_id: String, completion: @escaping (RollupSummary?) -> Void) {
+        guard let currentUserID = Auth.auth().currentUser?.uid else {
+            print("Error: Current user ID not available")
+            completion(nil)
+            return
+        }
+
+        let patientRef = Firestore.firestore().collection("users").document(currentUserID).collection("patients").document(patient_id)
+
+        PatientRollup.summaryDocument(ofPatient: patientRef).getDocument { snapshot, error in
+            if let error = error {
+                print("Error fetching rollups: \(error.localizedDescription)")
+                completion(nil)
+                return
+            }
+            completion(try? snapshot?.data(as: RollupSummary.self))
+        }
+    }
+
+    /// Rebuilds the rollup series whose result count no longer matches the history, e.g. tests added offline
+    /// or before rollups existed.
+    ///
+    /// - Parameters:
+    ///   - patient_id: The ID of the patient.
+    ///   - testType: The test type of the history.
+    ///   - data: The whole history of the test type.
+    func reconcileRollups(patient_id: String, testType: String, data: [MovementData]) {
+        guard let currentUserID = Auth.auth().currentUser?.uid else {
+            return
+        }
+
+        let patientRef = Firestore.firestore().collection("users").document(currentUserID).collection("patients").document(patient_id)
+
+        fetchRollupSummary(patient_id: patient_id) { summary in
+            let series = summary?.series ?? [:]
+            let stale = Set(data.map { $0.side }).contains { side in
+                series[PatientRollup.seriesKey(forTestType: testType, side: side)]?.count != data.filter { $0.side == side }.count
+            }
+            if stale {
+                self.rebuildRollup(patientRef: patientRef, testType: testType, data: data)
+            }
+        }
+    }
+
+    /// Rebuilds the rollup series and asymmetry of a test type from its history.
+    ///
+    /// - Parameters:
+    ///   - patientRef: The patient document.
+    ///   - testType: The test type.
+    ///   - data: The whole history of the test type.
+    private func rebuildRollup(patientRef: DocumentReference, testType: String, data: [MovementData]) {
+        PatientRollup.shared().replaceSeries(ofTestType: testType,
+                                             sides: data.map { $0.side },
+                                             values: data.map { NSNumber(value: $0.value) },
+                                             dates: data.map { $0.testDate },
+                                             patient: patientRef,
+                                             completion: nil)
+    }
 }
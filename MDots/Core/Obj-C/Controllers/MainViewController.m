@@ -10,6 +10,11 @@
 #import "MeasureViewController.h"
 #import "UIDeviceCategory.h"
 #import "UIViewCategory.h"
+#import "SyncCache.h"
+#import "MFMCalibrator.h"
+#import "FirmwareUpdateScheduler.h"
+#import "Tracer.h"
+#import "BodySegmentMap.h"
 
 #import <MBProgressHUD/MBProgressHUD.h>
 #import <MovellaDotSdk/DotDevice.h>
@@ -95,10 +100,20 @@
     self.navigationItem.rightBarButtonItem = item;
 }
 
-/// Creates a menu for the navigation bar item. For development purposes.
-/// @return nil.
+/// Creates a menu for the navigation bar item with the sensor maintenance actions.
+/// @return The menu.
 - (UIMenu *)createMenu{
-    return nil;
+    __weak __typeof(self) wself = self;
+    UIAction *calibrate = [UIAction actionWithTitle:@"Calibrate magnetic field" image:nil identifier:nil handler:^(__kindof UIAction * _Nonnull action) {
+        [wself calibrateMagneticField];
+    }];
+    UIAction *update = [UIAction actionWithTitle:@"Update firmware" image:nil identifier:nil handler:^(__kindof UIAction * _Nonnull action) {
+        [wself updateFirmware];
+    }];
+    UIAction *trace = [UIAction actionWithTitle:@"Start / stop trace" image:nil identifier:nil handler:^(__kindof UIAction * _Nonnull action) {
+        [wself toggleTrace];
+    }];
+    return [UIMenu menuWithTitle:@"" children:@[calibrate, update, trace]];
 }
 
 /// Sets up the views for the view controller.
@@ -183,6 +198,7 @@
     }
     [self.tableView reloadData];
     /// Start scan
+    TRACE_ASYNC_BEGIN("scan", (uintptr_t)self);
     [DotConnectionManager scan];
 }
 
@@ -209,6 +225,7 @@
 /// Disconnect all sensors.
 - (void)disconnectAll
 {
+    [[SyncCache sharedCache] invalidate];
     for (DotDevice *device in [DotDevicePool allBoundDevices])
     {
         /// Disconnect the sensor
@@ -220,30 +237,35 @@
     [self.connectList removeAllObjects];
 }
 
-/// Checks the number of connected sensors.
-/// @return A Boolean indicating whether the correct number of sensors are connected.
+/// Checks the number of connected sensors and that every body segment the test needs holds one.
+/// Missing segments take the sensors of their counterparts on the other side, so the same kit measures both sides without reassigning by hand; any other missing segment blocks START until the user assigns it.
+/// Sensors beyond the ones the test needs (up to one per segment) are measured too.
+/// @return A Boolean indicating whether the correct sensors are connected.
 - (Boolean)checkSensorsNumber
 {
-    if ([_testType isEqualToString:@"Sit and Reach"]) {
-        if(self.connectList.count != 2){
-            [self processInteger:2];
-            return false;
-        }
-        else return true;
-    } else if ([_testType isEqualToString:@"Lunge"]) {
-        if(self.connectList.count != 1){
-            [self processInteger:1];
-            return false;
-        }
-        else return true;
-    } else if ([_testType isEqualToString:@"Hip Rotation"]) {
-        if(self.connectList.count != 2){
-            [self processInteger:2];
-            return false;
-        }
-        else return true;
+    NSArray<NSNumber *> *segments = [BodySegmentMap requiredSegmentsForTestType:_testType side:_side];
+    if (segments.count == 0)
+    {
+        return false;
+    }
+    if (self.connectList.count < segments.count)
+    {
+        [self processInteger:(int)segments.count];
+        return false;
     }
-    return false;
+    if (self.connectList.count > BodySegmentCount)
+    {
+        [self showTextHud:[NSString stringWithFormat:@"Please connect at most %lu sensors", (unsigned long)BodySegmentCount]];
+        return false;
+    }
+    NSArray<NSNumber *> *missing = [[BodySegmentMap sharedMap] assignAddresses:[self.connectList valueForKey:@"macAddress"] toSegments:segments];
+    [self updateDeviceCellStatus];
+    if (missing.count > 0)
+    {
+        [self showTextHud:[NSString stringWithFormat:@"Please assign a sensor to the %@ (long press a sensor)", BodySegmentDisplayName(missing.firstObject.integerValue).lowercaseString]];
+        return false;
+    }
+    return true;
 }
 
 /// Displays a HUD indicating no sensors are connected.
@@ -284,6 +306,115 @@
     [hud hideAnimated:YES afterDelay:1.0f];
 }
 
+/// Runs the magnetic field mapping on the connected sensors that have no recent result.
+- (void)calibrateMagneticField
+{
+    if (self.connectList.count == 0)
+    {
+        [self showUnconnectHud];
+        return;
+    }
+    MFMCalibrator *calibrator = [MFMCalibrator sharedCalibrator];
+    if (calibrator.running)
+    {
+        [self showTextHud:@"Calibration already running"];
+        return;
+    }
+    if ([calibrator staleDevices:self.connectList].count == 0)
+    {
+        [self showTextHud:@"Sensors already calibrated"];
+        return;
+    }
+    MBProgressHUD *hud = [MBProgressHUD showHUDAddedTo:self.navigationController.view animated:YES];
+    hud.mode = MBProgressHUDModeDeterminateHorizontalBar;
+    hud.label.text = @"Rotate the sensors in all directions";
+    [hud.button setTitle:@"Cancel" forState:UIControlStateNormal];
+    [hud.button addTarget:calibrator action:@selector(cancel) forControlEvents:UIControlEventTouchUpInside];
+    __weak __typeof(self) wself = self;
+    [calibrator calibrateDevices:self.connectList progress:^(float progress) {
+        hud.progress = progress;
+    } completion:^(NSDictionary<NSString *,NSNumber *> * _Nonnull results) {
+        [hud hideAnimated:YES];
+        NSUInteger failed = 0;
+        for (NSNumber *result in results.allValues)
+        {
+            if (result.unsignedIntegerValue != XSDotMFMResultAcceptable && result.unsignedIntegerValue != XSDotMFMResultGood)
+            {
+                failed++;
+            }
+        }
+        [wself showTextHud:failed == 0 ? @"Calibration done" : [NSString stringWithFormat:@"Calibration failed on %lu sensors", (unsigned long)failed]];
+    }];
+}
+
+/// Checks every connected sensor for a firmware update and installs it, a few sensors at a time.
+- (void)updateFirmware
+{
+    if (self.connectList.count == 0)
+    {
+        [self showUnconnectHud];
+        return;
+    }
+    FirmwareUpdateScheduler *scheduler = [FirmwareUpdateScheduler sharedScheduler];
+    if (scheduler.running)
+    {
+        [self showTextHud:@"Firmware update already running"];
+        return;
+    }
+    MBProgressHUD *hud = [MBProgressHUD showHUDAddedTo:self.navigationController.view animated:YES];
+    hud.mode = MBProgressHUDModeDeterminateHorizontalBar;
+    hud.label.text = @"Updating firmware";
+    [hud.button setTitle:@"Cancel" forState:UIControlStateNormal];
+    [hud.button addTarget:scheduler action:@selector(cancel) forControlEvents:UIControlEventTouchUpInside];
+    __weak __typeof(self) wself = self;
+    [scheduler updateDevices:[self.connectList copy] progress:^(float progress, NSDictionary<NSString *,NSNumber *> * _Nonnull states) {
+        hud.progress = progress;
+        BOOL waiting = [states.allValues containsObject:@(FirmwareUpdateStateWaitingForCharge)];
+        hud.detailsLabel.text = waiting ? @"Put the sensors on their charger" : @"";
+    } completion:^(NSDictionary<NSString *,NSNumber *> * _Nonnull states) {
+        [hud hideAnimated:YES];
+        NSUInteger failed = 0;
+        for (NSNumber *state in states.allValues)
+        {
+            failed += state.integerValue == FirmwareUpdateStateFailed ? 1 : 0;
+        }
+        [wself showTextHud:failed == 0 ? @"Firmware up to date" : [NSString stringWithFormat:@"Update failed on %lu sensors", (unsigned long)failed]];
+    }];
+}
+
+/// Starts recording a trace, or stops it and exports it as Chrome trace JSON to Documents/Traces.
+- (void)toggleTrace
+{
+    if (!Tracer.running)
+    {
+        [Tracer start];
+        [self showTextHud:@"Tracing"];
+        return;
+    }
+    [Tracer stop];
+    NSURL *url = [Tracer defaultTraceURL];
+    NSError *error = nil;
+    if ([Tracer exportChromeTraceToURL:url error:&error])
+    {
+        [self showTextHud:[NSString stringWithFormat:@"Trace saved to %@", url.lastPathComponent]];
+    }
+    else
+    {
+        NSLog(@"Trace export failed: %@", error.localizedDescription);
+        [self showTextHud:@"Trace export failed"];
+    }
+}
+
+/// Displays a short text HUD.
+/// @param text The text to show.
+- (void)showTextHud:(NSString *)text
+{
+    MBProgressHUD *hud =  [MBProgressHUD showHUDAddedTo:self.navigationController.view animated:YES];
+    hud.mode = MBProgressHUDModeText;
+    hud.offset = CGPointMake(0, 200);
+    hud.label.text = text;
+    [hud hideAnimated:YES afterDelay:1.5f];
+}
 
 #pragma mark -- TouchEvent
 
@@ -299,6 +430,8 @@
         if (![self.connectList containsObject:device]) {
             [self.connectList addObject:device];
             /// connect a sensor
+            /// The trace id is the peripheral uuid, known from discovery; the mac address may only be read once connected
+            TRACE_ASYNC_BEGIN("connect", device.uuid.hash);
             [DotConnectionManager connect:device];
             /// add to DevicePool.
             /// Reconnection has Two conditions,please also unbind it after disconnected .
@@ -348,6 +481,7 @@
 /// Called when the Bluetooth scan is completed.
 - (void)onScanCompleted
 {
+    TRACE_ASYNC_END("scan", (uintptr_t)self);
     [self.tableView.mj_header endRefreshing];
 }
 
@@ -355,6 +489,7 @@
 /// @param device The device that failed to connect.
 - (void)onDeviceConnectFailed:(DotDevice *)device
 {
+    TRACE_ASYNC_END("connect", device.uuid.hash);
     [self updateDeviceCellStatus];
 }
 
@@ -362,20 +497,31 @@
 /// @param device The device that was disconnected.
 - (void)onDeviceDisconnected:(DotDevice *)device
 {
+    [[SyncCache sharedCache] invalidateForDevice:device];
     [self updateDeviceCellStatus];
 }
 
 /// Called when a device successfully connects.
+/// A reconnected device invalidates the cached sync, so the next synced measure re-syncs,
+/// and resumes its stream if a measurement is running.
 /// @param device The device that connected.
 - (void)onDeviceConnectSucceeded:(DotDevice *)device
 {
+    TRACE_ASYNC_END("connect", device.uuid.hash);
+    [[SyncCache sharedCache] invalidateForDevice:device];
     [self updateDeviceCellStatus];
+    UIViewController *topViewController = self.navigationController.topViewController;
+    if ([topViewController isKindOfClass:[MeasureViewController class]])
+    {
+        [(MeasureViewController *)topViewController deviceDidReconnect:device];
+    }
 }
 
 /// Called when a Dot device is discovered.
 /// @param device The discovered device.
 - (void)onDiscoverDevice:(DotDevice *)device
 {
+    TRACE_INSTANT("discover");
     NSInteger index = [self.deviceList indexOfObject:device];
     if(index == NSNotFound)
     {
@@ -472,4 +618,40 @@
     return DeviceConnectCell.cellHeight;
 }
 
+/// Offers the body segments a connected sensor can be assigned to.
+/// @param tableView The table view.
+/// @param indexPath The index path of the sensor.
+/// @param point The touch location.
+/// @return The menu configuration, or nil for a sensor that is not connected.
+- (UIContextMenuConfiguration *)tableView:(UITableView *)tableView contextMenuConfigurationForRowAtIndexPath:(NSIndexPath *)indexPath point:(CGPoint)point
+{
+    DotDevice *device = self.deviceList[indexPath.row];
+    if (![self.connectList containsObject:device])
+    {
+        return nil;
+    }
+    __weak __typeof(self) wself = self;
+    return [UIContextMenuConfiguration configurationWithIdentifier:nil previewProvider:nil actionProvider:^UIMenu * _Nullable(NSArray<UIMenuElement *> * _Nonnull suggestedActions) {
+        BodySegmentMap *map = [BodySegmentMap sharedMap];
+        BodySegment current = [map segmentForAddress:device.macAddress];
+        NSMutableArray<UIAction *> *actions = [NSMutableArray array];
+        for (BodySegment segment = BodySegmentPelvis; segment <= BodySegmentRightShank; segment++)
+        {
+            UIAction *action = [UIAction actionWithTitle:BodySegmentDisplayName(segment) image:nil identifier:nil handler:^(__kindof UIAction * _Nonnull action) {
+                [map setSegment:segment forAddress:device.macAddress];
+                [wself updateDeviceCellStatus];
+            }];
+            action.state = segment == current ? UIMenuElementStateOn : UIMenuElementStateOff;
+            [actions addObject:action];
+        }
+        UIAction *clear = [UIAction actionWithTitle:@"Unassign" image:nil identifier:nil handler:^(__kindof UIAction * _Nonnull action) {
+            [map setSegment:BodySegmentUnassigned forAddress:device.macAddress];
+            [wself updateDeviceCellStatus];
+        }];
+        clear.attributes = current == BodySegmentUnassigned ? UIMenuElementAttributesDisabled : 0;
+        [actions addObject:clear];
+        return [UIMenu menuWithTitle:@"Body segment" children:actions];
+    }];
+}
+
 @end
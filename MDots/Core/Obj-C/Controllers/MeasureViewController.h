@@ -40,6 +40,13 @@ NS_ASSUME_NONNULL_BEGIN
 /// ```
 - (void)setSide:(NSString *)side;
 
+/// Resumes the stream of a device that reconnected during a trial, once it is initialized again.
+/// @param device The device that reconnected.
+/// ```objc
+/// [measureViewController deviceDidReconnect:device];
+/// ```
+- (void)deviceDidReconnect:(DotDevice *)device;
+
 @end
 
 NS_ASSUME_NONNULL_END
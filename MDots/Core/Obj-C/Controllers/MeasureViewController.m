@@ -9,6 +9,23 @@
 #import "DeviceMeasureCell.h"
 #import "UIDeviceCategory.h"
 #import "UIViewCategory.h"
+#import "SyncCache.h"
+#import "SessionStore.h"
+#import "RecordingExporter.h"
+#import "PacketLossMonitor.h"
+#import "PayloadPlanner.h"
+#import "Tracer.h"
+#import "MetricsRegistry.h"
+#import "IngestExecutor.h"
+#import "BodySegmentMap.h"
+#import "JointAngleEngine.h"
+#import "RepetitionCounter.h"
+#import "StabilityTrigger.h"
+#import "MovementQuality.h"
+#import "TrialSession.h"
+#import "PatientRollup.h"
+#import "FusionEngine.h"
+#import "FreeAccelerationBatch.h"
 #import <MovellaDotSdk/DotSyncManager.h>
 #import <MovellaDotSdk/DotDefine.h>
 #import <MovellaDotSdk/DotUtils.h>
@@ -30,7 +47,8 @@
 @property (assign, nonatomic) UILabel *logFilePathLabel;
 @property (strong, nonatomic) UITableView *tableView;
 
-@property (strong, nonatomic) NSMutableArray *measures;
+/// euler triple per body segment (NSNumber of BodySegment)
+@property (strong, nonatomic, nullable) NSDictionary<NSNumber *, NSArray<NSNumber *> *> *measures;
 
 /// the progress hud of syncing.
 @property (assign, nonatomic) MBProgressHUD *syncingHud;
@@ -43,9 +61,48 @@
 @property (assign, nonatomic) BOOL syncResult;
 /// the sync flag(enable or disable sync)
 @property (assign, nonatomic) BOOL syncEnable;
+/// the record flag(record on the sensors and export after the trial instead of streaming)
+@property (assign, nonatomic) BOOL recordEnable;
+/// the auto capture flag(stop the streaming trial once the end position is held)
+@property (assign, nonatomic) BOOL autoCaptureEnable;
+/// the fusion flag(stream the sensors' increments and fuse the orientation on the phone instead of using the sensors' filter)
+@property (assign, nonatomic) BOOL fusionEnable;
+/// the orientation filter of the trial when fusion is enabled, nil otherwise
+@property (strong, nonatomic, nullable) FusionEngine *fusionEngine;
+/// the free acceleration workspace of recorded trials, reused between trials
+@property (strong, nonatomic) FreeAccelerationBatch *freeAccelerationBatch;
+/// the exporter used when recording on the sensors
+@property (strong, nonatomic) RecordingExporter *exporter;
+/// the gap detector on the streaming ingest path
+@property (strong, nonatomic) PacketLossMonitor *packetLossMonitor;
+/// the payload mode and output rate of the streaming trial
+@property (strong, nonatomic) PayloadPlan *payloadPlan;
+/// mac addresses of reconnected devices waiting to be initialized before their stream resumes
+@property (strong, nonatomic) NSMutableSet<NSString *> *pendingResumes;
+/// the per-device ingest queues of the streaming trial
+@property (strong, nonatomic) IngestExecutor *ingestExecutor;
+/// the live repetition segmentation of a streaming Lunge trial, nil otherwise
+@property (strong, nonatomic, nullable) RepetitionCounter *repetitionCounter;
+/// the held position detector of an auto capture trial, nil otherwise
+@property (strong, nonatomic, nullable) StabilityTrigger *stabilityTrigger;
+/// MetricsTimestamp of the STOP tap, 0 if none
+@property (assign, nonatomic) uint64_t stopTimestamp;
+/// the number of trials per session, 1 uploads every trial on its own
+@property (assign, nonatomic) NSUInteger trialCount;
+/// the trials of the session in progress, nil if a single trial is measured
+@property (strong, nonatomic, nullable) TrialSession *trialSession;
+/// the trial count control, locked while a session is in progress
+@property (strong, nonatomic) UISegmentedControl *trialControl;
+/// why the last trial gave no result when it was not missing data, e.g. a moving calibration pose, nil otherwise
+@property (strong, nonatomic, nullable) NSString *trialError;
 
 @end
 
+/// Seconds of samples reserved per device when a streaming trial starts
+static const NSUInteger kExpectedTrialDuration = 60;
+/// The trial counts offered per session
+static const NSUInteger kTrialCounts[] = {1, 3, 5};
+
 @implementation MeasureViewController
 
 /// Called after the controller’s view is loaded into memory.
@@ -92,6 +149,11 @@
     _syncResult = YES;
     _logEnable = NO;
     _syncEnable = NO;
+    _recordEnable = NO;
+    _autoCaptureEnable = NO;
+    _fusionEnable = NO;
+    _trialCount = 1;
+    _pendingResumes = [NSMutableSet set];
 }
 
 /// Configures the navigation items for the view controller.
@@ -144,10 +206,49 @@
     syncSwitch.on = _syncEnable;
     [syncSwitch addTarget:self action:@selector(handleSyncSwitch:) forControlEvents:UIControlEventTouchUpInside];
     
+    UILabel *recordTitle = [[UILabel alloc]initWithFrame:CGRectMake(syncSwitch.right + 15, edge, 70, 20)];
+    recordTitle.text = @"Record: ";
+    recordTitle.font = [UIFont boldSystemFontOfSize:16.f];
+    
+    UISwitch *recordSwitch = [[UISwitch alloc] initWithFrame:CGRectMake(recordTitle.right, edge - 5, 50, 30)];
+    recordSwitch.on = _recordEnable;
+    [recordSwitch addTarget:self action:@selector(handleRecordSwitch:) forControlEvents:UIControlEventTouchUpInside];
+    
+    UILabel *autoTitle = [[UILabel alloc]initWithFrame:CGRectMake(edge, syncStatusTitle.bottom + 15, 60, 20)];
+    autoTitle.text = @"Auto: ";
+    autoTitle.font = [UIFont boldSystemFontOfSize:16.f];
+    
+    UISwitch *autoSwitch = [[UISwitch alloc] initWithFrame:CGRectMake(autoTitle.right, autoTitle.top - 5, 50, 30)];
+    autoSwitch.on = _autoCaptureEnable;
+    [autoSwitch addTarget:self action:@selector(handleAutoSwitch:) forControlEvents:UIControlEventTouchUpInside];
+    
+    UILabel *trialTitle = [[UILabel alloc]initWithFrame:CGRectMake(autoSwitch.right + 15, autoTitle.top, 60, 20)];
+    trialTitle.text = @"Trials: ";
+    trialTitle.font = [UIFont boldSystemFontOfSize:16.f];
+    
+    UISegmentedControl *trialControl = [[UISegmentedControl alloc] initWithItems:@[@"1", @"3", @"5"]];
+    trialControl.frame = CGRectMake(trialTitle.right, autoTitle.top - 5, 120, 30);
+    for (NSUInteger i = 0; i < sizeof(kTrialCounts) / sizeof(kTrialCounts[0]); i++)
+    {
+        if (kTrialCounts[i] == _trialCount)
+        {
+            trialControl.selectedSegmentIndex = i;
+        }
+    }
+    [trialControl addTarget:self action:@selector(handleTrialControl:) forControlEvents:UIControlEventValueChanged];
+    
+    UILabel *fusionTitle = [[UILabel alloc]initWithFrame:CGRectMake(edge, autoTitle.bottom + 15, 70, 20)];
+    fusionTitle.text = @"Fusion: ";
+    fusionTitle.font = [UIFont boldSystemFontOfSize:16.f];
+    
+    UISwitch *fusionSwitch = [[UISwitch alloc] initWithFrame:CGRectMake(fusionTitle.right, fusionTitle.top - 5, 50, 30)];
+    fusionSwitch.on = _fusionEnable;
+    [fusionSwitch addTarget:self action:@selector(handleFusionSwitch:) forControlEvents:UIControlEventTouchUpInside];
+    
     
     CGRect frame = baseView.bounds;
-    frame.origin.y = syncStatusTitle.bottom + 10;
-    frame.size.height -= syncStatusTitle.bottom;
+    frame.origin.y = fusionTitle.bottom + 10;
+    frame.size.height -= fusionTitle.bottom;
     UITableView *tableView = [[UITableView alloc] initWithFrame:frame style:UITableViewStylePlain];
     tableView.showsVerticalScrollIndicator = NO;
     tableView.dataSource = self;
@@ -163,9 +264,18 @@
     [baseView addSubview:syncStatusLabel];
     [baseView addSubview:syncLabel];
     [baseView addSubview:syncSwitch];
+    [baseView addSubview:recordTitle];
+    [baseView addSubview:recordSwitch];
+    [baseView addSubview:autoTitle];
+    [baseView addSubview:autoSwitch];
+    [baseView addSubview:trialTitle];
+    [baseView addSubview:trialControl];
+    [baseView addSubview:fusionTitle];
+    [baseView addSubview:fusionSwitch];
     [baseView addSubview:tableView];
     
     self.syncStatusLabel = syncStatusLabel;
+    self.trialControl = trialControl;
     
 }
 
@@ -222,150 +332,494 @@
 /// Starts the real-time streaming measurement process.
 - (void)startMeasure
 {
+    self.stopTimestamp = 0;
+    self.repetitionCounter = nil;
+    self.stabilityTrigger = nil;
+    // One metrics session per uploaded test: a single trial, or every trial of a session, so the snapshot written
+    // with the upload covers all the trials it aggregates
+    if (self.trialCount > 1 && (self.trialSession == nil || self.trialSession.isComplete))
+    {
+        self.trialSession = [[TrialSession alloc] initWithTrialCount:self.trialCount];
+        [[MetricsRegistry sharedRegistry] beginSessionNamed:self.testType];
+    }
+    else if (self.trialSession == nil)
+    {
+        [[MetricsRegistry sharedRegistry] beginSessionNamed:self.testType];
+    }
+    [self refreshTrialTitle];
+    self.fusionEngine = nil;
+    if (self.recordEnable)
+    {
+        // The recording exports the acceleration and angular velocity, the orientation is fused again after the export
+        self.fusionEngine = self.fusionEnable ? [FusionEngine new] : nil;
+        [self startRecordingMeasure];
+        return;
+    }
+    TRACE_SCOPE("startMeasure");
     [self setupViews];
     self.startFlag = YES;
     self.tableView.hidden = NO;
+    self.payloadPlan = [[PayloadPlanner sharedPlanner] planForTestType:self.testType sensorCount:self.measureDevices.count fusion:self.fusionEnable];
+    NSLog(@"Streaming with %@", self.payloadPlan);
+    if (self.fusionEnable)
+    {
+        self.fusionEngine = [FusionEngine engineForPayloadMode:self.payloadPlan.payloadMode];
+        self.fusionEngine.sampleRate = self.payloadPlan.outputRate;
+    }
+    // Reserve a typical trial up front so no sample buffer grows while streaming
+    NSUInteger capacity = self.payloadPlan.outputRate * kExpectedTrialDuration;
+    SessionStore *store = [[SessionStore alloc] initWithAddresses:[self.measureDevices valueForKey:@"macAddress"] capacity:capacity];
+    self.packetLossMonitor = [[PacketLossMonitor alloc] initWithStore:store];
+    self.ingestExecutor = [[IngestExecutor alloc] initWithMonitor:self.packetLossMonitor];
+    // Streamed samples are fused live, so the display, the counter and the trigger see the fused angles
+    self.ingestExecutor.fusionEngine = self.fusionEngine;
+    __weak __typeof(self) wself = self;
+    self.ingestExecutor.displayBlock = ^(NSString *address, SessionSample sample) {
+        [wself refreshCellOfAddress:address sample:sample];
+        if (wself.repetitionCounter)
+        {
+            [wself refreshTrialTitle];
+        }
+    };
+    // Count the Lunge repetitions and watch for the held end position on the ingest queues, as the samples stream in
+    if ([self.testType isEqualToString:@"Lunge"])
+    {
+        self.repetitionCounter = [[RepetitionCounter alloc] initWithMetric:[RepetitionCounter lungeMetric]];
+    }
+    if (self.autoCaptureEnable)
+    {
+        self.stabilityTrigger = [StabilityTrigger triggerForTestType:self.testType];
+    }
+    RepetitionCounter *counter = self.repetitionCounter;
+    StabilityTrigger *trigger = self.stabilityTrigger;
+    NSString *counted = [self addressOfRequiredSegment:0 amongAddresses:store.addresses];
+    NSString *watched = trigger ? [self addressOfRequiredSegment:trigger.segmentIndex amongAddresses:store.addresses] : nil;
+    if (counter || trigger)
+    {
+        self.ingestExecutor.sampleBlock = ^(NSString *address, const SessionSample *sample) {
+            if (counter && [address isEqualToString:counted])
+            {
+                [counter addSample:sample];
+            }
+            if (trigger && [address isEqualToString:watched] && [trigger addSample:sample])
+            {
+                dispatch_async(dispatch_get_main_queue(), ^{
+                    [wself autoStopMeasure:trigger];
+                });
+            }
+        };
+    }
     for (DotDevice *device in self.measureDevices)
     {
-        device.plotMeasureMode = XSBleDevicePayloadCompleteEuler;
-        device.plotLogEnable = self.logEnable;
-        device.plotMeasureEnable = YES;
+        [self startStreaming:device];
     }
+    [self.ingestExecutor startDisplay];
+    [self promptCalibration];
 }
 
+/// Asks the patient to hold the neutral pose while the trial starts, for the tests calibrated from it.
+- (void)promptCalibration
+{
+    if ([self.testType isEqualToString:@"Hip Rotation"])
+    {
+        [self showTextHud:@"Hold the neutral pose"];
+    }
+}
 
-/// Sets up data plotting for a device.
-/// @param device The device for which to get plot data.
-- (void)getPlotData:(DotDevice *)device {
-    __block BOOL canSave = true;
-    
-    [device setDidParsePlotDataBlock:^(DotPlotData * _Nonnull
-                                       instant) {
-        if (canSave) {
-            
-            canSave = false;
-            
-            NSMutableArray *numArray = [[NSMutableArray alloc]initWithObjects:[NSNumber numberWithDouble:instant.euler0], [NSNumber numberWithDouble:instant.euler1], [NSNumber numberWithDouble:instant.euler2], nil];
-            
-            if (!self.measures) {
-                self.measures = [NSMutableArray array];
-            }
-            
-            [self.measures addObject: numArray];
+/// Registers the ingest block of a device, applies the payload plan and enables streaming, in one step.
+/// Used both when the trial starts and when a device resumes after a reconnect.
+/// @param device The device to stream from.
+- (void)startStreaming:(DotDevice *)device
+{
+    [self.ingestExecutor attachDevice:device];
+    [self.payloadPlan applyToDevice:device];
+    device.plotLogEnable = self.logEnable;
+    device.plotMeasureEnable = YES;
+}
+
+/// Resumes the stream of a device that reconnected during a trial.
+/// The gap is marked in the session so it is neither counted as loss nor interpolated.
+/// @param device The reconnected and initialized device.
+- (void)resumeStreaming:(DotDevice *)device
+{
+    [self.pendingResumes removeObject:device.macAddress];
+    if (!self.startFlag || self.recordEnable || ![self.measureDevices containsObject:device])
+    {
+        return;
+    }
+    NSLog(@"Resuming stream of %@", device.macAddress);
+    [self.packetLossMonitor restartStreamForAddress:device.macAddress];
+    [self startStreaming:device];
+}
+
+- (void)deviceDidReconnect:(DotDevice *)device
+{
+    if (!self.startFlag || self.recordEnable || ![self.measureDevices containsObject:device])
+    {
+        return;
+    }
+    [self.packetLossMonitor noteReconnectForAddress:device.macAddress];
+    [[[MetricsRegistry sharedRegistry] counterNamed:@"reconnects"] increment];
+    if ([device isInitialized])
+    {
+        [self resumeStreaming:device];
+    }
+    else
+    {
+        // Wait for kDotNotificationDeviceInitialized, the device does not accept commands before it
+        [self.pendingResumes addObject:device.macAddress];
+    }
+}
+
+/// Shows a sample in the cell of its device, if the cell is visible.
+/// @param address The device mac address.
+/// @param sample The sample.
+- (void)refreshCellOfAddress:(NSString *)address sample:(SessionSample)sample
+{
+    TRACE_SCOPE("refreshCell");
+    NSUInteger row = [[self.measureDevices valueForKey:@"macAddress"] indexOfObject:address];
+    if (row == NSNotFound)
+    {
+        return;
+    }
+    DeviceMeasureCell *cell = [self.tableView cellForRowAtIndexPath:[NSIndexPath indexPathForRow:row inSection:0]];
+    [cell refreshSample:sample];
+}
+
+/// Shows the trial of the session in progress and the live repetition count in the title.
+- (void)refreshTrialTitle
+{
+    NSMutableString *title = [NSMutableString stringWithString:@"Measure"];
+    if (self.trialSession)
+    {
+        NSUInteger trial = MIN(self.trialSession.trials.count + 1, self.trialSession.trialCount);
+        [title appendFormat:@" %lu/%lu", (unsigned long)trial, (unsigned long)self.trialSession.trialCount];
+    }
+    if (self.repetitionCounter)
+    {
+        [title appendFormat:@" (%lu reps)", (unsigned long)self.repetitionCounter.count];
+    }
+    self.title = title;
+}
+
+/// Builds the measures from the samples every device took at the same instant: the newest timestamp all devices have reached.
+/// Devices without a body segment are left out.
+/// @param store The session store.
+/// @return The euler triple per body segment, or nil if a device has no sample.
+- (nullable NSDictionary<NSNumber *, NSArray<NSNumber *> *> *)measuresFromStore:(SessionStore *)store
+{
+    UInt32 timeStamp;
+    if (![store getLatestCommonTimeStamp:&timeStamp])
+    {
+        return nil;
+    }
+    BodySegmentMap *map = [BodySegmentMap sharedMap];
+    NSMutableDictionary *measures = [NSMutableDictionary dictionaryWithCapacity:store.addresses.count];
+    for (NSString *address in store.addresses)
+    {
+        BodySegment segment = [map segmentForAddress:address];
+        SessionSample sample;
+        if (segment == BodySegmentUnassigned || ![store getSample:&sample atTimeStamp:timeStamp forAddress:address])
+        {
+            continue;
         }
-    }];
+        measures[@(segment)] = @[@(sample.euler[0]), @(sample.euler[1]), @(sample.euler[2])];
+    }
+    return measures;
+}
+
+/// The sensor on one of the body segments the test needs.
+/// @param index The index in `+[BodySegmentMap requiredSegmentsForTestType:side:]`.
+/// @param addresses The candidate mac addresses.
+/// @return The mac address, or nil if no sensor holds the segment.
+- (nullable NSString *)addressOfRequiredSegment:(NSUInteger)index amongAddresses:(NSArray<NSString *> *)addresses
+{
+    NSArray<NSNumber *> *segments = [BodySegmentMap requiredSegmentsForTestType:self.testType side:self.side];
+    return index < segments.count ? [[BodySegmentMap sharedMap] addressForSegment:segments[index].integerValue amongAddresses:addresses] : nil;
+}
+
+/// The euler triple of one of the body segments the test needs.
+/// @param index The index in `+[BodySegmentMap requiredSegmentsForTestType:side:]`.
+/// @return The euler triple, or nil if the segment was not measured.
+- (nullable NSArray<NSNumber *> *)measureOfRequiredSegment:(NSUInteger)index
+{
+    NSArray<NSNumber *> *segments = [BodySegmentMap requiredSegmentsForTestType:self.testType side:self.side];
+    return index < segments.count ? self.measures[segments[index]] : nil;
 }
 
 /// Uploads test data to Firebase.
+/// Waits for every sample received before STOP to be ingested, then takes the last sample of each device.
 /// @param devices The devices whose data will be uploaded.
-/// @warning 1 second delay before uploading data to Firebase to ensure most recent data is uploaded.
 - (void)uploadTestData:(NSArray *)devices {
-    // Switch statement based on the testType string
-    for (DotDevice *device in self.measureDevices)
+    uintptr_t traceId = (uintptr_t)self;
+    TRACE_ASYNC_BEGIN("uploadTestData", traceId);
+    IngestExecutor *executor = self.ingestExecutor;
+    SessionStore *store = self.packetLossMonitor.store;
+    __weak __typeof(self) wself = self;
+    [executor drainWithCompletion:^{
+        TRACE_ASYNC_END("uploadTestData", traceId);
+        [executor invalidate];
+        if (![wself uploadMeasuresFromStore:store])
+        {
+            [wself showTextHud:wself.trialError ?: @"No measured data"];
+        }
+    }];
+}
+
+/// Checks that every body segment the test needs was measured.
+/// @return YES if `uploadMeasuresFromStore:` can compute the result.
+- (BOOL)hasRequiredMeasures
+{
+    for (NSNumber *segment in [BodySegmentMap requiredSegmentsForTestType:self.testType side:self.side])
+    {
+        if (self.measures[segment] == nil)
+        {
+            return NO;
+        }
+    }
+    return YES;
+}
+
+/// Computes the test result from the samples of a trial and uploads it.
+/// In a multi-trial session the trial is added to the session instead, and the session is uploaded as one test once its last trial is in.
+/// @param store The session store of the trial.
+/// @return NO if a body segment the test needs has no sample.
+- (BOOL)uploadMeasuresFromStore:(SessionStore *)store {
+    TRACE_SCOPE("uploadMeasures");
+    double result = 0;
+    NSMutableDictionary *extraFields = [NSMutableDictionary dictionary];
+    if (![self getTrialResult:&result fields:extraFields fromStore:store])
+    {
+        return NO;
+    }
+    if (self.fusionEngine)
+    {
+        // Tells the results of the phone's filter from those of the sensors' filter, e.g. in the bulk export. They share the series and the norms:
+        // every result reads angles referenced to gravity, which both filters agree on; only the heading differs without magnetometer
+        extraFields[@"orientation"] = @"phoneFusion";
+    }
+    TrialSession *session = self.trialSession;
+    if (session == nil)
+    {
+        [self uploadToFirebaseWithResult:result extraFields:extraFields];
+        return YES;
+    }
+    if (![session addTrialWithValue:result side:self.side fields:extraFields])
+    {
+        // e.g. an internal rotation in a session of external ones, its median would mean nothing
+        [self showTextHud:[NSString stringWithFormat:@"Trial not saved: side %@ differs from %@", self.side, session.side]];
+        return YES;
+    }
+    if (!session.isComplete)
+    {
+        [self showTextHud:[NSString stringWithFormat:@"Trial %lu of %lu saved", (unsigned long)session.trials.count, (unsigned long)session.trialCount]];
+        [self refreshTrialTitle];
+        return YES;
+    }
+    [self uploadTrialSession:session];
+    self.trialSession = nil;
+    [self refreshTrialTitle];
+    return YES;
+}
+
+/// Uploads a complete session as one test: the median of the accepted trials is the value, under the side of the session,
+/// the trial closest to it gives the fields, and every trial is kept under `session`.
+/// @param session The complete session.
+- (void)uploadTrialSession:(TrialSession *)session
+{
+    RobustSummary summary;
+    if (![session getSummary:&summary])
     {
-        [self getPlotData: device];
-    }
-    dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(1 * NSEC_PER_SEC)), dispatch_get_main_queue(), ^{
-                // Code inside this block will execute after a 1-second delay
-                double result = 0;
-                if ([self->_testType isEqualToString:@"Sit and Reach"]) {
-                    
-                    NSArray *firstInnerArray = self.measures[0];
-                    NSNumber *firstDoubleNumber = firstInnerArray[1];
-                    
-                    NSArray *secondInnerArray = self.measures[1];
-                    NSNumber *secondDoubleNumber = secondInnerArray[1];
-                    
-                    if(firstDoubleNumber.doubleValue > secondDoubleNumber.doubleValue) {
-                        result = firstDoubleNumber.doubleValue - secondDoubleNumber.doubleValue;
-                    } else {
-                        result = secondDoubleNumber.doubleValue - firstDoubleNumber.doubleValue;
-                    }
-                    
-                    //NSLog(@"resta: %f", result);
-                } else if ([self->_testType isEqualToString:@"Lunge"]) {
-                    NSLog(@"Test Type lunge selected");
-                    NSArray *firstInnerArray = self.measures[0];
-                    NSNumber *firstDoubleNumber = firstInnerArray[1];
-                    result = fabs(firstDoubleNumber.doubleValue);
-                    
-                } else if ([self->_testType isEqualToString:@"Hip Rotation"]) {
-                    NSLog(@"Test Type hip rotation selected");
-                    NSArray *firstInnerArray = self.measures[0];
-                    NSNumber *firstYNumber = firstInnerArray[1];
-                    NSNumber *firstXNumber = firstInnerArray[0];
-                    
-                    NSArray *secondInnerArray = self.measures[1];
-                    NSNumber *secondYNumber = secondInnerArray[1];
-                    NSNumber *secondXNumber = secondInnerArray[0];
-                    
-                    if(self.side.length>1){
-                        self.side = [self.side substringToIndex:1];
-                    }
-                    //the smaller one is in the femur positon because its looking up
-                    if(firstYNumber.doubleValue > secondYNumber.doubleValue){
-                        if ([self->_side isEqualToString:@"L"]) {
-                            //For left leg: if x number of tibial is positive its external otherwise interrnal rotation
-                            //External rotation
-                            if(firstXNumber.doubleValue > 0){
-                                self.side = [self.side stringByAppendingString:@"e"];
-                                result = 90 - firstYNumber.doubleValue - secondXNumber.doubleValue;
-                            } else { //Internal rotation
-                                self.side = [self.side stringByAppendingString:@"i"];
-                                result = 90 - firstYNumber.doubleValue + secondXNumber.doubleValue;
-                            }
-                        } else {
-                            //For right leg: if x number of tibial is positive its internal otherwise external rotation
-                            //Internal rotation
-                            if(firstXNumber.doubleValue > 0){
-                                self.side = [self.side stringByAppendingString:@"i"];
-                                result = 90 - firstYNumber.doubleValue - secondXNumber.doubleValue;
-                            } else { //External rotation
-                                self.side = [self.side stringByAppendingString:@"e"];
-                                result = 90 - firstYNumber.doubleValue + secondXNumber.doubleValue;
-                            }
-                        }
-                        
-                    } else {
-                        if ([self->_side isEqualToString:@"L"]) {
-                            //For left leg: if x number of tibial is positive its external otherwise interrnal rotation
-                            //External rotation
-                            if(secondXNumber.doubleValue > 0){
-                                self.side = [self.side stringByAppendingString:@"e"];
-                                result = 90 - secondYNumber.doubleValue - firstXNumber.doubleValue;
-                            } else { //Internal rotation
-                                self.side = [self.side stringByAppendingString:@"i"];
-                                result = 90 - secondYNumber.doubleValue + firstXNumber.doubleValue;
-                            }
-                        } else {
-                            //For right leg: if x number of tibial is positive its internal otherwise external rotation
-                            //Internal rotation
-                            if(secondXNumber.doubleValue > 0){
-                                self.side = [self.side stringByAppendingString:@"i"];
-                                result = 90 - secondYNumber.doubleValue - firstXNumber.doubleValue;
-                            } else { //External rotation
-                                self.side = [self.side stringByAppendingString:@"e"];
-                                result = 90 - secondYNumber.doubleValue + firstXNumber.doubleValue;
-                            }
-                        }
-                    }
-                    
-                }
+        return;
+    }
+    NSArray<NSDictionary *> *trials = session.trials;
+    NSDictionary *representative = trials.firstObject;
+    for (NSDictionary *trial in trials)
+    {
+        if (fabs([trial[@"value"] doubleValue] - summary.median) < fabs([representative[@"value"] doubleValue] - summary.median))
+        {
+            representative = trial;
+        }
+    }
+    NSMutableDictionary *extraFields = [representative mutableCopy];
+    [extraFields removeObjectForKey:@"value"];
+    [extraFields removeObjectForKey:@"side"];
+    extraFields[@"session"] = [session aggregate];
+    self.side = session.side;
+    [self uploadToFirebaseWithResult:summary.median extraFields:extraFields];
+}
+
+/// Computes the test result of a trial and the fields of its analysis.
+/// @param result The result out.
+/// @param fields The fields out: segments, repetitions, quality and auto capture.
+/// @param store The session store of the trial.
+/// @return NO if a body segment the test needs has no sample, or `trialError` tells why the result cannot be computed.
+- (BOOL)getTrialResult:(double *)result fields:(NSMutableDictionary<NSString *, id> *)fields fromStore:(SessionStore *)store
+{
+    self.trialError = nil;
+    self.measures = [self measuresFromStore:store];
+    if (![self hasRequiredMeasures])
+    {
+        self.measures = nil;
+        return NO;
+    }
+    if ([self->_testType isEqualToString:@"Sit and Reach"]) {
+        
+        NSArray *firstInnerArray = [self measureOfRequiredSegment:0];
+        NSNumber *firstDoubleNumber = firstInnerArray[1];
+        
+        NSArray *secondInnerArray = [self measureOfRequiredSegment:1];
+        NSNumber *secondDoubleNumber = secondInnerArray[1];
         
-                [self uploadToFirebaseWithResult:result];
+        if(firstDoubleNumber.doubleValue > secondDoubleNumber.doubleValue) {
+            *result = firstDoubleNumber.doubleValue - secondDoubleNumber.doubleValue;
+        } else {
+            *result = secondDoubleNumber.doubleValue - firstDoubleNumber.doubleValue;
+        }
         
-            });
+        //NSLog(@"resta: %f", result);
+        // Only recordings export the acceleration, streaming payloads carry none
+        NSString *pelvis = [self addressOfRequiredSegment:0 amongAddresses:store.addresses];
+        if (self.recordEnable && pelvis)
+        {
+            if (self.freeAccelerationBatch == nil)
+            {
+                self.freeAccelerationBatch = [FreeAccelerationBatch new];
+            }
+            fields[@"pelvisDisplacement"] = @([self.freeAccelerationBatch peakDisplacementForStore:store address:pelvis]);
+        }
+    } else if ([self->_testType isEqualToString:@"Lunge"]) {
+        NSLog(@"Test Type lunge selected");
+        NSArray *firstInnerArray = [self measureOfRequiredSegment:0];
+        NSNumber *firstDoubleNumber = firstInnerArray[1];
+        *result = fabs(firstDoubleNumber.doubleValue);
+        // The deepest repetition replaces the value at STOP, recordings are segmented after the export
+        RepetitionCounter *counter = self.repetitionCounter;
+        if (counter == nil)
+        {
+            counter = [[RepetitionCounter alloc] initWithMetric:[RepetitionCounter lungeMetric]];
+            [counter addSamplesFromStore:store address:[self addressOfRequiredSegment:0 amongAddresses:store.addresses]];
+        }
+        double peak;
+        if ([counter getBestPeak:&peak])
+        {
+            *result = peak;
+            fields[@"repetitions"] = [counter summary];
+        }
+        
+    } else if ([self->_testType isEqualToString:@"Hip Rotation"]) {
+        NSLog(@"Test Type hip rotation selected");
+        double rotation = 0;
+        if (![self getHipRotation:&rotation fromStore:store])
+        {
+            self.measures = nil;
+            return NO;
+        }
+        if(self.side.length>1){
+            self.side = [self.side substringToIndex:1];
+        }
+        //Positive tilt of the tibial sensor is external for the left leg and internal for the right leg
+        if ((rotation > 0) == [self->_side isEqualToString:@"L"]) {
+            self.side = [self.side stringByAppendingString:@"e"];
+        } else {
+            self.side = [self.side stringByAppendingString:@"i"];
+        }
+        *result = fabs(rotation);
+    }
+        
+    NSDictionary *quality = [self movementQualityOfStore:store];
+    if (quality.count > 0)
+    {
+        fields[@"quality"] = quality;
+    }
+    if (self.stabilityTrigger.triggered)
+    {
+        fields[@"autoCapture"] = @{ @"heldValue": @(self.stabilityTrigger.heldValue) };
+    }
+    NSMutableDictionary *segments = [NSMutableDictionary dictionaryWithCapacity:self.measures.count];
+    [self.measures enumerateKeysAndObjectsUsingBlock:^(NSNumber *segment, NSArray<NSNumber *> *euler, BOOL *stop) {
+        segments[BodySegmentKey(segment.integerValue)] = euler;
+    }];
+    fields[@"segments"] = segments;
+    self.measures = nil;
+    return YES;
+}
+
+/// Analyses how smoothly every measured body segment moved during a trial.
+/// @param store The session store of the trial.
+/// @return The `MovementQuality` result per segment key.
+- (NSDictionary<NSString *, NSDictionary *> *)movementQualityOfStore:(SessionStore *)store
+{
+    TRACE_SCOPE("movementQuality");
+    MovementQuality *analysis = [MovementQuality sharedQuality];
+    BodySegmentMap *map = [BodySegmentMap sharedMap];
+    NSMutableDictionary *quality = [NSMutableDictionary dictionary];
+    for (NSString *address in store.addresses)
+    {
+        BodySegment segment = [map segmentForAddress:address];
+        MovementQualityResult result;
+        if (segment != BodySegmentUnassigned && [analysis analyzeStore:store address:address result:&result])
+        {
+            quality[BodySegmentKey(segment)] = [MovementQuality dictionaryWithResult:result];
+        }
+    }
+    return quality;
+}
+
+/// Computes the hip rotation of a trial: how far the shank tilted sideways in the world frame, as the femur turns about its own axis,
+/// at the last instant every sensor reached, from the neutral pose held during the first half second of the trial (see `promptCalibration`).
+/// The thigh turns with the shank when the knee is held still, so the angle between the two does not show the hip rotation.
+/// @param rotation The rotation out, in degrees, positive about the shank sensor x axis.
+/// @param store The session store of the trial.
+/// @return NO if the shank sensor has no sample, or if the leg moved during the calibration (`trialError` is then set).
+- (BOOL)getHipRotation:(double *)rotation fromStore:(SessionStore *)store
+{
+    NSString *shank = [self addressOfRequiredSegment:1 amongAddresses:store.addresses];
+    UInt32 timeStamp;
+    SessionSample distal;
+    if (shank == nil || ![store getLatestCommonTimeStamp:&timeStamp] || ![store getSample:&distal atTimeStamp:timeStamp forAddress:shank])
+    {
+        return NO;
+    }
+    JointAngleEngine *engine = [JointAngleEngine new];
+    if (![engine calibrateTiltFromStore:store address:shank])
+    {
+        if (engine.calibrationSpread > engine.calibrationTolerance)
+        {
+            self.trialError = [NSString stringWithFormat:@"Leg moved %.0f° during calibration, hold still at START", engine.calibrationSpread];
+        }
+        return NO;
+    }
+    *rotation = [engine tiltOfSample:distal];
+    return YES;
 }
 
 /// Uploads test data to Firebase with the provided result.
 /// @param result The result value to upload.
-- (void)uploadToFirebaseWithResult:(double)result {
+/// @param extraFields Fields of the test analysis to store with the result, e.g. the segments.
+- (void)uploadToFirebaseWithResult:(double)result extraFields:(NSDictionary<NSString *, id> *)extraFields {
+    TRACE_SCOPE("uploadToFirebaseWithResult");
     NSNumber *resultNumber = @(result);
-    NSDictionary *testData = @{
+    NSMutableDictionary *testData = [@{
         @"testDate": [FIRTimestamp timestampWithDate:[NSDate date]],
         @"value": resultNumber,
         @"side": _side
-    };
+    } mutableCopy];
+    [testData addEntriesFromDictionary:extraFields];
+    MetricsRegistry *metrics = [MetricsRegistry sharedRegistry];
+    if (self.packetLossMonitor)
+    {
+        NSDictionary<NSString *, NSDictionary *> *summary = [self.packetLossMonitor summary];
+        testData[@"packetLoss"] = summary;
+        testData[@"trusted"] = @([self.packetLossMonitor isTrustworthy]);
+        [summary enumerateKeysAndObjectsUsingBlock:^(NSString *address, NSDictionary *stats, BOOL *stop) {
+            [metrics gaugeNamed:[NSString stringWithFormat:@"lossRate.%@", address]].value = [stats[@"lossRate"] doubleValue];
+        }];
+        SessionArenaStats arena = self.packetLossMonitor.store.allocationStats;
+        [metrics gaugeNamed:@"arena.allocations"].value = arena.allocations;
+        [metrics gaugeNamed:@"arena.systemAllocations"].value = arena.systemAllocations;
+        [metrics gaugeNamed:@"arena.bytesReserved"].value = arena.bytesReserved;
+    }
     
     FIRFirestore *db = [FIRFirestore firestore];
     FIRAuth *auth = [FIRAuth auth];
@@ -374,6 +828,7 @@
     FIRUser *currentUser = auth.currentUser;
     if (!currentUser) {
         NSLog(@"Error: Current user not available.");
+        [[metrics counterNamed:@"firestore.failures"] increment];
         return;
     }
     NSString *currentUserID = currentUser.uid;
@@ -384,61 +839,186 @@
     // Access the specific patient document using patientID
     FIRDocumentReference *patientDocRef = [patientsRef documentWithPath: self.patientID];
     
-    FIRCollectionReference *testRef = [patientDocRef collectionWithPath: self.testType];
-    
-    // Save data to the lunge test collection
-    [testRef addDocumentWithData:testData completion:^(NSError * _Nullable error) {
+    // Save data to the test type collection and fold it into the patient rollup
+    uintptr_t traceId = (uintptr_t)testData;
+    TRACE_ASYNC_BEGIN("firestoreWrite", traceId);
+    uint64_t writeStart = MetricsTimestamp();
+    uint64_t stopTimestamp = self.stopTimestamp;
+    [[PatientRollup sharedRollup] addTestData:testData testType:self.testType patient:patientDocRef completion:^(NSError * _Nullable error) {
+        TRACE_ASYNC_END("firestoreWrite", traceId);
+        uint64_t now = MetricsTimestamp();
+        [[metrics histogramNamed:@"latency.firestoreWrite"] recordValue:now - writeStart];
         if (error != nil) {
             NSLog(@"Error uploading test data: %@", error.localizedDescription);
+            [[metrics counterNamed:@"firestore.failures"] increment];
         } else {
             NSLog(@"Test data uploaded successfully.");
+            [[metrics counterNamed:@"firestore.writes"] increment];
+            if (stopTimestamp > 0)
+            {
+                [[metrics histogramNamed:@"latency.stopToUpload"] recordValue:now - stopTimestamp];
+            }
+        }
+        NSError *snapshotError = nil;
+        if (![metrics writeSnapshotWithError:&snapshotError])
+        {
+            NSLog(@"Metrics snapshot failed: %@", snapshotError.localizedDescription);
+        }
+    }];
+}
+
+/// Starts recording the trial on the sensors' flash.
+- (void)startRecordingMeasure
+{
+    SessionStore *store = [[SessionStore alloc] initWithDevices:self.measureDevices];
+    self.packetLossMonitor = nil;
+    self.exporter = [[RecordingExporter alloc] initWithDevices:self.measureDevices store:store];
+    
+    __weak __typeof(self) wself = self;
+    [self.exporter startRecordingWithCompletion:^(BOOL success) {
+        if (success)
+        {
+            wself.startFlag = YES;
+            [wself promptCalibration];
+        }
+        else
+        {
+            [wself.exporter stopRecording];
+            [wself showTextHud:@"Recording not available"];
         }
     }];
 }
 
+/// Stops recording, exports every sensor in parallel and uploads the result from the last exported samples.
+- (void)stopRecordingMeasure
+{
+    [self.exporter stopRecording];
+    
+    MBProgressHUD *hud = [MBProgressHUD showHUDAddedTo:self.navigationController.view animated:YES];
+    hud.mode = MBProgressHUDModeDeterminateHorizontalBar;
+    hud.label.text = NSLocalizedString(@"Exporting...", @"Export title");
+    [hud.button setTitle:NSLocalizedString(@"Cancel", @"Cancel export") forState:UIControlStateNormal];
+    [hud.button addTarget:self.exporter action:@selector(cancel) forControlEvents:UIControlEventTouchUpInside];
+    
+    __weak __typeof(self) wself = self;
+    [self.exporter exportWithProgress:^(float progress) {
+        hud.progress = progress;
+    } completion:^(BOOL success) {
+        [hud hideAnimated:YES];
+        if (!success)
+        {
+            // The recording stays on the sensors until an export succeeds
+            [wself showTextHud:@"Export fail"];
+            return;
+        }
+        SessionStore *store = wself.exporter.store;
+        if (wself.fusionEngine)
+        {
+            store = [wself.fusionEngine reprocessStore:store];
+        }
+        if (![wself uploadMeasuresFromStore:store])
+        {
+            [wself showTextHud:wself.trialError ?: @"No recorded data"];
+        }
+    }];
+}
+
+/// Shows a short text message.
+/// @param text The message.
+- (void)showTextHud:(NSString *)text
+{
+    MBProgressHUD *hud =  [MBProgressHUD showHUDAddedTo:self.navigationController.view animated:YES];
+    hud.mode = MBProgressHUDModeText;
+    hud.offset = CGPointMake(0, 200);
+    hud.label.text = text;
+    [hud hideAnimated:YES afterDelay:1.0f];
+}
+
 /// Cancels the measurement process.
 - (void)cancelMeasurement
 {
     self.startFlag = NO;
+    if (self.recordEnable)
+    {
+        [self.exporter stopRecording];
+        [self.exporter cancel];
+    }
     
     for (DotDevice *device in self.measureDevices)
     {
         device.plotMeasureEnable = NO;
-        
     }
-    self.measures = [NSMutableArray array];
+    // Releases the plot blocks, then the session store and its arena in one go
+    [self.ingestExecutor invalidate];
+    self.ingestExecutor = nil;
+    self.packetLossMonitor = nil;
+    self.measures = nil;
+    self.trialSession = nil;
+    [self refreshTrialTitle];
     NSLog(@"Measurement canceled successfully.");
 }
 
 /// Stops the real-time streaming measurement process and uploads the test data.
 - (void)stopMeasure
 {
+    self.stopTimestamp = MetricsTimestamp();
     self.startFlag = NO;
-    [self uploadTestData: self.measureDevices];
-    
+    if (self.recordEnable)
+    {
+        [self stopRecordingMeasure];
+        return;
+    }
     for (DotDevice *device in self.measureDevices)
     {
         device.plotMeasureEnable = NO;
-        
     }
-    self.measures = [NSMutableArray array];
+    [self uploadTestData: self.measureDevices];
+}
+
+/// Stops an auto capture trial once its end position is held, as if STOP was tapped.
+/// @param trigger The trigger that fired.
+- (void)autoStopMeasure:(StabilityTrigger *)trigger
+{
+    if (!self.startFlag || trigger != self.stabilityTrigger)
+    {
+        return;
+    }
+    [self showTextHud:@"Position held"];
+    [self stopMeasure];
 }
 
 /// Starts the synchronization process.
+/// @discussion If the same devices were synced recently and all of them still report `isSynced`, the sync is skipped and the measurement starts straight away.
 - (void)startSync
 {
+    if ([[SyncCache sharedCache] isValidForDevices:self.measureDevices])
+    {
+        self.syncStatusLabel.text = @"Synced";
+        [self startMeasure];
+        return;
+    }
+    
+    uintptr_t traceId = (uintptr_t)self;
+    TRACE_ASYNC_BEGIN("sync", traceId);
     __weak __typeof(self) wself = self;
     DotSyncResultBlock block = ^(NSArray *array)
     {
+        TRACE_ASYNC_END("sync", traceId);
+        BOOL allSuccess = array.count == wself.measureDevices.count;
         for (int i = 0; i < array.count; i++)
         {
             NSDictionary *resultDic = array[i];
             wself.syncResult |= [[resultDic objectForKey:@"success"] boolValue];
+            allSuccess &= [[resultDic objectForKey:@"success"] boolValue];
         }
         
         [wself hideProgressHud];
         if (wself.syncResult)
         {
+            if (allSuccess)
+            {
+                [[SyncCache sharedCache] recordSyncForDevices:wself.measureDevices];
+            }
             wself.syncStatusLabel.text = @"Success";
             [wself startMeasure];
         }
@@ -526,9 +1106,78 @@
     self.syncEnable = sender.on;
 }
 
+/// Handles the tap event for the auto capture switch.
+/// @param sender The switch object.
+- (void)handleAutoSwitch:(UISwitch *)sender
+{
+    if (self.startFlag)
+    {
+        sender.on = self.autoCaptureEnable;
+        return;
+    }
+    self.autoCaptureEnable = sender.on;
+}
+
+/// Handles the tap event for the fusion switch.
+/// @param sender The switch object.
+- (void)handleFusionSwitch:(UISwitch *)sender
+{
+    if (self.startFlag)
+    {
+        sender.on = self.fusionEnable;
+        return;
+    }
+    self.fusionEnable = sender.on;
+}
+
+/// Handles a change of the trial count.
+/// @param sender The segmented control.
+- (void)handleTrialControl:(UISegmentedControl *)sender
+{
+    if (self.startFlag || self.trialSession)
+    {
+        // The count of a session in progress cannot change
+        NSUInteger count = self.trialSession ? self.trialSession.trialCount : self.trialCount;
+        for (NSUInteger i = 0; i < sizeof(kTrialCounts) / sizeof(kTrialCounts[0]); i++)
+        {
+            if (kTrialCounts[i] == count)
+            {
+                sender.selectedSegmentIndex = i;
+            }
+        }
+        return;
+    }
+    self.trialCount = kTrialCounts[sender.selectedSegmentIndex];
+}
+
+/// Handles the tap event for the record switch.
+/// @param sender The switch object.
+- (void)handleRecordSwitch:(UISwitch *)sender
+{
+    if (self.startFlag)
+    {
+        sender.on = self.recordEnable;
+        return;
+    }
+    self.recordEnable = sender.on;
+}
+
 
 #pragma mark - Notification
 
+/// Resumes the stream of a reconnected device once it is initialized.
+/// @param sender The notification, whose object is the DotDevice.
+- (void)onDeviceInitialized:(NSNotification *)sender
+{
+    DotDevice *device = sender.object;
+    dispatch_async(dispatch_get_main_queue(), ^{
+        if ([self.pendingResumes containsObject:device.macAddress])
+        {
+            [self resumeStreaming:device];
+        }
+    });
+}
+
 /// Receives the notification for the log file path.
 /// @param sender The notification object.
 - (void)onLogPathReceive:(NSNotification *)sender
@@ -537,18 +1186,20 @@
     self.logFilePathLabel.text = logText;
 }
 
-/// Add the notification for Log file path
+/// Add the notifications for Log file path and device initialization
 - (void)addObserver
 {
     NSNotificationCenter *center = [NSNotificationCenter defaultCenter];
     [center addObserver:self selector:@selector(onLogPathReceive:) name:kDotNotificationDeviceLoggingPath object:nil];
+    [center addObserver:self selector:@selector(onDeviceInitialized:) name:kDotNotificationDeviceInitialized object:nil];
 }
 
-/// Remove the notification for Log file path
+/// Remove the notifications for Log file path and device initialization
 - (void)removeObserver
 {
     NSNotificationCenter *center = [NSNotificationCenter defaultCenter];
     [center removeObserver:self name:kDotNotificationDeviceLoggingPath object:nil];
+    [center removeObserver:self name:kDotNotificationDeviceInitialized object:nil];
 }
 
 #pragma mark -- UITableViewDataSource &  UITableViewDelegate
@@ -0,0 +1,97 @@
+//
+//  MetricsRegistry.h
+//  MDots
+//
+//  Created by Estela Alvarez on 18/10/26.
+//
+
+#import <Foundation/Foundation.h>
+#import <time.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/// A monotonic timestamp in microseconds, for latency measurements.
+static inline uint64_t MetricsTimestamp(void)
+{
+    return clock_gettime_nsec_np(CLOCK_UPTIME_RAW) / 1000;
+}
+
+/// @class MetricCounter
+/// @discussion A monotonically increasing count. Updates are atomic and lock free.
+@interface MetricCounter : NSObject
+
+/// The current count.
+@property (assign, nonatomic, readonly) int64_t value;
+
+/// Adds one.
+- (void)increment;
+
+/// Adds a value.
+/// @param value The amount to add.
+- (void)add:(int64_t)value;
+
+@end
+
+/// @class MetricGauge
+/// @discussion The last value of a quantity (e.g. a loss rate). Updates are atomic and lock free.
+@interface MetricGauge : NSObject
+
+/// The last value set.
+@property (assign, nonatomic) double value;
+
+@end
+
+/// @class MetricHistogram
+/// @discussion A log-linear (HDR style) histogram of non-negative integer values, typically latencies in microseconds. Values are bucketed with about 3% relative precision up to 2^63; recording is a few atomic adds, lock free and without allocation.
+@interface MetricHistogram : NSObject
+
+/// The number of recorded values.
+@property (assign, nonatomic, readonly) int64_t count;
+
+/// Records a value.
+/// @param value The value, e.g. a latency in microseconds.
+- (void)recordValue:(uint64_t)value;
+
+/// The value below which the given fraction of the recorded values fall, within the bucket precision.
+/// @param percentile The fraction from 0 to 1.
+- (uint64_t)valueAtPercentile:(double)percentile;
+
+@end
+
+/// @class MetricsRegistry
+/// @discussion The always-on metrics of the app: counters, gauges and histograms looked up by name. Looking a metric up takes a lock, so hot paths keep the returned object; updating it never does. A snapshot of every metric can be written to Documents/Metrics as JSON, one file per session, to compare sessions and builds.
+@interface MetricsRegistry : NSObject
+
+/// The shared registry.
+/// ```objc
+/// [[[MetricsRegistry sharedRegistry] counterNamed:@"reconnects"] increment];
+/// ```
++ (instancetype)sharedRegistry;
+
+/// The counter with a name, created on first use.
+/// @param name The metric name.
+- (MetricCounter *)counterNamed:(NSString *)name;
+
+/// The gauge with a name, created on first use.
+/// @param name The metric name.
+- (MetricGauge *)gaugeNamed:(NSString *)name;
+
+/// The histogram with a name, created on first use.
+/// @param name The metric name.
+- (MetricHistogram *)histogramNamed:(NSString *)name;
+
+/// Drops every metric and starts a new session.
+/// @param sessionName A name for the session, used in the snapshot file name.
+- (void)beginSessionNamed:(NSString *)sessionName;
+
+/// Every metric as a JSON compatible dictionary, with the session duration, rates per second of the counters and the app build.
+- (NSDictionary *)snapshot;
+
+/// Writes the snapshot of the current session to Documents/Metrics.
+/// @param error The error if the file could not be written.
+/// @return The file written, or nil.
+- (nullable NSURL *)writeSnapshotWithError:(NSError * _Nullable *)error;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,310 @@
+//
+//  MetricsRegistry.m
+//  MDots
+//
+//  Created by Estela Alvarez on 18/10/26.
+//
+
+#import "MetricsRegistry.h"
+#import <stdatomic.h>
+#import <UIKit/UIKit.h>
+
+/// Sub-buckets per power of two, 2^5 = 32 gives about 3% precision
+enum { kHistogramSubBits = 5, kHistogramSubBuckets = 1 << kHistogramSubBits, kHistogramBuckets = (64 - kHistogramSubBits + 1) * kHistogramSubBuckets };
+
+#pragma mark - MetricCounter
+
+@implementation MetricCounter
+{
+    atomic_llong _value;
+}
+
+- (int64_t)value
+{
+    return atomic_load_explicit(&_value, memory_order_relaxed);
+}
+
+- (void)increment
+{
+    atomic_fetch_add_explicit(&_value, 1, memory_order_relaxed);
+}
+
+- (void)add:(int64_t)value
+{
+    atomic_fetch_add_explicit(&_value, value, memory_order_relaxed);
+}
+
+@end
+
+#pragma mark - MetricGauge
+
+@implementation MetricGauge
+{
+    /// The bits of the double value
+    atomic_ullong _bits;
+}
+
+- (double)value
+{
+    uint64_t bits = atomic_load_explicit(&_bits, memory_order_relaxed);
+    double value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+- (void)setValue:(double)value
+{
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    atomic_store_explicit(&_bits, bits, memory_order_relaxed);
+}
+
+@end
+
+#pragma mark - MetricHistogram
+
+/// The bucket of a value: values below 2 * kHistogramSubBuckets are exact, above that each power of two has kHistogramSubBuckets linear buckets.
+static inline NSUInteger HistogramBucket(uint64_t value)
+{
+    if (value < kHistogramSubBuckets)
+    {
+        return (NSUInteger)value;
+    }
+    int magnitude = 63 - __builtin_clzll(value);
+    int shift = magnitude - kHistogramSubBits;
+    NSUInteger sub = (NSUInteger)(value >> shift) - kHistogramSubBuckets;
+    return (NSUInteger)(shift + 1) * kHistogramSubBuckets + sub;
+}
+
+/// The highest value of a bucket.
+static inline uint64_t HistogramBucketUpperValue(NSUInteger bucket)
+{
+    if (bucket < kHistogramSubBuckets)
+    {
+        return bucket;
+    }
+    NSUInteger shift = bucket / kHistogramSubBuckets - 1;
+    uint64_t sub = bucket % kHistogramSubBuckets + kHistogramSubBuckets;
+    return ((sub + 1) << shift) - 1;
+}
+
+@implementation MetricHistogram
+{
+    atomic_llong _buckets[kHistogramBuckets];
+    atomic_llong _count;
+    atomic_ullong _sum;
+    atomic_ullong _min;
+    atomic_ullong _max;
+}
+
+- (instancetype)init
+{
+    if (self = [super init])
+    {
+        atomic_store(&_min, UINT64_MAX);
+    }
+    return self;
+}
+
+- (int64_t)count
+{
+    return atomic_load_explicit(&_count, memory_order_relaxed);
+}
+
+- (void)recordValue:(uint64_t)value
+{
+    atomic_fetch_add_explicit(&_buckets[HistogramBucket(value)], 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&_count, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&_sum, value, memory_order_relaxed);
+    uint64_t current = atomic_load_explicit(&_min, memory_order_relaxed);
+    while (value < current && !atomic_compare_exchange_weak_explicit(&_min, &current, value, memory_order_relaxed, memory_order_relaxed));
+    current = atomic_load_explicit(&_max, memory_order_relaxed);
+    while (value > current && !atomic_compare_exchange_weak_explicit(&_max, &current, value, memory_order_relaxed, memory_order_relaxed));
+}
+
+- (uint64_t)valueAtPercentile:(double)percentile
+{
+    int64_t count = self.count;
+    if (count == 0)
+    {
+        return 0;
+    }
+    int64_t target = (int64_t)ceil(MIN(MAX(percentile, 0), 1) * count);
+    int64_t seen = 0;
+    for (NSUInteger i = 0; i < kHistogramBuckets; i++)
+    {
+        seen += atomic_load_explicit(&_buckets[i], memory_order_relaxed);
+        if (seen >= MAX(target, 1))
+        {
+            return MIN(HistogramBucketUpperValue(i), atomic_load(&_max));
+        }
+    }
+    return atomic_load(&_max);
+}
+
+- (NSDictionary *)dictionaryRepresentation
+{
+    int64_t count = self.count;
+    if (count == 0)
+    {
+        return @{ @"count": @0 };
+    }
+    return @{
+        @"count": @(count),
+        @"min": @(atomic_load(&_min)),
+        @"max": @(atomic_load(&_max)),
+        @"mean": @((double)atomic_load(&_sum) / count),
+        @"p50": @([self valueAtPercentile:0.50]),
+        @"p90": @([self valueAtPercentile:0.90]),
+        @"p99": @([self valueAtPercentile:0.99]),
+    };
+}
+
+@end
+
+#pragma mark - MetricsRegistry
+
+@interface MetricsRegistry ()
+
+@property (strong, nonatomic) NSMutableDictionary<NSString *, MetricCounter *> *counters;
+@property (strong, nonatomic) NSMutableDictionary<NSString *, MetricGauge *> *gauges;
+@property (strong, nonatomic) NSMutableDictionary<NSString *, MetricHistogram *> *histograms;
+@property (strong, nonatomic) NSString *sessionName;
+@property (strong, nonatomic) NSDate *sessionStart;
+
+@end
+
+@implementation MetricsRegistry
+
++ (instancetype)sharedRegistry
+{
+    static MetricsRegistry *registry = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        registry = [MetricsRegistry new];
+    });
+    return registry;
+}
+
+- (instancetype)init
+{
+    if (self = [super init])
+    {
+        _counters = [NSMutableDictionary dictionary];
+        _gauges = [NSMutableDictionary dictionary];
+        _histograms = [NSMutableDictionary dictionary];
+        _sessionName = @"app";
+        _sessionStart = [NSDate date];
+    }
+    return self;
+}
+
+- (MetricCounter *)counterNamed:(NSString *)name
+{
+    @synchronized (self)
+    {
+        MetricCounter *counter = self.counters[name];
+        if (counter == nil)
+        {
+            counter = [MetricCounter new];
+            self.counters[name] = counter;
+        }
+        return counter;
+    }
+}
+
+- (MetricGauge *)gaugeNamed:(NSString *)name
+{
+    @synchronized (self)
+    {
+        MetricGauge *gauge = self.gauges[name];
+        if (gauge == nil)
+        {
+            gauge = [MetricGauge new];
+            self.gauges[name] = gauge;
+        }
+        return gauge;
+    }
+}
+
+- (MetricHistogram *)histogramNamed:(NSString *)name
+{
+    @synchronized (self)
+    {
+        MetricHistogram *histogram = self.histograms[name];
+        if (histogram == nil)
+        {
+            histogram = [MetricHistogram new];
+            self.histograms[name] = histogram;
+        }
+        return histogram;
+    }
+}
+
+- (void)beginSessionNamed:(NSString *)sessionName
+{
+    @synchronized (self)
+    {
+        // Metrics still held by a hot path keep counting, but are no longer reported
+        [self.counters removeAllObjects];
+        [self.gauges removeAllObjects];
+        [self.histograms removeAllObjects];
+        self.sessionName = sessionName;
+        self.sessionStart = [NSDate date];
+    }
+}
+
+- (NSDictionary *)snapshot
+{
+    @synchronized (self)
+    {
+        NSTimeInterval duration = -[self.sessionStart timeIntervalSinceNow];
+        NSMutableDictionary *counters = [NSMutableDictionary dictionary];
+        [self.counters enumerateKeysAndObjectsUsingBlock:^(NSString *name, MetricCounter *counter, BOOL *stop) {
+            int64_t value = counter.value;
+            counters[name] = @{ @"value": @(value), @"perSecond": @(duration > 0 ? value / duration : 0) };
+        }];
+        NSMutableDictionary *gauges = [NSMutableDictionary dictionary];
+        [self.gauges enumerateKeysAndObjectsUsingBlock:^(NSString *name, MetricGauge *gauge, BOOL *stop) {
+            gauges[name] = @(gauge.value);
+        }];
+        NSMutableDictionary *histograms = [NSMutableDictionary dictionary];
+        [self.histograms enumerateKeysAndObjectsUsingBlock:^(NSString *name, MetricHistogram *histogram, BOOL *stop) {
+            histograms[name] = [histogram dictionaryRepresentation];
+        }];
+        NSDictionary *info = [NSBundle mainBundle].infoDictionary;
+        return @{
+            @"session": self.sessionName,
+            @"start": @([self.sessionStart timeIntervalSince1970]),
+            @"duration": @(duration),
+            @"build": [NSString stringWithFormat:@"%@ (%@)", info[@"CFBundleShortVersionString"] ?: @"", info[@"CFBundleVersion"] ?: @""],
+            @"system": [NSString stringWithFormat:@"%@ %@", [UIDevice currentDevice].systemName, [UIDevice currentDevice].systemVersion],
+            @"counters": counters,
+            @"gauges": gauges,
+            @"histograms": histograms,
+        };
+    }
+}
+
+- (NSURL *)writeSnapshotWithError:(NSError **)error
+{
+    NSDictionary *snapshot = [self snapshot];
+    NSURL *documents = [[NSFileManager defaultManager] URLsForDirectory:NSDocumentDirectory inDomains:NSUserDomainMask].firstObject;
+    NSURL *folder = [documents URLByAppendingPathComponent:@"Metrics" isDirectory:YES];
+    if (![[NSFileManager defaultManager] createDirectoryAtURL:folder withIntermediateDirectories:YES attributes:nil error:error])
+    {
+        return nil;
+    }
+    NSDateFormatter *formatter = [NSDateFormatter new];
+    formatter.dateFormat = @"yyyyMMdd-HHmmss";
+    NSString *name = [NSString stringWithFormat:@"%@-%@.json", [formatter stringFromDate:self.sessionStart], snapshot[@"session"]];
+    NSURL *url = [folder URLByAppendingPathComponent:name];
+    NSData *data = [NSJSONSerialization dataWithJSONObject:snapshot options:NSJSONWritingPrettyPrinted error:error];
+    if (data == nil || ![data writeToURL:url options:NSDataWritingAtomic error:error])
+    {
+        return nil;
+    }
+    return url;
+}
+
+@end
@@ -0,0 +1,124 @@
+//
+//  Tracer.h
+//  MDots
+//
+//  Created by Estela Alvarez on 18/10/26.
+//
+
+#ifndef Tracer_h
+#define Tracer_h
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+/// Builds with MDOTS_TRACE=0 compile every TRACE_* macro out. Otherwise a disabled tracer costs one relaxed atomic load per macro.
+#ifndef MDOTS_TRACE
+#define MDOTS_TRACE 1
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// Whether events are recorded, set by TracerStart / TracerStop
+extern atomic_bool TracerEnabledFlag;
+
+static inline bool TracerIsEnabled(void)
+{
+    return atomic_load_explicit(&TracerEnabledFlag, memory_order_relaxed);
+}
+
+/// Records one event in the buffer of the calling thread. Names must be string literals (they are stored by pointer).
+/// @param phase The Chrome trace phase: 'B' / 'E' span begin / end, 'b' / 'e' async begin / end, 'C' counter, 'i' instant.
+/// @param name The event name.
+/// @param value The counter value, or the async id.
+void TracerRecord(char phase, const char *name, int64_t value);
+
+/// A span closed when it goes out of scope
+typedef struct
+{
+    const char *name;
+    bool active;
+} TracerScope;
+
+static inline TracerScope TracerScopeBegin(const char *name)
+{
+    TracerScope scope = { name, TracerIsEnabled() };
+    if (scope.active)
+    {
+        TracerRecord('B', name, 0);
+    }
+    return scope;
+}
+
+static inline void TracerScopeEnd(TracerScope *scope)
+{
+    if (scope->active)
+    {
+        TracerRecord('E', scope->name, 0);
+    }
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#define TRACER_CONCAT_(a, b) a##b
+#define TRACER_CONCAT(a, b) TRACER_CONCAT_(a, b)
+
+#if MDOTS_TRACE
+/// A span from here to the end of the enclosing scope
+#define TRACE_SCOPE(name) TracerScope TRACER_CONCAT(tracerScope, __LINE__) __attribute__((cleanup(TracerScopeEnd), unused)) = TracerScopeBegin(name)
+/// A span that starts and ends in different callbacks, matched by id
+#define TRACE_ASYNC_BEGIN(name, id) do { if (TracerIsEnabled()) TracerRecord('b', name, (int64_t)(id)); } while (0)
+#define TRACE_ASYNC_END(name, id) do { if (TracerIsEnabled()) TracerRecord('e', name, (int64_t)(id)); } while (0)
+/// A counter value
+#define TRACE_COUNTER(name, value) do { if (TracerIsEnabled()) TracerRecord('C', name, (int64_t)(value)); } while (0)
+/// A point in time
+#define TRACE_INSTANT(name) do { if (TracerIsEnabled()) TracerRecord('i', name, 0); } while (0)
+#else
+#define TRACE_SCOPE(name) do { } while (0)
+#define TRACE_ASYNC_BEGIN(name, id) do { } while (0)
+#define TRACE_ASYNC_END(name, id) do { } while (0)
+#define TRACE_COUNTER(name, value) do { } while (0)
+#define TRACE_INSTANT(name) do { } while (0)
+#endif
+
+#ifdef __OBJC__
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/// @class Tracer
+/// @discussion Records spans and counters from the hot paths (BLE callbacks, sync, upload) into per-thread buffers without locks, and exports them as Chrome trace-event JSON (open in chrome://tracing or Perfetto). Each thread owns its buffer, so recording is a timestamp and a store; events past a buffer's capacity are dropped and counted. The buffer of a thread that exits is kept until the next start and then reused, so worker threads coming and going do not grow the memory.
+@interface Tracer : NSObject
+
+/// Whether the tracer is recording.
+@property (class, assign, nonatomic, readonly) BOOL running;
+
+/// Clears the previous trace and starts recording.
++ (void)start;
+
+/// Stops recording, the events are kept until the next start.
++ (void)stop;
+
+/// Writes the recorded events as Chrome trace-event JSON.
+/// @param url The file to write.
+/// @param error The error if the file could not be written.
+/// @return YES on success.
+/// ```objc
+/// [Tracer stop];
+/// [Tracer exportChromeTraceToURL:url error:&error];
+/// ```
++ (BOOL)exportChromeTraceToURL:(NSURL *)url error:(NSError * _Nullable *)error;
+
+/// A Traces folder in the documents directory with a timestamped file name, for the next export.
++ (NSURL *)defaultTraceURL;
+
+@end
+
+NS_ASSUME_NONNULL_END
+#endif
+
+#endif /* Tracer_h */
@@ -0,0 +1,220 @@
+//
+//  Tracer.m
+//  MDots
+//
+//  Created by Estela Alvarez on 18/10/26.
+//
+
+#import "Tracer.h"
+#import <mach/mach_time.h>
+#import <pthread.h>
+
+/// Events per thread buffer, about 512 KB
+enum { kTracerBufferCapacity = 16384 };
+
+typedef struct
+{
+    uint64_t time;
+    const char *name;
+    int64_t value;
+    char phase;
+} TracerEvent;
+
+/// Who a buffer belongs to
+typedef enum
+{
+    /// Owned by a live thread
+    TracerBufferInUse = 0,
+    /// Its thread exited, the events are kept until the next start
+    TracerBufferRetired,
+    /// Empty, taken by the next thread that records
+    TracerBufferFree,
+} TracerBufferState;
+
+/// The buffer of one thread. Only its thread writes events, the count is published with release ordering.
+typedef struct TracerBuffer
+{
+    TracerEvent events[kTracerBufferCapacity];
+    atomic_uint count;
+    atomic_uint dropped;
+    atomic_int state;
+    uint64_t threadId;
+    struct TracerBuffer *next;
+} TracerBuffer;
+
+atomic_bool TracerEnabledFlag = false;
+
+/// All thread buffers, a push-only list. Buffers are reused rather than freed, so the list only grows
+/// with the number of threads recording during one trace.
+static _Atomic(TracerBuffer *) TracerBuffers = NULL;
+static _Thread_local TracerBuffer *TracerThreadBuffer = NULL;
+/// Retires the buffer of a thread when it exits
+static pthread_key_t TracerBufferKey;
+static pthread_once_t TracerBufferKeyOnce = PTHREAD_ONCE_INIT;
+/// Start time of the trace
+static uint64_t TracerStartTime = 0;
+
+static void TracerRetireBuffer(void *buffer)
+{
+    atomic_store(&((TracerBuffer *)buffer)->state, TracerBufferRetired);
+}
+
+static void TracerCreateBufferKey(void)
+{
+    pthread_key_create(&TracerBufferKey, TracerRetireBuffer);
+}
+
+/// Takes a free buffer, or NULL if none is.
+static TracerBuffer *TracerTakeFreeBuffer(void)
+{
+    for (TracerBuffer *buffer = atomic_load(&TracerBuffers); buffer != NULL; buffer = buffer->next)
+    {
+        int state = TracerBufferFree;
+        if (atomic_compare_exchange_strong(&buffer->state, &state, TracerBufferInUse))
+        {
+            return buffer;
+        }
+    }
+    return NULL;
+}
+
+/// The buffer of the calling thread, taken or created and published on first use.
+static TracerBuffer *TracerCurrentBuffer(void)
+{
+    TracerBuffer *buffer = TracerThreadBuffer;
+    if (buffer == NULL)
+    {
+        pthread_once(&TracerBufferKeyOnce, TracerCreateBufferKey);
+        buffer = TracerTakeFreeBuffer();
+        if (buffer == NULL)
+        {
+            buffer = calloc(1, sizeof(TracerBuffer));
+            if (buffer == NULL)
+            {
+                return NULL;
+            }
+            TracerBuffer *head = atomic_load(&TracerBuffers);
+            do
+            {
+                buffer->next = head;
+            }
+            while (!atomic_compare_exchange_weak(&TracerBuffers, &head, buffer));
+        }
+        pthread_threadid_np(NULL, &buffer->threadId);
+        pthread_setspecific(TracerBufferKey, buffer);
+        TracerThreadBuffer = buffer;
+    }
+    return buffer;
+}
+
+void TracerRecord(char phase, const char *name, int64_t value)
+{
+    TracerBuffer *buffer = TracerCurrentBuffer();
+    if (buffer == NULL)
+    {
+        return;
+    }
+    uint32_t index = atomic_load_explicit(&buffer->count, memory_order_relaxed);
+    if (index >= kTracerBufferCapacity)
+    {
+        atomic_fetch_add_explicit(&buffer->dropped, 1, memory_order_relaxed);
+        return;
+    }
+    TracerEvent *event = &buffer->events[index];
+    event->time = mach_absolute_time();
+    event->name = name;
+    event->value = value;
+    event->phase = phase;
+    atomic_store_explicit(&buffer->count, index + 1, memory_order_release);
+}
+
+@implementation Tracer
+
++ (BOOL)running
+{
+    return TracerIsEnabled();
+}
+
++ (void)start
+{
+    // Buffers stay allocated for the lifetime of the app, only their counts are reset;
+    // those of exited threads are handed to the next threads that record
+    for (TracerBuffer *buffer = atomic_load(&TracerBuffers); buffer != NULL; buffer = buffer->next)
+    {
+        atomic_store(&buffer->count, 0);
+        atomic_store(&buffer->dropped, 0);
+        int state = TracerBufferRetired;
+        atomic_compare_exchange_strong(&buffer->state, &state, TracerBufferFree);
+    }
+    TracerStartTime = mach_absolute_time();
+    atomic_store(&TracerEnabledFlag, true);
+}
+
++ (void)stop
+{
+    atomic_store(&TracerEnabledFlag, false);
+}
+
++ (NSURL *)defaultTraceURL
+{
+    NSURL *documents = [[NSFileManager defaultManager] URLsForDirectory:NSDocumentDirectory inDomains:NSUserDomainMask].firstObject;
+    NSURL *folder = [documents URLByAppendingPathComponent:@"Traces" isDirectory:YES];
+    [[NSFileManager defaultManager] createDirectoryAtURL:folder withIntermediateDirectories:YES attributes:nil error:nil];
+    NSDateFormatter *formatter = [NSDateFormatter new];
+    formatter.dateFormat = @"yyyyMMdd-HHmmss";
+    NSString *name = [NSString stringWithFormat:@"trace-%@.json", [formatter stringFromDate:[NSDate date]]];
+    return [folder URLByAppendingPathComponent:name];
+}
+
++ (BOOL)exportChromeTraceToURL:(NSURL *)url error:(NSError **)error
+{
+    mach_timebase_info_data_t timebase;
+    mach_timebase_info(&timebase);
+    double microsecondsPerTick = (double)timebase.numer / timebase.denom / 1000.0;
+    int pid = [NSProcessInfo processInfo].processIdentifier;
+    
+    NSMutableArray *events = [NSMutableArray array];
+    NSUInteger dropped = 0;
+    for (TracerBuffer *buffer = atomic_load(&TracerBuffers); buffer != NULL; buffer = buffer->next)
+    {
+        uint32_t count = atomic_load_explicit(&buffer->count, memory_order_acquire);
+        dropped += atomic_load(&buffer->dropped);
+        for (uint32_t i = 0; i < count; i++)
+        {
+            TracerEvent *event = &buffer->events[i];
+            NSMutableDictionary *json = [NSMutableDictionary dictionaryWithCapacity:7];
+            json[@"name"] = @(event->name);
+            json[@"ph"] = [NSString stringWithFormat:@"%c", event->phase];
+            json[@"ts"] = @((double)(event->time - TracerStartTime) * microsecondsPerTick);
+            json[@"pid"] = @(pid);
+            json[@"tid"] = @(buffer->threadId);
+            switch (event->phase)
+            {
+                case 'C':
+                    json[@"args"] = @{ @"value": @(event->value) };
+                    break;
+                case 'b':
+                case 'e':
+                    json[@"cat"] = @"async";
+                    json[@"id"] = [NSString stringWithFormat:@"0x%llx", (unsigned long long)event->value];
+                    break;
+                case 'i':
+                    json[@"s"] = @"t";
+                    break;
+                default:
+                    break;
+            }
+            [events addObject:json];
+        }
+    }
+    if (dropped > 0)
+    {
+        NSLog(@"Trace dropped %lu events, buffers full", (unsigned long)dropped);
+    }
+    
+    NSDictionary *trace = @{ @"traceEvents": events, @"displayTimeUnit": @"ms", @"otherData": @{ @"droppedEvents": @(dropped) } };
+    NSData *data = [NSJSONSerialization dataWithJSONObject:trace options:0 error:error];
+    return data != nil && [data writeToURL:url options:NSDataWritingAtomic error:error];
+}
+
+@end
@@ -5,3 +5,6 @@
 #import <MovellaDotSdk/MovellaDotSdk.h>
 #import "MeasureViewController.h"
 #import "MainViewController.h"
+#import "PatientRollup.h"
+#import "CohortAnalytics.h"
+#import "BulkExporter.h"
@@ -0,0 +1,59 @@
+//
+//  AsymmetryIndex.h
+//  MDots
+//
+//  Created by Estela Alvarez on 18/10/26.
+//
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/// A left and right result of the same day.
+typedef struct
+{
+    /// The left result
+    double left;
+    /// The right result
+    double right;
+    /// The limb symmetry index, 100 * weaker / stronger, in percent
+    double symmetry;
+    /// The signed asymmetry, 100 * (right - left) / stronger, in percent; positive when the right side reaches further
+    double bias;
+} AsymmetryPair;
+
+/// @class AsymmetryIndex
+/// @discussion Pairs a new result with the last result of the other limb when both were measured the same day, and computes their limb symmetry index.
+/// Side codes pair as "L"/"R", "Le"/"Re" and "Li"/"Ri"; single side tests ("S") have no pair.
+@interface AsymmetryIndex : NSObject
+
+/// The side measured against, e.g. "Re" for "Le".
+/// @param side The side of a result.
+/// @return The other side, or nil if the side has no pair.
++ (nullable NSString *)counterpartOfSide:(NSString *)side;
+
+/// The key of the asymmetry of a test in the rollup `asymmetry` map, e.g. "Lunge" or "Hip Rotation:e".
+/// @param testType The test type.
+/// @param side Either side of the pair.
++ (NSString *)pairKeyForTestType:(NSString *)testType side:(NSString *)side;
+
+/// Pairs a new result with the last result of the other side.
+/// @param pair The pair out.
+/// @param value The new result.
+/// @param side The side of the new result.
+/// @param date The date of the new result.
+/// @param lastValue The last result of the other side.
+/// @param lastDate The date of the last result of the other side, nil if the other side was never measured.
+/// @return NO if the other side was not measured the same day, or both results are zero.
+/// ```objc
+/// AsymmetryPair pair;
+/// if ([AsymmetryIndex getPair:&pair value:42 side:@"L" date:date lastValue:48 lastDate:rightDate])
+/// {
+///     NSLog(@"LSI %.0f %%", pair.symmetry);
+/// }
+/// ```
++ (BOOL)getPair:(AsymmetryPair *)pair value:(double)value side:(NSString *)side date:(NSDate *)date lastValue:(double)lastValue lastDate:(nullable NSDate *)lastDate;
+
+@end
+
+NS_ASSUME_NONNULL_END
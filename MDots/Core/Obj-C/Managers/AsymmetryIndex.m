@@ -0,0 +1,50 @@
+//
+//  AsymmetryIndex.m
+//  MDots
+//
+//  Created by Estela Alvarez on 18/10/26.
+//
+
+#import "AsymmetryIndex.h"
+
+@implementation AsymmetryIndex
+
++ (nullable NSString *)counterpartOfSide:(NSString *)side
+{
+    if (side.length == 0)
+    {
+        return nil;
+    }
+    NSString *limb = [side substringToIndex:1];
+    NSString *other = [limb isEqualToString:@"L"] ? @"R" : ([limb isEqualToString:@"R"] ? @"L" : nil);
+    return other ? [other stringByAppendingString:[side substringFromIndex:1]] : nil;
+}
+
++ (NSString *)pairKeyForTestType:(NSString *)testType side:(NSString *)side
+{
+    NSString *rotation = side.length > 1 ? [side substringFromIndex:1] : @"";
+    return rotation.length > 0 ? [NSString stringWithFormat:@"%@:%@", testType, rotation] : testType;
+}
+
++ (BOOL)getPair:(AsymmetryPair *)pair value:(double)value side:(NSString *)side date:(NSDate *)date lastValue:(double)lastValue lastDate:(nullable NSDate *)lastDate
+{
+    if (lastDate == nil || ![[NSCalendar currentCalendar] isDate:date inSameDayAsDate:lastDate])
+    {
+        return NO;
+    }
+    BOOL isLeft = [side hasPrefix:@"L"];
+    double left = fabs(isLeft ? value : lastValue);
+    double right = fabs(isLeft ? lastValue : value);
+    double stronger = MAX(left, right);
+    if (stronger < 1e-6)
+    {
+        return NO;
+    }
+    pair->left = left;
+    pair->right = right;
+    pair->symmetry = 100.0 * MIN(left, right) / stronger;
+    pair->bias = 100.0 * (right - left) / stronger;
+    return YES;
+}
+
+@end
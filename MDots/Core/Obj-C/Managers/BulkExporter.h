@@ -0,0 +1,59 @@
+//
+//  BulkExporter.h
+//  MDots
+//
+//  Created by Estela Alvarez on 18/10/26.
+//
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/// Called with the share of patients exported, from 0 to 1.
+typedef void (^BulkExportProgressBlock)(float progress);
+/// Called with the export folder, or the error that stopped the export.
+typedef void (^BulkExportCompletion)(NSURL * _Nullable directory, NSError * _Nullable error);
+
+/// @class BulkExporter
+/// @discussion Exports every test of every patient of the current user to CSV files in `Documents/Exports/<date>/`.
+/// Patients and tests are read in pages with a bounded number of patients in flight, and each patient's rows are appended to the current chunk file as soon as the patient is read, so memory does not grow with the export.
+/// A line per exported patient in `checkpoint.log` lets an interrupted export resume where it stopped; `manifest.json` marks a finished export.
+/// Columns: patient_id, test_type, test_id, test_date (ISO 8601), side, value, trusted, orientation (`phoneFusion`, empty for the sensors' filter).
+@interface BulkExporter : NSObject
+
+/// The documents read per query. Defaults to 200.
+@property (assign, nonatomic) NSUInteger pageSize;
+
+/// The patients read at once. Defaults to 4.
+@property (assign, nonatomic) NSUInteger concurrentPatients;
+
+/// The rows per CSV file before a new one is started. Defaults to 50000.
+@property (assign, nonatomic) NSUInteger rowsPerChunk;
+
+/// Whether an export is running.
+@property (assign, atomic, readonly, getter=isRunning) BOOL running;
+
+/// The most recent export that did not finish, nil if none.
++ (nullable NSURL *)resumableExport;
+
+/// Creates an exporter.
+/// @param testTypes The test type collections to export.
+/// ```objc
+/// BulkExporter *exporter = [[BulkExporter alloc] initWithTestTypes:@[@"Sit and Reach", @"Lunge", @"Hip Rotation"]];
+/// ```
+- (instancetype)initWithTestTypes:(NSArray<NSString *> *)testTypes NS_DESIGNATED_INITIALIZER;
+
+- (instancetype)init NS_UNAVAILABLE;
+
+/// Starts or resumes an export.
+/// @param directory The folder of an unfinished export to resume, or nil to start a new one.
+/// @param progress Called on the main queue after each patient.
+/// @param completion Called on the main queue when the export finished, failed or was cancelled. A failed or cancelled export can be resumed.
+- (void)exportToDirectory:(nullable NSURL *)directory progress:(nullable BulkExportProgressBlock)progress completion:(BulkExportCompletion)completion;
+
+/// Stops the export after the patients in flight, keeping it resumable.
+- (void)cancel;
+
+@end
+
+NS_ASSUME_NONNULL_END
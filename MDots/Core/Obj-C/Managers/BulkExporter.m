@@ -0,0 +1,461 @@
+//
+//  BulkExporter.m
+//  MDots
+//
+//  Created by Estela Alvarez on 18/10/26.
+//
+
+#import "BulkExporter.h"
+#import <Firebase.h>
+
+static NSString * const kCheckpointName = @"checkpoint.log";
+static NSString * const kManifestName = @"manifest.json";
+static NSString * const kHeader = @"patient_id,test_type,test_id,test_date,side,value,trusted,orientation\n";
+
+@interface BulkExporter ()
+
+@property (strong, nonatomic) NSArray<NSString *> *testTypes;
+@property (assign, atomic) BOOL running;
+@property (assign, atomic) BOOL cancelled;
+/// Serializes the export state and the file writes
+@property (strong, nonatomic) dispatch_queue_t queue;
+@property (strong, nonatomic) NSISO8601DateFormatter *dateFormatter;
+
+// Export state, only touched on the queue
+@property (strong, nonatomic) NSURL *directory;
+@property (strong, nonatomic) FIRCollectionReference *patientsRef;
+@property (strong, nonatomic) NSMutableArray<NSString *> *pendingPatients;
+@property (assign, nonatomic) NSUInteger patientCount;
+@property (assign, nonatomic) NSUInteger exportedPatients;
+@property (assign, nonatomic) NSUInteger activePatients;
+@property (strong, nonatomic, nullable) NSFileHandle *chunk;
+@property (strong, nonatomic, nullable) NSFileHandle *checkpoint;
+@property (assign, nonatomic) NSUInteger chunkIndex;
+@property (assign, nonatomic) NSUInteger chunkRows;
+@property (assign, nonatomic) NSUInteger totalRows;
+@property (strong, nonatomic, nullable) NSError *error;
+@property (copy, nonatomic, nullable) BulkExportProgressBlock progress;
+@property (copy, nonatomic, nullable) BulkExportCompletion completion;
+
+@end
+
+@implementation BulkExporter
+
+- (instancetype)initWithTestTypes:(NSArray<NSString *> *)testTypes
+{
+    if (self = [super init])
+    {
+        _testTypes = [testTypes copy];
+        _pageSize = 200;
+        _concurrentPatients = 4;
+        _rowsPerChunk = 50000;
+        _queue = dispatch_queue_create("BulkExporter", DISPATCH_QUEUE_SERIAL);
+        _dateFormatter = [NSISO8601DateFormatter new];
+    }
+    return self;
+}
+
+/// The folder holding every export.
++ (NSURL *)exportsDirectory
+{
+    NSURL *documents = [[NSFileManager defaultManager] URLsForDirectory:NSDocumentDirectory inDomains:NSUserDomainMask].firstObject;
+    return [documents URLByAppendingPathComponent:@"Exports" isDirectory:YES];
+}
+
++ (nullable NSURL *)resumableExport
+{
+    NSFileManager *manager = [NSFileManager defaultManager];
+    NSArray<NSURL *> *exports = [manager contentsOfDirectoryAtURL:[self exportsDirectory] includingPropertiesForKeys:nil options:NSDirectoryEnumerationSkipsHiddenFiles error:nil];
+    // Folder names are dates, they sort in time order
+    for (NSURL *directory in [exports sortedArrayUsingComparator:^NSComparisonResult(NSURL *a, NSURL *b) { return [b.lastPathComponent compare:a.lastPathComponent]; }])
+    {
+        if ([manager fileExistsAtPath:[directory URLByAppendingPathComponent:kCheckpointName].path]
+            && ![manager fileExistsAtPath:[directory URLByAppendingPathComponent:kManifestName].path])
+        {
+            return directory;
+        }
+    }
+    return nil;
+}
+
+/// The CSV file of a chunk.
+- (NSURL *)chunkURL:(NSUInteger)index
+{
+    return [self.directory URLByAppendingPathComponent:[NSString stringWithFormat:@"results-%03lu.csv", (unsigned long)index]];
+}
+
+- (void)exportToDirectory:(nullable NSURL *)directory progress:(nullable BulkExportProgressBlock)progress completion:(BulkExportCompletion)completion
+{
+    if (self.running)
+    {
+        return;
+    }
+    FIRUser *currentUser = [FIRAuth auth].currentUser;
+    if (!currentUser)
+    {
+        NSLog(@"Error: Current user not available.");
+        completion(nil, [NSError errorWithDomain:@"BulkExporter" code:1 userInfo:@{ NSLocalizedDescriptionKey: @"Current user not available" }]);
+        return;
+    }
+    self.running = YES;
+    self.cancelled = NO;
+    __weak __typeof(self) wself = self;
+    dispatch_async(self.queue, ^{
+        wself.progress = progress;
+        wself.completion = completion;
+        wself.error = nil;
+        wself.patientsRef = [[FIRFirestore firestore] collectionWithPath:[NSString stringWithFormat:@"users/%@/patients", currentUser.uid]];
+        NSError *error = nil;
+        NSSet<NSString *> *exported = [wself openDirectory:directory error:&error];
+        if (exported == nil)
+        {
+            [wself finishWithError:error];
+            return;
+        }
+        [wself listPatientsAfter:nil into:[NSMutableArray array] exported:exported];
+    });
+}
+
+- (void)cancel
+{
+    self.cancelled = YES;
+}
+
+#pragma mark - Files
+
+/// Creates the export folder, or reopens an unfinished one: drops the rows written after the last checkpoint line, so no patient is exported twice.
+/// @param directory The folder to resume, nil for a new export.
+/// @return The IDs of the patients already exported, nil on error.
+- (nullable NSSet<NSString *> *)openDirectory:(nullable NSURL *)directory error:(NSError **)error
+{
+    NSFileManager *manager = [NSFileManager defaultManager];
+    if (directory == nil)
+    {
+        NSDateFormatter *formatter = [NSDateFormatter new];
+        formatter.dateFormat = @"yyyyMMdd-HHmmss";
+        directory = [[BulkExporter exportsDirectory] URLByAppendingPathComponent:[formatter stringFromDate:[NSDate date]] isDirectory:YES];
+    }
+    if (![manager createDirectoryAtURL:directory withIntermediateDirectories:YES attributes:nil error:error])
+    {
+        return nil;
+    }
+    self.directory = directory;
+    
+    // Each checkpoint line is "patient_id<TAB>chunk<TAB>chunk length<TAB>rows", written after the patient's rows
+    NSURL *checkpointURL = [directory URLByAppendingPathComponent:kCheckpointName];
+    NSString *log = [NSString stringWithContentsOfURL:checkpointURL encoding:NSUTF8StringEncoding error:nil] ?: @"";
+    NSMutableSet *exported = [NSMutableSet set];
+    unsigned long long length = 0;
+    self.chunkIndex = 0;
+    self.totalRows = 0;
+    for (NSString *line in [log componentsSeparatedByString:@"\n"])
+    {
+        NSArray<NSString *> *fields = [line componentsSeparatedByString:@"\t"];
+        if (fields.count < 4)
+        {
+            continue;
+        }
+        [exported addObject:fields[0]];
+        self.chunkIndex = (NSUInteger)fields[1].integerValue;
+        length = (unsigned long long)fields[2].longLongValue;
+        self.totalRows = (NSUInteger)fields[3].integerValue;
+    }
+    // The log is rewritten from its complete lines, in case the last one was cut
+    NSMutableString *clean = [NSMutableString string];
+    for (NSString *line in [log componentsSeparatedByString:@"\n"])
+    {
+        if ([line componentsSeparatedByString:@"\t"].count >= 4)
+        {
+            [clean appendFormat:@"%@\n", line];
+        }
+    }
+    if (![clean writeToURL:checkpointURL atomically:YES encoding:NSUTF8StringEncoding error:error])
+    {
+        return nil;
+    }
+    // Later chunks only hold rows of patients that were not checkpointed
+    for (NSUInteger index = self.chunkIndex + 1; [manager fileExistsAtPath:[self chunkURL:index].path]; index++)
+    {
+        [manager removeItemAtURL:[self chunkURL:index] error:nil];
+    }
+    NSURL *chunkURL = [self chunkURL:self.chunkIndex];
+    if (exported.count == 0 || ![manager fileExistsAtPath:chunkURL.path])
+    {
+        if (![kHeader writeToURL:chunkURL atomically:YES encoding:NSUTF8StringEncoding error:error])
+        {
+            return nil;
+        }
+        length = [kHeader lengthOfBytesUsingEncoding:NSUTF8StringEncoding];
+    }
+    self.chunk = [NSFileHandle fileHandleForWritingToURL:chunkURL error:error];
+    self.checkpoint = [NSFileHandle fileHandleForWritingToURL:checkpointURL error:error];
+    if (self.chunk == nil || self.checkpoint == nil
+        || ![self.chunk truncateAtOffset:length error:error] || ![self.chunk seekToEndReturningOffset:nil error:error]
+        || ![self.checkpoint seekToEndReturningOffset:nil error:error])
+    {
+        return nil;
+    }
+    self.chunkRows = [self countRowsOfChunk:chunkURL];
+    return exported;
+}
+
+/// Counts the data rows of a chunk being resumed.
+- (NSUInteger)countRowsOfChunk:(NSURL *)url
+{
+    NSData *data = [NSData dataWithContentsOfURL:url options:NSDataReadingMappedIfSafe error:nil];
+    const char *bytes = data.bytes;
+    NSUInteger lines = 0;
+    for (NSUInteger i = 0; i < data.length; i++)
+    {
+        lines += bytes[i] == '\n';
+    }
+    return lines > 0 ? lines - 1 : 0;
+}
+
+/// Appends the rows of a patient to the current chunk, then its checkpoint line. Starts a new chunk when the current one is full.
+/// @param rows The CSV rows.
+/// @param rowCount The number of rows.
+/// @param patientID The patient.
+- (BOOL)appendRows:(NSData *)rows count:(NSUInteger)rowCount ofPatient:(NSString *)patientID error:(NSError **)error
+{
+    if (self.chunkRows > 0 && self.chunkRows + rowCount > self.rowsPerChunk)
+    {
+        [self.chunk closeAndReturnError:nil];
+        self.chunkIndex++;
+        self.chunkRows = 0;
+        NSURL *chunkURL = [self chunkURL:self.chunkIndex];
+        if (![kHeader writeToURL:chunkURL atomically:YES encoding:NSUTF8StringEncoding error:error])
+        {
+            return NO;
+        }
+        self.chunk = [NSFileHandle fileHandleForWritingToURL:chunkURL error:error];
+        if (self.chunk == nil || ![self.chunk seekToEndReturningOffset:nil error:error])
+        {
+            return NO;
+        }
+    }
+    unsigned long long length = 0;
+    if (![self.chunk writeData:rows error:error] || ![self.chunk seekToEndReturningOffset:&length error:error])
+    {
+        return NO;
+    }
+    self.chunkRows += rowCount;
+    self.totalRows += rowCount;
+    NSString *line = [NSString stringWithFormat:@"%@\t%lu\t%llu\t%lu\n", patientID, (unsigned long)self.chunkIndex, length, (unsigned long)self.totalRows];
+    return [self.checkpoint writeData:[line dataUsingEncoding:NSUTF8StringEncoding] error:error];
+}
+
+/// Quotes a CSV field if needed.
++ (NSString *)csvField:(NSString *)field
+{
+    static NSCharacterSet *special = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        special = [NSCharacterSet characterSetWithCharactersInString:@",\"\n\r"];
+    });
+    if ([field rangeOfCharacterFromSet:special].location == NSNotFound)
+    {
+        return field;
+    }
+    return [NSString stringWithFormat:@"\"%@\"", [field stringByReplacingOccurrencesOfString:@"\"" withString:@"\"\""]];
+}
+
+/// Formats one test as a CSV row.
+- (NSString *)rowOfTest:(FIRQueryDocumentSnapshot *)test testType:(NSString *)testType patient:(NSString *)patientID
+{
+    NSDictionary *data = test.data;
+    id date = data[@"testDate"];
+    id side = data[@"side"];
+    id value = data[@"value"];
+    id trusted = data[@"trusted"];
+    id orientation = data[@"orientation"];
+    return [NSString stringWithFormat:@"%@,%@,%@,%@,%@,%@,%@,%@\n",
+            [BulkExporter csvField:patientID],
+            [BulkExporter csvField:testType],
+            [BulkExporter csvField:test.documentID],
+            [date isKindOfClass:[FIRTimestamp class]] ? [self.dateFormatter stringFromDate:[(FIRTimestamp *)date dateValue]] : @"",
+            [side isKindOfClass:[NSString class]] ? [BulkExporter csvField:side] : @"",
+            [value isKindOfClass:[NSNumber class]] ? [value stringValue] : @"",
+            [trusted isKindOfClass:[NSNumber class]] ? ([trusted boolValue] ? @"true" : @"false") : @"",
+            [orientation isKindOfClass:[NSString class]] ? [BulkExporter csvField:orientation] : @""];
+}
+
+#pragma mark - Reading
+
+/// Lists the patient IDs page by page, then starts reading the ones not exported yet.
+/// Runs on the queue.
+- (void)listPatientsAfter:(nullable FIRDocumentSnapshot *)last into:(NSMutableArray<NSString *> *)patients exported:(NSSet<NSString *> *)exported
+{
+    FIRQuery *query = [self.patientsRef queryLimitedTo:(NSInteger)self.pageSize];
+    if (last)
+    {
+        query = [query queryStartingAfterDocument:last];
+    }
+    __weak __typeof(self) wself = self;
+    [query getDocumentsWithCompletion:^(FIRQuerySnapshot * _Nullable snapshot, NSError * _Nullable error) {
+        dispatch_async(wself.queue, ^{
+            if (snapshot == nil)
+            {
+                [wself finishWithError:error];
+                return;
+            }
+            [patients addObjectsFromArray:[snapshot.documents valueForKey:@"documentID"]];
+            if (snapshot.documents.count == wself.pageSize && !wself.cancelled)
+            {
+                [wself listPatientsAfter:snapshot.documents.lastObject into:patients exported:exported];
+                return;
+            }
+            wself.patientCount = patients.count;
+            wself.exportedPatients = 0;
+            wself.pendingPatients = [NSMutableArray arrayWithCapacity:patients.count];
+            for (NSString *patientID in patients)
+            {
+                if ([exported containsObject:patientID])
+                {
+                    wself.exportedPatients++;
+                }
+                else
+                {
+                    [wself.pendingPatients addObject:patientID];
+                }
+            }
+            [wself readNextPatients];
+        });
+    }];
+}
+
+/// Starts reading patients until `concurrentPatients` are in flight, and finishes once all were exported.
+/// Runs on the queue.
+- (void)readNextPatients
+{
+    BOOL stopping = self.cancelled || self.error != nil;
+    while (!stopping && self.activePatients < MAX(self.concurrentPatients, 1u) && self.pendingPatients.count > 0)
+    {
+        NSString *patientID = self.pendingPatients.firstObject;
+        [self.pendingPatients removeObjectAtIndex:0];
+        self.activePatients++;
+        [self readTestsOfPatient:patientID testIndex:0 after:nil rows:[NSMutableData data] rowCount:0];
+    }
+    if (self.activePatients > 0)
+    {
+        return;
+    }
+    if (stopping)
+    {
+        [self finishWithError:self.error ?: [NSError errorWithDomain:NSCocoaErrorDomain code:NSUserCancelledError userInfo:nil]];
+        return;
+    }
+    if (self.pendingPatients.count == 0)
+    {
+        [self finishWithError:nil];
+    }
+}
+
+/// Reads one page of tests of a patient, then the next page or test type, and appends the patient once all are read.
+/// Runs on the queue.
+- (void)readTestsOfPatient:(NSString *)patientID testIndex:(NSUInteger)testIndex after:(nullable FIRDocumentSnapshot *)last rows:(NSMutableData *)rows rowCount:(NSUInteger)rowCount
+{
+    if (testIndex == self.testTypes.count)
+    {
+        self.activePatients--;
+        NSError *error = nil;
+        if (self.error == nil && ![self appendRows:rows count:rowCount ofPatient:patientID error:&error])
+        {
+            self.error = error;
+        }
+        self.exportedPatients++;
+        float progress = self.patientCount > 0 ? (float)self.exportedPatients / self.patientCount : 1.f;
+        BulkExportProgressBlock block = self.progress;
+        if (block)
+        {
+            dispatch_async(dispatch_get_main_queue(), ^{
+                block(progress);
+            });
+        }
+        [self readNextPatients];
+        return;
+    }
+    NSString *testType = self.testTypes[testIndex];
+    FIRQuery *query = [[[[self.patientsRef documentWithPath:patientID] collectionWithPath:testType] queryOrderedByField:@"testDate"] queryLimitedTo:(NSInteger)self.pageSize];
+    if (last)
+    {
+        query = [query queryStartingAfterDocument:last];
+    }
+    __weak __typeof(self) wself = self;
+    [query getDocumentsWithCompletion:^(FIRQuerySnapshot * _Nullable snapshot, NSError * _Nullable error) {
+        dispatch_async(wself.queue, ^{
+            if (snapshot == nil)
+            {
+                // The patient is not checkpointed, a resume reads it again
+                NSLog(@"Error exporting tests of %@: %@", patientID, error.localizedDescription);
+                wself.error = wself.error ?: error;
+                wself.activePatients--;
+                [wself readNextPatients];
+                return;
+            }
+            NSUInteger count = rowCount;
+            @autoreleasepool
+            {
+                for (FIRQueryDocumentSnapshot *test in snapshot.documents)
+                {
+                    [rows appendData:[[wself rowOfTest:test testType:testType patient:patientID] dataUsingEncoding:NSUTF8StringEncoding]];
+                    count++;
+                }
+            }
+            BOOL morePages = snapshot.documents.count == wself.pageSize;
+            [wself readTestsOfPatient:patientID
+                            testIndex:morePages ? testIndex : testIndex + 1
+                                after:morePages ? snapshot.documents.lastObject : nil
+                                 rows:rows
+                             rowCount:count];
+        });
+    }];
+}
+
+/// Closes the files, writes the manifest of a finished export and calls the completion.
+/// Runs on the queue.
+- (void)finishWithError:(nullable NSError *)error
+{
+    [self.chunk closeAndReturnError:nil];
+    [self.checkpoint closeAndReturnError:nil];
+    self.chunk = nil;
+    self.checkpoint = nil;
+    if (error == nil)
+    {
+        NSMutableArray *files = [NSMutableArray array];
+        for (NSUInteger index = 0; index <= self.chunkIndex; index++)
+        {
+            [files addObject:[self chunkURL:index].lastPathComponent];
+        }
+        NSDictionary *manifest = @{
+            @"date": [self.dateFormatter stringFromDate:[NSDate date]],
+            @"patients": @(self.patientCount),
+            @"rows": @(self.totalRows),
+            @"testTypes": self.testTypes,
+            @"files": files,
+        };
+        NSData *data = [NSJSONSerialization dataWithJSONObject:manifest options:NSJSONWritingPrettyPrinted error:&error];
+        if (data)
+        {
+            [data writeToURL:[self.directory URLByAppendingPathComponent:kManifestName] options:NSDataWritingAtomic error:&error];
+        }
+    }
+    else
+    {
+        NSLog(@"Export stopped: %@", error.localizedDescription);
+    }
+    NSURL *directory = error ? nil : self.directory;
+    BulkExportCompletion completion = self.completion;
+    self.progress = nil;
+    self.completion = nil;
+    self.pendingPatients = nil;
+    self.running = NO;
+    dispatch_async(dispatch_get_main_queue(), ^{
+        if (completion)
+        {
+            completion(directory, error);
+        }
+    });
+}
+
+@end
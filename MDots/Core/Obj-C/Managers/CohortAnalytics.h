@@ -0,0 +1,107 @@
+//
+//  CohortAnalytics.h
+//  MDots
+//
+//  Created by Estela Alvarez on 18/10/26.
+//
+
+#import <Foundation/Foundation.h>
+#import "QuantileSketch.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+/// The value of one patient in one norm, with the patient at the time of the test
+typedef struct
+{
+    double value;
+    /// Age at the test, in years
+    double age;
+    /// Height in cm, 0 if unknown
+    double height;
+    /// Index of the norm in the norm keys, e.g. the external rotations of a Hip Rotation test
+    uint32_t norm;
+} CohortResult;
+
+/// @class CohortNorms
+/// @discussion The normative distribution of one test type over every patient of the clinician, as quantile sketches (`QuantileSketch.c`) per norm (test and rotation) and per age and height band.
+/// Immutable once built, can be queried from any thread.
+@interface CohortNorms : NSObject
+
+/// The test type.
+@property (strong, nonatomic, readonly) NSString *testType;
+
+/// The number of values in the norms, one per patient and norm.
+@property (assign, nonatomic, readonly) NSUInteger resultCount;
+
+/// When the norms were built.
+@property (strong, nonatomic, readonly) NSDate *date;
+
+/// The percentile of a result among the results of patients of the same age and height band, or of all patients if the band has too few results.
+/// Binary search over the sketch centroids, O(log n).
+/// @param value The result.
+/// @param side The side of the result, which picks the norm of a rotation.
+/// @param age The age of the patient, in years.
+/// @param height The height of the patient in cm, 0 if unknown.
+/// @return The percentile in [0, 100], or NAN if there is no norm for the side.
+/// ```objc
+/// double percentile = [norms percentileOfValue:42 side:@"L" age:31 height:172];
+/// ```
+- (double)percentileOfValue:(double)value side:(NSString *)side age:(double)age height:(double)height;
+
+/// The result at a percentile, e.g. 50 for the median of the band.
+/// @param percentile The percentile in [0, 100].
+/// @param side The side, which picks the norm of a rotation.
+/// @param age The age of the patient, in years.
+/// @param height The height of the patient in cm, 0 if unknown.
+/// @return The result, or NAN if there is no norm for the side.
+- (double)valueAtPercentile:(double)percentile side:(NSString *)side age:(double)age height:(double)height;
+
+@end
+
+/// Called with the norms, nil if they could not be loaded.
+typedef void (^CohortNormsCompletion)(CohortNorms * _Nullable norms);
+
+/// @class CohortAnalytics
+/// @discussion Builds cohort norms from the results of a test type: the patients' tests are read with a bounded number of concurrent queries (served from the Firestore cache when offline),
+/// reduced to one value per patient and norm (the latest result of each side, averaged over the sides), partitioned across the cores, sketched per partition and merged. Norms are cached per test type.
+/// The norms include every patient, the one a percentile is asked for too: they are built once and shared by all queries, and that patient is one value among the cohort.
+@interface CohortAnalytics : NSObject
+
+/// The results a band needs before its own percentiles are used. Defaults to 30.
+@property (assign, nonatomic) NSUInteger minimumBandCount;
+
+/// The sketch accuracy parameter. Defaults to 100.
+@property (assign, nonatomic) double compression;
+
+/// How long cached norms are used, in seconds. Defaults to 1 hour.
+@property (assign, nonatomic) NSTimeInterval validityInterval;
+
+/// The number of patients whose tests are read at once. Defaults to 8.
+@property (assign, nonatomic) NSUInteger concurrentReads;
+
+/// The shared analytics.
+/// ```objc
+/// [[CohortAnalytics sharedAnalytics] loadNormsForTestType:@"Lunge" completion:^(CohortNorms *norms) { ... }];
+/// ```
++ (instancetype)sharedAnalytics;
+
+/// The cached norms of a test type, nil if none or stale.
+/// @param testType The test type.
+- (nullable CohortNorms *)normsForTestType:(NSString *)testType;
+
+/// Loads the norms of a test type: the cached ones, or reads every patient's results and builds them.
+/// Concurrent loads of the same test type share one build.
+/// @param testType The test type.
+/// @param completion Called on the main queue.
+- (void)loadNormsForTestType:(NSString *)testType completion:(CohortNormsCompletion)completion;
+
+/// Builds norms from results in memory, in parallel partitions. Called by `loadNormsForTestType:completion:`.
+/// @param testType The test type.
+/// @param results The `CohortResult` array.
+/// @param normKeys The norm keys, `AsymmetryIndex` pair keys, indexed by `CohortResult.norm`.
+/// @return The norms.
+- (CohortNorms *)buildNormsForTestType:(NSString *)testType results:(NSData *)results normKeys:(NSArray<NSString *> *)normKeys;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,407 @@
+//
+//  CohortAnalytics.m
+//  MDots
+//
+//  Created by Estela Alvarez on 18/10/26.
+//
+
+#import "CohortAnalytics.h"
+#import "AsymmetryIndex.h"
+#import <Firebase.h>
+
+/// The band counts of a norm; the sketch of all patients follows its band sketches
+enum
+{
+    kAgeBands = 5,
+    kHeightBands = 3,
+    kOverallSketch = kAgeBands * kHeightBands,
+    kSketchesPerNorm = kOverallSketch + 1,
+};
+/// Upper bounds of the age bands in years, the last band is open
+static const double kAgeBounds[kAgeBands - 1] = {18, 30, 45, 60};
+/// Upper bounds of the height bands in cm, the last band is open
+static const double kHeightBounds[kHeightBands - 1] = {160, 175};
+/// Seconds per year of age
+static const double kSecondsPerYear = 365.25 * 86400.0;
+
+/// The band sketch of a patient.
+/// @return The sketch index within a norm, or -1 if the height is unknown.
+static long CohortBand(double age, double height)
+{
+    if (!(height > 0.0))
+    {
+        return -1;
+    }
+    int ageBand = 0, heightBand = 0;
+    while (ageBand < kAgeBands - 1 && age >= kAgeBounds[ageBand])
+    {
+        ageBand++;
+    }
+    while (heightBand < kHeightBands - 1 && height >= kHeightBounds[heightBand])
+    {
+        heightBand++;
+    }
+    return (long)(ageBand * kHeightBands + heightBand);
+}
+
+#pragma mark - CohortNorms
+
+@interface CohortNorms ()
+
+@property (strong, nonatomic) NSString *testType;
+@property (assign, nonatomic) NSUInteger resultCount;
+@property (strong, nonatomic) NSDate *date;
+/// Norm key to norm index
+@property (strong, nonatomic) NSDictionary<NSString *, NSNumber *> *normIndexes;
+/// kSketchesPerNorm flushed QuantileSketchState per norm
+@property (strong, nonatomic) NSData *sketches;
+@property (assign, nonatomic) NSUInteger minimumBandCount;
+
+@end
+
+@implementation CohortNorms
+
+/// The sketch to query for a patient: its band, or all patients if the band is too small.
+/// @return The sketch, or NULL if there is no norm for the side.
+- (nullable const QuantileSketchState *)sketchForSide:(NSString *)side age:(double)age height:(double)height
+{
+    NSNumber *norm = self.normIndexes[[AsymmetryIndex pairKeyForTestType:self.testType side:side]];
+    if (norm == nil)
+    {
+        return NULL;
+    }
+    const QuantileSketchState *sketches = (const QuantileSketchState *)self.sketches.bytes + norm.unsignedIntegerValue * kSketchesPerNorm;
+    long band = CohortBand(age, height);
+    if (band >= 0 && QuantileSketchWeight(&sketches[band]) >= self.minimumBandCount)
+    {
+        return &sketches[band];
+    }
+    return &sketches[kOverallSketch];
+}
+
+- (double)percentileOfValue:(double)value side:(NSString *)side age:(double)age height:(double)height
+{
+    const QuantileSketchState *sketch = [self sketchForSide:side age:age height:height];
+    return sketch ? 100.0 * QuantileSketchCdf(sketch, value) : NAN;
+}
+
+- (double)valueAtPercentile:(double)percentile side:(NSString *)side age:(double)age height:(double)height
+{
+    const QuantileSketchState *sketch = [self sketchForSide:side age:age height:height];
+    return sketch ? QuantileSketchQuantile(sketch, percentile / 100.0) : NAN;
+}
+
+- (NSString *)description
+{
+    return [NSString stringWithFormat:@"<CohortNorms %@: %lu results, norms %@>", self.testType, (unsigned long)self.resultCount, self.normIndexes.allKeys];
+}
+
+@end
+
+#pragma mark - CohortLoad
+
+/// The state of one load, only touched on the analytics queue
+@interface CohortLoad : NSObject
+
+@property (strong, nonatomic) NSString *testType;
+@property (strong, nonatomic) NSArray<FIRQueryDocumentSnapshot *> *patients;
+@property (assign, nonatomic) NSUInteger next;
+@property (assign, nonatomic) NSUInteger active;
+/// CohortResult array
+@property (strong, nonatomic) NSMutableData *results;
+@property (strong, nonatomic) NSMutableArray<NSString *> *normKeys;
+@property (strong, nonatomic) NSMutableDictionary<NSString *, NSNumber *> *normIndexes;
+@property (copy, nonatomic) void (^completion)(CohortLoad *load);
+
+@end
+
+@implementation CohortLoad
+@end
+
+#pragma mark - CohortAnalytics
+
+@interface CohortAnalytics ()
+
+/// Serializes the loads and builds, off the main queue
+@property (strong, nonatomic) dispatch_queue_t queue;
+@property (strong, nonatomic) NSMutableDictionary<NSString *, CohortNorms *> *cache;
+/// Completions waiting for a load in progress, per test type
+@property (strong, nonatomic) NSMutableDictionary<NSString *, NSMutableArray<CohortNormsCompletion> *> *pendingLoads;
+
+@end
+
+@implementation CohortAnalytics
+
++ (instancetype)sharedAnalytics
+{
+    static CohortAnalytics *analytics = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        analytics = [CohortAnalytics new];
+    });
+    return analytics;
+}
+
+- (instancetype)init
+{
+    if (self = [super init])
+    {
+        _minimumBandCount = 30;
+        _compression = 100;
+        _validityInterval = 60 * 60;
+        _concurrentReads = 8;
+        _queue = dispatch_queue_create("CohortAnalytics", DISPATCH_QUEUE_SERIAL);
+        _cache = [NSMutableDictionary dictionary];
+        _pendingLoads = [NSMutableDictionary dictionary];
+    }
+    return self;
+}
+
+- (nullable CohortNorms *)normsForTestType:(NSString *)testType
+{
+    @synchronized (self)
+    {
+        CohortNorms *norms = self.cache[testType];
+        return norms && -[norms.date timeIntervalSinceNow] < self.validityInterval ? norms : nil;
+    }
+}
+
+- (void)loadNormsForTestType:(NSString *)testType completion:(CohortNormsCompletion)completion
+{
+    CohortNorms *cached = [self normsForTestType:testType];
+    if (cached)
+    {
+        dispatch_async(dispatch_get_main_queue(), ^{
+            completion(cached);
+        });
+        return;
+    }
+    @synchronized (self)
+    {
+        NSMutableArray *waiting = self.pendingLoads[testType];
+        if (waiting)
+        {
+            [waiting addObject:completion];
+            return;
+        }
+        self.pendingLoads[testType] = [NSMutableArray arrayWithObject:completion];
+    }
+    
+    __weak __typeof(self) wself = self;
+    [self readResultsOfTestType:testType completion:^(CohortLoad * _Nullable load) {
+        CohortNorms *norms = load ? [wself buildNormsForTestType:testType results:load.results normKeys:load.normKeys] : nil;
+        NSArray<CohortNormsCompletion> *waiting;
+        @synchronized (wself)
+        {
+            if (norms)
+            {
+                wself.cache[testType] = norms;
+            }
+            waiting = wself.pendingLoads[testType];
+            [wself.pendingLoads removeObjectForKey:testType];
+        }
+        dispatch_async(dispatch_get_main_queue(), ^{
+            for (CohortNormsCompletion block in waiting)
+            {
+                block(norms);
+            }
+        });
+    }];
+}
+
+/// Reads the results of a test type of every patient of the current user.
+/// @param testType The test type.
+/// @param completion Called on the analytics queue, with nil if the patients could not be listed.
+- (void)readResultsOfTestType:(NSString *)testType completion:(void (^)(CohortLoad * _Nullable load))completion
+{
+    FIRUser *currentUser = [FIRAuth auth].currentUser;
+    if (!currentUser)
+    {
+        NSLog(@"Error: Current user not available.");
+        dispatch_async(self.queue, ^{
+            completion(nil);
+        });
+        return;
+    }
+    FIRCollectionReference *patientsRef = [[FIRFirestore firestore] collectionWithPath:[NSString stringWithFormat:@"users/%@/patients", currentUser.uid]];
+    __weak __typeof(self) wself = self;
+    [patientsRef getDocumentsWithCompletion:^(FIRQuerySnapshot * _Nullable snapshot, NSError * _Nullable error) {
+        dispatch_async(wself.queue, ^{
+            if (snapshot == nil)
+            {
+                NSLog(@"Error fetching patients: %@", error.localizedDescription);
+                completion(nil);
+                return;
+            }
+            CohortLoad *load = [CohortLoad new];
+            load.testType = testType;
+            load.patients = snapshot.documents;
+            load.results = [NSMutableData data];
+            load.normKeys = [NSMutableArray array];
+            load.normIndexes = [NSMutableDictionary dictionary];
+            load.completion = completion;
+            [wself readNextPatientsOfLoad:load];
+        });
+    }];
+}
+
+/// Starts reading patients until `concurrentReads` reads are in flight, and completes the load once all were read.
+/// Runs on the analytics queue.
+/// @param load The load.
+- (void)readNextPatientsOfLoad:(CohortLoad *)load
+{
+    __weak __typeof(self) wself = self;
+    while (load.active < MAX(self.concurrentReads, 1u) && load.next < load.patients.count)
+    {
+        FIRQueryDocumentSnapshot *patient = load.patients[load.next++];
+        load.active++;
+        [[patient.reference collectionWithPath:load.testType] getDocumentsWithCompletion:^(FIRQuerySnapshot * _Nullable snapshot, NSError * _Nullable error) {
+            dispatch_async(wself.queue, ^{
+                load.active--;
+                if (snapshot)
+                {
+                    [wself appendTests:snapshot.documents ofPatient:patient toLoad:load];
+                }
+                else
+                {
+                    NSLog(@"Error fetching tests of %@: %@", patient.documentID, error.localizedDescription);
+                }
+                [wself readNextPatientsOfLoad:load];
+            });
+        }];
+    }
+    if (load.active == 0 && load.next == load.patients.count && load.completion)
+    {
+        void (^completion)(CohortLoad *) = load.completion;
+        load.completion = nil;
+        completion(load);
+    }
+}
+
+/// Appends the results of a patient to a load: one value per norm, so a patient tested often weighs no more than one tested once.
+/// The value is the latest result of each side of the norm, averaged over the sides, at the age of the latest of those tests.
+/// @param tests The test documents.
+/// @param patient The patient document, for the birth date and the height.
+/// @param load The load.
+- (void)appendTests:(NSArray<FIRQueryDocumentSnapshot *> *)tests ofPatient:(FIRQueryDocumentSnapshot *)patient toLoad:(CohortLoad *)load
+{
+    id birthDate = patient.data[@"birthDate"];
+    NSDate *birth = [birthDate isKindOfClass:[FIRTimestamp class]] ? [(FIRTimestamp *)birthDate dateValue] : nil;
+    double height = [patient.data[@"height"] doubleValue];
+    // The latest test of each side
+    NSMutableDictionary<NSString *, NSDictionary *> *latest = [NSMutableDictionary dictionary];
+    NSMutableDictionary<NSString *, NSDate *> *latestDates = [NSMutableDictionary dictionary];
+    for (FIRQueryDocumentSnapshot *test in tests)
+    {
+        NSDictionary *data = test.data;
+        id value = data[@"value"];
+        id side = data[@"side"];
+        id testDate = data[@"testDate"];
+        if (![value isKindOfClass:[NSNumber class]] || ![side isKindOfClass:[NSString class]])
+        {
+            continue;
+        }
+        NSDate *date = [testDate isKindOfClass:[FIRTimestamp class]] ? [(FIRTimestamp *)testDate dateValue] : [NSDate date];
+        NSDate *previous = latestDates[side];
+        if (previous == nil || [date compare:previous] == NSOrderedDescending)
+        {
+            latest[side] = data;
+            latestDates[side] = date;
+        }
+    }
+    
+    // Both sides of a norm, e.g. the left and right Lunge, fold into one value
+    NSMutableDictionary<NSString *, NSMutableArray<NSString *> *> *sidesOfNorm = [NSMutableDictionary dictionary];
+    for (NSString *side in latest)
+    {
+        NSString *key = [AsymmetryIndex pairKeyForTestType:load.testType side:side];
+        if (sidesOfNorm[key] == nil)
+        {
+            sidesOfNorm[key] = [NSMutableArray array];
+        }
+        [sidesOfNorm[key] addObject:side];
+    }
+    [sidesOfNorm enumerateKeysAndObjectsUsingBlock:^(NSString *key, NSArray<NSString *> *sides, BOOL *stop) {
+        NSNumber *norm = load.normIndexes[key];
+        if (norm == nil)
+        {
+            norm = @(load.normKeys.count);
+            load.normIndexes[key] = norm;
+            [load.normKeys addObject:key];
+        }
+        double sum = 0;
+        NSDate *date = nil;
+        for (NSString *side in sides)
+        {
+            sum += [latest[side][@"value"] doubleValue];
+            date = date ? [date laterDate:latestDates[side]] : latestDates[side];
+        }
+        CohortResult result;
+        result.value = sum / sides.count;
+        result.age = birth ? [date timeIntervalSinceDate:birth] / kSecondsPerYear : -1;
+        result.height = height;
+        result.norm = norm.unsignedIntValue;
+        [load.results appendBytes:&result length:sizeof(result)];
+    }];
+}
+
+- (CohortNorms *)buildNormsForTestType:(NSString *)testType results:(NSData *)results normKeys:(NSArray<NSString *> *)normKeys
+{
+    const CohortResult *items = results.bytes;
+    size_t count = results.length / sizeof(CohortResult);
+    size_t normCount = normKeys.count;
+    size_t perPartition = normCount * kSketchesPerNorm;
+    // Small cohorts are not worth the extra sketches
+    size_t partitions = MAX(MIN((size_t)[NSProcessInfo processInfo].activeProcessorCount, count / 4096), 1u);
+    NSMutableData *workspace = [NSMutableData dataWithLength:partitions * perPartition * sizeof(QuantileSketchState)];
+    QuantileSketchState *sketches = workspace.mutableBytes;
+    double compression = self.compression;
+    
+    dispatch_apply(partitions, DISPATCH_APPLY_AUTO, ^(size_t partition) {
+        QuantileSketchState *own = sketches + partition * perPartition;
+        for (size_t i = 0; i < perPartition; i++)
+        {
+            QuantileSketchInit(&own[i], compression);
+        }
+        size_t end = count * (partition + 1) / partitions;
+        for (size_t i = count * partition / partitions; i < end; i++)
+        {
+            if (items[i].norm >= normCount)
+            {
+                continue;
+            }
+            QuantileSketchState *norm = own + items[i].norm * kSketchesPerNorm;
+            QuantileSketchAdd(&norm[kOverallSketch], items[i].value, 1.0);
+            long band = items[i].age >= 0 ? CohortBand(items[i].age, items[i].height) : -1;
+            if (band >= 0)
+            {
+                QuantileSketchAdd(&norm[band], items[i].value, 1.0);
+            }
+        }
+    });
+    // Merge the partitions into the first one, one sketch per task
+    dispatch_apply(perPartition, DISPATCH_APPLY_AUTO, ^(size_t sketch) {
+        for (size_t partition = 1; partition < partitions; partition++)
+        {
+            QuantileSketchMerge(&sketches[sketch], &sketches[partition * perPartition + sketch]);
+        }
+        QuantileSketchFlush(&sketches[sketch]);
+    });
+    
+    NSMutableDictionary *normIndexes = [NSMutableDictionary dictionaryWithCapacity:normCount];
+    for (NSUInteger i = 0; i < normCount; i++)
+    {
+        normIndexes[normKeys[i]] = @(i);
+    }
+    CohortNorms *norms = [CohortNorms new];
+    norms.testType = testType;
+    norms.resultCount = count;
+    norms.date = [NSDate date];
+    norms.normIndexes = normIndexes;
+    norms.sketches = [NSData dataWithBytes:sketches length:perPartition * sizeof(QuantileSketchState)];
+    norms.minimumBandCount = self.minimumBandCount;
+    NSLog(@"Built %@ over %zu partitions", norms, partitions);
+    return norms;
+}
+
+@end
@@ -0,0 +1,69 @@
+//
+//  FirmwareUpdateScheduler.h
+//  MDots
+//
+//  Created by Estela Alvarez on 18/10/26.
+//
+
+#import <Foundation/Foundation.h>
+#import <MovellaDotSdk/DotDevice.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/// The firmware update state of one device
+typedef NS_ENUM(NSInteger, FirmwareUpdateState)
+{
+    FirmwareUpdateStatePending = 0,
+    FirmwareUpdateStateChecking,
+    /// An update is downloaded and waiting for a free slot
+    FirmwareUpdateStateReady,
+    /// The sensor must be put on its charger before it can be updated
+    FirmwareUpdateStateWaitingForCharge,
+    FirmwareUpdateStateUpdating,
+    FirmwareUpdateStateUpToDate,
+    FirmwareUpdateStateSucceeded,
+    FirmwareUpdateStateFailed,
+};
+
+/// Overall progress from 0 to 1, and the state of every device keyed by mac address.
+typedef void (^FirmwareUpdateProgressBlock)(float progress, NSDictionary<NSString *, NSNumber *> *states);
+/// The final state of every device keyed by mac address.
+typedef void (^FirmwareUpdateCompletionBlock)(NSDictionary<NSString *, NSNumber *> *states);
+
+/// @class FirmwareUpdateScheduler
+/// @discussion Updates the firmware of a whole kit with `DotOtaManager`. Checks run one device at a time so each firmware image is downloaded once into the SDK cache and reused, updates run on up to `maxConcurrentUpdates` sensors at once, sensors that are not charging wait until they are, and failed updates are retried.
+@interface FirmwareUpdateScheduler : NSObject
+
+/// How many sensors are updated at the same time. Defaults to 2, to keep the BLE link reliable.
+@property (assign, nonatomic) NSUInteger maxConcurrentUpdates;
+
+/// How many times a failed update is retried. Defaults to 2.
+@property (assign, nonatomic) NSUInteger maxRetries;
+
+/// How long checking a device for an update, download included, may take before it counts as failed, in seconds. Defaults to 2 minutes.
+@property (assign, nonatomic) NSTimeInterval checkTimeout;
+
+/// How long an update may take before it is stopped and counted as failed, in seconds. Defaults to 10 minutes.
+@property (assign, nonatomic) NSTimeInterval updateTimeout;
+
+/// Whether updates are running.
+@property (assign, nonatomic, readonly) BOOL running;
+
+/// The shared scheduler. It owns the `DotOtaManager` delegate while running.
+/// ```objc
+/// [[FirmwareUpdateScheduler sharedScheduler] updateDevices:self.connectList progress:nil completion:nil];
+/// ```
++ (instancetype)sharedScheduler;
+
+/// Checks the devices for updates and installs them. Devices that are not connected are skipped.
+/// @param devices The devices to update.
+/// @param progress Called on the main queue whenever a device progresses or changes state.
+/// @param completion Called on the main queue once every device is up to date, updated or failed.
+- (void)updateDevices:(NSArray<DotDevice *> *)devices progress:(nullable FirmwareUpdateProgressBlock)progress completion:(nullable FirmwareUpdateCompletionBlock)completion;
+
+/// Stops the running updates, completing with the states reached so far.
+- (void)cancel;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,416 @@
+//
+//  FirmwareUpdateScheduler.m
+//  MDots
+//
+//  Created by Estela Alvarez on 18/10/26.
+//
+
+#import "FirmwareUpdateScheduler.h"
+#import <MovellaDotSdk/DotOtaManager.h>
+#import <MovellaDotSdk/DotDefine.h>
+
+/// Delay before a failed update is tried again
+static const NSTimeInterval kRetryDelay = 5;
+
+/// The update bookkeeping of one device
+@interface FirmwareUpdateJob : NSObject
+
+@property (strong, nonatomic) DotDevice *device;
+@property (assign, nonatomic) FirmwareUpdateState state;
+@property (assign, nonatomic) float progress;
+@property (assign, nonatomic) NSUInteger attempts;
+/// Increased on every start, so a stale timeout does not stop a later attempt
+@property (assign, nonatomic) NSUInteger generation;
+/// A failed update is not started again before this date
+@property (strong, nonatomic, nullable) NSDate *retryDate;
+
+@end
+
+@implementation FirmwareUpdateJob
+
+- (BOOL)isFinished
+{
+    return self.state == FirmwareUpdateStateUpToDate || self.state == FirmwareUpdateStateSucceeded || self.state == FirmwareUpdateStateFailed;
+}
+
+@end
+
+@interface FirmwareUpdateScheduler ()<DotOtaManagerDelegate>
+
+@property (assign, nonatomic) BOOL running;
+/// Jobs in the order the devices were given
+@property (strong, nonatomic) NSMutableArray<FirmwareUpdateJob *> *jobs;
+@property (copy, nonatomic, nullable) FirmwareUpdateProgressBlock progressBlock;
+@property (copy, nonatomic, nullable) FirmwareUpdateCompletionBlock completionBlock;
+
+@end
+
+@implementation FirmwareUpdateScheduler
+
++ (instancetype)sharedScheduler
+{
+    static FirmwareUpdateScheduler *scheduler = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        scheduler = [FirmwareUpdateScheduler new];
+    });
+    return scheduler;
+}
+
+- (instancetype)init
+{
+    if (self = [super init])
+    {
+        _maxConcurrentUpdates = 2;
+        _maxRetries = 2;
+        _checkTimeout = 2 * 60;
+        _updateTimeout = 10 * 60;
+        _jobs = [NSMutableArray array];
+    }
+    return self;
+}
+
+- (void)updateDevices:(NSArray<DotDevice *> *)devices progress:(FirmwareUpdateProgressBlock)progress completion:(FirmwareUpdateCompletionBlock)completion
+{
+    if (self.running)
+    {
+        NSLog(@"Firmware update already running");
+        return;
+    }
+    self.running = YES;
+    self.progressBlock = progress;
+    self.completionBlock = completion;
+    [self.jobs removeAllObjects];
+    for (DotDevice *device in devices)
+    {
+        if (!device.stateIsConnected)
+        {
+            // Would never answer the check and hold up every other device
+            NSLog(@"Skipping firmware update of disconnected %@", device.macAddress);
+            continue;
+        }
+        FirmwareUpdateJob *job = [FirmwareUpdateJob new];
+        job.device = device;
+        [self.jobs addObject:job];
+    }
+    
+    [DotOtaManager setOtaManagerDelegate:self];
+    [[NSNotificationCenter defaultCenter] addObserver:self selector:@selector(onDeviceBatteryUpdated:) name:kDotNotificationDeviceBatteryDidUpdate object:nil];
+    [self schedule];
+}
+
+- (void)cancel
+{
+    if (!self.running)
+    {
+        return;
+    }
+    for (FirmwareUpdateJob *job in self.jobs)
+    {
+        if (job.state == FirmwareUpdateStateUpdating)
+        {
+            [[DotOtaManager defaultManager] stopOta:job.device];
+            job.state = FirmwareUpdateStateFailed;
+        }
+    }
+    [self finish];
+}
+
+#pragma mark - Scheduling
+
+/// The job of a device.
+/// @param address The device mac address.
+- (nullable FirmwareUpdateJob *)jobForAddress:(NSString *)address
+{
+    for (FirmwareUpdateJob *job in self.jobs)
+    {
+        if ([job.device.macAddress isEqualToString:address])
+        {
+            return job;
+        }
+    }
+    return nil;
+}
+
+/// Starts the next check and as many updates as there are free slots, then reports progress or completion.
+- (void)schedule
+{
+    if (!self.running)
+    {
+        return;
+    }
+    
+    // One check at a time, so a firmware image already downloaded for a previous device is reused from the cache
+    BOOL checking = NO;
+    for (FirmwareUpdateJob *job in self.jobs)
+    {
+        checking = checking || job.state == FirmwareUpdateStateChecking;
+    }
+    if (!checking)
+    {
+        for (FirmwareUpdateJob *job in self.jobs)
+        {
+            if (job.state == FirmwareUpdateStatePending)
+            {
+                [self checkJob:job];
+                break;
+            }
+        }
+    }
+    
+    NSUInteger updating = 0;
+    for (FirmwareUpdateJob *job in self.jobs)
+    {
+        updating += job.state == FirmwareUpdateStateUpdating ? 1 : 0;
+    }
+    for (FirmwareUpdateJob *job in self.jobs)
+    {
+        if (updating >= self.maxConcurrentUpdates)
+        {
+            break;
+        }
+        BOOL startable = job.state == FirmwareUpdateStateReady || job.state == FirmwareUpdateStateWaitingForCharge;
+        if (!startable || [job.retryDate timeIntervalSinceNow] > 0)
+        {
+            continue;
+        }
+        if (!job.device.battery.chargeState)
+        {
+            // The sensor refuses OTA unless it is charging
+            job.state = FirmwareUpdateStateWaitingForCharge;
+            continue;
+        }
+        [self startJob:job];
+        updating++;
+    }
+    
+    [self reportProgress];
+    BOOL finished = YES;
+    for (FirmwareUpdateJob *job in self.jobs)
+    {
+        finished = finished && [job isFinished];
+    }
+    if (finished)
+    {
+        [self finish];
+    }
+}
+
+/// Checks a device for an update with a timeout, so a device that never answers does not hold up the others.
+/// @param job The job to check.
+- (void)checkJob:(FirmwareUpdateJob *)job
+{
+    job.state = FirmwareUpdateStateChecking;
+    job.generation += 1;
+    NSUInteger generation = job.generation;
+    [[DotOtaManager defaultManager] checkOtaUpdatesAndDownload:job.device];
+    
+    __weak __typeof(self) wself = self;
+    dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(self.checkTimeout * NSEC_PER_SEC)), dispatch_get_main_queue(), ^{
+        if (job.state == FirmwareUpdateStateChecking && job.generation == generation)
+        {
+            NSLog(@"Firmware check of %@ timed out", job.device.macAddress);
+            job.state = FirmwareUpdateStateFailed;
+            [wself schedule];
+        }
+    });
+}
+
+/// Starts the update of a device with a timeout.
+/// @param job The job to start.
+- (void)startJob:(FirmwareUpdateJob *)job
+{
+    job.state = FirmwareUpdateStateUpdating;
+    job.progress = 0;
+    job.attempts += 1;
+    job.generation += 1;
+    NSUInteger generation = job.generation;
+    NSLog(@"Updating firmware of %@, attempt %lu", job.device.macAddress, (unsigned long)job.attempts);
+    [[DotOtaManager defaultManager] startOta:job.device];
+    
+    __weak __typeof(self) wself = self;
+    dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(self.updateTimeout * NSEC_PER_SEC)), dispatch_get_main_queue(), ^{
+        if (job.state == FirmwareUpdateStateUpdating && job.generation == generation)
+        {
+            NSLog(@"Firmware update of %@ timed out", job.device.macAddress);
+            [[DotOtaManager defaultManager] stopOta:job.device];
+            [wself failJob:job];
+        }
+    });
+}
+
+/// Retries a failed update after a delay, or marks it failed once the retries are used up.
+/// @param job The failed job.
+- (void)failJob:(FirmwareUpdateJob *)job
+{
+    if (job.attempts > self.maxRetries)
+    {
+        job.state = FirmwareUpdateStateFailed;
+        [self schedule];
+        return;
+    }
+    // The device reboots after a failed attempt, give it time before the next one
+    job.state = FirmwareUpdateStateReady;
+    job.retryDate = [NSDate dateWithTimeIntervalSinceNow:kRetryDelay];
+    [self schedule];
+    __weak __typeof(self) wself = self;
+    dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(kRetryDelay * NSEC_PER_SEC)), dispatch_get_main_queue(), ^{
+        [wself schedule];
+    });
+}
+
+/// Reports the overall progress and the device states.
+- (void)reportProgress
+{
+    if (self.progressBlock == nil || self.jobs.count == 0)
+    {
+        return;
+    }
+    float total = 0;
+    NSMutableDictionary *states = [NSMutableDictionary dictionaryWithCapacity:self.jobs.count];
+    for (FirmwareUpdateJob *job in self.jobs)
+    {
+        total += [job isFinished] ? 1 : job.progress;
+        states[job.device.macAddress] = @(job.state);
+    }
+    self.progressBlock(total / self.jobs.count, states);
+}
+
+/// Releases the OTA delegate and reports the final states.
+- (void)finish
+{
+    [DotOtaManager setOtaManagerDelegate:nil];
+    [[NSNotificationCenter defaultCenter] removeObserver:self name:kDotNotificationDeviceBatteryDidUpdate object:nil];
+    NSMutableDictionary *states = [NSMutableDictionary dictionaryWithCapacity:self.jobs.count];
+    for (FirmwareUpdateJob *job in self.jobs)
+    {
+        states[job.device.macAddress] = @(job.state);
+    }
+    FirmwareUpdateCompletionBlock completion = self.completionBlock;
+    self.running = NO;
+    self.progressBlock = nil;
+    self.completionBlock = nil;
+    if (completion)
+    {
+        completion(states);
+    }
+}
+
+#pragma mark - Notification
+
+/// Starts the updates of sensors that were put on their charger.
+/// @param sender The notification, whose object is the DotDevice.
+- (void)onDeviceBatteryUpdated:(NSNotification *)sender
+{
+    dispatch_async(dispatch_get_main_queue(), ^{
+        [self schedule];
+    });
+}
+
+#pragma mark - DotOtaManagerDelegate
+
+- (void)onOtaUpdates:(NSString *)address result:(BOOL)result version:(NSString *)version releaseNotes:(NSString *)releaseNotes
+{
+    dispatch_async(dispatch_get_main_queue(), ^{
+        FirmwareUpdateJob *job = [self jobForAddress:address];
+        if (job.state != FirmwareUpdateStateChecking)
+        {
+            return;
+        }
+        if (!result)
+        {
+            job.state = FirmwareUpdateStateUpToDate;
+            [self schedule];
+        }
+        // Otherwise wait for onOtaDownload
+    });
+}
+
+- (void)onOtaDownload:(NSString *)address version:(NSString *)version
+{
+    dispatch_async(dispatch_get_main_queue(), ^{
+        FirmwareUpdateJob *job = [self jobForAddress:address];
+        if (job.state == FirmwareUpdateStateChecking)
+        {
+            NSLog(@"Firmware %@ ready for %@", version, address);
+            job.state = FirmwareUpdateStateReady;
+            [self schedule];
+        }
+    });
+}
+
+- (void)onOtaUncharged:(NSString *)address
+{
+    dispatch_async(dispatch_get_main_queue(), ^{
+        FirmwareUpdateJob *job = [self jobForAddress:address];
+        if (job.state == FirmwareUpdateStateUpdating)
+        {
+            // Not a failed attempt, the update starts again once the sensor charges
+            job.attempts -= 1;
+            job.state = FirmwareUpdateStateWaitingForCharge;
+            [self schedule];
+        }
+    });
+}
+
+- (void)onOtaFileMismatch:(NSString *)address
+{
+    dispatch_async(dispatch_get_main_queue(), ^{
+        FirmwareUpdateJob *job = [self jobForAddress:address];
+        if (job && ![job isFinished])
+        {
+            NSLog(@"Firmware file does not match %@", address);
+            job.state = FirmwareUpdateStateFailed;
+            [self schedule];
+        }
+    });
+}
+
+- (void)onOtaStart:(NSString *)address result:(BOOL)result errorCode:(int)errorCode
+{
+    dispatch_async(dispatch_get_main_queue(), ^{
+        FirmwareUpdateJob *job = [self jobForAddress:address];
+        if (job.state == FirmwareUpdateStateUpdating && !result)
+        {
+            NSLog(@"Firmware update of %@ did not start, error %d", address, errorCode);
+            [self failJob:job];
+        }
+    });
+}
+
+- (void)onOtaProgress:(NSString *)address progress:(float)progress errorCode:(int)errorCode
+{
+    dispatch_async(dispatch_get_main_queue(), ^{
+        FirmwareUpdateJob *job = [self jobForAddress:address];
+        if (job.state == FirmwareUpdateStateUpdating)
+        {
+            // Accept both a fraction and a percentage
+            float fraction = progress > 1 ? progress / 100.0f : progress;
+            job.progress = MIN(MAX(fraction, 0), 1);
+            [self reportProgress];
+        }
+    });
+}
+
+- (void)onOtaEnd:(NSString *)address result:(BOOL)result errorCode:(int)errorCode
+{
+    dispatch_async(dispatch_get_main_queue(), ^{
+        FirmwareUpdateJob *job = [self jobForAddress:address];
+        if (job.state != FirmwareUpdateStateUpdating)
+        {
+            return;
+        }
+        if (result)
+        {
+            job.state = FirmwareUpdateStateSucceeded;
+            [self schedule];
+        }
+        else
+        {
+            NSLog(@"Firmware update of %@ failed, error %d", address, errorCode);
+            [self failJob:job];
+        }
+    });
+}
+
+@end
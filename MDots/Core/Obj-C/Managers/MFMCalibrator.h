@@ -0,0 +1,62 @@
+//
+//  MFMCalibrator.h
+//  MDots
+//
+//  Created by Estela Alvarez on 18/10/26.
+//
+
+#import <Foundation/Foundation.h>
+#import <MovellaDotSdk/DotDevice.h>
+#import <MovellaDotSdk/DotDefine.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/// Overall progress of a calibration, from 0 to 1.
+typedef void (^MFMCalibrationProgressBlock)(float progress);
+/// The result of every calibrated device keyed by mac address (NSNumber of XSDotMFMResultTpye).
+typedef void (^MFMCalibrationCompletionBlock)(NSDictionary<NSString *, NSNumber *> *results);
+
+/// @class MFMCalibrator
+/// @discussion Runs the magnetic field mapping (MFM) of several sensors at the same time, so a kit takes as long as one sensor. Results are cached per mac address with their date (in NSUserDefaults), and only devices without a recent good result are mapped again.
+@interface MFMCalibrator : NSObject
+
+/// How long an MFM result is trusted, in seconds. Defaults to 7 days.
+@property (assign, nonatomic) NSTimeInterval validityInterval;
+
+/// How long a calibration may run before the devices without a result fail. Defaults to 3 minutes.
+@property (assign, nonatomic) NSTimeInterval timeout;
+
+/// Whether a calibration is running.
+@property (assign, nonatomic, readonly) BOOL running;
+
+/// The shared calibrator.
+/// ```objc
+/// [[MFMCalibrator sharedCalibrator] calibrateDevices:devices progress:nil completion:nil];
+/// ```
++ (instancetype)sharedCalibrator;
+
+/// The devices without an acceptable result newer than `validityInterval`.
+/// @param devices The candidate devices.
+- (NSArray<DotDevice *> *)staleDevices:(NSArray<DotDevice *> *)devices;
+
+/// The date of the last acceptable result of a device, or nil.
+/// @param address The device mac address.
+- (nullable NSDate *)lastCalibrationDateForAddress:(NSString *)address;
+
+/// Maps the stale devices among the given ones in parallel. The sensors must be rotated in every direction until the progress reaches 1.
+/// A device that disconnects, or has no result within `timeout`, fails with `XSDotMFMResultFailed`.
+/// @param devices The devices to calibrate.
+/// @param progress Called on the main queue with the mean progress of the mapped devices.
+/// @param completion Called on the main queue when every mapped device finished. Empty if no device was stale or a calibration is already running.
+- (void)calibrateDevices:(NSArray<DotDevice *> *)devices progress:(nullable MFMCalibrationProgressBlock)progress completion:(nullable MFMCalibrationCompletionBlock)completion;
+
+/// Stops the running calibration, completing with the results received so far and `XSDotMFMResultFailed` for the other devices.
+- (void)cancel;
+
+/// Forgets the cached result of a device, so it is mapped again.
+/// @param address The device mac address.
+- (void)invalidateAddress:(NSString *)address;
+
+@end
+
+NS_ASSUME_NONNULL_END
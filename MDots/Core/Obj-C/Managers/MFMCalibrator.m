@@ -0,0 +1,254 @@
+//
+//  MFMCalibrator.m
+//  MDots
+//
+//  Created by Estela Alvarez on 18/10/26.
+//
+
+#import "MFMCalibrator.h"
+#import <MovellaDotSdkMfm/DotMFMManager.h>
+#import <MovellaDotSdk/DotDefine.h>
+
+/// NSUserDefaults key of the cache, a dictionary of mac address to @{date, result}
+static NSString * const kMFMCacheKey = @"MFMCalibrationCache";
+static NSString * const kMFMCacheDateKey = @"date";
+static NSString * const kMFMCacheResultKey = @"result";
+
+@interface MFMCalibrator ()<DotMFMDelegate>
+
+@property (assign, nonatomic) BOOL running;
+/// The devices being mapped
+@property (strong, nonatomic) NSArray<DotDevice *> *devices;
+/// Progress from 0 to 100 per mac address
+@property (strong, nonatomic) NSMutableDictionary<NSString *, NSNumber *> *progresses;
+/// Result per mac address
+@property (strong, nonatomic) NSMutableDictionary<NSString *, NSNumber *> *results;
+@property (copy, nonatomic, nullable) MFMCalibrationProgressBlock progressBlock;
+@property (copy, nonatomic, nullable) MFMCalibrationCompletionBlock completionBlock;
+/// Increased on every calibration, so a stale timeout does not stop a later one
+@property (assign, nonatomic) NSUInteger generation;
+
+@end
+
+@implementation MFMCalibrator
+
++ (instancetype)sharedCalibrator
+{
+    static MFMCalibrator *calibrator = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        calibrator = [MFMCalibrator new];
+    });
+    return calibrator;
+}
+
+- (instancetype)init
+{
+    if (self = [super init])
+    {
+        _validityInterval = 7 * 24 * 60 * 60;
+        _timeout = 3 * 60;
+        _progresses = [NSMutableDictionary dictionary];
+        _results = [NSMutableDictionary dictionary];
+    }
+    return self;
+}
+
+#pragma mark - Cache
+
+- (NSDictionary *)cache
+{
+    return [[NSUserDefaults standardUserDefaults] dictionaryForKey:kMFMCacheKey] ?: @{};
+}
+
+- (nullable NSDate *)lastCalibrationDateForAddress:(NSString *)address
+{
+    NSDictionary *entry = [self cache][address];
+    return entry[kMFMCacheDateKey];
+}
+
+- (NSArray<DotDevice *> *)staleDevices:(NSArray<DotDevice *> *)devices
+{
+    NSMutableArray *stale = [NSMutableArray array];
+    for (DotDevice *device in devices)
+    {
+        NSDate *date = [self lastCalibrationDateForAddress:device.macAddress];
+        if (date == nil || -[date timeIntervalSinceNow] > self.validityInterval)
+        {
+            [stale addObject:device];
+        }
+    }
+    return stale;
+}
+
+/// Stores an acceptable result of a device with the current date.
+/// @param result The MFM result.
+/// @param address The device mac address.
+- (void)cacheResult:(XSDotMFMResultTpye)result forAddress:(NSString *)address
+{
+    NSMutableDictionary *cache = [[self cache] mutableCopy];
+    cache[address] = @{ kMFMCacheDateKey: [NSDate date], kMFMCacheResultKey: @(result) };
+    [[NSUserDefaults standardUserDefaults] setObject:cache forKey:kMFMCacheKey];
+}
+
+- (void)invalidateAddress:(NSString *)address
+{
+    NSMutableDictionary *cache = [[self cache] mutableCopy];
+    [cache removeObjectForKey:address];
+    [[NSUserDefaults standardUserDefaults] setObject:cache forKey:kMFMCacheKey];
+}
+
+#pragma mark - Calibration
+
+- (void)calibrateDevices:(NSArray<DotDevice *> *)devices progress:(MFMCalibrationProgressBlock)progress completion:(MFMCalibrationCompletionBlock)completion
+{
+    if (self.running)
+    {
+        NSLog(@"MFM already running");
+        if (completion)
+        {
+            completion(@{});
+        }
+        return;
+    }
+    NSArray *stale = [self staleDevices:devices];
+    if (stale.count == 0)
+    {
+        if (completion)
+        {
+            completion(@{});
+        }
+        return;
+    }
+    
+    self.running = YES;
+    self.devices = stale;
+    self.progressBlock = progress;
+    self.completionBlock = completion;
+    [self.progresses removeAllObjects];
+    [self.results removeAllObjects];
+    
+    __weak __typeof(self) wself = self;
+    for (DotDevice *device in stale)
+    {
+        self.progresses[device.macAddress] = @0;
+        [device setDidMFMProgress:^(NSString * _Nonnull address, int progress) {
+            [wself onMFMProgress:progress address:address];
+        }];
+        [device setDidMFMResult:^(NSString * _Nonnull address, XSDotMFMResultTpye type) {
+            [wself onMFMCompleted:type address:address];
+        }];
+    }
+    [[NSNotificationCenter defaultCenter] addObserver:self selector:@selector(onDeviceDisconnected:) name:kDotNotificationDeviceDidDisconnect object:nil];
+    // One call for all devices, the sensors are mapped at the same time
+    DotMFMManager *manager = [DotMFMManager defaultManager];
+    manager.mfmDelegate = self;
+    [manager startMFM:stale];
+    
+    self.generation += 1;
+    NSUInteger generation = self.generation;
+    dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(self.timeout * NSEC_PER_SEC)), dispatch_get_main_queue(), ^{
+        if (wself.running && wself.generation == generation)
+        {
+            NSLog(@"MFM timed out");
+            [wself cancel];
+        }
+    });
+}
+
+- (void)cancel
+{
+    if (!self.running)
+    {
+        return;
+    }
+    [[DotMFMManager defaultManager] stopMFM:self.devices];
+    [self finish];
+}
+
+/// Clears the callbacks and reports the results, the devices without one as failed.
+- (void)finish
+{
+    [[NSNotificationCenter defaultCenter] removeObserver:self name:kDotNotificationDeviceDidDisconnect object:nil];
+    for (DotDevice *device in self.devices)
+    {
+        [device setDidMFMProgress:nil];
+        [device setDidMFMResult:nil];
+    }
+    [DotMFMManager defaultManager].mfmDelegate = nil;
+    MFMCalibrationCompletionBlock completion = self.completionBlock;
+    NSMutableDictionary *results = [self.results mutableCopy];
+    for (DotDevice *device in self.devices)
+    {
+        if (results[device.macAddress] == nil)
+        {
+            results[device.macAddress] = @(XSDotMFMResultFailed);
+        }
+    }
+    self.running = NO;
+    self.devices = nil;
+    self.progressBlock = nil;
+    self.completionBlock = nil;
+    if (completion)
+    {
+        completion(results);
+    }
+}
+
+#pragma mark - Notification
+
+/// Fails the mapping of a device that disconnected.
+/// @param sender The notification, whose object is the DotDevice.
+- (void)onDeviceDisconnected:(NSNotification *)sender
+{
+    DotDevice *device = sender.object;
+    NSLog(@"MFM of %@ interrupted by a disconnection", device.macAddress);
+    [self onMFMCompleted:XSDotMFMResultFailed address:device.macAddress];
+}
+
+#pragma mark - DotMFMDelegate
+
+// The device blocks and the manager delegate may both report, so both handlers are idempotent.
+
+- (void)onMFMProgress:(int)progress address:(NSString *)address
+{
+    dispatch_async(dispatch_get_main_queue(), ^{
+        if (!self.running || address == nil || self.progresses[address] == nil)
+        {
+            return;
+        }
+        self.progresses[address] = @(MAX(progress, self.progresses[address].intValue));
+        float total = 0;
+        for (NSNumber *value in self.progresses.allValues)
+        {
+            total += value.floatValue;
+        }
+        if (self.progressBlock)
+        {
+            self.progressBlock(total / (100.0f * self.progresses.count));
+        }
+    });
+}
+
+- (void)onMFMCompleted:(XSDotMFMResultTpye)type address:(NSString *)address
+{
+    dispatch_async(dispatch_get_main_queue(), ^{
+        if (!self.running || address == nil || self.progresses[address] == nil || self.results[address] != nil)
+        {
+            return;
+        }
+        NSLog(@"MFM of %@ finished with result %lu", address, (unsigned long)type);
+        self.results[address] = @(type);
+        self.progresses[address] = @100;
+        if (type == XSDotMFMResultAcceptable || type == XSDotMFMResultGood)
+        {
+            [self cacheResult:type forAddress:address];
+        }
+        if (self.results.count == self.devices.count)
+        {
+            [self finish];
+        }
+    });
+}
+
+@end
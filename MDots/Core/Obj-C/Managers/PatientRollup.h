@@ -0,0 +1,70 @@
+//
+//  PatientRollup.h
+//  MDots
+//
+//  Created by Estela Alvarez on 18/10/26.
+//
+
+#import <Foundation/Foundation.h>
+#import <FirebaseFirestore/FirebaseFirestore.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/// Called once a test and its rollup were written, or failed to.
+typedef void (^PatientRollupCompletion)(NSError * _Nullable error);
+
+/// @class PatientRollup
+/// @discussion Keeps one summary document per patient (`patients/{id}/rollups/summary`) whose `series` map holds, per test type and side, the result count, last value, min/max, an EWMA, the least squares trend and the monthly means.
+/// Its `asymmetry` map holds, per test and rotation, the limb symmetry index of the left and right results measured the same day, with the same statistics.
+/// Every new test updates its series incrementally in the same Firestore transaction that adds the test, so the patient screen reads one document whatever the length of the history.
+@interface PatientRollup : NSObject
+
+/// The weight of the newest result in the EWMA. Defaults to 0.3.
+@property (assign, nonatomic) double smoothing;
+
+/// The number of monthly buckets kept per series, oldest dropped first. Defaults to 36.
+@property (assign, nonatomic) NSUInteger monthLimit;
+
+/// The shared rollup writer.
+/// ```objc
+/// [[PatientRollup sharedRollup] addTestData:testData testType:@"Lunge" patient:patientRef completion:nil];
+/// ```
++ (instancetype)sharedRollup;
+
+/// The key of a series in the `series` map, e.g. "Lunge:L".
+/// @param testType The test type.
+/// @param side The side stored with the tests, e.g. "Le".
++ (NSString *)seriesKeyForTestType:(NSString *)testType side:(NSString *)side;
+
+/// The summary document of a patient.
+/// @param patientRef The patient document.
++ (FIRDocumentReference *)summaryDocumentOfPatient:(FIRDocumentReference *)patientRef;
+
+/// Folds a result into a series.
+/// @param value The result.
+/// @param date The date of the test.
+/// @param series The series so far, nil for the first result.
+/// @return The updated series.
+- (NSDictionary<NSString *, id> *)seriesByAddingValue:(double)value date:(NSDate *)date toSeries:(nullable NSDictionary<NSString *, id> *)series;
+
+/// Adds a test to its test type collection and folds it into its series, atomically.
+/// If the transaction cannot run, e.g. offline, the test is added alone and the series is rebuilt later by `replaceSeriesOfTestType:sides:values:dates:patient:completion:`.
+/// @param testData The test document; needs `value`, `side` and `testDate`.
+/// @param testType The test type collection.
+/// @param patientRef The patient document.
+/// @param completion Called on the main queue.
+- (void)addTestData:(NSDictionary<NSString *, id> *)testData testType:(NSString *)testType patient:(FIRDocumentReference *)patientRef completion:(nullable PatientRollupCompletion)completion;
+
+/// Rebuilds the series and the asymmetry of a test type from its whole history, e.g. after a test was deleted.
+/// The history is replayed in date order, so the result matches what the incremental updates would have built.
+/// @param testType The test type.
+/// @param sides The side of every result.
+/// @param values The results, none removes the series of the test type.
+/// @param dates The test dates.
+/// @param patientRef The patient document.
+/// @param completion Called on the main queue.
+- (void)replaceSeriesOfTestType:(NSString *)testType sides:(NSArray<NSString *> *)sides values:(NSArray<NSNumber *> *)values dates:(NSArray<NSDate *> *)dates patient:(FIRDocumentReference *)patientRef completion:(nullable PatientRollupCompletion)completion;
+
+@end
+
+NS_ASSUME_NONNULL_END
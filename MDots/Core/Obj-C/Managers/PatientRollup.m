@@ -0,0 +1,301 @@
+//
+//  PatientRollup.m
+//  MDots
+//
+//  Created by Estela Alvarez on 18/10/26.
+//
+
+#import "PatientRollup.h"
+#import "AsymmetryIndex.h"
+
+/// Seconds per day, the unit of the trend slope
+static const double kSecondsPerDay = 86400.0;
+
+@interface PatientRollup ()
+
+/// Formats the monthly bucket keys, e.g. "2026-10"
+@property (strong, nonatomic) NSDateFormatter *monthFormatter;
+
+@end
+
+@implementation PatientRollup
+
++ (instancetype)sharedRollup
+{
+    static PatientRollup *rollup = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        rollup = [PatientRollup new];
+    });
+    return rollup;
+}
+
+- (instancetype)init
+{
+    if (self = [super init])
+    {
+        _smoothing = 0.3;
+        _monthLimit = 36;
+        _monthFormatter = [NSDateFormatter new];
+        _monthFormatter.locale = [NSLocale localeWithLocaleIdentifier:@"en_US_POSIX"];
+        _monthFormatter.timeZone = [NSTimeZone timeZoneForSecondsFromGMT:0];
+        _monthFormatter.dateFormat = @"yyyy-MM";
+    }
+    return self;
+}
+
++ (NSString *)seriesKeyForTestType:(NSString *)testType side:(NSString *)side
+{
+    return [NSString stringWithFormat:@"%@:%@", testType, side];
+}
+
++ (FIRDocumentReference *)summaryDocumentOfPatient:(FIRDocumentReference *)patientRef
+{
+    return [[patientRef collectionWithPath:@"rollups"] documentWithPath:@"summary"];
+}
+
+/// Reads a date field, stored as a FIRTimestamp once written.
+/// @param value The field value.
+/// @return The date, or nil.
++ (nullable NSDate *)dateOfField:(nullable id)value
+{
+    if ([value isKindOfClass:[FIRTimestamp class]])
+    {
+        return [(FIRTimestamp *)value dateValue];
+    }
+    return [value isKindOfClass:[NSDate class]] ? value : nil;
+}
+
+/// A map field of a summary document.
+/// @param field The field name, "series" or "asymmetry".
+/// @param summary The summary snapshot, which may not exist yet.
+/// @return A mutable copy of the map.
++ (NSMutableDictionary<NSString *, NSDictionary *> *)map:(NSString *)field ofSummary:(FIRDocumentSnapshot *)summary
+{
+    NSDictionary *map = summary.exists ? summary.data[field] : nil;
+    return [map isKindOfClass:[NSDictionary class]] ? [map mutableCopy] : [NSMutableDictionary dictionary];
+}
+
+/// Writes the whole summary document, so trimmed monthly buckets and removed series do not survive a merge.
+/// @param series The series map.
+/// @param asymmetry The asymmetry map.
+/// @param summaryRef The summary document.
+/// @param transaction The transaction that read the summary.
++ (void)writeSeries:(NSDictionary<NSString *, NSDictionary *> *)series asymmetry:(NSDictionary<NSString *, NSDictionary *> *)asymmetry toSummary:(FIRDocumentReference *)summaryRef transaction:(FIRTransaction *)transaction
+{
+    [transaction setData:@{ @"series": series, @"asymmetry": asymmetry, @"updated": [FIRFieldValue fieldValueForServerTimestamp] } forDocument:summaryRef];
+}
+
+/// Folds a result into its series and, when the other side was measured the same day, into the asymmetry of its test.
+/// @param value The result.
+/// @param side The side of the result.
+/// @param date The date of the test.
+/// @param testType The test type.
+/// @param series The series map, updated in place.
+/// @param asymmetry The asymmetry map, updated in place.
+- (void)addValue:(double)value side:(NSString *)side date:(NSDate *)date testType:(NSString *)testType toSeries:(NSMutableDictionary *)series asymmetry:(NSMutableDictionary *)asymmetry
+{
+    NSString *key = [PatientRollup seriesKeyForTestType:testType side:side];
+    NSString *counterpart = [AsymmetryIndex counterpartOfSide:side];
+    NSDictionary *other = counterpart ? series[[PatientRollup seriesKeyForTestType:testType side:counterpart]] : nil;
+    series[key] = [self seriesByAddingValue:value date:date toSeries:series[key]];
+    AsymmetryPair pair;
+    if (other && [AsymmetryIndex getPair:&pair value:value side:side date:date lastValue:[other[@"last"] doubleValue] lastDate:[PatientRollup dateOfField:other[@"lastDate"]]])
+    {
+        NSString *pairKey = [AsymmetryIndex pairKeyForTestType:testType side:side];
+        asymmetry[pairKey] = [self asymmetry:asymmetry[pairKey] byAddingPair:pair date:date];
+    }
+}
+
+/// Folds a pair into the symmetry series of a test.
+/// A day holds one pair: a retest the same day replaces the pair of that day, folded again onto the series as it was before it.
+/// @param entry The asymmetry entry so far, nil for the first pair.
+/// @param pair The new pair.
+/// @param date The date of the newer result of the pair.
+/// @return The updated entry.
+- (NSDictionary<NSString *, id> *)asymmetry:(nullable NSDictionary<NSString *, id> *)entry byAddingPair:(AsymmetryPair)pair date:(NSDate *)date
+{
+    static NSArray<NSString *> *pairFields = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        pairFields = @[@"base", @"pairDay", @"left", @"right", @"bias"];
+    });
+    NSDate *pairDay = [PatientRollup dateOfField:entry[@"pairDay"]];
+    NSDictionary *base = entry;
+    if (pairDay && [[NSCalendar currentCalendar] isDate:date inSameDayAsDate:pairDay])
+    {
+        base = [entry[@"base"] isKindOfClass:[NSDictionary class]] ? entry[@"base"] : nil;
+    }
+    NSMutableDictionary *series = [base mutableCopy];
+    [series removeObjectsForKeys:pairFields];
+    NSMutableDictionary *updated = [[self seriesByAddingValue:pair.symmetry date:date toSeries:series] mutableCopy];
+    if (series)
+    {
+        updated[@"base"] = series;
+    }
+    updated[@"pairDay"] = date;
+    updated[@"left"] = @(pair.left);
+    updated[@"right"] = @(pair.right);
+    updated[@"bias"] = @(pair.bias);
+    return updated;
+}
+
+- (NSDictionary<NSString *, id> *)seriesByAddingValue:(double)value date:(NSDate *)date toSeries:(nullable NSDictionary<NSString *, id> *)series
+{
+    NSInteger count = [series[@"count"] integerValue];
+    NSDate *origin = [PatientRollup dateOfField:series[@"origin"]];
+    NSDate *lastDate = [PatientRollup dateOfField:series[@"lastDate"]];
+    if (count == 0 || origin == nil)
+    {
+        series = nil;
+        count = 0;
+        origin = date;
+    }
+    NSMutableDictionary *updated = series ? [series mutableCopy] : [NSMutableDictionary dictionary];
+    
+    // The trend is the least squares line through (days since the first test, value), kept as running sums
+    double x = [date timeIntervalSinceDate:origin] / kSecondsPerDay;
+    double sumX = [series[@"sumX"] doubleValue] + x;
+    double sumY = [series[@"sumY"] doubleValue] + value;
+    double sumXX = [series[@"sumXX"] doubleValue] + x * x;
+    double sumXY = [series[@"sumXY"] doubleValue] + x * value;
+    count++;
+    double denominator = count * sumXX - sumX * sumX;
+    double slope = denominator > 1e-9 ? (count * sumXY - sumX * sumY) / denominator : 0;
+    
+    updated[@"count"] = @(count);
+    updated[@"origin"] = origin;
+    updated[@"sumX"] = @(sumX);
+    updated[@"sumY"] = @(sumY);
+    updated[@"sumXX"] = @(sumXX);
+    updated[@"sumXY"] = @(sumXY);
+    updated[@"mean"] = @(sumY / count);
+    updated[@"slopePerDay"] = @(slope);
+    updated[@"min"] = @(series ? MIN([series[@"min"] doubleValue], value) : value);
+    updated[@"max"] = @(series ? MAX([series[@"max"] doubleValue], value) : value);
+    // The EWMA follows arrival order, which is date order except for rebuilt or late offline results
+    updated[@"ewma"] = @(series ? self.smoothing * value + (1 - self.smoothing) * [series[@"ewma"] doubleValue] : value);
+    if (lastDate == nil || series == nil || [date compare:lastDate] != NSOrderedAscending)
+    {
+        updated[@"last"] = @(value);
+        updated[@"lastDate"] = date;
+    }
+    
+    NSMutableDictionary *months = [series[@"months"] mutableCopy] ?: [NSMutableDictionary dictionary];
+    NSString *month = [self.monthFormatter stringFromDate:date];
+    NSDictionary *bucket = months[month];
+    NSInteger bucketCount = [bucket[@"count"] integerValue] + 1;
+    double bucketSum = [bucket[@"sum"] doubleValue] + value;
+    months[month] = @{ @"count": @(bucketCount), @"sum": @(bucketSum), @"mean": @(bucketSum / bucketCount) };
+    if (months.count > self.monthLimit)
+    {
+        // "yyyy-MM" keys sort by date
+        NSArray *keys = [months.allKeys sortedArrayUsingSelector:@selector(compare:)];
+        [months removeObjectsForKeys:[keys subarrayWithRange:NSMakeRange(0, months.count - self.monthLimit)]];
+    }
+    updated[@"months"] = months;
+    return updated;
+}
+
+- (void)addTestData:(NSDictionary<NSString *, id> *)testData testType:(NSString *)testType patient:(FIRDocumentReference *)patientRef completion:(nullable PatientRollupCompletion)completion
+{
+    FIRDocumentReference *testRef = [[patientRef collectionWithPath:testType] documentWithAutoID];
+    FIRDocumentReference *summaryRef = [PatientRollup summaryDocumentOfPatient:patientRef];
+    NSString *side = testData[@"side"];
+    double value = [testData[@"value"] doubleValue];
+    NSDate *date = [PatientRollup dateOfField:testData[@"testDate"]] ?: [NSDate date];
+    
+    __weak __typeof(self) wself = self;
+    [patientRef.firestore runTransactionWithBlock:^id _Nullable(FIRTransaction *transaction, NSError **errorPointer) {
+        FIRDocumentSnapshot *summary = [transaction getDocument:summaryRef error:errorPointer];
+        if (summary == nil)
+        {
+            return nil;
+        }
+        NSMutableDictionary *series = [PatientRollup map:@"series" ofSummary:summary];
+        NSMutableDictionary *asymmetry = [PatientRollup map:@"asymmetry" ofSummary:summary];
+        [wself addValue:value side:side date:date testType:testType toSeries:series asymmetry:asymmetry];
+        [transaction setData:testData forDocument:testRef];
+        [PatientRollup writeSeries:series asymmetry:asymmetry toSummary:summaryRef transaction:transaction];
+        return nil;
+    } completion:^(id _Nullable result, NSError * _Nullable error) {
+        if (error == nil)
+        {
+            if (completion)
+            {
+                completion(nil);
+            }
+            return;
+        }
+        // Transactions need the server; the test must not be lost for the sake of its rollup
+        NSLog(@"Rollup transaction failed, adding the test alone: %@", error.localizedDescription);
+        [testRef setData:testData completion:^(NSError * _Nullable error) {
+            if (completion)
+            {
+                completion(error);
+            }
+        }];
+    }];
+}
+
+/// Whether a key of the series or asymmetry map belongs to a test type.
+/// @param key The map key, e.g. "Lunge:L" or "Lunge".
+/// @param testType The test type.
++ (BOOL)key:(NSString *)key belongsToTestType:(NSString *)testType
+{
+    return [key isEqualToString:testType] || [key hasPrefix:[testType stringByAppendingString:@":"]];
+}
+
+- (void)replaceSeriesOfTestType:(NSString *)testType sides:(NSArray<NSString *> *)sides values:(NSArray<NSNumber *> *)values dates:(NSArray<NSDate *> *)dates patient:(FIRDocumentReference *)patientRef completion:(nullable PatientRollupCompletion)completion
+{
+    NSUInteger count = MIN(sides.count, MIN(values.count, dates.count));
+    NSMutableArray<NSNumber *> *order = [NSMutableArray arrayWithCapacity:count];
+    for (NSUInteger i = 0; i < count; i++)
+    {
+        [order addObject:@(i)];
+    }
+    [order sortUsingComparator:^NSComparisonResult(NSNumber *a, NSNumber *b) {
+        return [dates[a.unsignedIntegerValue] compare:dates[b.unsignedIntegerValue]];
+    }];
+    // Replay the history of the test type on empty maps, outside of the transaction
+    NSMutableDictionary *rebuiltSeries = [NSMutableDictionary dictionary];
+    NSMutableDictionary *rebuiltAsymmetry = [NSMutableDictionary dictionary];
+    for (NSNumber *index in order)
+    {
+        NSUInteger i = index.unsignedIntegerValue;
+        [self addValue:values[i].doubleValue side:sides[i] date:dates[i] testType:testType toSeries:rebuiltSeries asymmetry:rebuiltAsymmetry];
+    }
+    
+    FIRDocumentReference *summaryRef = [PatientRollup summaryDocumentOfPatient:patientRef];
+    [patientRef.firestore runTransactionWithBlock:^id _Nullable(FIRTransaction *transaction, NSError **errorPointer) {
+        FIRDocumentSnapshot *summary = [transaction getDocument:summaryRef error:errorPointer];
+        if (summary == nil)
+        {
+            return nil;
+        }
+        NSMutableDictionary *series = [PatientRollup map:@"series" ofSummary:summary];
+        NSMutableDictionary *asymmetry = [PatientRollup map:@"asymmetry" ofSummary:summary];
+        for (NSMutableDictionary *map in @[series, asymmetry])
+        {
+            NSSet *stale = [map keysOfEntriesPassingTest:^BOOL(NSString *key, id obj, BOOL *stop) {
+                return [PatientRollup key:key belongsToTestType:testType];
+            }];
+            [map removeObjectsForKeys:stale.allObjects];
+        }
+        [series addEntriesFromDictionary:rebuiltSeries];
+        [asymmetry addEntriesFromDictionary:rebuiltAsymmetry];
+        [PatientRollup writeSeries:series asymmetry:asymmetry toSummary:summaryRef transaction:transaction];
+        return nil;
+    } completion:^(id _Nullable result, NSError * _Nullable error) {
+        if (error)
+        {
+            NSLog(@"Rollup rebuild failed: %@", error.localizedDescription);
+        }
+        if (completion)
+        {
+            completion(error);
+        }
+    }];
+}
+
+@end
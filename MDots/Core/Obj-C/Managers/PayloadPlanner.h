@@ -0,0 +1,90 @@
+//
+//  PayloadPlanner.h
+//  MDots
+//
+//  Created by Estela Alvarez on 18/10/26.
+//
+
+#import <Foundation/Foundation.h>
+#import <MovellaDotSdk/DotDevice.h>
+#import <MovellaDotSdk/DotDefine.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/// The data channels a test needs from every sensor.
+typedef NS_OPTIONS(NSUInteger, PayloadChannels)
+{
+    PayloadChannelEuler             = 1 << 0,
+    PayloadChannelQuaternion        = 1 << 1,
+    PayloadChannelFreeAcceleration  = 1 << 2,
+    PayloadChannelAcceleration      = 1 << 3,
+    PayloadChannelAngularVelocity   = 1 << 4,
+    PayloadChannelMagneticField     = 1 << 5,
+    /// Orientation and velocity increments, integrated on the sensor at its internal rate
+    PayloadChannelDeltaQuantities   = 1 << 6,
+};
+
+/// @class PayloadPlan
+/// @discussion The streaming configuration chosen for a test.
+@interface PayloadPlan : NSObject
+
+/// The payload mode to stream
+@property (assign, nonatomic) XSBleDevicePayloadMode payloadMode;
+/// The output rate in Hz
+@property (assign, nonatomic) int outputRate;
+/// The filter profile index (0 General, 1 Dynamic)
+@property (assign, nonatomic) int filterIndex;
+/// The payload size of one sample in bytes
+@property (assign, nonatomic) NSUInteger payloadSize;
+/// The BLE load of all sensors together in bytes per second
+@property (assign, nonatomic) NSUInteger totalBytesPerSecond;
+
+/// Applies the plan to a device before streaming starts.
+/// @param device The device to configure.
+- (void)applyToDevice:(DotDevice *)device;
+
+@end
+
+/// @class PayloadPlanner
+/// @discussion Picks the smallest payload mode and the lowest output rate that still meet the channel and bandwidth needs of a test, given how many sensors share the BLE link.
+@interface PayloadPlanner : NSObject
+
+/// The BLE budget shared by all streaming sensors, in payload bytes per second.
+@property (assign, nonatomic) NSUInteger bleBudgetBytesPerSecond;
+
+/// The shared planner.
++ (instancetype)sharedPlanner;
+
+/// Plans the streaming configuration of a test.
+/// @param testType The type of test (e.g., lunge, hip rotation).
+/// @param sensorCount The number of sensors streaming at once.
+/// @return The plan.
+/// ```objc
+/// PayloadPlan *plan = [[PayloadPlanner sharedPlanner] planForTestType:@"Lunge" sensorCount:1];
+/// ```
+- (PayloadPlan *)planForTestType:(NSString *)testType sensorCount:(NSUInteger)sensorCount;
+
+/// Plans the streaming configuration of a test whose orientation is fused on the phone by a `FusionEngine`.
+/// Streams the delta quantities instead of the sensor's orientation: they are integrated on the sensor,
+/// so the fused orientation keeps its accuracy at the lower rates the BLE budget allows.
+/// @param testType The type of test.
+/// @param sensorCount The number of sensors streaming at once.
+/// @param fusion Whether the phone fuses the orientation.
+/// @return The plan.
+- (PayloadPlan *)planForTestType:(NSString *)testType sensorCount:(NSUInteger)sensorCount fusion:(BOOL)fusion;
+
+/// Plans a streaming configuration from explicit requirements.
+/// @param channels The channels needed.
+/// @param minRate The lowest acceptable output rate in Hz.
+/// @param preferredRate The output rate to use when the BLE budget allows it.
+/// @param filterIndex The filter profile index.
+/// @param sensorCount The number of sensors streaming at once.
+- (PayloadPlan *)planForChannels:(PayloadChannels)channels minRate:(int)minRate preferredRate:(int)preferredRate filterIndex:(int)filterIndex sensorCount:(NSUInteger)sensorCount;
+
+/// The payload size in bytes of a payload mode, or 0 if unknown.
+/// @param payloadMode The payload mode.
++ (NSUInteger)payloadSizeOfMode:(XSBleDevicePayloadMode)payloadMode;
+
+@end
+
+NS_ASSUME_NONNULL_END
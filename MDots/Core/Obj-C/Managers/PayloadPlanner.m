@@ -0,0 +1,171 @@
+//
+//  PayloadPlanner.m
+//  MDots
+//
+//  Created by Estela Alvarez on 18/10/26.
+//
+
+#import "PayloadPlanner.h"
+
+/// Output rates supported while streaming, in ascending order
+static const int kStreamingRates[] = { 1, 4, 10, 12, 15, 20, 30, 60 };
+
+/// A payload mode with its size and channels
+typedef struct
+{
+    XSBleDevicePayloadMode mode;
+    NSUInteger size;
+    PayloadChannels channels;
+} PayloadModeInfo;
+
+/// Real-time payload modes in ascending size (Movella DOT user manual, measurement payloads)
+static const PayloadModeInfo kPayloadModes[] = {
+    { XSBleDevicePayloadOrientationEuler,           16, PayloadChannelEuler },
+    { XSBleDevicePayloadFreeAcceleration,           16, PayloadChannelFreeAcceleration },
+    { XSBleDevicePayloadOrientationQuaternion,      20, PayloadChannelQuaternion },
+    { XSBleDevicePayloadCompleteEuler,              28, PayloadChannelEuler | PayloadChannelFreeAcceleration },
+    { XSBleDevicePayloadRateQuantitiesNoMag,        28, PayloadChannelAcceleration | PayloadChannelAngularVelocity },
+    { XSBleDevicePayloadHighFidelityNoMag,          29, PayloadChannelAcceleration | PayloadChannelAngularVelocity },
+    { XSBleDevicePayloadCompleteQuaternion,         32, PayloadChannelQuaternion | PayloadChannelFreeAcceleration },
+    { XSBleDevicePayloadCustomMode3,                32, PayloadChannelQuaternion | PayloadChannelAngularVelocity },
+    { XSBleDevicePayloadDeltaQuantitiesNoMag,       32, PayloadChannelDeltaQuantities },
+    { XSBleDevicePayloadCustomMode2,                34, PayloadChannelEuler | PayloadChannelFreeAcceleration | PayloadChannelMagneticField },
+    { XSBleDevicePayloadRateQuantitiesWithMag,      34, PayloadChannelAcceleration | PayloadChannelAngularVelocity | PayloadChannelMagneticField },
+    { XSBleDevicePayloadExtendedEuler,              36, PayloadChannelEuler | PayloadChannelFreeAcceleration },
+    { XSBleDevicePayloadExtendedQuaternion,         36, PayloadChannelQuaternion | PayloadChannelFreeAcceleration },
+    { XSBleDevicePayloadDeltaQuantitiesWithMag,     38, PayloadChannelDeltaQuantities | PayloadChannelMagneticField },
+    { XSBleDevicePayloadCustomMode1,                40, PayloadChannelEuler | PayloadChannelFreeAcceleration | PayloadChannelAngularVelocity },
+    { XSBleDevicePayloadCustomMode5,                44, PayloadChannelQuaternion | PayloadChannelAcceleration | PayloadChannelAngularVelocity },
+    { XSBleDevicePayloadCustomMode4,                51, PayloadChannelQuaternion | PayloadChannelAcceleration | PayloadChannelAngularVelocity | PayloadChannelMagneticField },
+};
+
+@implementation PayloadPlan
+
+- (void)applyToDevice:(DotDevice *)device
+{
+    int filterIndex = 0;
+    for (DotFilterProfile *profile in device.filterProfilesList)
+    {
+        if (profile.filterIndex == self.filterIndex)
+        {
+            filterIndex = self.filterIndex;
+        }
+    }
+    device.plotMeasureMode = self.payloadMode;
+    [device setOutputRate:self.outputRate filterIndex:filterIndex];
+}
+
+- (NSString *)description
+{
+    return [NSString stringWithFormat:@"<PayloadPlan mode=%ld rate=%dHz filter=%d size=%luB load=%luB/s>", (long)self.payloadMode, self.outputRate, self.filterIndex, (unsigned long)self.payloadSize, (unsigned long)self.totalBytesPerSecond];
+}
+
+@end
+
+@implementation PayloadPlanner
+
++ (instancetype)sharedPlanner
+{
+    static PayloadPlanner *planner = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        planner = [PayloadPlanner new];
+    });
+    return planner;
+}
+
+- (instancetype)init
+{
+    if (self = [super init])
+    {
+        // Five sensors streaming a 40 byte payload at 60 Hz
+        _bleBudgetBytesPerSecond = 5 * 60 * 40;
+    }
+    return self;
+}
+
++ (NSUInteger)payloadSizeOfMode:(XSBleDevicePayloadMode)payloadMode
+{
+    for (size_t i = 0; i < sizeof(kPayloadModes) / sizeof(kPayloadModes[0]); i++)
+    {
+        if (kPayloadModes[i].mode == payloadMode)
+        {
+            return kPayloadModes[i].size;
+        }
+    }
+    return 0;
+}
+
+- (PayloadPlan *)planForTestType:(NSString *)testType sensorCount:(NSUInteger)sensorCount
+{
+    return [self planForTestType:testType sensorCount:sensorCount fusion:NO];
+}
+
+- (PayloadPlan *)planForTestType:(NSString *)testType sensorCount:(NSUInteger)sensorCount fusion:(BOOL)fusion
+{
+    // The tests only read euler angles of quasi-static end positions,
+    // so the general filter profile and a moderate rate are enough.
+    PayloadChannels channels = PayloadChannelEuler | PayloadChannelFreeAcceleration;
+    int minRate = 30, preferredRate = 60;
+    if ([testType isEqualToString:@"Lunge"])
+    {
+        // Repetitions are tracked from the live signal
+        channels = PayloadChannelEuler;
+        minRate = 20;
+        preferredRate = 30;
+    }
+    else if ([testType isEqualToString:@"Sit and Reach"] || [testType isEqualToString:@"Hip Rotation"])
+    {
+        channels = PayloadChannelEuler;
+        minRate = 15;
+        preferredRate = 30;
+    }
+    if (fusion)
+    {
+        // The phone computes the euler angles from the increments
+        channels = PayloadChannelDeltaQuantities;
+    }
+    return [self planForChannels:channels minRate:minRate preferredRate:preferredRate filterIndex:0 sensorCount:sensorCount];
+}
+
+- (PayloadPlan *)planForChannels:(PayloadChannels)channels minRate:(int)minRate preferredRate:(int)preferredRate filterIndex:(int)filterIndex sensorCount:(NSUInteger)sensorCount
+{
+    PayloadPlan *plan = [PayloadPlan new];
+    plan.payloadMode = XSBleDevicePayloadCompleteEuler;
+    plan.payloadSize = [PayloadPlanner payloadSizeOfMode:XSBleDevicePayloadCompleteEuler];
+    plan.filterIndex = filterIndex;
+    
+    // Smallest payload that carries every requested channel
+    for (size_t i = 0; i < sizeof(kPayloadModes) / sizeof(kPayloadModes[0]); i++)
+    {
+        if ((kPayloadModes[i].channels & channels) == channels)
+        {
+            plan.payloadMode = kPayloadModes[i].mode;
+            plan.payloadSize = kPayloadModes[i].size;
+            break;
+        }
+    }
+    
+    // Highest supported rate not above the preferred one that fits the BLE budget, never below the minimum
+    NSUInteger sensors = MAX(sensorCount, 1);
+    int count = sizeof(kStreamingRates) / sizeof(kStreamingRates[0]);
+    int rate = kStreamingRates[count - 1];
+    for (int i = count - 1; i >= 0; i--)
+    {
+        rate = kStreamingRates[i];
+        BOOL fits = sensors * plan.payloadSize * rate <= self.bleBudgetBytesPerSecond;
+        if ((rate <= preferredRate && fits) || (i > 0 && kStreamingRates[i - 1] < minRate))
+        {
+            break;
+        }
+    }
+    plan.outputRate = rate;
+    plan.totalBytesPerSecond = sensors * plan.payloadSize * rate;
+    if (plan.totalBytesPerSecond > self.bleBudgetBytesPerSecond)
+    {
+        NSLog(@"Payload plan over BLE budget: %@", plan);
+    }
+    return plan;
+}
+
+@end
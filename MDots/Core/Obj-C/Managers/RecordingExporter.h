@@ -0,0 +1,57 @@
+//
+//  RecordingExporter.h
+//  MDots
+//
+//  Created by Estela Alvarez on 18/10/26.
+//
+
+#import <Foundation/Foundation.h>
+#import <MovellaDotSdk/DotDevice.h>
+#import "SessionStore.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+/// Called on the main queue with the aggregated export progress of all devices, from 0 to 1.
+typedef void (^RecordingExportProgressBlock)(float progress);
+/// Called on the main queue once every device has finished (or failed) exporting.
+typedef void (^RecordingExportCompletionBlock)(BOOL success);
+
+/// @class RecordingExporter
+/// @discussion Records a trial on the sensors' flash instead of streaming it over BLE, then exports all devices concurrently into a `SessionStore`. An export interrupted by a disconnection resumes when the device is initialized again, a device that exports nothing for `stallTimeout` fails, and the flash is erased once everything is exported.
+@interface RecordingExporter : NSObject
+
+/// The store the exported samples are written to.
+@property (strong, nonatomic, readonly) SessionStore *store;
+
+/// How long a device may take to report its flash ready before it counts as not started. Defaults to 10 seconds.
+@property (assign, nonatomic) NSTimeInterval startTimeout;
+
+/// How long a device may go without exporting a sample, e.g. while disconnected, before its export fails. Defaults to 60 seconds.
+@property (assign, nonatomic) NSTimeInterval stallTimeout;
+
+/// Creates an exporter for the given devices.
+/// @param devices The devices to record on.
+/// @param store The store that receives the exported samples.
+/// ```objc
+/// RecordingExporter *exporter = [[RecordingExporter alloc] initWithDevices:self.measureDevices store:store];
+/// ```
+- (instancetype)initWithDevices:(NSArray<DotDevice *> *)devices store:(SessionStore *)store;
+
+/// Starts recording on every device once its flash is ready.
+/// @param completion Called on the main queue with YES if every device started recording within `startTimeout`.
+- (void)startRecordingWithCompletion:(void (^)(BOOL success))completion;
+
+/// Stops recording on every device.
+- (void)stopRecording;
+
+/// Exports the last recording file of every device in parallel, then erases the flash.
+/// @param progress The aggregated progress block.
+/// @param completion The completion block.
+- (void)exportWithProgress:(nullable RecordingExportProgressBlock)progress completion:(RecordingExportCompletionBlock)completion;
+
+/// Stops any running export without erasing the flash. The completion block is called with NO.
+- (void)cancel;
+
+@end
+
+NS_ASSUME_NONNULL_END
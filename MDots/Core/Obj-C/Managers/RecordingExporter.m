@@ -0,0 +1,416 @@
+//
+//  RecordingExporter.m
+//  MDots
+//
+//  Created by Estela Alvarez on 18/10/26.
+//
+
+#import "RecordingExporter.h"
+#import <MovellaDotSdk/DotDefine.h>
+#import <MovellaDotSdk/DotUtils.h>
+
+/// Record until stopped (or until the flash is full)
+static const UInt16 kRecordingTimeUnlimited = 0xFFFF;
+/// Interval between two checks for stalled exports
+static const NSTimeInterval kWatchdogInterval = 5;
+
+/// The export state of one device
+@interface RecordingExportState : NSObject
+
+@property (assign, nonatomic) NSUInteger fileIndex;
+@property (assign, nonatomic) NSUInteger expectedSamples;
+@property (assign, nonatomic) UInt32 lastTimeStamp;
+@property (assign, nonatomic) BOOL hasSample;
+/// When the device last exported a sample or resumed
+@property (assign, nonatomic) CFAbsoluteTime lastActivity;
+@property (assign, nonatomic) BOOL interrupted;
+@property (assign, nonatomic) BOOL finished;
+@property (assign, nonatomic) BOOL success;
+
+@end
+
+@implementation RecordingExportState
+@end
+
+@interface RecordingExporter ()
+
+@property (strong, nonatomic) NSArray<DotDevice *> *devices;
+@property (strong, nonatomic) SessionStore *store;
+/// Export state per mac address
+@property (strong, nonatomic) NSMutableDictionary<NSString *, RecordingExportState *> *states;
+@property (copy, nonatomic, nullable) RecordingExportProgressBlock progressBlock;
+@property (copy, nonatomic, nullable) RecordingExportCompletionBlock completionBlock;
+@property (assign, nonatomic) BOOL exporting;
+/// Increased on every export, so a stale watchdog stops
+@property (assign, nonatomic) NSUInteger generation;
+
+@end
+
+@implementation RecordingExporter
+
+- (instancetype)initWithDevices:(NSArray<DotDevice *> *)devices store:(SessionStore *)store
+{
+    if (self = [super init])
+    {
+        _devices = devices;
+        _store = store;
+        _states = [NSMutableDictionary dictionaryWithCapacity:devices.count];
+        _startTimeout = 10;
+        _stallTimeout = 60;
+    }
+    return self;
+}
+
+- (void)dealloc
+{
+    [[NSNotificationCenter defaultCenter] removeObserver:self];
+}
+
+/// The recording data exported for each sample: enough for the euler based tests and the free acceleration / angular velocity metrics.
+- (NSData *)exportDataFormat
+{
+    UInt8 bytes[5] = { XSRecordingDataTimestamp, XSRecordingDataQuaternion, XSRecordingDataEulerAngles, XSRecordingDataAcceleration, XSRecordingDataAngularVelocity };
+    return [NSData dataWithBytes:bytes length:sizeof(bytes)];
+}
+
+/// The size in bytes of one exported sample.
+- (NSUInteger)bytesPerSample
+{
+    NSData *format = [self exportDataFormat];
+    const UInt8 *bytes = format.bytes;
+    NSUInteger size = 0;
+    for (NSUInteger i = 0; i < format.length; i++)
+    {
+        size += [DotUtils bytesFromRecordingData:bytes[i]];
+    }
+    return MAX(size, 1);
+}
+
+#pragma mark - Recording
+
+- (void)startRecordingWithCompletion:(void (^)(BOOL success))completion
+{
+    /// Devices that have not answered yet, only touched on the main queue
+    NSMutableSet<NSString *> *waiting = [NSMutableSet setWithArray:[self.devices valueForKey:@"macAddress"]];
+    __block BOOL allStarted = YES;
+    void (^deviceDone)(NSString *, BOOL) = ^(NSString *address, BOOL started) {
+        dispatch_async(dispatch_get_main_queue(), ^{
+            if (![waiting containsObject:address])
+            {
+                return;
+            }
+            [waiting removeObject:address];
+            allStarted &= started;
+            if (waiting.count == 0)
+            {
+                completion(allStarted);
+            }
+        });
+    };
+    
+    for (DotDevice *device in self.devices)
+    {
+        __weak DotDevice *wdevice = device;
+        NSString *address = device.macAddress;
+        [device setFlashInfoDoneBlock:^(XSFlashInfoStatus status) {
+            if (status == XSFlashInfoIsReady)
+            {
+                deviceDone(address, [wdevice startRecording:kRecordingTimeUnlimited]);
+            }
+            else
+            {
+                NSLog(@"Flash of %@ not ready: %lu", address, (unsigned long)status);
+                deviceDone(address, NO);
+            }
+        }];
+        if (![device getFlashInfo])
+        {
+            deviceDone(address, NO);
+        }
+    }
+    
+    dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(self.startTimeout * NSEC_PER_SEC)), dispatch_get_main_queue(), ^{
+        for (NSString *address in [waiting copy])
+        {
+            NSLog(@"Flash of %@ did not answer", address);
+            deviceDone(address, NO);
+        }
+    });
+}
+
+- (void)stopRecording
+{
+    for (DotDevice *device in self.devices)
+    {
+        [device stopRecording];
+    }
+}
+
+#pragma mark - Export
+
+- (void)exportWithProgress:(RecordingExportProgressBlock)progress completion:(RecordingExportCompletionBlock)completion
+{
+    self.progressBlock = progress;
+    self.completionBlock = completion;
+    self.exporting = YES;
+    self.generation += 1;
+    [self.store reset];
+    [self.states removeAllObjects];
+    
+    NSNotificationCenter *center = [NSNotificationCenter defaultCenter];
+    [center addObserver:self selector:@selector(onDeviceDisconnected:) name:kDotNotificationDeviceDidDisconnect object:nil];
+    [center addObserver:self selector:@selector(onDeviceInitialized:) name:kDotNotificationDeviceInitialized object:nil];
+    
+    for (DotDevice *device in self.devices)
+    {
+        RecordingExportState *state = [RecordingExportState new];
+        state.lastActivity = CFAbsoluteTimeGetCurrent();
+        self.states[device.macAddress] = state;
+        [self exportDevice:device];
+    }
+    [self watchExportOfGeneration:self.generation];
+}
+
+/// Fails the devices that exported nothing for `stallTimeout`, then checks again until the export ends.
+/// @param generation The export being watched.
+- (void)watchExportOfGeneration:(NSUInteger)generation
+{
+    if (!self.exporting || self.generation != generation)
+    {
+        return;
+    }
+    CFAbsoluteTime now = CFAbsoluteTimeGetCurrent();
+    for (DotDevice *device in self.devices)
+    {
+        RecordingExportState *state = self.states[device.macAddress];
+        CFAbsoluteTime lastActivity;
+        @synchronized (state)
+        {
+            lastActivity = state.lastActivity;
+        }
+        if (!state.finished && now - lastActivity > self.stallTimeout)
+        {
+            NSLog(@"Export of %@ stalled", device.macAddress);
+            [device stopExportFileData];
+            [self finishDevice:device success:NO];
+        }
+    }
+    __weak __typeof(self) wself = self;
+    dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(kWatchdogInterval * NSEC_PER_SEC)), dispatch_get_main_queue(), ^{
+        [wself watchExportOfGeneration:generation];
+    });
+}
+
+/// Reads the file list of a device and starts exporting its last recording file.
+/// @param device The device to export.
+- (void)exportDevice:(DotDevice *)device
+{
+    __weak __typeof(self) wself = self;
+    __weak DotDevice *wdevice = device;
+    RecordingExportState *state = self.states[device.macAddress];
+    
+    [device setExportFileInfoDone:^(BOOL success) {
+        DotDevice *device = wdevice;
+        NSArray<DotRecordingFile *> *files = device.recording.files;
+        if (!success || files.count == 0)
+        {
+            [wself finishDevice:device success:NO];
+            return;
+        }
+        state.fileIndex = files.count - 1;
+        state.expectedSamples = files.lastObject.fileSize / [wself bytesPerSample];
+        
+        device.exportDataFormat = [wself exportDataFormat];
+        device.recording.exportFileList = @[@(state.fileIndex)];
+        device.recording.exportFileDone = ^(NSUInteger index, BOOL result) {
+            // YES once every file of the list is done, NO when one file is. A disconnection also ends the file,
+            // that export resumes once the device is back; failures are left to the disconnection and the watchdog
+            if (result)
+            {
+                [wself finishDevice:wdevice success:YES];
+                return;
+            }
+            @synchronized (state)
+            {
+                state.lastActivity = CFAbsoluteTimeGetCurrent();
+            }
+            [wself reportProgress];
+        };
+        [device setDidParseExportFileDataBlock:^(DotPlotData * _Nonnull plotData) {
+            [wself storeExportedData:plotData device:wdevice];
+        }];
+        if (![device startExportFileData])
+        {
+            [wself finishDevice:device success:NO];
+        }
+    }];
+    
+    if (![device getExportFileInfo])
+    {
+        [self finishDevice:device success:NO];
+    }
+}
+
+/// Stores one exported sample, skipping the samples already stored before a resume.
+/// @param plotData The exported sample.
+/// @param device The device it belongs to.
+- (void)storeExportedData:(DotPlotData *)plotData device:(DotDevice *)device
+{
+    RecordingExportState *state = self.states[device.macAddress];
+    @synchronized (state)
+    {
+        state.lastActivity = CFAbsoluteTimeGetCurrent();
+        // The sensor clock wraps every ~71.6 minutes, compare the difference like SessionStore
+        if (state.hasSample && (int32_t)(plotData.timeStamp - state.lastTimeStamp) <= 0)
+        {
+            return;
+        }
+        state.hasSample = YES;
+        state.lastTimeStamp = plotData.timeStamp;
+    }
+    [self.store appendSample:SessionSampleMake(plotData) forAddress:device.macAddress];
+    
+    NSUInteger count = [self.store sampleCountForAddress:device.macAddress];
+    if (count % 60 == 0)
+    {
+        [self reportProgress];
+    }
+}
+
+/// Reports the progress of all devices, weighted by their expected sample count.
+- (void)reportProgress
+{
+    NSUInteger expected = 0;
+    NSUInteger received = 0;
+    for (NSString *address in self.states)
+    {
+        RecordingExportState *state = self.states[address];
+        NSUInteger count = [self.store sampleCountForAddress:address];
+        expected += state.expectedSamples;
+        received += state.finished ? state.expectedSamples : MIN(count, state.expectedSamples);
+    }
+    float progress = expected > 0 ? (float)received / expected : 0;
+    RecordingExportProgressBlock block = self.progressBlock;
+    if (block)
+    {
+        dispatch_async(dispatch_get_main_queue(), ^{
+            block(progress);
+        });
+    }
+}
+
+/// Marks a device as done and completes the export once every device is done.
+/// @param device The device.
+/// @param success Whether the export of the device succeeded.
+- (void)finishDevice:(DotDevice *)device success:(BOOL)success
+{
+    dispatch_async(dispatch_get_main_queue(), ^{
+        RecordingExportState *state = self.states[device.macAddress];
+        if (!self.exporting || state.finished)
+        {
+            return;
+        }
+        state.finished = YES;
+        state.success = success;
+        [device setDidParseExportFileDataBlock:nil];
+        [self reportProgress];
+        
+        BOOL allSuccess = YES;
+        for (RecordingExportState *state in self.states.allValues)
+        {
+            if (!state.finished)
+            {
+                return;
+            }
+            allSuccess &= state.success;
+        }
+        [self completeWithSuccess:allSuccess];
+    });
+}
+
+/// Erases the recordings once they are safely exported and calls the completion block.
+/// @param success Whether every device was exported.
+- (void)completeWithSuccess:(BOOL)success
+{
+    self.exporting = NO;
+    [[NSNotificationCenter defaultCenter] removeObserver:self];
+    if (success)
+    {
+        for (DotDevice *device in self.devices)
+        {
+            __weak DotDevice *wdevice = device;
+            [device setEraseDataDoneBlock:^(int success) {
+                NSLog(@"Erase flash of %@: %d", wdevice.macAddress, success);
+            }];
+            [device eraseData];
+        }
+    }
+    RecordingExportCompletionBlock completion = self.completionBlock;
+    self.completionBlock = nil;
+    self.progressBlock = nil;
+    if (completion)
+    {
+        completion(success);
+    }
+}
+
+- (void)cancel
+{
+    if (!self.exporting)
+    {
+        return;
+    }
+    for (DotDevice *device in self.devices)
+    {
+        [device stopExportFileData];
+        [device setDidParseExportFileDataBlock:nil];
+    }
+    self.exporting = NO;
+    [[NSNotificationCenter defaultCenter] removeObserver:self];
+    RecordingExportCompletionBlock completion = self.completionBlock;
+    self.completionBlock = nil;
+    self.progressBlock = nil;
+    if (completion)
+    {
+        completion(NO);
+    }
+}
+
+#pragma mark - Notification
+
+/// Marks the export of a disconnected device as interrupted.
+/// @param sender The notification, whose object is the DotDevice.
+- (void)onDeviceDisconnected:(NSNotification *)sender
+{
+    DotDevice *device = sender.object;
+    dispatch_async(dispatch_get_main_queue(), ^{
+        RecordingExportState *state = self.states[device.macAddress];
+        if (self.exporting && state && !state.finished)
+        {
+            NSLog(@"Export of %@ interrupted", device.macAddress);
+            state.interrupted = YES;
+        }
+    });
+}
+
+/// Resumes an interrupted export once the device is initialized again.
+/// @param sender The notification, whose object is the DotDevice.
+- (void)onDeviceInitialized:(NSNotification *)sender
+{
+    DotDevice *device = sender.object;
+    dispatch_async(dispatch_get_main_queue(), ^{
+        RecordingExportState *state = self.states[device.macAddress];
+        if (self.exporting && state.interrupted && !state.finished)
+        {
+            NSLog(@"Resuming export of %@", device.macAddress);
+            state.interrupted = NO;
+            @synchronized (state)
+            {
+                state.lastActivity = CFAbsoluteTimeGetCurrent();
+            }
+            [self exportDevice:device];
+        }
+    });
+}
+
+@end
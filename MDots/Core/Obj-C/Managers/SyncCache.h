@@ -0,0 +1,47 @@
+//
+//  SyncCache.h
+//  MDots
+//
+//  Created by Estela Alvarez on 18/10/26.
+//
+
+#import <Foundation/Foundation.h>
+#import <MovellaDotSdk/DotDevice.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/// @class SyncCache
+/// @discussion Remembers the last successful `DotSyncManager` synchronization (when it happened and which sensors took part) so repeated trials with the same sensors can skip the sync step.
+@interface SyncCache : NSObject
+
+/// How long a cached sync is trusted, in seconds. Defaults to 30 minutes.
+@property (assign, nonatomic) NSTimeInterval validityInterval;
+
+/// The date of the last successful sync, or nil if there is none.
+@property (strong, nonatomic, readonly, nullable) NSDate *lastSyncDate;
+
+/// The shared cache instance.
+/// ```objc
+/// [[SyncCache sharedCache] isValidForDevices:devices];
+/// ```
++ (instancetype)sharedCache;
+
+/// Checks whether the last sync can be reused for the given devices.
+/// @param devices The devices about to be measured.
+/// @return YES if the device set is unchanged, the sync is not stale and every device still reports `isSynced`.
+- (BOOL)isValidForDevices:(NSArray<DotDevice *> *)devices;
+
+/// Records a successful sync of the given devices.
+/// @param devices The devices that were synced.
+- (void)recordSyncForDevices:(NSArray<DotDevice *> *)devices;
+
+/// Drops the cached sync if the device took part in it. Called when a device disconnects or reconnects.
+/// @param device The device whose connection changed.
+- (void)invalidateForDevice:(DotDevice *)device;
+
+/// Drops the cached sync.
+- (void)invalidate;
+
+@end
+
+NS_ASSUME_NONNULL_END
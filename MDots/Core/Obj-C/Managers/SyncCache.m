@@ -0,0 +1,112 @@
+//
+//  SyncCache.m
+//  MDots
+//
+//  Created by Estela Alvarez on 18/10/26.
+//
+
+#import "SyncCache.h"
+
+@interface SyncCache ()
+
+@property (strong, nonatomic, nullable) NSDate *lastSyncDate;
+/// Mac addresses of the devices in the last successful sync
+@property (strong, nonatomic, nullable) NSSet<NSString *> *syncedAddresses;
+
+@end
+
+@implementation SyncCache
+
++ (instancetype)sharedCache
+{
+    static SyncCache *cache = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        cache = [SyncCache new];
+    });
+    return cache;
+}
+
+- (instancetype)init
+{
+    if (self = [super init])
+    {
+        _validityInterval = 30 * 60;
+    }
+    return self;
+}
+
+/// Builds the set of mac addresses for a device list.
+/// @param devices The devices.
+/// @return The set of addresses.
+- (NSSet<NSString *> *)addressesOfDevices:(NSArray<DotDevice *> *)devices
+{
+    NSMutableSet *addresses = [NSMutableSet setWithCapacity:devices.count];
+    for (DotDevice *device in devices)
+    {
+        if (device.macAddress)
+        {
+            [addresses addObject:device.macAddress];
+        }
+    }
+    return addresses;
+}
+
+- (BOOL)isValidForDevices:(NSArray<DotDevice *> *)devices
+{
+    @synchronized (self)
+    {
+        if (self.lastSyncDate == nil || devices.count == 0)
+        {
+            return NO;
+        }
+        if (-[self.lastSyncDate timeIntervalSinceNow] > self.validityInterval)
+        {
+            return NO;
+        }
+        if (![[self addressesOfDevices:devices] isEqualToSet:self.syncedAddresses])
+        {
+            return NO;
+        }
+    }
+    for (DotDevice *device in devices)
+    {
+        if (!device.isSynced)
+        {
+            return NO;
+        }
+    }
+    return YES;
+}
+
+- (void)recordSyncForDevices:(NSArray<DotDevice *> *)devices
+{
+    @synchronized (self)
+    {
+        self.syncedAddresses = [self addressesOfDevices:devices];
+        self.lastSyncDate = [NSDate date];
+    }
+}
+
+- (void)invalidateForDevice:(DotDevice *)device
+{
+    @synchronized (self)
+    {
+        if (device.macAddress && [self.syncedAddresses containsObject:device.macAddress])
+        {
+            self.syncedAddresses = nil;
+            self.lastSyncDate = nil;
+        }
+    }
+}
+
+- (void)invalidate
+{
+    @synchronized (self)
+    {
+        self.syncedAddresses = nil;
+        self.lastSyncDate = nil;
+    }
+}
+
+@end
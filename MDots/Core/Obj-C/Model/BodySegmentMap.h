@@ -0,0 +1,83 @@
+//
+//  BodySegmentMap.h
+//  MDots
+//
+//  Created by Estela Alvarez on 18/10/26.
+//
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/// The body segments a sensor can be strapped to.
+typedef NS_ENUM(NSInteger, BodySegment)
+{
+    BodySegmentUnassigned = 0,
+    BodySegmentPelvis,
+    BodySegmentLeftThigh,
+    BodySegmentRightThigh,
+    BodySegmentLeftShank,
+    BodySegmentRightShank,
+};
+
+/// The most sensors a measurement can use, one per body segment.
+FOUNDATION_EXPORT const NSUInteger BodySegmentCount;
+
+/// The key of a segment in uploaded documents, e.g. "leftThigh".
+/// @param segment The segment.
+FOUNDATION_EXPORT NSString *BodySegmentKey(BodySegment segment);
+
+/// The name of a segment shown to the user, e.g. "Left thigh".
+/// @param segment The segment.
+FOUNDATION_EXPORT NSString *BodySegmentDisplayName(BodySegment segment);
+
+/// @class BodySegmentMap
+/// @discussion Remembers which body segment each sensor (keyed by mac address) is strapped to, and which segments every test needs. A segment holds at most one sensor. The mapping is kept in NSUserDefaults so a kit strapped the same way is not assigned again.
+@interface BodySegmentMap : NSObject
+
+/// The shared map instance.
+/// ```objc
+/// BodySegment segment = [[BodySegmentMap sharedMap] segmentForAddress:device.macAddress];
+/// ```
++ (instancetype)sharedMap;
+
+/// The segments a test needs, in the order its result uses them.
+/// @param testType The test type, e.g. "Hip Rotation".
+/// @param side The measured side: "L", "R" or "S" (single movement, measured on the left).
+/// @return The segments, empty for an unknown test.
+/// ```objc
+/// NSArray<NSNumber *> *segments = [BodySegmentMap requiredSegmentsForTestType:@"Hip Rotation" side:@"L"];
+/// // @[@(BodySegmentLeftThigh), @(BodySegmentLeftShank)]
+/// ```
++ (NSArray<NSNumber *> *)requiredSegmentsForTestType:(NSString *)testType side:(NSString *)side;
+
+/// The segment a sensor is assigned to.
+/// @param address The sensor mac address.
+/// @return The segment, or `BodySegmentUnassigned`.
+- (BodySegment)segmentForAddress:(NSString *)address;
+
+/// Assigns a sensor to a segment, unassigning the sensor that held the segment before.
+/// @param segment The segment, or `BodySegmentUnassigned` to clear the sensor.
+/// @param address The sensor mac address.
+- (void)setSegment:(BodySegment)segment forAddress:(NSString *)address;
+
+/// Finds the sensor assigned to a segment among some sensors.
+/// @param segment The segment.
+/// @param addresses The candidate mac addresses, e.g. the connected sensors.
+/// @return The mac address, or nil if none of them holds the segment.
+- (nullable NSString *)addressForSegment:(BodySegment)segment amongAddresses:(NSArray<NSString *> *)addresses;
+
+/// Assigns the segments a test needs that none of the sensors holds yet, when the user already placed a sensor on the same segment of the other side:
+/// a missing segment takes the sensor of its counterpart if the test does not need it (a left thigh sensor becomes the right thigh one when switching sides).
+/// Unassigned sensors and sensors of other segments are never assigned by a guess; the user assigns them.
+/// @param addresses The mac addresses of the connected sensors.
+/// @param segments The segments the test needs.
+/// @return The segments still missing, which the user must assign before the test starts.
+/// ```objc
+/// NSArray *missing = [[BodySegmentMap sharedMap] assignAddresses:addresses toSegments:segments];
+/// ```
+- (NSArray<NSNumber *> *)assignAddresses:(NSArray<NSString *> *)addresses toSegments:(NSArray<NSNumber *> *)segments;
+
+@end
+
+NS_ASSUME_NONNULL_END
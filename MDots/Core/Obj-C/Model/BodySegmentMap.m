@@ -0,0 +1,179 @@
+//
+//  BodySegmentMap.m
+//  MDots
+//
+//  Created by Estela Alvarez on 18/10/26.
+//
+
+#import "BodySegmentMap.h"
+
+/// NSUserDefaults key of the map, a dictionary of mac address to segment
+static NSString * const kBodySegmentMapKey = @"BodySegmentMap";
+
+const NSUInteger BodySegmentCount = 5;
+
+NSString *BodySegmentKey(BodySegment segment)
+{
+    switch (segment)
+    {
+        case BodySegmentPelvis: return @"pelvis";
+        case BodySegmentLeftThigh: return @"leftThigh";
+        case BodySegmentRightThigh: return @"rightThigh";
+        case BodySegmentLeftShank: return @"leftShank";
+        case BodySegmentRightShank: return @"rightShank";
+        default: return @"unassigned";
+    }
+}
+
+NSString *BodySegmentDisplayName(BodySegment segment)
+{
+    switch (segment)
+    {
+        case BodySegmentPelvis: return @"Pelvis";
+        case BodySegmentLeftThigh: return @"Left thigh";
+        case BodySegmentRightThigh: return @"Right thigh";
+        case BodySegmentLeftShank: return @"Left shank";
+        case BodySegmentRightShank: return @"Right shank";
+        default: return @"Unassigned";
+    }
+}
+
+@interface BodySegmentMap ()
+
+/// Segment per mac address
+@property (strong, nonatomic) NSMutableDictionary<NSString *, NSNumber *> *segments;
+
+@end
+
+@implementation BodySegmentMap
+
++ (instancetype)sharedMap
+{
+    static BodySegmentMap *map = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        map = [BodySegmentMap new];
+    });
+    return map;
+}
+
+- (instancetype)init
+{
+    if (self = [super init])
+    {
+        NSDictionary *saved = [[NSUserDefaults standardUserDefaults] dictionaryForKey:kBodySegmentMapKey];
+        _segments = saved ? [saved mutableCopy] : [NSMutableDictionary dictionary];
+    }
+    return self;
+}
+
++ (NSArray<NSNumber *> *)requiredSegmentsForTestType:(NSString *)testType side:(NSString *)side
+{
+    BOOL right = [side hasPrefix:@"R"];
+    NSNumber *thigh = right ? @(BodySegmentRightThigh) : @(BodySegmentLeftThigh);
+    NSNumber *shank = right ? @(BodySegmentRightShank) : @(BodySegmentLeftShank);
+    if ([testType isEqualToString:@"Sit and Reach"])
+    {
+        return @[@(BodySegmentPelvis), thigh];
+    }
+    else if ([testType isEqualToString:@"Lunge"])
+    {
+        return @[thigh];
+    }
+    else if ([testType isEqualToString:@"Hip Rotation"])
+    {
+        return @[thigh, shank];
+    }
+    return @[];
+}
+
+- (void)save
+{
+    [[NSUserDefaults standardUserDefaults] setObject:self.segments forKey:kBodySegmentMapKey];
+}
+
+- (BodySegment)segmentForAddress:(NSString *)address
+{
+    @synchronized (self)
+    {
+        return self.segments[address].integerValue;
+    }
+}
+
+- (void)setSegment:(BodySegment)segment forAddress:(NSString *)address
+{
+    @synchronized (self)
+    {
+        for (NSString *holder in [self.segments allKeysForObject:@(segment)])
+        {
+            [self.segments removeObjectForKey:holder];
+        }
+        if (segment == BodySegmentUnassigned)
+        {
+            [self.segments removeObjectForKey:address];
+        }
+        else
+        {
+            self.segments[address] = @(segment);
+        }
+        [self save];
+    }
+}
+
+- (nullable NSString *)addressForSegment:(BodySegment)segment amongAddresses:(NSArray<NSString *> *)addresses
+{
+    @synchronized (self)
+    {
+        for (NSString *address in addresses)
+        {
+            if (self.segments[address].integerValue == segment)
+            {
+                return address;
+            }
+        }
+        return nil;
+    }
+}
+
+/// The same segment on the other side, e.g. the right thigh for the left thigh.
+/// @param segment The segment.
+/// @return The counterpart, or `segment` itself for the pelvis.
+static BodySegment BodySegmentCounterpart(BodySegment segment)
+{
+    switch (segment)
+    {
+        case BodySegmentLeftThigh: return BodySegmentRightThigh;
+        case BodySegmentRightThigh: return BodySegmentLeftThigh;
+        case BodySegmentLeftShank: return BodySegmentRightShank;
+        case BodySegmentRightShank: return BodySegmentLeftShank;
+        default: return segment;
+    }
+}
+
+- (NSArray<NSNumber *> *)assignAddresses:(NSArray<NSString *> *)addresses toSegments:(NSArray<NSNumber *> *)segments
+{
+    NSMutableArray<NSNumber *> *missing = [NSMutableArray array];
+    for (NSNumber *segment in segments)
+    {
+        if (![self addressForSegment:segment.integerValue amongAddresses:addresses])
+        {
+            [missing addObject:segment];
+        }
+    }
+    for (NSNumber *segment in [missing copy])
+    {
+        /// Switching sides moves the strap to the other leg, the sensor keeps its segment. Any other sensor is left
+        /// to the user: a thigh and shank swapped by a guess would flip the sign of Hip Rotation without a warning
+        BodySegment counterpart = BodySegmentCounterpart(segment.integerValue);
+        NSString *address = [self addressForSegment:counterpart amongAddresses:addresses];
+        if (!address || counterpart == segment.integerValue || [segments containsObject:@(counterpart)])
+        {
+            continue;
+        }
+        [self setSegment:segment.integerValue forAddress:address];
+        [missing removeObject:segment];
+    }
+    return missing;
+}
+
+@end
@@ -0,0 +1,140 @@
+//
+//  SessionArena.c
+//  MDots
+//
+//  Created by Estela Alvarez on 18/10/26.
+//
+
+#include "SessionArena.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct SessionArenaChunk
+{
+    struct SessionArenaChunk *next;
+    size_t size;
+    size_t used;
+    /// No alignment of its own, SessionArenaAlloc rounds every allocation up to the one it asks for
+    unsigned char data[];
+} SessionArenaChunk;
+
+struct SessionArena
+{
+    /// The chunk allocations are served from, older chunks follow it
+    SessionArenaChunk *head;
+    size_t chunkSize;
+    SessionArenaStats stats;
+};
+
+static SessionArenaChunk *SessionArenaNewChunk(SessionArena *arena, size_t size)
+{
+    SessionArenaChunk *chunk = malloc(sizeof(SessionArenaChunk) + size);
+    if (chunk == NULL)
+    {
+        return NULL;
+    }
+    chunk->size = size;
+    chunk->used = 0;
+    chunk->next = arena->head;
+    arena->head = chunk;
+    arena->stats.chunks += 1;
+    arena->stats.bytesReserved += size;
+    arena->stats.systemAllocations += 1;
+    return chunk;
+}
+
+SessionArena *SessionArenaCreate(size_t chunkSize)
+{
+    SessionArena *arena = calloc(1, sizeof(SessionArena));
+    if (arena == NULL)
+    {
+        return NULL;
+    }
+    arena->chunkSize = chunkSize > 0 ? chunkSize : 64 * 1024;
+    arena->stats.systemAllocations = 1;
+    return arena;
+}
+
+void SessionArenaDestroy(SessionArena *arena)
+{
+    if (arena == NULL)
+    {
+        return;
+    }
+    SessionArenaChunk *chunk = arena->head;
+    while (chunk)
+    {
+        SessionArenaChunk *next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+    free(arena);
+}
+
+void *SessionArenaAlloc(SessionArena *arena, size_t size, size_t alignment)
+{
+    if (alignment == 0)
+    {
+        alignment = 1;
+    }
+    SessionArenaChunk *chunk = arena->head;
+    size_t offset = 0;
+    if (chunk)
+    {
+        uintptr_t base = (uintptr_t)chunk->data;
+        offset = ((base + chunk->used + alignment - 1) & ~(uintptr_t)(alignment - 1)) - base;
+    }
+    if (chunk == NULL || offset + size > chunk->size)
+    {
+        size_t needed = size + alignment;
+        chunk = SessionArenaNewChunk(arena, needed > arena->chunkSize ? needed : arena->chunkSize);
+        if (chunk == NULL)
+        {
+            return NULL;
+        }
+        uintptr_t base = (uintptr_t)chunk->data;
+        offset = ((base + alignment - 1) & ~(uintptr_t)(alignment - 1)) - base;
+    }
+    arena->stats.bytesUsed += offset + size - chunk->used;
+    arena->stats.allocations += 1;
+    chunk->used = offset + size;
+    void *memory = chunk->data + offset;
+    memset(memory, 0, size);
+    return memory;
+}
+
+void SessionArenaReset(SessionArena *arena)
+{
+    // Keep the oldest chunk, it is at the tail of the list
+    SessionArenaChunk *chunk = arena->head;
+    SessionArenaChunk *kept = NULL;
+    while (chunk)
+    {
+        SessionArenaChunk *next = chunk->next;
+        if (next == NULL)
+        {
+            kept = chunk;
+        }
+        else
+        {
+            free(chunk);
+        }
+        chunk = next;
+    }
+    arena->head = kept;
+    arena->stats.allocations = 0;
+    arena->stats.bytesUsed = 0;
+    arena->stats.chunks = kept ? 1 : 0;
+    arena->stats.bytesReserved = kept ? kept->size : 0;
+    if (kept)
+    {
+        kept->used = 0;
+        kept->next = NULL;
+    }
+}
+
+SessionArenaStats SessionArenaGetStats(const SessionArena *arena)
+{
+    return arena->stats;
+}
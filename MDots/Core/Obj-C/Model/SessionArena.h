@@ -0,0 +1,61 @@
+//
+//  SessionArena.h
+//  MDots
+//
+//  Created by Estela Alvarez on 18/10/26.
+//
+
+#ifndef SessionArena_h
+#define SessionArena_h
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// A bump allocator for the buffers of one measurement session. Allocations are never freed one by one:
+/// the whole session is released at once by SessionArenaReset or SessionArenaDestroy. Not thread safe.
+typedef struct SessionArena SessionArena;
+
+/// The allocation counters of an arena
+typedef struct
+{
+    /// Allocations served since the last reset
+    size_t allocations;
+    /// Bytes handed out since the last reset, including alignment padding
+    size_t bytesUsed;
+    /// Bytes held in chunks
+    size_t bytesReserved;
+    /// Chunks currently held
+    size_t chunks;
+    /// Calls to malloc since the arena was created
+    size_t systemAllocations;
+} SessionArenaStats;
+
+/// Creates an arena.
+/// @param chunkSize The size of each chunk taken from the system; larger requests get a chunk of their own.
+/// @return The arena, or NULL if out of memory.
+SessionArena *SessionArenaCreate(size_t chunkSize);
+
+/// Releases every allocation and the arena itself.
+void SessionArenaDestroy(SessionArena *arena);
+
+/// Allocates zero-filled memory that lives until the next reset.
+/// @param arena The arena.
+/// @param size The size in bytes.
+/// @param alignment A power of two.
+/// @return The memory, or NULL if out of memory.
+void *SessionArenaAlloc(SessionArena *arena, size_t size, size_t alignment);
+
+/// Releases every allocation in one operation. The first chunk is kept for the next session.
+void SessionArenaReset(SessionArena *arena);
+
+/// The allocation counters.
+SessionArenaStats SessionArenaGetStats(const SessionArena *arena);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SessionArena_h */
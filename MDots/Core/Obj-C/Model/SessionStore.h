@@ -0,0 +1,115 @@
+//
+//  SessionStore.h
+//  MDots
+//
+//  Created by Estela Alvarez on 18/10/26.
+//
+
+#import <Foundation/Foundation.h>
+#import <MovellaDotSdk/DotDevice.h>
+#import "SessionArena.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+/// One sample of a device, copied out of a `DotPlotData` so it can be stored without keeping the SDK object alive.
+typedef struct
+{
+    UInt32 packageCounter;
+    UInt32 timeStamp;
+    /// w, x, y, z
+    float quat[4];
+    /// Roll, pitch, yaw in degrees
+    double euler[3];
+    float freeAcc[3];
+    double acc[3];
+    /// Angular velocity in deg/s, like `euler`. The SDK reports rad/s, `SessionSampleMake` converts it.
+    double gyr[3];
+    /// Orientation increment (w, x, y, z) of the delta quantities payloads
+    double dq[4];
+    /// Velocity increment of the delta quantities payloads
+    double dv[3];
+} SessionSample;
+
+/// Copies the fields of a plot data object into a `SessionSample`.
+/// @param plotData The SDK sample.
+/// @return The stored sample.
+FOUNDATION_EXPORT SessionSample SessionSampleMake(DotPlotData *plotData);
+
+/// @class SessionStore
+/// @discussion Stores the samples of one measurement trial, one contiguous buffer per device (keyed by mac address). Safe to append from SDK callback threads.
+/// The buffers live in a `SessionArena` sized for the expected trial, so appending does not allocate until a buffer fills up, and the whole session is released at once.
+@interface SessionStore : NSObject
+
+/// The mac addresses of the devices in the session, in measure order.
+@property (strong, nonatomic, readonly) NSArray<NSString *> *addresses;
+
+/// The allocation counters of the session arena.
+@property (assign, nonatomic, readonly) SessionArenaStats allocationStats;
+
+/// Creates a store for the given devices.
+/// @param devices The devices in the session.
+/// ```objc
+/// SessionStore *store = [[SessionStore alloc] initWithDevices:self.measureDevices];
+/// ```
+- (instancetype)initWithDevices:(NSArray<DotDevice *> *)devices;
+
+/// Creates a store for the given mac addresses, e.g. to hold a reprocessed session.
+/// @param addresses The mac addresses of the devices in the session.
+- (instancetype)initWithAddresses:(NSArray<NSString *> *)addresses;
+
+/// Creates a store reserving room for a number of samples per device.
+/// @param addresses The mac addresses of the devices in the session.
+/// @param capacity The samples expected per device. Defaults to 4096 (68 s at 60 Hz) in the other initializers.
+- (instancetype)initWithAddresses:(NSArray<NSString *> *)addresses capacity:(NSUInteger)capacity;
+
+/// Appends a sample for a device.
+/// @param sample The sample to append.
+/// @param address The device mac address.
+- (void)appendSample:(SessionSample)sample forAddress:(NSString *)address;
+
+/// The number of samples stored for a device.
+/// @param address The device mac address.
+- (NSUInteger)sampleCountForAddress:(NSString *)address;
+
+/// Copies the last stored sample of a device.
+/// @param sample The sample to fill in.
+/// @param address The device mac address.
+/// @return NO if the device has no samples.
+- (BOOL)getLastSample:(SessionSample *)sample forAddress:(NSString *)address;
+
+/// The newest timestamp every device has reached: the earliest of the last sample timestamps. Used to read all devices at the same instant.
+/// @param timeStamp The timestamp to fill in, in microseconds (`sampleTimeFine`).
+/// @return NO if a device has no samples.
+- (BOOL)getLatestCommonTimeStamp:(UInt32 *)timeStamp;
+
+/// Copies the last sample of a device taken at or before a timestamp, by binary search. Timestamps are compared modulo 2^32, so the search stays correct across the counter wrap.
+/// @param sample The sample to fill in.
+/// @param timeStamp The timestamp, in microseconds (`sampleTimeFine`).
+/// @param address The device mac address.
+/// @return NO if the device has no sample at or before the timestamp.
+/// ```objc
+/// UInt32 now;
+/// SessionSample pelvis;
+/// if ([store getLatestCommonTimeStamp:&now] && [store getSample:&pelvis atTimeStamp:now forAddress:address]) { ... }
+/// ```
+- (BOOL)getSample:(SessionSample *)sample atTimeStamp:(UInt32)timeStamp forAddress:(NSString *)address;
+
+/// Calls the block with all samples of a device while the store is locked.
+/// @param address The device mac address.
+/// @param block Receives the sample buffer and its count. The pointer must not escape the block.
+- (void)enumerateSamplesForAddress:(NSString *)address usingBlock:(void (^)(const SessionSample *samples, NSUInteger count))block;
+
+/// Marks the next sample of a device as the first one after a break in the stream (e.g. a reconnect).
+/// @param address The device mac address.
+- (void)markGapForAddress:(NSString *)address;
+
+/// The indexes of the samples that start a new stream after a break.
+/// @param address The device mac address.
+- (NSIndexSet *)gapIndexesForAddress:(NSString *)address;
+
+/// Removes all samples and gap marks, releasing the session arena in one operation.
+- (void)reset;
+
+@end
+
+NS_ASSUME_NONNULL_END
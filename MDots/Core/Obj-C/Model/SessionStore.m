@@ -0,0 +1,299 @@
+//
+//  SessionStore.m
+//  MDots
+//
+//  Created by Estela Alvarez on 18/10/26.
+//
+
+#import "SessionStore.h"
+
+SessionSample SessionSampleMake(DotPlotData *plotData)
+{
+    SessionSample sample;
+    sample.packageCounter = plotData.packageCounter;
+    sample.timeStamp = plotData.timeStamp;
+    sample.quat[0] = plotData.quatW;
+    sample.quat[1] = plotData.quatX;
+    sample.quat[2] = plotData.quatY;
+    sample.quat[3] = plotData.quatZ;
+    sample.euler[0] = plotData.euler0;
+    sample.euler[1] = plotData.euler1;
+    sample.euler[2] = plotData.euler2;
+    sample.freeAcc[0] = plotData.freeAccX;
+    sample.freeAcc[1] = plotData.freeAccY;
+    sample.freeAcc[2] = plotData.freeAccZ;
+    sample.acc[0] = plotData.acc0;
+    sample.acc[1] = plotData.acc1;
+    sample.acc[2] = plotData.acc2;
+    // The SDK reports the gyroscope in rad/s, the store keeps every angle in degrees
+    sample.gyr[0] = plotData.gyr0 * (180.0 / M_PI);
+    sample.gyr[1] = plotData.gyr1 * (180.0 / M_PI);
+    sample.gyr[2] = plotData.gyr2 * (180.0 / M_PI);
+    sample.dq[0] = plotData.dQ0;
+    sample.dq[1] = plotData.dQ1;
+    sample.dq[2] = plotData.dQ2;
+    sample.dq[3] = plotData.dQ3;
+    sample.dv[0] = plotData.dV0;
+    sample.dv[1] = plotData.dV1;
+    sample.dv[2] = plotData.dV2;
+    return sample;
+}
+
+/// The samples of one device, held in the session arena
+@interface SessionSampleBuffer : NSObject
+
+@property (assign, nonatomic) SessionSample *samples;
+@property (assign, nonatomic) NSUInteger count;
+@property (assign, nonatomic) NSUInteger capacity;
+
+@end
+
+@implementation SessionSampleBuffer
+@end
+
+@interface SessionStore ()
+{
+    SessionArena *_arena;
+}
+
+@property (strong, nonatomic) NSArray<NSString *> *addresses;
+/// Samples expected per device, reserved on the first sample
+@property (assign, nonatomic) NSUInteger initialCapacity;
+/// The chunk size of the arena, kept to create it again if it could not be created with the store
+@property (assign, nonatomic) size_t arenaChunkSize;
+/// The samples per mac address
+@property (strong, nonatomic) NSMutableDictionary<NSString *, SessionSampleBuffer *> *buffers;
+/// Indexes of the samples following a break per mac address
+@property (strong, nonatomic) NSMutableDictionary<NSString *, NSMutableIndexSet *> *gaps;
+
+@end
+
+@implementation SessionStore
+
+- (instancetype)initWithDevices:(NSArray<DotDevice *> *)devices
+{
+    return [self initWithAddresses:[devices valueForKey:@"macAddress"]];
+}
+
+- (instancetype)initWithAddresses:(NSArray<NSString *> *)addresses
+{
+    return [self initWithAddresses:addresses capacity:4096];
+}
+
+- (instancetype)initWithAddresses:(NSArray<NSString *> *)addresses capacity:(NSUInteger)capacity
+{
+    if (self = [super init])
+    {
+        _initialCapacity = MAX(capacity, 64);
+        // One chunk holds the initial buffers of every device
+        _arenaChunkSize = _initialCapacity * sizeof(SessionSample) * MAX(addresses.count, 1) + 64 * addresses.count;
+        _arena = SessionArenaCreate(_arenaChunkSize);
+        if (_arena == NULL)
+        {
+            // Retried on the first sample, samples are dropped until then
+            NSLog(@"Session store out of memory");
+        }
+        _buffers = [NSMutableDictionary dictionaryWithCapacity:addresses.count];
+        _gaps = [NSMutableDictionary dictionary];
+        for (NSString *address in addresses)
+        {
+            _buffers[address] = [SessionSampleBuffer new];
+        }
+        _addresses = [addresses copy];
+    }
+    return self;
+}
+
+- (void)dealloc
+{
+    SessionArenaDestroy(_arena);
+}
+
+- (SessionArenaStats)allocationStats
+{
+    @synchronized (self)
+    {
+        if (_arena == NULL)
+        {
+            return (SessionArenaStats){ 0 };
+        }
+        return SessionArenaGetStats(_arena);
+    }
+}
+
+/// The buffer of a device, created for devices that were not in the session.
+- (SessionSampleBuffer *)bufferForAddress:(NSString *)address
+{
+    SessionSampleBuffer *buffer = self.buffers[address];
+    if (buffer == nil)
+    {
+        buffer = [SessionSampleBuffer new];
+        self.buffers[address] = buffer;
+    }
+    return buffer;
+}
+
+/// Moves a full buffer to an arena block twice as large. The old block is released with the session.
+- (BOOL)growBuffer:(SessionSampleBuffer *)buffer
+{
+    NSUInteger capacity = buffer.capacity > 0 ? buffer.capacity * 2 : self.initialCapacity;
+    if (_arena == NULL)
+    {
+        _arena = SessionArenaCreate(self.arenaChunkSize);
+    }
+    SessionSample *samples = _arena == NULL ? NULL : SessionArenaAlloc(_arena, capacity * sizeof(SessionSample), 64);
+    if (samples == NULL)
+    {
+        NSLog(@"Session store out of memory");
+        return NO;
+    }
+    if (buffer.count > 0)
+    {
+        memcpy(samples, buffer.samples, buffer.count * sizeof(SessionSample));
+    }
+    buffer.samples = samples;
+    buffer.capacity = capacity;
+    return YES;
+}
+
+- (void)appendSample:(SessionSample)sample forAddress:(NSString *)address
+{
+    @synchronized (self)
+    {
+        SessionSampleBuffer *buffer = [self bufferForAddress:address];
+        if (buffer.count == buffer.capacity && ![self growBuffer:buffer])
+        {
+            return;
+        }
+        buffer.samples[buffer.count] = sample;
+        buffer.count += 1;
+    }
+}
+
+- (NSUInteger)sampleCountForAddress:(NSString *)address
+{
+    @synchronized (self)
+    {
+        return self.buffers[address].count;
+    }
+}
+
+- (BOOL)getLastSample:(SessionSample *)sample forAddress:(NSString *)address
+{
+    @synchronized (self)
+    {
+        SessionSampleBuffer *buffer = self.buffers[address];
+        if (buffer.count == 0)
+        {
+            return NO;
+        }
+        *sample = buffer.samples[buffer.count - 1];
+        return YES;
+    }
+}
+
+- (BOOL)getLatestCommonTimeStamp:(UInt32 *)timeStamp
+{
+    @synchronized (self)
+    {
+        BOOL found = NO;
+        UInt32 common = 0;
+        for (NSString *address in self.addresses)
+        {
+            SessionSampleBuffer *buffer = self.buffers[address];
+            if (buffer.count == 0)
+            {
+                return NO;
+            }
+            UInt32 last = buffer.samples[buffer.count - 1].timeStamp;
+            if (!found || (int32_t)(last - common) < 0)
+            {
+                common = last;
+                found = YES;
+            }
+        }
+        *timeStamp = common;
+        return found;
+    }
+}
+
+- (BOOL)getSample:(SessionSample *)sample atTimeStamp:(UInt32)timeStamp forAddress:(NSString *)address
+{
+    @synchronized (self)
+    {
+        SessionSampleBuffer *buffer = self.buffers[address];
+        // First index whose sample is after the timestamp
+        NSUInteger low = 0;
+        NSUInteger high = buffer.count;
+        while (low < high)
+        {
+            NSUInteger mid = low + (high - low) / 2;
+            if ((int32_t)(buffer.samples[mid].timeStamp - timeStamp) <= 0)
+            {
+                low = mid + 1;
+            }
+            else
+            {
+                high = mid;
+            }
+        }
+        if (low == 0)
+        {
+            return NO;
+        }
+        *sample = buffer.samples[low - 1];
+        return YES;
+    }
+}
+
+- (void)enumerateSamplesForAddress:(NSString *)address usingBlock:(void (^)(const SessionSample *samples, NSUInteger count))block
+{
+    @synchronized (self)
+    {
+        SessionSampleBuffer *buffer = self.buffers[address];
+        block(buffer.samples, buffer.count);
+    }
+}
+
+- (void)markGapForAddress:(NSString *)address
+{
+    @synchronized (self)
+    {
+        NSMutableIndexSet *gaps = self.gaps[address];
+        if (gaps == nil)
+        {
+            gaps = [NSMutableIndexSet indexSet];
+            self.gaps[address] = gaps;
+        }
+        [gaps addIndex:self.buffers[address].count];
+    }
+}
+
+- (NSIndexSet *)gapIndexesForAddress:(NSString *)address
+{
+    @synchronized (self)
+    {
+        return [self.gaps[address] copy] ?: [NSIndexSet indexSet];
+    }
+}
+
+- (void)reset
+{
+    @synchronized (self)
+    {
+        // Every sample buffer goes back to the arena at once
+        if (_arena)
+        {
+            SessionArenaReset(_arena);
+        }
+        for (SessionSampleBuffer *buffer in self.buffers.allValues)
+        {
+            buffer.samples = NULL;
+            buffer.count = 0;
+            buffer.capacity = 0;
+        }
+        [self.gaps removeAllObjects];
+    }
+}
+
+@end
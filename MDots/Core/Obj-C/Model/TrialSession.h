@@ -0,0 +1,59 @@
+//
+//  TrialSession.h
+//  MDots
+//
+//  Created by Estela Alvarez on 18/10/26.
+//
+
+#import <Foundation/Foundation.h>
+#import "RobustStatistics.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+/// @class TrialSession
+/// @discussion Collects the results of K trials of the same test and side, and aggregates them robustly. Every trial must have the side of the first one, so a Hip Rotation session never pools internal and external rotations: outliers are rejected by their modified z-score, then the median, trimmed mean and coefficient of variation of the rest are computed. The whole session is uploaded as one document.
+@interface TrialSession : NSObject
+
+/// The number of trials of the session.
+@property (assign, nonatomic, readonly) NSUInteger trialCount;
+
+/// The modified z-score above which a trial is rejected. Defaults to 3.5.
+@property (assign, nonatomic) double outlierThreshold;
+
+/// The share of trials cut from each end for the trimmed mean. Defaults to 0.2.
+@property (assign, nonatomic) double trimFraction;
+
+/// The trials added so far: value, side and the fields of the trial analysis.
+@property (strong, nonatomic, readonly) NSArray<NSDictionary<NSString *, id> *> *trials;
+
+/// The side of the first trial, which every other trial must match. Nil before the first trial.
+@property (strong, nonatomic, readonly, nullable) NSString *side;
+
+/// Whether every trial was added.
+@property (assign, nonatomic, readonly, getter=isComplete) BOOL complete;
+
+/// Creates a session.
+/// @param trialCount The number of trials, at least 1.
+/// ```objc
+/// TrialSession *session = [[TrialSession alloc] initWithTrialCount:3];
+/// ```
+- (instancetype)initWithTrialCount:(NSUInteger)trialCount;
+
+/// Adds the result of a trial.
+/// @param value The test result.
+/// @param side The side of the trial, e.g. "Le" for a left external rotation.
+/// @param fields The fields of the trial analysis (segments, repetitions, quality...).
+/// @return NO, and the trial is not added, if its side differs from the side of the session.
+- (BOOL)addTrialWithValue:(double)value side:(NSString *)side fields:(NSDictionary<NSString *, id> *)fields;
+
+/// Summarizes the accepted trials.
+/// @param summary The summary out.
+/// @return NO if there is no trial.
+- (BOOL)getSummary:(RobustSummary *)summary;
+
+/// The session as stored with the test: the summary, the indexes of the rejected trials and every trial with its `accepted` flag.
+- (NSDictionary<NSString *, id> *)aggregate;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,111 @@
+//
+//  TrialSession.m
+//  MDots
+//
+//  Created by Estela Alvarez on 18/10/26.
+//
+
+#import "TrialSession.h"
+
+@interface TrialSession ()
+
+@property (strong, nonatomic) NSMutableArray<NSDictionary<NSString *, id> *> *mutableTrials;
+
+@end
+
+@implementation TrialSession
+
+- (instancetype)initWithTrialCount:(NSUInteger)trialCount
+{
+    if (self = [super init])
+    {
+        _trialCount = MAX(trialCount, 1u);
+        _outlierThreshold = 3.5;
+        _trimFraction = 0.2;
+        _mutableTrials = [NSMutableArray arrayWithCapacity:_trialCount];
+    }
+    return self;
+}
+
+- (NSArray<NSDictionary<NSString *, id> *> *)trials
+{
+    return [self.mutableTrials copy];
+}
+
+- (BOOL)isComplete
+{
+    return self.mutableTrials.count >= self.trialCount;
+}
+
+- (NSString *)side
+{
+    return self.mutableTrials.firstObject[@"side"];
+}
+
+- (BOOL)addTrialWithValue:(double)value side:(NSString *)side fields:(NSDictionary<NSString *, id> *)fields
+{
+    if (self.side && ![self.side isEqualToString:side])
+    {
+        return NO;
+    }
+    NSMutableDictionary *trial = [fields mutableCopy];
+    trial[@"value"] = @(value);
+    trial[@"side"] = side;
+    [self.mutableTrials addObject:trial];
+    return YES;
+}
+
+/// Runs the outlier rejection and the summary over the trial values.
+/// @param accepted The flags out, one per trial.
+/// @return NO if there is no trial.
+- (BOOL)getSummary:(RobustSummary *)summary accepted:(NSMutableData *)accepted
+{
+    NSUInteger count = self.mutableTrials.count;
+    NSMutableData *values = [NSMutableData dataWithLength:count * sizeof(double)];
+    NSMutableData *scratch = [NSMutableData dataWithLength:count * sizeof(double)];
+    accepted.length = count;
+    double *v = values.mutableBytes;
+    for (NSUInteger i = 0; i < count; i++)
+    {
+        v[i] = [self.mutableTrials[i][@"value"] doubleValue];
+    }
+    RobustRejectOutliers(v, count, self.outlierThreshold, accepted.mutableBytes, scratch.mutableBytes);
+    return RobustSummarize(v, accepted.mutableBytes, count, self.trimFraction, summary, scratch.mutableBytes) != 0;
+}
+
+- (BOOL)getSummary:(RobustSummary *)summary
+{
+    return [self getSummary:summary accepted:[NSMutableData data]];
+}
+
+- (NSDictionary<NSString *, id> *)aggregate
+{
+    RobustSummary summary;
+    NSMutableData *accepted = [NSMutableData data];
+    [self getSummary:&summary accepted:accepted];
+    const unsigned char *flags = accepted.bytes;
+    NSMutableArray *trials = [NSMutableArray arrayWithCapacity:self.mutableTrials.count];
+    NSMutableArray *rejected = [NSMutableArray array];
+    for (NSUInteger i = 0; i < self.mutableTrials.count; i++)
+    {
+        NSMutableDictionary *trial = [self.mutableTrials[i] mutableCopy];
+        trial[@"accepted"] = @(flags[i] != 0);
+        [trials addObject:trial];
+        if (!flags[i])
+        {
+            [rejected addObject:@(i)];
+        }
+    }
+    return @{
+        @"trialCount": @(self.mutableTrials.count),
+        @"median": @(summary.median),
+        @"trimmedMean": @(summary.trimmedMean),
+        @"mean": @(summary.mean),
+        @"standardDeviation": @(summary.standardDeviation),
+        @"coefficientOfVariation": @(summary.coefficientOfVariation),
+        @"rejected": rejected,
+        @"trials": trials,
+    };
+}
+
+@end
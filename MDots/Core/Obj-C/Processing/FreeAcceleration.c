@@ -0,0 +1,50 @@
+//
+//  FreeAcceleration.c
+//  MDots
+//
+//  Created by Estela Alvarez on 18/10/26.
+//
+
+#include "FreeAcceleration.h"
+
+void FreeAccelerationCompute(FreeAccelerationInput input, size_t count, double gravity, FreeAccelerationOutput output)
+{
+    const float *restrict qw = input.qw;
+    const float *restrict qx = input.qx;
+    const float *restrict qy = input.qy;
+    const float *restrict qz = input.qz;
+    const double *restrict ax = input.ax;
+    const double *restrict ay = input.ay;
+    const double *restrict az = input.az;
+    double *restrict fx = output.x;
+    double *restrict fy = output.y;
+    double *restrict fz = output.z;
+    
+    // Branch free body so the loop is vectorized across samples
+    for (size_t i = 0; i < count; i++)
+    {
+        double w = qw[i], x = qx[i], y = qy[i], z = qz[i];
+        double a0 = ax[i], a1 = ay[i], a2 = az[i];
+        double xx = x * x, yy = y * y, zz = z * z;
+        double xy = x * y, xz = x * z, yz = y * z;
+        double wx = w * x, wy = w * y, wz = w * z;
+        fx[i] = (1.0 - 2.0 * (yy + zz)) * a0 + 2.0 * (xy - wz) * a1 + 2.0 * (xz + wy) * a2;
+        fy[i] = 2.0 * (xy + wz) * a0 + (1.0 - 2.0 * (xx + zz)) * a1 + 2.0 * (yz - wx) * a2;
+        fz[i] = 2.0 * (xz - wy) * a0 + 2.0 * (yz + wx) * a1 + (1.0 - 2.0 * (xx + yy)) * a2 - gravity;
+    }
+}
+
+void FreeAccelerationIntegrate(const double *values, const double *dt, size_t count, double *integral)
+{
+    if (count == 0)
+    {
+        return;
+    }
+    double sum = 0.0;
+    integral[0] = 0.0;
+    for (size_t i = 1; i < count; i++)
+    {
+        sum += 0.5 * (values[i - 1] + values[i]) * dt[i];
+        integral[i] = sum;
+    }
+}
@@ -0,0 +1,61 @@
+//
+//  FreeAcceleration.h
+//  MDots
+//
+//  Created by Estela Alvarez on 18/10/26.
+//
+
+#ifndef FreeAcceleration_h
+#define FreeAcceleration_h
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// Batch free acceleration over whole trial columns, the column form of `DotPlotData -getCalFreeAcc:`.
+/// All columns are caller owned (structure of arrays), nothing is allocated.
+
+/// The default local gravity of the SDK, in m/s2
+#define FREE_ACCELERATION_DEFAULT_GRAVITY 9.8127
+
+/// Input columns, one value per sample
+typedef struct
+{
+    const float *qw;
+    const float *qx;
+    const float *qy;
+    const float *qz;
+    const double *ax;
+    const double *ay;
+    const double *az;
+} FreeAccelerationInput;
+
+/// Output columns, one value per sample
+typedef struct
+{
+    double *x;
+    double *y;
+    double *z;
+} FreeAccelerationOutput;
+
+/// Rotates the sensor accelerations to the earth frame (Z up) and removes gravity.
+/// @param input The quaternion and acceleration columns.
+/// @param count The number of samples.
+/// @param gravity The local gravity in m/s2.
+/// @param output The free acceleration columns, must not alias the input.
+void FreeAccelerationCompute(FreeAccelerationInput input, size_t count, double gravity, FreeAccelerationOutput output);
+
+/// Cumulative trapezoidal integral of a column, e.g. free acceleration to velocity or velocity to displacement.
+/// @param values The column to integrate.
+/// @param dt The time steps in seconds between sample i - 1 and i (dt[0] is ignored).
+/// @param count The number of samples.
+/// @param integral The integral column, integral[0] is 0. May alias neither input.
+void FreeAccelerationIntegrate(const double *values, const double *dt, size_t count, double *integral);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* FreeAcceleration_h */
@@ -0,0 +1,46 @@
+//
+//  FreeAccelerationBatch.h
+//  MDots
+//
+//  Created by Estela Alvarez on 18/10/26.
+//
+
+#import <Foundation/Foundation.h>
+#import "SessionStore.h"
+#import "FreeAcceleration.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+/// The free acceleration columns of one device over a trial, valid only inside the block they are passed to
+typedef struct
+{
+    const double *x;
+    const double *y;
+    const double *z;
+    /// Time step in seconds before each sample (dt[0] is 0)
+    const double *dt;
+    NSUInteger count;
+} FreeAccelerationColumns;
+
+/// @class FreeAccelerationBatch
+/// @discussion Computes free acceleration for a whole stored trial in one pass (`FreeAcceleration.c`), instead of one `-getCalFreeAcc:` call per packet. The column buffers are kept and reused between calls, so a batch only allocates when a trial is longer than any before it. Not thread safe, use one instance per queue.
+@interface FreeAccelerationBatch : NSObject
+
+/// The local gravity in m/s2. Defaults to 9.8127, the SDK default.
+@property (assign, nonatomic) double localGravity;
+
+/// Computes the free acceleration of a device from its stored quaternions and accelerations.
+/// @param store The recorded session.
+/// @param address The device mac address.
+/// @param block Receives the columns. The pointers must not escape the block.
+- (void)computeForStore:(SessionStore *)store address:(NSString *)address usingBlock:(void (^)(FreeAccelerationColumns columns))block;
+
+/// The largest distance in meters the device moved from its start position, by double integration of the free acceleration.
+/// Integration drift grows with time, so this is only meaningful over short movements.
+/// @param store The recorded session.
+/// @param address The device mac address.
+- (double)peakDisplacementForStore:(SessionStore *)store address:(NSString *)address;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,125 @@
+//
+//  FreeAccelerationBatch.m
+//  MDots
+//
+//  Created by Estela Alvarez on 18/10/26.
+//
+
+#import "FreeAccelerationBatch.h"
+
+/// Column indexes in the workspace
+enum
+{
+    kColumnAx = 0,
+    kColumnAy,
+    kColumnAz,
+    kColumnFx,
+    kColumnFy,
+    kColumnFz,
+    kColumnDt,
+    kColumnScratchA,
+    kColumnScratchB,
+    kDoubleColumnCount,
+};
+
+@interface FreeAccelerationBatch ()
+
+/// Capacity in samples of every column
+@property (assign, nonatomic) NSUInteger capacity;
+/// The double columns, one block of kDoubleColumnCount * capacity
+@property (strong, nonatomic) NSMutableData *doubles;
+/// The quaternion columns, one block of 4 * capacity
+@property (strong, nonatomic) NSMutableData *floats;
+
+@end
+
+@implementation FreeAccelerationBatch
+
+- (instancetype)init
+{
+    if (self = [super init])
+    {
+        _localGravity = FREE_ACCELERATION_DEFAULT_GRAVITY;
+        _doubles = [NSMutableData data];
+        _floats = [NSMutableData data];
+    }
+    return self;
+}
+
+/// Grows the workspace to hold count samples.
+- (void)reserve:(NSUInteger)count
+{
+    if (count <= self.capacity)
+    {
+        return;
+    }
+    self.doubles.length = count * kDoubleColumnCount * sizeof(double);
+    self.floats.length = count * 4 * sizeof(float);
+    self.capacity = count;
+}
+
+/// A double column of the workspace.
+- (double *)column:(NSUInteger)index
+{
+    return (double *)self.doubles.mutableBytes + index * self.capacity;
+}
+
+- (void)computeForStore:(SessionStore *)store address:(NSString *)address usingBlock:(void (^)(FreeAccelerationColumns columns))block
+{
+    [store enumerateSamplesForAddress:address usingBlock:^(const SessionSample *samples, NSUInteger count) {
+        [self reserve:count];
+        float *quats = self.floats.mutableBytes;
+        float *qw = quats, *qx = quats + self.capacity, *qy = quats + 2 * self.capacity, *qz = quats + 3 * self.capacity;
+        double *ax = [self column:kColumnAx], *ay = [self column:kColumnAy], *az = [self column:kColumnAz];
+        double *dt = [self column:kColumnDt];
+        for (NSUInteger i = 0; i < count; i++)
+        {
+            const SessionSample *sample = &samples[i];
+            qw[i] = sample->quat[0];
+            qx[i] = sample->quat[1];
+            qy[i] = sample->quat[2];
+            qz[i] = sample->quat[3];
+            ax[i] = sample->acc[0];
+            ay[i] = sample->acc[1];
+            az[i] = sample->acc[2];
+            // Timestamps are in microseconds and wrap around
+            dt[i] = i > 0 ? (UInt32)(sample->timeStamp - samples[i - 1].timeStamp) * 1e-6 : 0;
+        }
+        
+        FreeAccelerationInput input = { qw, qx, qy, qz, ax, ay, az };
+        FreeAccelerationOutput output = { [self column:kColumnFx], [self column:kColumnFy], [self column:kColumnFz] };
+        FreeAccelerationCompute(input, count, self.localGravity, output);
+        
+        FreeAccelerationColumns columns = { output.x, output.y, output.z, dt, count };
+        block(columns);
+    }];
+}
+
+- (double)peakDisplacementForStore:(SessionStore *)store address:(NSString *)address
+{
+    __block double peak = 0;
+    [self computeForStore:store address:address usingBlock:^(FreeAccelerationColumns columns) {
+        double *velocity = [self column:kColumnScratchA];
+        double *position = [self column:kColumnScratchB];
+        double *squared = [self column:kColumnAx];
+        const double *axes[3] = { columns.x, columns.y, columns.z };
+        // The raw acceleration columns are no longer needed, reuse one for the squared distance
+        memset(squared, 0, columns.count * sizeof(double));
+        for (int axis = 0; axis < 3; axis++)
+        {
+            FreeAccelerationIntegrate(axes[axis], columns.dt, columns.count, velocity);
+            FreeAccelerationIntegrate(velocity, columns.dt, columns.count, position);
+            for (NSUInteger i = 0; i < columns.count; i++)
+            {
+                squared[i] += position[i] * position[i];
+            }
+        }
+        for (NSUInteger i = 0; i < columns.count; i++)
+        {
+            peak = MAX(peak, squared[i]);
+        }
+    }];
+    return sqrt(peak);
+}
+
+@end
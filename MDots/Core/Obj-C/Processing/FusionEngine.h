@@ -0,0 +1,73 @@
+//
+//  FusionEngine.h
+//  MDots
+//
+//  Created by Estela Alvarez on 18/10/26.
+//
+
+#import <Foundation/Foundation.h>
+#import <MovellaDotSdk/DotDefine.h>
+#import "SessionStore.h"
+#import "MotionFusion.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+/// The channels the fusion engine reads from a sample
+typedef NS_ENUM(NSInteger, FusionInput)
+{
+    /// `acc` and `gyr` (HighFidelity, RateQuantities, CustomMode4 and CustomMode5 payloads)
+    FusionInputInertial = 0,
+    /// `dq` and `dv` (DeltaQuantities payloads)
+    FusionInputDeltaQuantities,
+};
+
+/// @class FusionEngine
+/// @discussion Computes the orientation on the phone from the inertial payloads instead of using the sensor's own filter, with a Madgwick or Mahony filter (`MotionFusion.c`). Fuses live samples one at a time, or re-runs over a stored session with different parameters.
+@interface FusionEngine : NSObject
+
+/// The filter algorithm. Defaults to Madgwick.
+@property (assign, nonatomic) MotionFusionType filterType;
+/// Madgwick gain. Defaults to 0.1.
+@property (assign, nonatomic) double beta;
+/// Mahony proportional gain. Defaults to 1.0.
+@property (assign, nonatomic) double kp;
+/// Mahony integral gain. Defaults to 0.
+@property (assign, nonatomic) double ki;
+/// The channels fused. Defaults to FusionInputInertial.
+@property (assign, nonatomic) FusionInput input;
+/// The output rate used when two timestamps do not give a usable time step. Defaults to 60 Hz.
+@property (assign, nonatomic) double sampleRate;
+
+/// Whether a payload mode carries the channels the engine can fuse.
+/// @param payloadMode The payload mode.
++ (BOOL)canFusePayloadMode:(XSBleDevicePayloadMode)payloadMode;
+
+/// Creates an engine reading the channels of a payload mode.
+/// @param payloadMode The streamed payload mode.
+/// @return The engine, or nil if the payload cannot be fused.
+/// ```objc
+/// FusionEngine *engine = [FusionEngine engineForPayloadMode:plan.payloadMode];
+/// ```
++ (nullable instancetype)engineForPayloadMode:(XSBleDevicePayloadMode)payloadMode;
+
+/// Fuses one live sample, replacing its `quat` and `euler` with the fused orientation.
+/// @param sample The sample, updated in place.
+/// @param address The device mac address.
+- (void)fuseSample:(SessionSample *)sample address:(NSString *)address;
+
+/// Forgets the filter state of every device, so the next sample starts from the accelerometer attitude.
+- (void)reset;
+
+/// Re-runs the fusion over a stored session. The filter restarts at every gap marked in the store.
+/// @param store The recorded session, left unchanged.
+/// @return A new store with the same samples and the fused `quat` and `euler`.
+/// ```objc
+/// FusionEngine *engine = [FusionEngine new];
+/// engine.filterType = MotionFusionMahony;
+/// SessionStore *fused = [engine reprocessStore:store];
+/// ```
+- (SessionStore *)reprocessStore:(SessionStore *)store;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,229 @@
+//
+//  FusionEngine.m
+//  MDots
+//
+//  Created by Estela Alvarez on 18/10/26.
+//
+
+#import "FusionEngine.h"
+
+/// The live filter state of one device
+typedef struct
+{
+    MotionFusionState fusion;
+    UInt32 lastTimeStamp;
+    BOOL hasLastTimeStamp;
+} FusionDeviceState;
+
+@interface FusionEngine ()
+
+/// NSMutableData of FusionDeviceState per mac address
+@property (strong, nonatomic) NSMutableDictionary<NSString *, NSMutableData *> *states;
+
+@end
+
+@implementation FusionEngine
+
+- (instancetype)init
+{
+    if (self = [super init])
+    {
+        MotionFusionParams params;
+        MotionFusionParamsDefault(&params);
+        _filterType = params.type;
+        _beta = params.beta;
+        _kp = params.kp;
+        _ki = params.ki;
+        _input = FusionInputInertial;
+        _sampleRate = 60;
+        _states = [NSMutableDictionary dictionary];
+    }
+    return self;
+}
+
++ (BOOL)canFusePayloadMode:(XSBleDevicePayloadMode)payloadMode
+{
+    switch (payloadMode)
+    {
+        case XSBleDevicePayloadInertialHighFidelityWithMag:
+        case XSBleDevicePayloadHighFidelityNoMag:
+        case XSBleDevicePayloadRateQuantitiesWithMag:
+        case XSBleDevicePayloadRateQuantitiesNoMag:
+        case XSBleDevicePayloadDeltaQuantitiesWithMag:
+        case XSBleDevicePayloadDeltaQuantitiesNoMag:
+        case XSBleDevicePayloadCustomMode4:
+        case XSBleDevicePayloadCustomMode5:
+            return YES;
+        default:
+            return NO;
+    }
+}
+
++ (instancetype)engineForPayloadMode:(XSBleDevicePayloadMode)payloadMode
+{
+    if (![self canFusePayloadMode:payloadMode])
+    {
+        return nil;
+    }
+    FusionEngine *engine = [self new];
+    if (payloadMode == XSBleDevicePayloadDeltaQuantitiesWithMag || payloadMode == XSBleDevicePayloadDeltaQuantitiesNoMag)
+    {
+        engine.input = FusionInputDeltaQuantities;
+    }
+    return engine;
+}
+
+/// The filter parameters of the current settings.
+- (MotionFusionParams)params
+{
+    MotionFusionParams params;
+    params.type = self.filterType;
+    params.beta = self.beta;
+    params.kp = self.kp;
+    params.ki = self.ki;
+    return params;
+}
+
+/// The time step between two sample timestamps (microseconds, wrapping), or one output period if unusable.
+- (double)timeStepFrom:(UInt32)previous to:(UInt32)current
+{
+    double dt = (UInt32)(current - previous) * 1e-6;
+    if (dt <= 0 || dt > 1.0)
+    {
+        dt = 1.0 / self.sampleRate;
+    }
+    return dt;
+}
+
+/// Fills the gyroscope (rad/s) and acceleration inputs of a sample.
+- (void)inputsOfSample:(const SessionSample *)sample dt:(double)dt gyr:(double *)gyr acc:(double *)acc
+{
+    if (self.input == FusionInputDeltaQuantities)
+    {
+        MotionFusionFromDeltas(sample->dq, sample->dv, dt, gyr, acc);
+        return;
+    }
+    // The store keeps `gyr` in deg/s, the filter works in rad/s
+    double scale = M_PI / 180.0;
+    for (int i = 0; i < 3; i++)
+    {
+        gyr[i] = sample->gyr[i] * scale;
+        acc[i] = sample->acc[i];
+    }
+}
+
+/// Writes a fused quaternion and its euler angles into a sample.
+static void WriteOrientation(SessionSample *sample, const double q[4])
+{
+    for (int i = 0; i < 4; i++)
+    {
+        sample->quat[i] = q[i];
+    }
+    MotionFusionQuaternionToEuler(q, sample->euler);
+}
+
+#pragma mark - Live
+
+- (void)fuseSample:(SessionSample *)sample address:(NSString *)address
+{
+    MotionFusionParams params = [self params];
+    @synchronized (self.states)
+    {
+        NSMutableData *data = self.states[address];
+        if (data == nil)
+        {
+            data = [NSMutableData dataWithLength:sizeof(FusionDeviceState)];
+            FusionDeviceState *state = data.mutableBytes;
+            MotionFusionStateReset(&state->fusion);
+            self.states[address] = data;
+        }
+        FusionDeviceState *state = data.mutableBytes;
+        double dt = state->hasLastTimeStamp ? [self timeStepFrom:state->lastTimeStamp to:sample->timeStamp] : 1.0 / self.sampleRate;
+        double gyr[3], acc[3];
+        [self inputsOfSample:sample dt:dt gyr:gyr acc:acc];
+        MotionFusionUpdate(&params, &state->fusion, gyr, acc, dt);
+        state->lastTimeStamp = sample->timeStamp;
+        state->hasLastTimeStamp = YES;
+        WriteOrientation(sample, state->fusion.q);
+    }
+}
+
+- (void)reset
+{
+    @synchronized (self.states)
+    {
+        [self.states removeAllObjects];
+    }
+}
+
+#pragma mark - Reprocessing
+
+- (SessionStore *)reprocessStore:(SessionStore *)store
+{
+    SessionStore *fused = [[SessionStore alloc] initWithAddresses:store.addresses];
+    MotionFusionParams params = [self params];
+    
+    for (NSString *address in store.addresses)
+    {
+        __block NSMutableData *copy = nil;
+        [store enumerateSamplesForAddress:address usingBlock:^(const SessionSample *samples, NSUInteger count) {
+            copy = [NSMutableData dataWithBytes:samples length:count * sizeof(SessionSample)];
+        }];
+        NSUInteger count = copy.length / sizeof(SessionSample);
+        if (count == 0)
+        {
+            continue;
+        }
+        SessionSample *samples = copy.mutableBytes;
+        NSIndexSet *gaps = [store gapIndexesForAddress:address];
+        
+        // Input columns for one block run of the filter
+        double *gyr = malloc(count * 3 * sizeof(double));
+        double *acc = malloc(count * 3 * sizeof(double));
+        double *dt = malloc(count * sizeof(double));
+        double *quat = malloc(count * 4 * sizeof(double));
+        if (!gyr || !acc || !dt || !quat)
+        {
+            NSLog(@"Fusion of %@ skipped, out of memory", address);
+            free(gyr);
+            free(acc);
+            free(dt);
+            free(quat);
+            continue;
+        }
+        for (NSUInteger i = 0; i < count; i++)
+        {
+            dt[i] = i > 0 ? [self timeStepFrom:samples[i - 1].timeStamp to:samples[i].timeStamp] : 1.0 / self.sampleRate;
+            [self inputsOfSample:&samples[i] dt:dt[i] gyr:&gyr[i * 3] acc:&acc[i * 3]];
+        }
+        
+        // One block per contiguous stream, the filter restarts after every gap
+        NSUInteger start = 0;
+        while (start < count)
+        {
+            NSUInteger end = [gaps indexGreaterThanIndex:start];
+            end = MIN(end, count);
+            MotionFusionState state;
+            MotionFusionStateReset(&state);
+            MotionFusionUpdateBlock(&params, &state, 1, end - start, &gyr[start * 3], &acc[start * 3], &dt[start], 0, &quat[start * 4]);
+            start = end;
+        }
+        
+        for (NSUInteger i = 0; i < count; i++)
+        {
+            if ([gaps containsIndex:i])
+            {
+                [fused markGapForAddress:address];
+            }
+            WriteOrientation(&samples[i], &quat[i * 4]);
+            [fused appendSample:samples[i] forAddress:address];
+        }
+        free(gyr);
+        free(acc);
+        free(dt);
+        free(quat);
+    }
+    return fused;
+}
+
+@end
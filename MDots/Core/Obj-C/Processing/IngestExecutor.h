@@ -0,0 +1,63 @@
+//
+//  IngestExecutor.h
+//  MDots
+//
+//  Created by Estela Alvarez on 18/10/26.
+//
+
+#import <Foundation/Foundation.h>
+#import <MovellaDotSdk/DotDevice.h>
+#import "PacketLossMonitor.h"
+#import "FusionEngine.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+/// Receives the newest sample of a device on the main queue.
+typedef void (^IngestDisplayBlock)(NSString *address, SessionSample sample);
+
+/// Receives every ingested sample of a device on its ingest queue.
+typedef void (^IngestSampleBlock)(NSString *address, const SessionSample *sample);
+
+/// @class IngestExecutor
+/// @discussion Moves streamed samples off the SDK callback thread: each device has its own serial queue feeding the `PacketLossMonitor` (and through it the `SessionStore`), so devices are processed in parallel and in order. Samples reach the queue through a ring preallocated per device, so a packet costs a copy and no allocation; the SDK must deliver the packets of a device on one thread at a time. The UI is handed the newest sample of each device once per display frame, from a CADisplayLink, instead of once per packet; the main thread never waits for ingest and ingest never touches main-thread state.
+@interface IngestExecutor : NSObject
+
+/// The monitor the samples are ingested into.
+@property (strong, nonatomic, readonly) PacketLossMonitor *monitor;
+
+/// Called on the main queue, at most once per frame per device, with the newest sample.
+@property (copy, nonatomic, nullable) IngestDisplayBlock displayBlock;
+
+/// Called on the ingest queue of a device after each of its samples is stored, e.g. to run a streaming analysis without blocking the SDK thread. Read when a device is first attached.
+@property (copy, nonatomic, nullable) IngestSampleBlock sampleBlock;
+
+/// Fuses the orientation of every sample on its ingest queue, before it is stored, when the payload carries no orientation. Read when a device is first attached.
+@property (strong, nonatomic, nullable) FusionEngine *fusionEngine;
+
+/// The UI refresh rate. Defaults to 30.
+@property (assign, nonatomic) NSInteger preferredFramesPerSecond;
+
+/// Creates an executor ingesting into a monitor.
+/// @param monitor The packet loss monitor of the trial.
+/// ```objc
+/// IngestExecutor *executor = [[IngestExecutor alloc] initWithMonitor:monitor];
+/// ```
+- (instancetype)initWithMonitor:(PacketLossMonitor *)monitor;
+
+/// Registers the plot data block of a device. Registering the same device again (e.g. after a reconnect) keeps its queue.
+/// @param device The streaming device.
+- (void)attachDevice:(DotDevice *)device;
+
+/// Starts handing samples to `displayBlock`.
+- (void)startDisplay;
+
+/// Waits, off the main thread, for every sample already received to be ingested, then calls the completion on the main queue.
+/// @param completion Called once the store holds every received sample.
+- (void)drainWithCompletion:(dispatch_block_t)completion;
+
+/// Unregisters the plot data blocks and stops the display updates. Must be called to release the executor.
+- (void)invalidate;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,256 @@
+//
+//  IngestExecutor.m
+//  MDots
+//
+//  Created by Estela Alvarez on 18/10/26.
+//
+
+#import "IngestExecutor.h"
+#import "Tracer.h"
+#import "MetricsRegistry.h"
+#import "IngestRing.h"
+#import <QuartzCore/QuartzCore.h>
+#import <os/lock.h>
+
+/// Samples a lane buffers between the SDK thread and its queue, a power of two: 17 s at 60 Hz
+static const uint32_t kLaneCapacity = 1024;
+
+/// One buffered sample with its arrival time
+typedef struct
+{
+    SessionSample sample;
+    uint64_t received;
+} IngestSlot;
+
+/// The ingest lane of one device.
+/// The SDK callback thread is the only producer of its ring (`IngestRing.c`) and the lane queue the only consumer, so neither side
+/// takes a lock or allocates per sample: the producer copies into the next slot and pokes a data source, which coalesces the pokes
+/// into one drain on the queue. `Benchmarks/IngestRingBench.c` stress tests that handoff.
+@interface IngestLane : NSObject
+{
+    @public
+    os_unfair_lock _lock;
+    /// Guarded by _lock, written by the lane queue
+    SessionSample _latest;
+    uint64_t _latestReceived;
+    uint64_t _sequence;
+    /// kLaneCapacity IngestSlot allocated once
+    IngestRing _ring;
+}
+
+@property (strong, nonatomic) NSString *address;
+@property (strong, nonatomic) dispatch_queue_t queue;
+/// Drains the ring on the queue when the producer merges data into it
+@property (strong, nonatomic) dispatch_source_t source;
+@property (weak, nonatomic) DotDevice *device;
+/// The sequence last handed to the UI, main queue only
+@property (assign, nonatomic) uint64_t displayedSequence;
+@property (strong, nonatomic) MetricCounter *samples;
+/// Samples dropped because the ring was full
+@property (strong, nonatomic) MetricCounter *overflows;
+@property (strong, nonatomic) PacketLossMonitor *monitor;
+@property (copy, nonatomic, nullable) IngestSampleBlock sampleBlock;
+@property (strong, nonatomic, nullable) FusionEngine *fusionEngine;
+
+@end
+
+@implementation IngestLane
+
+- (instancetype)init
+{
+    if (self = [super init])
+    {
+        _lock = OS_UNFAIR_LOCK_INIT;
+        if (!IngestRingInit(&_ring, sizeof(IngestSlot), kLaneCapacity))
+        {
+            return nil;
+        }
+    }
+    return self;
+}
+
+- (void)dealloc
+{
+    IngestRingDestroy(&_ring);
+}
+
+/// Copies a sample into the ring. SDK callback thread only.
+/// @return NO if the ring is full and the sample was dropped.
+- (BOOL)pushSample:(const SessionSample *)sample received:(uint64_t)received
+{
+    IngestSlot slot = { *sample, received };
+    return IngestRingPush(&_ring, &slot) != 0;
+}
+
+/// Ingests every sample in the ring. Lane queue only.
+- (void)drain
+{
+    uint32_t tail;
+    uint32_t head = IngestRingBeginRead(&_ring, &tail);
+    if (tail == head)
+    {
+        return;
+    }
+    TRACE_SCOPE("ingest");
+    NSString *address = self.address;
+    IngestSampleBlock sampleBlock = self.sampleBlock;
+    FusionEngine *fusionEngine = self.fusionEngine;
+    IngestSlot *slot = NULL;
+    for (; tail != head; tail++)
+    {
+        slot = IngestRingSlot(&_ring, tail);
+        [self.samples increment];
+        if (fusionEngine)
+        {
+            [fusionEngine fuseSample:&slot->sample address:address];
+        }
+        [self.monitor ingestSample:slot->sample address:address];
+        if (sampleBlock)
+        {
+            sampleBlock(address, &slot->sample);
+        }
+    }
+    os_unfair_lock_lock(&_lock);
+    _latest = slot->sample;
+    _latestReceived = slot->received;
+    _sequence += 1;
+    os_unfair_lock_unlock(&_lock);
+    // The slots are free once the UI copy is taken
+    IngestRingEndRead(&_ring, tail);
+}
+
+@end
+
+@interface IngestExecutor ()
+
+@property (strong, nonatomic) PacketLossMonitor *monitor;
+/// Lanes per mac address, only changed on the main queue
+@property (strong, nonatomic) NSMutableDictionary<NSString *, IngestLane *> *lanes;
+@property (strong, nonatomic, nullable) CADisplayLink *displayLink;
+@property (strong, nonatomic) MetricHistogram *displayLatency;
+
+@end
+
+@implementation IngestExecutor
+
+- (instancetype)initWithMonitor:(PacketLossMonitor *)monitor
+{
+    if (self = [super init])
+    {
+        _monitor = monitor;
+        _lanes = [NSMutableDictionary dictionary];
+        _preferredFramesPerSecond = 30;
+        _displayLatency = [[MetricsRegistry sharedRegistry] histogramNamed:@"latency.callbackToDisplay"];
+    }
+    return self;
+}
+
+- (void)attachDevice:(DotDevice *)device
+{
+    NSString *address = device.macAddress;
+    IngestLane *lane = self.lanes[address];
+    if (lane == nil)
+    {
+        lane = [IngestLane new];
+        if (lane == nil)
+        {
+            NSLog(@"Ingest lane of %@ out of memory", address);
+            return;
+        }
+        lane.address = address;
+        lane.monitor = self.monitor;
+        lane.sampleBlock = self.sampleBlock;
+        lane.fusionEngine = self.fusionEngine;
+        NSString *label = [NSString stringWithFormat:@"MDots.ingest.%@", address];
+        dispatch_queue_attr_t attributes = dispatch_queue_attr_make_with_qos_class(DISPATCH_QUEUE_SERIAL, QOS_CLASS_USER_INITIATED, 0);
+        lane.queue = dispatch_queue_create(label.UTF8String, attributes);
+        lane.samples = [[MetricsRegistry sharedRegistry] counterNamed:[NSString stringWithFormat:@"samples.%@", address]];
+        lane.overflows = [[MetricsRegistry sharedRegistry] counterNamed:[NSString stringWithFormat:@"samples.overflow.%@", address]];
+        // The source keeps the lane until `invalidate` cancels it
+        lane.source = dispatch_source_create(DISPATCH_SOURCE_TYPE_DATA_ADD, 0, 0, lane.queue);
+        dispatch_source_set_event_handler(lane.source, ^{
+            [lane drain];
+        });
+        dispatch_resume(lane.source);
+        self.lanes[address] = lane;
+    }
+    lane.device = device;
+    
+    // The block keeps the lane, not the executor
+    [device setDidParsePlotDataBlock:^(DotPlotData * _Nonnull plotData) {
+        TRACE_SCOPE("plotData");
+        uint64_t received = MetricsTimestamp();
+        // Copy out of the SDK object right away, so nothing SDK owned crosses threads
+        SessionSample sample = SessionSampleMake(plotData);
+        if (![lane pushSample:&sample received:received])
+        {
+            // The monitor sees the missing counters as a gap
+            [lane.overflows increment];
+            return;
+        }
+        dispatch_source_merge_data(lane.source, 1);
+    }];
+}
+
+- (void)startDisplay
+{
+    if (self.displayLink)
+    {
+        return;
+    }
+    self.displayLink = [CADisplayLink displayLinkWithTarget:self selector:@selector(onDisplayLink:)];
+    self.displayLink.preferredFramesPerSecond = self.preferredFramesPerSecond;
+    [self.displayLink addToRunLoop:[NSRunLoop mainRunLoop] forMode:NSRunLoopCommonModes];
+}
+
+/// Hands the newest sample of every device that changed since the last frame to the UI.
+/// @param displayLink The display link.
+- (void)onDisplayLink:(CADisplayLink *)displayLink
+{
+    TRACE_SCOPE("displayFrame");
+    IngestDisplayBlock displayBlock = self.displayBlock;
+    for (IngestLane *lane in self.lanes.allValues)
+    {
+        os_unfair_lock_lock(&lane->_lock);
+        uint64_t sequence = lane->_sequence;
+        SessionSample sample = lane->_latest;
+        uint64_t received = lane->_latestReceived;
+        os_unfair_lock_unlock(&lane->_lock);
+        if (sequence == lane.displayedSequence)
+        {
+            continue;
+        }
+        lane.displayedSequence = sequence;
+        if (displayBlock)
+        {
+            displayBlock(lane.address, sample);
+        }
+        [self.displayLatency recordValue:MetricsTimestamp() - received];
+    }
+}
+
+- (void)drainWithCompletion:(dispatch_block_t)completion
+{
+    dispatch_group_t group = dispatch_group_create();
+    for (IngestLane *lane in self.lanes.allValues)
+    {
+        // Runs after any drain already scheduled, and takes what is left in the ring
+        dispatch_group_async(group, lane.queue, ^{
+            [lane drain];
+        });
+    }
+    dispatch_group_notify(group, dispatch_get_main_queue(), completion);
+}
+
+- (void)invalidate
+{
+    [self.displayLink invalidate];
+    self.displayLink = nil;
+    for (IngestLane *lane in self.lanes.allValues)
+    {
+        [lane.device setDidParsePlotDataBlock:nil];
+        dispatch_source_cancel(lane.source);
+    }
+}
+
+@end
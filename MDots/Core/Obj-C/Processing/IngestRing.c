@@ -0,0 +1,64 @@
+//
+//  IngestRing.c
+//  MDots
+//
+//  Created by Estela Alvarez on 18/10/26.
+//
+
+#include "IngestRing.h"
+#include <stdlib.h>
+#include <string.h>
+
+int IngestRingInit(IngestRing *ring, size_t slotSize, uint32_t capacity)
+{
+    if (capacity == 0 || (capacity & (capacity - 1)) != 0)
+    {
+        return 0;
+    }
+    ring->slots = calloc(capacity, slotSize);
+    if (ring->slots == NULL)
+    {
+        return 0;
+    }
+    ring->slotSize = slotSize;
+    ring->capacity = capacity;
+    atomic_init(&ring->head, 0);
+    atomic_init(&ring->tail, 0);
+    return 1;
+}
+
+void IngestRingDestroy(IngestRing *ring)
+{
+    free(ring->slots);
+    ring->slots = NULL;
+}
+
+int IngestRingPush(IngestRing *ring, const void *item)
+{
+    uint32_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+    // Positions wrap around, the difference stays right
+    if (head - tail == ring->capacity)
+    {
+        return 0;
+    }
+    memcpy(IngestRingSlot(ring, head), item, ring->slotSize);
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+    return 1;
+}
+
+uint32_t IngestRingBeginRead(IngestRing *ring, uint32_t *tail)
+{
+    *tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    return atomic_load_explicit(&ring->head, memory_order_acquire);
+}
+
+void *IngestRingSlot(const IngestRing *ring, uint32_t position)
+{
+    return ring->slots + (size_t)(position & (ring->capacity - 1)) * ring->slotSize;
+}
+
+void IngestRingEndRead(IngestRing *ring, uint32_t tail)
+{
+    atomic_store_explicit(&ring->tail, tail, memory_order_release);
+}
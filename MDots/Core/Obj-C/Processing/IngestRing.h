@@ -0,0 +1,63 @@
+//
+//  IngestRing.h
+//  MDots
+//
+//  Created by Estela Alvarez on 18/10/26.
+//
+
+#ifndef IngestRing_h
+#define IngestRing_h
+
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// Portable C11 single producer, single consumer ring of fixed size slots. The slots are allocated once;
+/// neither side takes a lock or allocates per item. The producer copies into the next free slot, the consumer
+/// reads the slots in place and releases them in one step once it is done with them.
+
+/// The ring
+typedef struct
+{
+    unsigned char *slots;
+    size_t slotSize;
+    /// A power of two
+    uint32_t capacity;
+    /// Next slot written, only advanced by the producer
+    _Atomic uint32_t head;
+    /// Next slot read, only advanced by the consumer
+    _Atomic uint32_t tail;
+} IngestRing;
+
+/// Allocates the slots of a ring.
+/// @param capacity The slot count, a power of two.
+/// @return 0 if the capacity is not a power of two or out of memory.
+int IngestRingInit(IngestRing *ring, size_t slotSize, uint32_t capacity);
+
+/// Frees the slots.
+void IngestRingDestroy(IngestRing *ring);
+
+/// Copies an item into the next free slot. Producer only.
+/// @return 0 if the ring is full and the item was dropped.
+int IngestRingPush(IngestRing *ring, const void *item);
+
+/// The items ready to read are the slots from *tail up to the returned head, excluded. Consumer only.
+/// @param tail The first slot to read out.
+/// @return The head, equal to *tail if the ring is empty.
+uint32_t IngestRingBeginRead(IngestRing *ring, uint32_t *tail);
+
+/// The slot of a position between the tail and the head of a read.
+void *IngestRingSlot(const IngestRing *ring, uint32_t position);
+
+/// Gives the slots before tail back to the producer. Consumer only.
+void IngestRingEndRead(IngestRing *ring, uint32_t tail);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* IngestRing_h */
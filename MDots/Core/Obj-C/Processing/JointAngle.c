@@ -0,0 +1,184 @@
+//
+//  JointAngle.c
+//  MDots
+//
+//  Created by Estela Alvarez on 18/10/26.
+//
+
+#include "JointAngle.h"
+#include <math.h>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+/// Axes of each sequence, indexed by JointAngleSequence
+static const int kSequenceAxes[6][3] = {
+    {0, 1, 2}, {0, 2, 1}, {1, 0, 2}, {1, 2, 0}, {2, 0, 1}, {2, 1, 0},
+};
+
+static void Normalize4(double q[4])
+{
+    double norm = sqrt(q[0] * q[0] + q[1] * q[1] + q[2] * q[2] + q[3] * q[3]);
+    if (norm > 0.0)
+    {
+        double inv = 1.0 / norm;
+        q[0] *= inv;
+        q[1] *= inv;
+        q[2] *= inv;
+        q[3] *= inv;
+    }
+}
+
+/// out = a * b, out may not alias a or b.
+static void Multiply(const double a[4], const double b[4], double out[4])
+{
+    out[0] = a[0] * b[0] - a[1] * b[1] - a[2] * b[2] - a[3] * b[3];
+    out[1] = a[0] * b[1] + a[1] * b[0] + a[2] * b[3] - a[3] * b[2];
+    out[2] = a[0] * b[2] - a[1] * b[3] + a[2] * b[0] + a[3] * b[1];
+    out[3] = a[0] * b[3] + a[1] * b[2] - a[2] * b[1] + a[3] * b[0];
+}
+
+void JointAngleStateInit(JointAngleState *state, JointAngleSequence sequence)
+{
+    state->sequence = sequence;
+    state->offset[0] = 1.0;
+    state->offset[1] = state->offset[2] = state->offset[3] = 0.0;
+    state->calibrationSum[0] = state->calibrationSum[1] = state->calibrationSum[2] = state->calibrationSum[3] = 0.0;
+    state->calibrationCount = 0;
+}
+
+void JointAngleQuaternionFromEuler(const double euler[3], double q[4])
+{
+    double toHalfRadians = M_PI / 360.0;
+    double cr = cos(euler[0] * toHalfRadians), sr = sin(euler[0] * toHalfRadians);
+    double cp = cos(euler[1] * toHalfRadians), sp = sin(euler[1] * toHalfRadians);
+    double cy = cos(euler[2] * toHalfRadians), sy = sin(euler[2] * toHalfRadians);
+    q[0] = cr * cp * cy + sr * sp * sy;
+    q[1] = sr * cp * cy - cr * sp * sy;
+    q[2] = cr * sp * cy + sr * cp * sy;
+    q[3] = cr * cp * sy - sr * sp * cy;
+}
+
+void JointAngleVerticalInSensor(const double q[4], double v[3])
+{
+    double w = q[0], x = q[1], y = q[2], z = q[3];
+    // The last row of the sensor to world rotation
+    v[0] = 2.0 * (x * z - w * y);
+    v[1] = 2.0 * (y * z + w * x);
+    v[2] = 1.0 - 2.0 * (x * x + y * y);
+}
+
+double JointAngleTilt(const double neutral[3], const double v[3], int axis)
+{
+    double cross[3] = {
+        neutral[1] * v[2] - neutral[2] * v[1],
+        neutral[2] * v[0] - neutral[0] * v[2],
+        neutral[0] * v[1] - neutral[1] * v[0],
+    };
+    double dot = neutral[0] * v[0] + neutral[1] * v[1] + neutral[2] * v[2];
+    double angle = atan2(sqrt(cross[0] * cross[0] + cross[1] * cross[1] + cross[2] * cross[2]), dot) * 180.0 / M_PI;
+    // The vertical turns the opposite way to the sensor in the sensor axes
+    return cross[axis] > 0.0 ? -angle : angle;
+}
+
+void JointAngleRelative(const double prox[4], const double dist[4], double rel[4])
+{
+    double conj[4] = { prox[0], -prox[1], -prox[2], -prox[3] };
+    Multiply(conj, dist, rel);
+}
+
+void JointAngleAddCalibrationFrame(JointAngleState *state, const double prox[4], const double dist[4])
+{
+    double rel[4];
+    JointAngleRelative(prox, dist, rel);
+    // q and -q are the same rotation, keep every frame in the hemisphere of the first one so the mean does not cancel out
+    if (state->calibrationCount > 0)
+    {
+        double dot = rel[0] * state->calibrationSum[0] + rel[1] * state->calibrationSum[1]
+                   + rel[2] * state->calibrationSum[2] + rel[3] * state->calibrationSum[3];
+        if (dot < 0.0)
+        {
+            rel[0] = -rel[0];
+            rel[1] = -rel[1];
+            rel[2] = -rel[2];
+            rel[3] = -rel[3];
+        }
+    }
+    for (int i = 0; i < 4; i++)
+    {
+        state->calibrationSum[i] += rel[i];
+    }
+    state->calibrationCount++;
+}
+
+int JointAngleFinishCalibration(JointAngleState *state)
+{
+    if (state->calibrationCount == 0)
+    {
+        return 0;
+    }
+    // Normalized sum of nearby quaternions, close to the true mean for the small spread of a static pose
+    for (int i = 0; i < 4; i++)
+    {
+        state->offset[i] = state->calibrationSum[i];
+        state->calibrationSum[i] = 0.0;
+    }
+    Normalize4(state->offset);
+    state->calibrationCount = 0;
+    return 1;
+}
+
+void JointAngleDecompose(const double q[4], JointAngleSequence sequence, double angles[3])
+{
+    double w = q[0], x = q[1], y = q[2], z = q[3];
+    double r[3][3] = {
+        { 1.0 - 2.0 * (y * y + z * z), 2.0 * (x * y - w * z), 2.0 * (x * z + w * y) },
+        { 2.0 * (x * y + w * z), 1.0 - 2.0 * (x * x + z * z), 2.0 * (y * z - w * x) },
+        { 2.0 * (x * z - w * y), 2.0 * (y * z + w * x), 1.0 - 2.0 * (x * x + y * y) },
+    };
+    int i = kSequenceAxes[sequence][0];
+    int j = kSequenceAxes[sequence][1];
+    int k = kSequenceAxes[sequence][2];
+    // +1 for the cyclic sequences (XYZ, YZX, ZXY), -1 for the others
+    double parity = ((j - i + 3) % 3 == 1) ? 1.0 : -1.0;
+    double s = parity * r[i][k];
+    if (s > 1.0)
+    {
+        s = 1.0;
+    }
+    else if (s < -1.0)
+    {
+        s = -1.0;
+    }
+    double toDegrees = 180.0 / M_PI;
+    angles[1] = asin(s) * toDegrees;
+    if (fabs(s) > 1.0 - 1e-12)
+    {
+        angles[0] = atan2(parity * r[k][j], r[j][j]) * toDegrees;
+        angles[2] = 0.0;
+    }
+    else
+    {
+        angles[0] = atan2(-parity * r[j][k], r[k][k]) * toDegrees;
+        angles[2] = atan2(-parity * r[i][j], r[i][i]) * toDegrees;
+    }
+}
+
+void JointAngleUpdate(const JointAngleState *state, const double prox[4], const double dist[4], double angles[3])
+{
+    double rel[4];
+    double joint[4];
+    JointAngleRelative(prox, dist, rel);
+    double inverseOffset[4] = { state->offset[0], -state->offset[1], -state->offset[2], -state->offset[3] };
+    Multiply(rel, inverseOffset, joint);
+    JointAngleDecompose(joint, state->sequence, angles);
+}
+
+void JointAngleUpdateBlock(const JointAngleState *state, const double *prox, const double *dist, size_t count, double *angles)
+{
+    for (size_t n = 0; n < count; n++)
+    {
+        JointAngleUpdate(state, prox + n * 4, dist + n * 4, angles + n * 3);
+    }
+}
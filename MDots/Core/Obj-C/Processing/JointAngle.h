@@ -0,0 +1,93 @@
+//
+//  JointAngle.h
+//  MDots
+//
+//  Created by Estela Alvarez on 18/10/26.
+//
+
+#ifndef JointAngle_h
+#define JointAngle_h
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// Portable C99 joint angles from the orientations of the sensors on the two segments of a joint.
+/// Quaternions are (w, x, y, z), angles in degrees. The joint rotation is the relative orientation
+/// q_prox^-1 * q_dist with the one of the calibration pose removed, expressed in the proximal sensor axes,
+/// so it does not depend on the heading of the subject nor on how the sensors sit on the segments.
+
+/// The intrinsic rotation sequence of the decomposition, e.g. XYZ: about x, then the new y, then the new z
+typedef enum
+{
+    JointAngleSequenceXYZ = 0,
+    JointAngleSequenceXZY,
+    JointAngleSequenceYXZ,
+    JointAngleSequenceYZX,
+    JointAngleSequenceZXY,
+    JointAngleSequenceZYX,
+} JointAngleSequence;
+
+/// The state of one joint
+typedef struct
+{
+    JointAngleSequence sequence;
+    /// The relative orientation of the calibration pose
+    double offset[4];
+    /// Sum of the relative orientations of the calibration frames
+    double calibrationSum[4];
+    size_t calibrationCount;
+} JointAngleState;
+
+/// Resets a joint, the offset is the identity until a calibration finishes.
+void JointAngleStateInit(JointAngleState *state, JointAngleSequence sequence);
+
+/// Converts euler angles in degrees (roll, pitch, yaw), the convention of DotPlotData euler0-2, to a quaternion.
+void JointAngleQuaternionFromEuler(const double euler[3], double q[4]);
+
+/// The vertical (world z) in the axes of a sensor of orientation q.
+void JointAngleVerticalInSensor(const double q[4], double v[3]);
+
+/// How far a sensor tilted from a neutral pose, from its vertical in that pose and now: the angle between the two,
+/// positive when the sensor turned the positive way about its own axis `axis` (0 x, 1 y, 2 z). Depends only on gravity, not on the heading.
+/// @param neutral The vertical in the neutral pose (3).
+/// @param v The vertical now (3).
+/// @param axis The sensor axis of the sign.
+double JointAngleTilt(const double neutral[3], const double v[3], int axis);
+
+/// The relative orientation q_prox^-1 * q_dist.
+void JointAngleRelative(const double prox[4], const double dist[4], double rel[4]);
+
+/// Adds one frame of the static calibration pose.
+void JointAngleAddCalibrationFrame(JointAngleState *state, const double prox[4], const double dist[4]);
+
+/// Takes the mean relative orientation of the calibration frames as the neutral pose.
+/// @return 0 if no frame was added, the offset is then unchanged.
+int JointAngleFinishCalibration(JointAngleState *state);
+
+/// Decomposes a rotation into the three angles of a sequence. The middle angle is within [-90, 90];
+/// at gimbal lock (middle angle at +-90) the third angle is set to 0.
+void JointAngleDecompose(const double q[4], JointAngleSequence sequence, double angles[3]);
+
+/// The joint angles of one frame.
+/// @param state The calibrated joint.
+/// @param prox The proximal sensor orientation (4).
+/// @param dist The distal sensor orientation (4).
+/// @param angles The angles out (3), in the order of the sequence.
+void JointAngleUpdate(const JointAngleState *state, const double prox[4], const double dist[4], double angles[3]);
+
+/// The joint angles of a block of frames.
+/// @param state The calibrated joint.
+/// @param prox The proximal orientations (count * 4).
+/// @param dist The distal orientations (count * 4).
+/// @param count The number of frames.
+/// @param angles The angles out (count * 3).
+void JointAngleUpdateBlock(const JointAngleState *state, const double *prox, const double *dist, size_t count, double *angles);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* JointAngle_h */
@@ -0,0 +1,99 @@
+//
+//  JointAngleEngine.h
+//  MDots
+//
+//  Created by Estela Alvarez on 18/10/26.
+//
+
+#import <Foundation/Foundation.h>
+#import "SessionStore.h"
+#import "JointAngle.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+/// The joint angles of a stored trial, valid only inside the block they are passed to
+typedef struct
+{
+    /// The angles of each frame (count * 3), in the order of the sequence
+    const double *angles;
+    /// The distal sensor timestamp of each frame (count)
+    const UInt32 *timeStamps;
+    NSUInteger count;
+} JointAngleColumns;
+
+/// @class JointAngleEngine
+/// @discussion Computes the angles of a joint from the orientations of the sensors on its proximal and distal segments (`JointAngle.c`), instead of combining the euler angles of each sensor. The neutral pose is taken from a short static calibration, so the result depends neither on the heading of the subject nor on how the sensors were strapped. Runs per frame or over a stored trial.
+/// A rotation that turns both segments together, e.g. hip rotation with the knee held still, leaves the joint unchanged; the tilt of one sensor from its neutral pose measures those instead. Not thread safe, use one instance per queue.
+@interface JointAngleEngine : NSObject
+
+/// The decomposition sequence. Defaults to XYZ, so the first angle is the rotation about the proximal sensor x axis.
+@property (assign, nonatomic) JointAngleSequence sequence;
+
+/// The length of the static calibration at the start of a stored trial, in seconds. Defaults to 0.5.
+@property (assign, nonatomic) NSTimeInterval calibrationDuration;
+
+/// The largest rotation of the joint, or tilt of the sensor, in degrees, allowed while the calibration pose is held. Defaults to 5.
+@property (assign, nonatomic) double calibrationTolerance;
+
+/// The largest rotation of the joint, or tilt of the sensor, in degrees, during the last calibration from a store.
+@property (assign, nonatomic, readonly) double calibrationSpread;
+
+/// Whether a calibration finished since the last reset. Without one the neutral pose is the sensors' own alignment.
+@property (assign, nonatomic, readonly) BOOL calibrated;
+
+/// The orientation of a sample: its quaternion if the payload has one, otherwise built from its euler angles.
+/// @param q The quaternion out (w, x, y, z).
+/// @param sample The sample.
++ (void)getOrientation:(double *)q ofSample:(const SessionSample *)sample;
+
+/// Clears the calibration.
+- (void)reset;
+
+/// Adds one frame of the static calibration pose.
+/// @param proximal The proximal sensor sample.
+/// @param distal The distal sensor sample taken at the same time.
+- (void)addCalibrationProximal:(SessionSample)proximal distal:(SessionSample)distal;
+
+/// Takes the mean of the calibration frames as the neutral pose.
+/// @return NO if no frame was added.
+- (BOOL)finishCalibration;
+
+/// The joint angles of one frame.
+/// @param angles The angles out (3), in degrees.
+/// @param proximal The proximal sensor sample.
+/// @param distal The distal sensor sample taken at the same time.
+/// ```objc
+/// double angles[3];
+/// [engine getAngles:angles proximal:thigh distal:shank];
+/// ```
+- (void)getAngles:(double *)angles proximal:(SessionSample)proximal distal:(SessionSample)distal;
+
+/// Calibrates from the first `calibrationDuration` of a stored trial, during which the joint must be held in the neutral pose.
+/// The calibration is rejected if the joint rotated by more than `calibrationTolerance` during it, since a moving pose is no neutral pose.
+/// @param store The recorded session.
+/// @param proximal The proximal sensor mac address.
+/// @param distal The distal sensor mac address.
+/// @return NO if the sensors have no common frames or the joint was not held still.
+- (BOOL)calibrateFromStore:(SessionStore *)store proximal:(NSString *)proximal distal:(NSString *)distal;
+
+/// Calibrates the tilt of one sensor from the first `calibrationDuration` of a stored trial, during which the segment must be held in the neutral pose.
+/// The calibration is rejected if the sensor tilted by more than `calibrationTolerance` during it.
+/// @param store The recorded session.
+/// @param address The sensor mac address.
+/// @return NO if the sensor has no sample or was not held still.
+- (BOOL)calibrateTiltFromStore:(SessionStore *)store address:(NSString *)address;
+
+/// How far a sensor tilted from the neutral pose of `calibrateTiltFromStore:address:`, in degrees, positive when it turned the positive way about its x axis.
+/// @param sample The sensor sample.
+- (double)tiltOfSample:(SessionSample)sample;
+
+/// Computes the joint angles of every distal sample of a stored trial, paired with the last proximal sample taken at or before it.
+/// @param store The recorded session.
+/// @param proximal The proximal sensor mac address.
+/// @param distal The distal sensor mac address.
+/// @param block Receives the columns. The pointers must not escape the block.
+- (void)computeForStore:(SessionStore *)store proximal:(NSString *)proximal distal:(NSString *)distal usingBlock:(void (^)(JointAngleColumns columns))block;
+
+@end
+
+NS_ASSUME_NONNULL_END
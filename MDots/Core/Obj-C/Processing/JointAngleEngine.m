@@ -0,0 +1,237 @@
+//
+//  JointAngleEngine.m
+//  MDots
+//
+//  Created by Estela Alvarez on 18/10/26.
+//
+
+#import "JointAngleEngine.h"
+
+@interface JointAngleEngine ()
+{
+    JointAngleState _state;
+    /// The vertical in the sensor axes in the neutral pose of the tilt
+    double _neutralVertical[3];
+}
+
+@property (assign, nonatomic) BOOL calibrated;
+@property (assign, nonatomic) double calibrationSpread;
+/// Capacity in frames of the workspace
+@property (assign, nonatomic) NSUInteger capacity;
+/// The proximal and distal quaternions (2 * 4 * capacity) then the angles (3 * capacity)
+@property (strong, nonatomic) NSMutableData *doubles;
+/// The frame timestamps (capacity)
+@property (strong, nonatomic) NSMutableData *timeStamps;
+
+@end
+
+@implementation JointAngleEngine
+
+- (instancetype)init
+{
+    if (self = [super init])
+    {
+        _sequence = JointAngleSequenceXYZ;
+        _calibrationDuration = 0.5;
+        _calibrationTolerance = 5.0;
+        _doubles = [NSMutableData data];
+        _timeStamps = [NSMutableData data];
+        [self reset];
+    }
+    return self;
+}
+
++ (void)getOrientation:(double *)q ofSample:(const SessionSample *)sample
+{
+    if (sample->quat[0] != 0 || sample->quat[1] != 0 || sample->quat[2] != 0 || sample->quat[3] != 0)
+    {
+        for (int i = 0; i < 4; i++)
+        {
+            q[i] = sample->quat[i];
+        }
+    }
+    else
+    {
+        JointAngleQuaternionFromEuler(sample->euler, q);
+    }
+}
+
+- (void)setSequence:(JointAngleSequence)sequence
+{
+    _sequence = sequence;
+    _state.sequence = sequence;
+}
+
+- (void)reset
+{
+    JointAngleStateInit(&_state, self.sequence);
+    // The sensor z axis up
+    _neutralVertical[0] = _neutralVertical[1] = 0.0;
+    _neutralVertical[2] = 1.0;
+    self.calibrated = NO;
+}
+
+- (void)addCalibrationProximal:(SessionSample)proximal distal:(SessionSample)distal
+{
+    double prox[4], dist[4];
+    [JointAngleEngine getOrientation:prox ofSample:&proximal];
+    [JointAngleEngine getOrientation:dist ofSample:&distal];
+    JointAngleAddCalibrationFrame(&_state, prox, dist);
+}
+
+- (BOOL)finishCalibration
+{
+    if (!JointAngleFinishCalibration(&_state))
+    {
+        return NO;
+    }
+    self.calibrated = YES;
+    return YES;
+}
+
+- (void)getAngles:(double *)angles proximal:(SessionSample)proximal distal:(SessionSample)distal
+{
+    double prox[4], dist[4];
+    [JointAngleEngine getOrientation:prox ofSample:&proximal];
+    [JointAngleEngine getOrientation:dist ofSample:&distal];
+    JointAngleUpdate(&_state, prox, dist, angles);
+}
+
+/// Grows the workspace to hold count frames.
+- (void)reserve:(NSUInteger)count
+{
+    if (count <= self.capacity)
+    {
+        return;
+    }
+    self.doubles.length = count * 11 * sizeof(double);
+    self.timeStamps.length = count * sizeof(UInt32);
+    self.capacity = count;
+}
+
+/// Pairs every distal sample with the last proximal sample at or before it, in one merge pass over both buffers.
+/// @param block Receives the paired quaternions (count * 4 each) and the frame timestamps.
+- (void)alignStore:(SessionStore *)store proximal:(NSString *)proximal distal:(NSString *)distal usingBlock:(void (^)(const double *prox, const double *dist, const UInt32 *timeStamps, NSUInteger count))block
+{
+    [store enumerateSamplesForAddress:proximal usingBlock:^(const SessionSample *proxSamples, NSUInteger proxCount) {
+        [store enumerateSamplesForAddress:distal usingBlock:^(const SessionSample *distSamples, NSUInteger distCount) {
+            [self reserve:distCount];
+            double *prox = self.doubles.mutableBytes;
+            double *dist = prox + 4 * self.capacity;
+            UInt32 *timeStamps = self.timeStamps.mutableBytes;
+            NSUInteger count = 0;
+            NSUInteger p = 0;
+            for (NSUInteger d = 0; d < distCount; d++)
+            {
+                UInt32 timeStamp = distSamples[d].timeStamp;
+                // Timestamps are in microseconds and wrap around
+                while (p < proxCount && (int32_t)(proxSamples[p].timeStamp - timeStamp) <= 0)
+                {
+                    p++;
+                }
+                if (p == 0)
+                {
+                    continue;
+                }
+                [JointAngleEngine getOrientation:prox + count * 4 ofSample:&proxSamples[p - 1]];
+                [JointAngleEngine getOrientation:dist + count * 4 ofSample:&distSamples[d]];
+                timeStamps[count] = timeStamp;
+                count++;
+            }
+            block(prox, dist, timeStamps, count);
+        }];
+    }];
+}
+
+- (BOOL)calibrateFromStore:(SessionStore *)store proximal:(NSString *)proximal distal:(NSString *)distal
+{
+    [self reset];
+    UInt32 window = (UInt32)(self.calibrationDuration * 1e6);
+    __block double spread = 0;
+    [self alignStore:store proximal:proximal distal:distal usingBlock:^(const double *prox, const double *dist, const UInt32 *timeStamps, NSUInteger count) {
+        double first[4], rel[4];
+        for (NSUInteger i = 0; i < count && (UInt32)(timeStamps[i] - timeStamps[0]) <= window; i++)
+        {
+            JointAngleAddCalibrationFrame(&self->_state, prox + i * 4, dist + i * 4);
+            // Rotation of the joint since the first frame of the pose
+            JointAngleRelative(prox + i * 4, dist + i * 4, i == 0 ? first : rel);
+            if (i > 0)
+            {
+                double dot = fabs(first[0] * rel[0] + first[1] * rel[1] + first[2] * rel[2] + first[3] * rel[3]);
+                spread = MAX(spread, 2.0 * acos(MIN(dot, 1.0)) * 180.0 / M_PI);
+            }
+        }
+    }];
+    self.calibrationSpread = spread;
+    if (spread > self.calibrationTolerance)
+    {
+        NSLog(@"Calibration rejected, the joint rotated %.1f degrees", spread);
+        [self reset];
+        return NO;
+    }
+    return [self finishCalibration];
+}
+
+- (BOOL)calibrateTiltFromStore:(SessionStore *)store address:(NSString *)address
+{
+    [self reset];
+    UInt32 window = (UInt32)(self.calibrationDuration * 1e6);
+    __block double sum[3] = { 0, 0, 0 };
+    __block double spread = 0;
+    __block NSUInteger frames = 0;
+    [store enumerateSamplesForAddress:address usingBlock:^(const SessionSample *samples, NSUInteger count) {
+        double q[4], first[3], v[3];
+        for (NSUInteger i = 0; i < count && (UInt32)(samples[i].timeStamp - samples[0].timeStamp) <= window; i++)
+        {
+            [JointAngleEngine getOrientation:q ofSample:&samples[i]];
+            JointAngleVerticalInSensor(q, i == 0 ? first : v);
+            if (i > 0)
+            {
+                spread = MAX(spread, fabs(JointAngleTilt(first, v, 0)));
+            }
+            const double *vertical = i == 0 ? first : v;
+            for (int k = 0; k < 3; k++)
+            {
+                sum[k] += vertical[k];
+            }
+            frames++;
+        }
+    }];
+    self.calibrationSpread = spread;
+    if (frames == 0)
+    {
+        return NO;
+    }
+    if (spread > self.calibrationTolerance)
+    {
+        NSLog(@"Calibration rejected, the sensor tilted %.1f degrees", spread);
+        return NO;
+    }
+    double norm = sqrt(sum[0] * sum[0] + sum[1] * sum[1] + sum[2] * sum[2]);
+    for (int k = 0; k < 3; k++)
+    {
+        _neutralVertical[k] = sum[k] / norm;
+    }
+    self.calibrated = YES;
+    return YES;
+}
+
+- (double)tiltOfSample:(SessionSample)sample
+{
+    double q[4], v[3];
+    [JointAngleEngine getOrientation:q ofSample:&sample];
+    JointAngleVerticalInSensor(q, v);
+    return JointAngleTilt(_neutralVertical, v, 0);
+}
+
+- (void)computeForStore:(SessionStore *)store proximal:(NSString *)proximal distal:(NSString *)distal usingBlock:(void (^)(JointAngleColumns columns))block
+{
+    [self alignStore:store proximal:proximal distal:distal usingBlock:^(const double *prox, const double *dist, const UInt32 *timeStamps, NSUInteger count) {
+        double *angles = (double *)self.doubles.mutableBytes + 8 * self.capacity;
+        JointAngleUpdateBlock(&self->_state, prox, dist, count, angles);
+        JointAngleColumns columns = { angles, timeStamps, count };
+        block(columns);
+    }];
+}
+
+@end
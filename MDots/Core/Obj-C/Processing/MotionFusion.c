@@ -0,0 +1,206 @@
+//
+//  MotionFusion.c
+//  MDots
+//
+//  Created by Estela Alvarez on 18/10/26.
+//
+
+#include "MotionFusion.h"
+#include <math.h>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+void MotionFusionParamsDefault(MotionFusionParams *params)
+{
+    params->type = MotionFusionMadgwick;
+    params->beta = 0.1;
+    params->kp = 1.0;
+    params->ki = 0.0;
+}
+
+void MotionFusionStateReset(MotionFusionState *state)
+{
+    state->q[0] = 1.0;
+    state->q[1] = state->q[2] = state->q[3] = 0.0;
+    state->integral[0] = state->integral[1] = state->integral[2] = 0.0;
+    state->initialized = 0;
+}
+
+static void Normalize4(double q[4])
+{
+    double norm = sqrt(q[0] * q[0] + q[1] * q[1] + q[2] * q[2] + q[3] * q[3]);
+    if (norm > 0.0)
+    {
+        double inv = 1.0 / norm;
+        q[0] *= inv;
+        q[1] *= inv;
+        q[2] *= inv;
+        q[3] *= inv;
+    }
+}
+
+/// Attitude from the gravity direction alone, yaw is zero.
+static void InitializeFromAcc(MotionFusionState *state, const double acc[3])
+{
+    double roll = atan2(acc[1], acc[2]);
+    double pitch = atan2(-acc[0], sqrt(acc[1] * acc[1] + acc[2] * acc[2]));
+    double cr = cos(roll * 0.5), sr = sin(roll * 0.5);
+    double cp = cos(pitch * 0.5), sp = sin(pitch * 0.5);
+    state->q[0] = cr * cp;
+    state->q[1] = sr * cp;
+    state->q[2] = cr * sp;
+    state->q[3] = -sr * sp;
+    state->initialized = 1;
+}
+
+/// Madgwick IMU update (gradient descent on the gravity direction).
+static void MadgwickUpdate(double beta, double q[4], const double g[3], const double a[3], double dt)
+{
+    double q0 = q[0], q1 = q[1], q2 = q[2], q3 = q[3];
+    double qDot0 = 0.5 * (-q1 * g[0] - q2 * g[1] - q3 * g[2]);
+    double qDot1 = 0.5 * (q0 * g[0] + q2 * g[2] - q3 * g[1]);
+    double qDot2 = 0.5 * (q0 * g[1] - q1 * g[2] + q3 * g[0]);
+    double qDot3 = 0.5 * (q0 * g[2] + q1 * g[1] - q2 * g[0]);
+    
+    double norm = sqrt(a[0] * a[0] + a[1] * a[1] + a[2] * a[2]);
+    if (norm > 0.0)
+    {
+        double ax = a[0] / norm, ay = a[1] / norm, az = a[2] / norm;
+        double f0 = 2.0 * (q1 * q3 - q0 * q2) - ax;
+        double f1 = 2.0 * (q0 * q1 + q2 * q3) - ay;
+        double f2 = 2.0 * (0.5 - q1 * q1 - q2 * q2) - az;
+        double s0 = -2.0 * q2 * f0 + 2.0 * q1 * f1;
+        double s1 = 2.0 * q3 * f0 + 2.0 * q0 * f1 - 4.0 * q1 * f2;
+        double s2 = -2.0 * q0 * f0 + 2.0 * q3 * f1 - 4.0 * q2 * f2;
+        double s3 = 2.0 * q1 * f0 + 2.0 * q2 * f1;
+        double sNorm = sqrt(s0 * s0 + s1 * s1 + s2 * s2 + s3 * s3);
+        if (sNorm > 0.0)
+        {
+            double k = beta / sNorm;
+            qDot0 -= k * s0;
+            qDot1 -= k * s1;
+            qDot2 -= k * s2;
+            qDot3 -= k * s3;
+        }
+    }
+    q[0] = q0 + qDot0 * dt;
+    q[1] = q1 + qDot1 * dt;
+    q[2] = q2 + qDot2 * dt;
+    q[3] = q3 + qDot3 * dt;
+    Normalize4(q);
+}
+
+/// Mahony IMU update (PI correction of the gyroscope with the gravity error).
+static void MahonyUpdate(double kp, double ki, double q[4], double integral[3], const double gyr[3], const double a[3], double dt)
+{
+    double q0 = q[0], q1 = q[1], q2 = q[2], q3 = q[3];
+    double g[3] = { gyr[0], gyr[1], gyr[2] };
+    double norm = sqrt(a[0] * a[0] + a[1] * a[1] + a[2] * a[2]);
+    if (norm > 0.0)
+    {
+        double ax = a[0] / norm, ay = a[1] / norm, az = a[2] / norm;
+        // Gravity direction estimated from the current attitude
+        double vx = 2.0 * (q1 * q3 - q0 * q2);
+        double vy = 2.0 * (q0 * q1 + q2 * q3);
+        double vz = q0 * q0 - q1 * q1 - q2 * q2 + q3 * q3;
+        double e[3] = { ay * vz - az * vy, az * vx - ax * vz, ax * vy - ay * vx };
+        for (int i = 0; i < 3; i++)
+        {
+            if (ki > 0.0)
+            {
+                integral[i] += ki * e[i] * dt;
+                g[i] += integral[i];
+            }
+            g[i] += kp * e[i];
+        }
+    }
+    double h = 0.5 * dt;
+    q[0] = q0 + (-q1 * g[0] - q2 * g[1] - q3 * g[2]) * h;
+    q[1] = q1 + (q0 * g[0] + q2 * g[2] - q3 * g[1]) * h;
+    q[2] = q2 + (q0 * g[1] - q1 * g[2] + q3 * g[0]) * h;
+    q[3] = q3 + (q0 * g[2] + q1 * g[1] - q2 * g[0]) * h;
+    Normalize4(q);
+}
+
+void MotionFusionUpdate(const MotionFusionParams *params, MotionFusionState *state, const double gyr[3], const double acc[3], double dt)
+{
+    if (!state->initialized)
+    {
+        InitializeFromAcc(state, acc);
+        return;
+    }
+    if (!(dt > 0.0))
+    {
+        return;
+    }
+    if (params->type == MotionFusionMahony)
+    {
+        MahonyUpdate(params->kp, params->ki, state->q, state->integral, gyr, acc, dt);
+    }
+    else
+    {
+        MadgwickUpdate(params->beta, state->q, gyr, acc, dt);
+    }
+}
+
+void MotionFusionUpdateBlock(const MotionFusionParams *params, MotionFusionState *states, size_t sensors, size_t count,
+                             const double *gyr, const double *acc, const double *dt, double fixedDt, double *quatOut)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        double step = dt ? dt[i] : fixedDt;
+        for (size_t s = 0; s < sensors; s++)
+        {
+            size_t v = (i * sensors + s) * 3;
+            MotionFusionState *state = &states[s];
+            MotionFusionUpdate(params, state, &gyr[v], &acc[v], step);
+            if (quatOut)
+            {
+                double *out = &quatOut[(i * sensors + s) * 4];
+                out[0] = state->q[0];
+                out[1] = state->q[1];
+                out[2] = state->q[2];
+                out[3] = state->q[3];
+            }
+        }
+    }
+}
+
+void MotionFusionFromDeltas(const double dq[4], const double dv[3], double dt, double gyr[3], double acc[3])
+{
+    double inv = dt > 0.0 ? 1.0 / dt : 0.0;
+    double w = dq[0], x = dq[1], y = dq[2], z = dq[3];
+    if (w < 0.0)
+    {
+        w = -w; x = -x; y = -y; z = -z;
+    }
+    double vNorm = sqrt(x * x + y * y + z * z);
+    // Rotation angle over the period, divided by the axis norm (2 for small angles)
+    double scale = vNorm > 1e-12 ? 2.0 * atan2(vNorm, w) / vNorm : 2.0;
+    gyr[0] = x * scale * inv;
+    gyr[1] = y * scale * inv;
+    gyr[2] = z * scale * inv;
+    acc[0] = dv[0] * inv;
+    acc[1] = dv[1] * inv;
+    acc[2] = dv[2] * inv;
+}
+
+void MotionFusionQuaternionToEuler(const double q[4], double euler[3])
+{
+    double w = q[0], x = q[1], y = q[2], z = q[3];
+    double sinp = 2.0 * (w * y - z * x);
+    if (sinp > 1.0)
+    {
+        sinp = 1.0;
+    }
+    else if (sinp < -1.0)
+    {
+        sinp = -1.0;
+    }
+    double toDegrees = 180.0 / M_PI;
+    euler[0] = atan2(2.0 * (w * x + y * z), 1.0 - 2.0 * (x * x + y * y)) * toDegrees;
+    euler[1] = asin(sinp) * toDegrees;
+    euler[2] = atan2(2.0 * (w * z + x * y), 1.0 - 2.0 * (y * y + z * z)) * toDegrees;
+}
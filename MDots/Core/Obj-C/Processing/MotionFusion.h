@@ -0,0 +1,92 @@
+//
+//  MotionFusion.h
+//  MDots
+//
+//  Created by Estela Alvarez on 18/10/26.
+//
+
+#ifndef MotionFusion_h
+#define MotionFusion_h
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// Portable C99 orientation filters (no Foundation, no allocation), so they can be built and benchmarked off the device.
+/// Quaternions are (w, x, y, z), gyroscope in rad/s, acceleration in any unit (only its direction is used).
+
+/// The filter algorithm
+typedef enum
+{
+    MotionFusionMadgwick = 0,
+    MotionFusionMahony,
+} MotionFusionType;
+
+/// The filter parameters
+typedef struct
+{
+    MotionFusionType type;
+    /// Madgwick gradient step gain
+    double beta;
+    /// Mahony proportional gain
+    double kp;
+    /// Mahony integral gain
+    double ki;
+} MotionFusionParams;
+
+/// The state of one sensor
+typedef struct
+{
+    double q[4];
+    /// Mahony integral of the gyroscope bias
+    double integral[3];
+    int initialized;
+} MotionFusionState;
+
+/// Fills in the default parameters (Madgwick, beta 0.1, kp 1.0, ki 0.0).
+void MotionFusionParamsDefault(MotionFusionParams *params);
+
+/// Resets a sensor state, the next update initializes the attitude from the accelerometer.
+void MotionFusionStateReset(MotionFusionState *state);
+
+/// Runs one update of a sensor.
+/// @param params The filter parameters.
+/// @param state The sensor state.
+/// @param gyr The angular velocity (3).
+/// @param acc The acceleration (3).
+/// @param dt The time step in seconds.
+void MotionFusionUpdate(const MotionFusionParams *params, MotionFusionState *state, const double gyr[3], const double acc[3], double dt);
+
+/// Runs a block of samples for N sensors. The columns are sample major with the sensors inner:
+/// the vector of sensor s at sample i starts at ((i * sensors) + s) * 3 (* 4 for quaternions).
+/// @param params The filter parameters.
+/// @param states The states of the sensors (sensors).
+/// @param sensors The number of sensors.
+/// @param count The number of samples per sensor.
+/// @param gyr The angular velocity column (count * sensors * 3).
+/// @param acc The acceleration column (count * sensors * 3).
+/// @param dt The time steps in seconds (count), or NULL to use fixedDt.
+/// @param fixedDt The time step when dt is NULL.
+/// @param quatOut The fused quaternion column (count * sensors * 4), may be NULL.
+void MotionFusionUpdateBlock(const MotionFusionParams *params, MotionFusionState *states, size_t sensors, size_t count,
+                             const double *gyr, const double *acc, const double *dt, double fixedDt, double *quatOut);
+
+/// Converts the delta quantities of one sample (orientation and velocity increments) into the
+/// angular velocity and acceleration over the sample period.
+/// @param dq The orientation increment quaternion (4).
+/// @param dv The velocity increment (3).
+/// @param dt The sample period in seconds.
+/// @param gyr The angular velocity out (3).
+/// @param acc The acceleration out (3).
+void MotionFusionFromDeltas(const double dq[4], const double dv[3], double dt, double gyr[3], double acc[3]);
+
+/// Converts a quaternion to euler angles in degrees (roll, pitch, yaw), the convention of DotPlotData euler0-2.
+void MotionFusionQuaternionToEuler(const double q[4], double euler[3]);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MotionFusion_h */
@@ -0,0 +1,66 @@
+//
+//  MovementQuality.h
+//  MDots
+//
+//  Created by Estela Alvarez on 18/10/26.
+//
+
+#import <Foundation/Foundation.h>
+#import "SessionStore.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+/// The movement quality of one sensor over a trial
+typedef struct
+{
+    /// Spectral arc length of the angular speed, negative, closer to 0 is smoother (about -1.6 for a single minimum jerk movement)
+    double sparc;
+    /// Share of the angular velocity power in the tremor band, from 0 to 1
+    double tremorPowerRatio;
+    /// Log dimensionless jerk of the angular speed, negative, closer to 0 is smoother
+    double logDimensionlessJerk;
+    /// Peak angular speed in deg/s
+    double peakSpeed;
+    /// Trial duration in seconds
+    double duration;
+} MovementQualityResult;
+
+/// @class MovementQuality
+/// @discussion Analyses the angular velocity of a stored trial in the frequency domain with Accelerate (vDSP): SPARC smoothness, tremor band power and jerk, so charts can show how a range was reached and not only the range.
+/// The angular velocity is the gyroscope when the payload has one, otherwise it is derived from consecutive orientations. The FFT setup and the work buffers are kept and only grow, so the trials of a session share one plan. Not thread safe, use one instance per queue.
+@interface MovementQuality : NSObject
+
+/// The highest frequency SPARC considers, in Hz. Defaults to 10.
+@property (assign, nonatomic) double sparcCutoff;
+
+/// The normalized magnitude under which the spectrum is considered noise for SPARC. Defaults to 0.05.
+@property (assign, nonatomic) double sparcThreshold;
+
+/// Times the speed profile is zero padded, as a power of two, for a fine SPARC spectrum. Defaults to 4 (16x).
+@property (assign, nonatomic) NSUInteger sparcPadding;
+
+/// The tremor band in Hz. Defaults to 4 to 12.
+@property (assign, nonatomic) double tremorLow;
+@property (assign, nonatomic) double tremorHigh;
+
+/// The shared instance, used on the main queue.
+/// ```objc
+/// MovementQualityResult result;
+/// [[MovementQuality sharedQuality] analyzeStore:store address:address result:&result];
+/// ```
++ (instancetype)sharedQuality;
+
+/// Analyses the samples of one device.
+/// @param store The recorded session.
+/// @param address The device mac address.
+/// @param result The result out.
+/// @return NO if the device has too few samples or did not move.
+- (BOOL)analyzeStore:(SessionStore *)store address:(NSString *)address result:(MovementQualityResult *)result;
+
+/// A result as stored with the test.
+/// @param result The result.
++ (NSDictionary<NSString *, NSNumber *> *)dictionaryWithResult:(MovementQualityResult)result;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,319 @@
+//
+//  MovementQuality.m
+//  MDots
+//
+//  Created by Estela Alvarez on 18/10/26.
+//
+
+#import "MovementQuality.h"
+#import "JointAngle.h"
+#import <Accelerate/Accelerate.h>
+
+/// Trials shorter than this many samples are not analysed
+static const NSUInteger kMinimumSamples = 16;
+
+/// Column indexes in the sample workspace
+enum
+{
+    kColumnX = 0,
+    kColumnY,
+    kColumnZ,
+    kColumnSpeed,
+    kColumnScratch,
+    kSampleColumnCount,
+};
+
+@interface MovementQuality ()
+
+/// The FFT setup, valid for every size up to 2^setupLog2n
+@property (assign, nonatomic) FFTSetupD setup;
+@property (assign, nonatomic) vDSP_Length setupLog2n;
+/// Capacity in samples of every sample column
+@property (assign, nonatomic) NSUInteger capacity;
+@property (strong, nonatomic) NSMutableData *samples;
+/// The zero padded FFT input, then the spectrum halves and magnitudes
+@property (strong, nonatomic) NSMutableData *spectrum;
+
+@end
+
+@implementation MovementQuality
+
++ (instancetype)sharedQuality
+{
+    static MovementQuality *quality = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        quality = [MovementQuality new];
+    });
+    return quality;
+}
+
+- (instancetype)init
+{
+    if (self = [super init])
+    {
+        _sparcCutoff = 10.0;
+        _sparcThreshold = 0.05;
+        _sparcPadding = 4;
+        _tremorLow = 4.0;
+        _tremorHigh = 12.0;
+        _samples = [NSMutableData data];
+        _spectrum = [NSMutableData data];
+    }
+    return self;
+}
+
+- (void)dealloc
+{
+    if (_setup)
+    {
+        vDSP_destroy_fftsetupD(_setup);
+    }
+}
+
+/// Makes the FFT setup and spectrum buffer big enough for 2^log2n points.
+- (void)reserveFFT:(vDSP_Length)log2n
+{
+    if (self.setup == NULL || log2n > self.setupLog2n)
+    {
+        if (self.setup)
+        {
+            vDSP_destroy_fftsetupD(self.setup);
+        }
+        self.setup = vDSP_create_fftsetupD(log2n, kFFTRadix2);
+        self.setupLog2n = log2n;
+    }
+    // Input (n), split halves (n), magnitudes (n / 2 + 1)
+    NSUInteger length = ((2u << log2n) + (1u << (log2n - 1)) + 1) * sizeof(double);
+    if (self.spectrum.length < length)
+    {
+        self.spectrum.length = length;
+    }
+}
+
+/// A sample column of the workspace.
+- (double *)column:(NSUInteger)index
+{
+    return (double *)self.samples.mutableBytes + index * self.capacity;
+}
+
+/// The magnitude (or power) spectrum of a signal, zero padded to 2^log2n points.
+/// @param signal The signal.
+/// @param count The number of samples, at most 2^log2n.
+/// @param log2n The FFT size.
+/// @param power YES for squared magnitudes.
+/// @return The n / 2 + 1 bins from DC to Nyquist, all scaled by the same factor, valid until the next call.
+- (const double *)spectrumOf:(const double *)signal count:(NSUInteger)count log2n:(vDSP_Length)log2n power:(BOOL)power
+{
+    vDSP_Length n = 1u << log2n;
+    double *input = self.spectrum.mutableBytes;
+    double *real = input + n;
+    double *imag = real + n / 2;
+    double *magnitudes = imag + n / 2;
+    memcpy(input, signal, count * sizeof(double));
+    vDSP_vclrD(input + count, 1, n - count);
+    DSPDoubleSplitComplex split = { real, imag };
+    vDSP_ctozD((const DSPDoubleComplex *)input, 2, &split, 1, n / 2);
+    vDSP_fft_zripD(self.setup, &split, 1, log2n, kFFTDirection_Forward);
+    // The packed format keeps the real DC bin in real[0] and the real Nyquist bin in imag[0]
+    double dc = real[0];
+    double nyquist = imag[0];
+    imag[0] = 0;
+    if (power)
+    {
+        vDSP_zvmagsD(&split, 1, magnitudes, 1, n / 2);
+        magnitudes[0] = dc * dc;
+        magnitudes[n / 2] = nyquist * nyquist;
+    }
+    else
+    {
+        vDSP_zvabsD(&split, 1, magnitudes, 1, n / 2);
+        magnitudes[0] = fabs(dc);
+        magnitudes[n / 2] = fabs(nyquist);
+    }
+    return magnitudes;
+}
+
+/// Fills the angular velocity and speed columns in deg/s.
+/// @return The mean sample period in seconds.
+- (double)loadAngularVelocity:(const SessionSample *)samples count:(NSUInteger)count
+{
+    double *x = [self column:kColumnX], *y = [self column:kColumnY], *z = [self column:kColumnZ];
+    // Timestamps are in microseconds and wrap around
+    double dt = (UInt32)(samples[count - 1].timeStamp - samples[0].timeStamp) * 1e-6 / (count - 1);
+    BOOL hasGyroscope = NO;
+    for (NSUInteger i = 0; i < count && !hasGyroscope; i++)
+    {
+        hasGyroscope = samples[i].gyr[0] != 0 || samples[i].gyr[1] != 0 || samples[i].gyr[2] != 0;
+    }
+    if (hasGyroscope)
+    {
+        // Already in deg/s, see `SessionSampleMake`
+        for (NSUInteger i = 0; i < count; i++)
+        {
+            x[i] = samples[i].gyr[0];
+            y[i] = samples[i].gyr[1];
+            z[i] = samples[i].gyr[2];
+        }
+    }
+    else
+    {
+        // Rotation between consecutive orientations, in the sensor frame
+        double previous[4], current[4], delta[4];
+        JointAngleQuaternionFromEuler(samples[0].euler, previous);
+        x[0] = y[0] = z[0] = 0;
+        for (NSUInteger i = 1; i < count; i++)
+        {
+            JointAngleQuaternionFromEuler(samples[i].euler, current);
+            JointAngleRelative(previous, current, delta);
+            double sign = delta[0] < 0 ? -1.0 : 1.0;
+            double sine = sqrt(delta[1] * delta[1] + delta[2] * delta[2] + delta[3] * delta[3]);
+            double scale = sine > 1e-12 ? sign * 2.0 * atan2(sine, fabs(delta[0])) / sine * (180.0 / M_PI) / dt : 0.0;
+            x[i] = delta[1] * scale;
+            y[i] = delta[2] * scale;
+            z[i] = delta[3] * scale;
+            memcpy(previous, current, sizeof(previous));
+        }
+        // The first sample has no predecessor
+        x[0] = x[1];
+        y[0] = y[1];
+        z[0] = z[1];
+    }
+    double *speed = [self column:kColumnSpeed];
+    vDSP_vmmaD(x, 1, x, 1, y, 1, y, 1, speed, 1, count);
+    vDSP_vmaD(z, 1, z, 1, speed, 1, speed, 1, count);
+    int length = (int)count;
+    vvsqrt(speed, speed, &length);
+    return dt;
+}
+
+/// The spectral arc length of the speed profile.
+- (double)sparcOfSpeed:(const double *)speed count:(NSUInteger)count dt:(double)dt
+{
+    vDSP_Length log2n = (vDSP_Length)ceil(log2((double)count)) + self.sparcPadding;
+    [self reserveFFT:log2n];
+    NSUInteger n = 1u << log2n;
+    const double *magnitudes = [self spectrumOf:speed count:count log2n:log2n power:NO];
+    if (magnitudes[0] <= 0)
+    {
+        return 0;
+    }
+    double inverseDC = 1.0 / magnitudes[0];
+    // Highest bin under the cutoff still above the noise threshold
+    NSUInteger cutoff = MIN((NSUInteger)(self.sparcCutoff * n * dt), n / 2);
+    NSUInteger last = 0;
+    for (NSUInteger k = 1; k <= cutoff; k++)
+    {
+        if (magnitudes[k] * inverseDC >= self.sparcThreshold)
+        {
+            last = k;
+        }
+    }
+    if (last == 0)
+    {
+        return 0;
+    }
+    double step = 1.0 / last;
+    double length = 0;
+    for (NSUInteger k = 1; k <= last; k++)
+    {
+        double rise = (magnitudes[k] - magnitudes[k - 1]) * inverseDC;
+        length += sqrt(step * step + rise * rise);
+    }
+    return -length;
+}
+
+/// The share of the angular velocity power in the tremor band.
+- (double)tremorRatioCount:(NSUInteger)count dt:(double)dt
+{
+    vDSP_Length log2n = (vDSP_Length)ceil(log2((double)count));
+    [self reserveFFT:log2n];
+    NSUInteger n = 1u << log2n;
+    NSUInteger low = MAX((NSUInteger)ceil(self.tremorLow * n * dt), 1u);
+    NSUInteger high = MIN((NSUInteger)floor(self.tremorHigh * n * dt), n / 2);
+    double band = 0, total = 0;
+    double *scratch = [self column:kColumnScratch];
+    for (NSUInteger axis = kColumnX; axis <= kColumnZ; axis++)
+    {
+        // Without the mean, the DC bin does not count as movement
+        double mean;
+        vDSP_meanvD([self column:axis], 1, &mean, count);
+        mean = -mean;
+        vDSP_vsaddD([self column:axis], 1, &mean, scratch, 1, count);
+        const double *power = [self spectrumOf:scratch count:count log2n:log2n power:YES];
+        double sum;
+        vDSP_sveD(power + 1, 1, &sum, n / 2);
+        total += sum;
+        if (high >= low)
+        {
+            vDSP_sveD(power + low, 1, &sum, high - low + 1);
+            band += sum;
+        }
+    }
+    return total > 0 ? band / total : 0;
+}
+
+/// The log dimensionless jerk of the speed profile: -ln(T^3 / v_peak^2 * integral of (d2v/dt2)^2 dt).
+- (double)logDimensionlessJerkOfSpeed:(const double *)speed count:(NSUInteger)count dt:(double)dt peak:(double)peak
+{
+    double *jerk = [self column:kColumnScratch];
+    // Second central difference
+    double two = -2.0;
+    vDSP_vsmaD(speed + 1, 1, &two, speed, 1, jerk, 1, count - 2);
+    vDSP_vaddD(jerk, 1, speed + 2, 1, jerk, 1, count - 2);
+    double inverseDt2 = 1.0 / (dt * dt);
+    vDSP_vsmulD(jerk, 1, &inverseDt2, jerk, 1, count - 2);
+    double sumOfSquares;
+    vDSP_svesqD(jerk, 1, &sumOfSquares, count - 2);
+    double duration = dt * (count - 1);
+    double dimensionless = duration * duration * duration / (peak * peak) * sumOfSquares * dt;
+    return dimensionless > 0 ? -log(dimensionless) : 0;
+}
+
+- (BOOL)analyzeStore:(SessionStore *)store address:(NSString *)address result:(MovementQualityResult *)result
+{
+    __block BOOL analysed = NO;
+    [store enumerateSamplesForAddress:address usingBlock:^(const SessionSample *samples, NSUInteger count) {
+        if (count < kMinimumSamples)
+        {
+            return;
+        }
+        if (count > self.capacity)
+        {
+            self.samples.length = count * kSampleColumnCount * sizeof(double);
+            self.capacity = count;
+        }
+        double dt = [self loadAngularVelocity:samples count:count];
+        if (dt <= 0)
+        {
+            return;
+        }
+        const double *speed = [self column:kColumnSpeed];
+        double peak;
+        vDSP_maxvD(speed, 1, &peak, count);
+        if (peak <= 0)
+        {
+            return;
+        }
+        result->peakSpeed = peak;
+        result->duration = dt * (count - 1);
+        result->sparc = [self sparcOfSpeed:speed count:count dt:dt];
+        result->tremorPowerRatio = [self tremorRatioCount:count dt:dt];
+        result->logDimensionlessJerk = [self logDimensionlessJerkOfSpeed:speed count:count dt:dt peak:peak];
+        analysed = YES;
+    }];
+    return analysed;
+}
+
++ (NSDictionary<NSString *, NSNumber *> *)dictionaryWithResult:(MovementQualityResult)result
+{
+    return @{
+        @"sparc": @(result.sparc),
+        @"tremorPowerRatio": @(result.tremorPowerRatio),
+        @"logDimensionlessJerk": @(result.logDimensionlessJerk),
+        @"peakSpeed": @(result.peakSpeed),
+        @"duration": @(result.duration),
+    };
+}
+
+@end
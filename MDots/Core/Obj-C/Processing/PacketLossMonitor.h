@@ -0,0 +1,92 @@
+//
+//  PacketLossMonitor.h
+//  MDots
+//
+//  Created by Estela Alvarez on 18/10/26.
+//
+
+#import <Foundation/Foundation.h>
+#import <MovellaDotSdk/DotPlotData.h>
+#import "SessionStore.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+/// @class PacketLossStats
+/// @discussion Loss counters of one device during a trial.
+@interface PacketLossStats : NSObject
+
+/// Samples received from the sensor
+@property (assign, nonatomic) NSUInteger received;
+/// Samples missing according to the package counter
+@property (assign, nonatomic) NSUInteger lost;
+/// Missing samples filled in by interpolation
+@property (assign, nonatomic) NSUInteger repaired;
+/// Gaps too long to interpolate
+@property (assign, nonatomic) NSUInteger longGaps;
+/// Length in samples of the longest gap
+@property (assign, nonatomic) NSUInteger longestGap;
+/// Reconnects during the trial
+@property (assign, nonatomic) NSUInteger reconnects;
+/// Time in seconds from the last reconnect to the first sample after it, 0 if none
+@property (assign, nonatomic) NSTimeInterval lastResumeLatency;
+
+/// The fraction of expected samples that were lost.
+- (double)lossRate;
+
+/// The counters as a dictionary, ready to be stored with the test result.
+- (NSDictionary<NSString *, NSNumber *> *)dictionaryRepresentation;
+
+@end
+
+/// @class PacketLossMonitor
+/// @discussion Sits on the ingest path between the SDK plot data blocks and the `SessionStore`. It follows the `packageCounter` of every device, counts and logs the lost samples, fills short gaps (SLERP for quaternions, linear interpolation for the other channels) and flags the long ones.
+@interface PacketLossMonitor : NSObject
+
+/// The longest gap, in samples, that is filled in by interpolation. Defaults to 6 (100 ms at 60 Hz).
+@property (assign, nonatomic) NSUInteger maxRepairGap;
+
+/// The highest loss rate for which a trial is still considered trustworthy. Defaults to 0.02.
+@property (assign, nonatomic) double maxTrustedLossRate;
+
+/// The store the received and repaired samples are written to.
+@property (strong, nonatomic, readonly) SessionStore *store;
+
+/// Creates a monitor writing to the given store.
+/// @param store The session store.
+/// ```objc
+/// PacketLossMonitor *monitor = [[PacketLossMonitor alloc] initWithStore:store];
+/// ```
+- (instancetype)initWithStore:(SessionStore *)store;
+
+/// Checks a received sample for a gap, repairs it if short and stores the sample.
+/// @param plotData The received sample.
+/// @param address The device mac address.
+- (void)ingestPlotData:(DotPlotData *)plotData address:(NSString *)address;
+
+/// Checks a sample for a gap, repairs it if short and stores the sample.
+/// @param sample The received sample.
+/// @param address The device mac address.
+- (void)ingestSample:(SessionSample)sample address:(NSString *)address;
+
+/// Marks the next sample of a device as the start of a new stream, so the gap before it is not counted as loss.
+/// The break is marked in the store.
+/// @param address The device mac address.
+- (void)restartStreamForAddress:(NSString *)address;
+
+/// Counts a reconnect of a device and starts timing it, until the first sample after it arrives.
+/// @param address The device mac address.
+- (void)noteReconnectForAddress:(NSString *)address;
+
+/// The loss counters of a device.
+/// @param address The device mac address.
+- (PacketLossStats *)statsForAddress:(NSString *)address;
+
+/// Whether no device lost more than `maxTrustedLossRate` or had a gap too long to repair.
+- (BOOL)isTrustworthy;
+
+/// The counters of every device keyed by mac address, ready to be stored with the test result.
+- (NSDictionary<NSString *, NSDictionary *> *)summary;
+
+@end
+
+NS_ASSUME_NONNULL_END
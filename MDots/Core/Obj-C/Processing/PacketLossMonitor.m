@@ -0,0 +1,274 @@
+//
+//  PacketLossMonitor.m
+//  MDots
+//
+//  Created by Estela Alvarez on 18/10/26.
+//
+
+#import "PacketLossMonitor.h"
+
+@implementation PacketLossStats
+
+- (double)lossRate
+{
+    NSUInteger expected = self.received + self.lost;
+    return expected > 0 ? (double)self.lost / expected : 0;
+}
+
+- (NSDictionary<NSString *, NSNumber *> *)dictionaryRepresentation
+{
+    return @{
+        @"received": @(self.received),
+        @"lost": @(self.lost),
+        @"repaired": @(self.repaired),
+        @"longGaps": @(self.longGaps),
+        @"longestGap": @(self.longestGap),
+        @"reconnects": @(self.reconnects),
+        @"lastResumeLatency": @(self.lastResumeLatency),
+        @"lossRate": @([self lossRate])
+    };
+}
+
+@end
+
+/// The gap state of one device
+@interface PacketLossDeviceState : NSObject
+
+@property (strong, nonatomic) PacketLossStats *stats;
+@property (assign, nonatomic) SessionSample lastSample;
+@property (assign, nonatomic) BOOL hasLastSample;
+/// System uptime of a reconnect still waiting for its first sample, 0 if none
+@property (assign, nonatomic) NSTimeInterval reconnectTime;
+
+@end
+
+@implementation PacketLossDeviceState
+@end
+
+#pragma mark - Interpolation
+
+/// Linear interpolation of an angle in degrees along the shortest arc.
+static double InterpolateDegrees(double a, double b, double t)
+{
+    double delta = fmod(b - a + 540.0, 360.0) - 180.0;
+    double value = a + delta * t;
+    if (value > 180.0)
+    {
+        value -= 360.0;
+    }
+    else if (value <= -180.0)
+    {
+        value += 360.0;
+    }
+    return value;
+}
+
+/// Spherical linear interpolation of two unit quaternions (w, x, y, z).
+static void Slerp(const float a[4], const float b[4], double t, float out[4])
+{
+    double dot = a[0] * b[0] + a[1] * b[1] + a[2] * b[2] + a[3] * b[3];
+    double sign = 1.0;
+    if (dot < 0)
+    {
+        dot = -dot;
+        sign = -1.0;
+    }
+    double wa, wb;
+    if (dot > 0.9995)
+    {
+        wa = 1.0 - t;
+        wb = t;
+    }
+    else
+    {
+        double theta = acos(dot);
+        double sinTheta = sin(theta);
+        wa = sin((1.0 - t) * theta) / sinTheta;
+        wb = sin(t * theta) / sinTheta;
+    }
+    double norm = 0;
+    for (int i = 0; i < 4; i++)
+    {
+        out[i] = wa * a[i] + wb * sign * b[i];
+        norm += out[i] * out[i];
+    }
+    norm = sqrt(norm);
+    if (norm > 0)
+    {
+        for (int i = 0; i < 4; i++)
+        {
+            out[i] /= norm;
+        }
+    }
+}
+
+/// Builds the sample at fraction t between a and b.
+static SessionSample InterpolateSample(const SessionSample *a, const SessionSample *b, UInt32 packageCounter, double t)
+{
+    SessionSample sample;
+    sample.packageCounter = packageCounter;
+    sample.timeStamp = a->timeStamp + (UInt32)llround((double)(UInt32)(b->timeStamp - a->timeStamp) * t);
+    Slerp(a->quat, b->quat, t, sample.quat);
+    for (int i = 0; i < 3; i++)
+    {
+        sample.euler[i] = InterpolateDegrees(a->euler[i], b->euler[i], t);
+        sample.freeAcc[i] = a->freeAcc[i] + (b->freeAcc[i] - a->freeAcc[i]) * t;
+        sample.acc[i] = a->acc[i] + (b->acc[i] - a->acc[i]) * t;
+        sample.gyr[i] = a->gyr[i] + (b->gyr[i] - a->gyr[i]) * t;
+        sample.dv[i] = a->dv[i] + (b->dv[i] - a->dv[i]) * t;
+    }
+    for (int i = 0; i < 4; i++)
+    {
+        sample.dq[i] = a->dq[i] + (b->dq[i] - a->dq[i]) * t;
+    }
+    return sample;
+}
+
+@interface PacketLossMonitor ()
+
+@property (strong, nonatomic) SessionStore *store;
+/// Gap state per mac address
+@property (strong, nonatomic) NSMutableDictionary<NSString *, PacketLossDeviceState *> *states;
+
+@end
+
+@implementation PacketLossMonitor
+
+- (instancetype)initWithStore:(SessionStore *)store
+{
+    if (self = [super init])
+    {
+        _store = store;
+        _maxRepairGap = 6;
+        _maxTrustedLossRate = 0.02;
+        _states = [NSMutableDictionary dictionary];
+    }
+    return self;
+}
+
+/// The gap state of a device, created on first use.
+/// @param address The device mac address.
+- (PacketLossDeviceState *)stateForAddress:(NSString *)address
+{
+    @synchronized (self.states)
+    {
+        PacketLossDeviceState *state = self.states[address];
+        if (state == nil)
+        {
+            state = [PacketLossDeviceState new];
+            state.stats = [PacketLossStats new];
+            self.states[address] = state;
+        }
+        return state;
+    }
+}
+
+- (void)ingestPlotData:(DotPlotData *)plotData address:(NSString *)address
+{
+    [self ingestSample:SessionSampleMake(plotData) address:address];
+}
+
+- (void)ingestSample:(SessionSample)sample address:(NSString *)address
+{
+    PacketLossDeviceState *state = [self stateForAddress:address];
+    @synchronized (state)
+    {
+        if (state.reconnectTime > 0)
+        {
+            state.stats.lastResumeLatency = [NSProcessInfo processInfo].systemUptime - state.reconnectTime;
+            state.reconnectTime = 0;
+            NSLog(@"Stream of %@ resumed %.0f ms after reconnect", address, state.stats.lastResumeLatency * 1000);
+        }
+        if (state.hasLastSample)
+        {
+            SessionSample last = state.lastSample;
+            // Unsigned difference, so the counter wrapping around is not a gap
+            UInt32 step = sample.packageCounter - last.packageCounter;
+            if (step == 0 || step > UINT32_MAX / 2)
+            {
+                // Duplicate or late packet
+                return;
+            }
+            NSUInteger missing = step - 1;
+            if (missing > 0)
+            {
+                state.stats.lost += missing;
+                state.stats.longestGap = MAX(state.stats.longestGap, missing);
+                if (missing <= self.maxRepairGap)
+                {
+                    for (NSUInteger i = 1; i <= missing; i++)
+                    {
+                        double t = (double)i / step;
+                        SessionSample repaired = InterpolateSample(&last, &sample, last.packageCounter + (UInt32)i, t);
+                        [self.store appendSample:repaired forAddress:address];
+                    }
+                    state.stats.repaired += missing;
+                }
+                else
+                {
+                    state.stats.longGaps += 1;
+                    NSLog(@"Packet loss on %@: %lu samples missing after counter %u", address, (unsigned long)missing, (unsigned int)last.packageCounter);
+                }
+            }
+        }
+        state.lastSample = sample;
+        state.hasLastSample = YES;
+        state.stats.received += 1;
+    }
+    [self.store appendSample:sample forAddress:address];
+}
+
+- (void)restartStreamForAddress:(NSString *)address
+{
+    PacketLossDeviceState *state = [self stateForAddress:address];
+    @synchronized (state)
+    {
+        state.hasLastSample = NO;
+    }
+    [self.store markGapForAddress:address];
+}
+
+- (void)noteReconnectForAddress:(NSString *)address
+{
+    PacketLossDeviceState *state = [self stateForAddress:address];
+    @synchronized (state)
+    {
+        state.stats.reconnects += 1;
+        state.reconnectTime = [NSProcessInfo processInfo].systemUptime;
+    }
+}
+
+- (PacketLossStats *)statsForAddress:(NSString *)address
+{
+    return [self stateForAddress:address].stats;
+}
+
+- (BOOL)isTrustworthy
+{
+    @synchronized (self.states)
+    {
+        for (PacketLossDeviceState *state in self.states.allValues)
+        {
+            if (state.stats.longGaps > 0 || [state.stats lossRate] > self.maxTrustedLossRate)
+            {
+                return NO;
+            }
+        }
+    }
+    return YES;
+}
+
+- (NSDictionary<NSString *, NSDictionary *> *)summary
+{
+    NSMutableDictionary *summary = [NSMutableDictionary dictionary];
+    @synchronized (self.states)
+    {
+        for (NSString *address in self.states)
+        {
+            summary[address] = [self.states[address].stats dictionaryRepresentation];
+        }
+    }
+    return summary;
+}
+
+@end
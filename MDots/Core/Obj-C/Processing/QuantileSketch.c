@@ -0,0 +1,228 @@
+//
+//  QuantileSketch.c
+//  MDots
+//
+//  Created by Estela Alvarez on 18/10/26.
+//
+
+#include "QuantileSketch.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+#ifndef M_PI_2
+#define M_PI_2 1.57079632679489661923
+#endif
+
+static int CompareCentroids(const void *a, const void *b)
+{
+    double x = ((const QuantileCentroid *)a)->mean, y = ((const QuantileCentroid *)b)->mean;
+    return (x > y) - (x < y);
+}
+
+/// The arcsine scale function k(q) = compression / (2 pi) * asin(2q - 1)
+static double ScaleK(double q, double compression)
+{
+    return compression / (2.0 * M_PI) * asin(2.0 * q - 1.0);
+}
+
+/// The inverse of the scale function
+static double ScaleQ(double k, double compression)
+{
+    double s = k * 2.0 * M_PI / compression;
+    if (s >= M_PI_2)
+    {
+        return 1.0;
+    }
+    return (sin(s) + 1.0) / 2.0;
+}
+
+void QuantileSketchInit(QuantileSketchState *state, double compression)
+{
+    state->compression = fmin(fmax(compression, 10.0), QUANTILE_SKETCH_CAPACITY / 2);
+    state->totalWeight = 0.0;
+    state->min = INFINITY;
+    state->max = -INFINITY;
+    state->count = 0;
+    state->buffered = 0;
+}
+
+void QuantileSketchFlush(QuantileSketchState *state)
+{
+    if (state->buffered == 0)
+    {
+        return;
+    }
+    QuantileCentroid sorted[QUANTILE_SKETCH_CAPACITY + QUANTILE_SKETCH_BUFFER];
+    size_t n = state->count;
+    memcpy(sorted, state->centroids, n * sizeof(QuantileCentroid));
+    memcpy(sorted + n, state->buffer, state->buffered * sizeof(QuantileCentroid));
+    n += state->buffered;
+    state->buffered = 0;
+    qsort(sorted, n, sizeof(QuantileCentroid), CompareCentroids);
+    
+    // Greedy merge: a centroid grows while its quantile range spans at most one unit of k
+    double total = state->totalWeight;
+    double before = 0.0;
+    double limit = total * ScaleQ(ScaleK(0.0, state->compression) + 1.0, state->compression);
+    QuantileCentroid current = sorted[0];
+    size_t count = 0;
+    for (size_t i = 1; i < n; i++)
+    {
+        if (before + current.weight + sorted[i].weight <= limit && count < QUANTILE_SKETCH_CAPACITY - 1)
+        {
+            current.weight += sorted[i].weight;
+            current.mean += (sorted[i].mean - current.mean) * sorted[i].weight / current.weight;
+        }
+        else
+        {
+            state->centroids[count++] = current;
+            before += current.weight;
+            limit = total * ScaleQ(ScaleK(before / total, state->compression) + 1.0, state->compression);
+            current = sorted[i];
+        }
+    }
+    state->centroids[count++] = current;
+    state->count = count;
+    double cumulative = 0.0;
+    for (size_t i = 0; i < count; i++)
+    {
+        state->cumulative[i] = cumulative;
+        cumulative += state->centroids[i].weight;
+    }
+}
+
+void QuantileSketchAdd(QuantileSketchState *state, double value, double weight)
+{
+    if (!isfinite(value) || !(weight > 0.0))
+    {
+        return;
+    }
+    if (state->buffered == QUANTILE_SKETCH_BUFFER)
+    {
+        QuantileSketchFlush(state);
+    }
+    state->buffer[state->buffered].mean = value;
+    state->buffer[state->buffered].weight = weight;
+    state->buffered++;
+    state->totalWeight += weight;
+    state->min = fmin(state->min, value);
+    state->max = fmax(state->max, value);
+}
+
+void QuantileSketchMerge(QuantileSketchState *state, const QuantileSketchState *other)
+{
+    const QuantileCentroid *sources[2] = { other->centroids, other->buffer };
+    size_t counts[2] = { other->count, other->buffered };
+    for (int s = 0; s < 2; s++)
+    {
+        for (size_t i = 0; i < counts[s]; i++)
+        {
+            QuantileSketchAdd(state, sources[s][i].mean, sources[s][i].weight);
+        }
+    }
+    // The other extremes may lie inside its centroids
+    if (other->totalWeight > 0.0)
+    {
+        state->min = fmin(state->min, other->min);
+        state->max = fmax(state->max, other->max);
+    }
+}
+
+double QuantileSketchWeight(const QuantileSketchState *state)
+{
+    return state->totalWeight;
+}
+
+double QuantileSketchQuantile(const QuantileSketchState *state, double q)
+{
+    size_t n = state->count;
+    if (n == 0)
+    {
+        return NAN;
+    }
+    q = fmin(fmax(q, 0.0), 1.0);
+    double target = q * state->totalWeight;
+    // Each centroid is taken as centered on its mean; the ends interpolate to min and max
+    double firstCenter = state->centroids[0].weight / 2.0;
+    if (target <= firstCenter)
+    {
+        return state->min + (state->centroids[0].mean - state->min) * (firstCenter > 0.0 ? target / firstCenter : 0.0);
+    }
+    double lastCenter = state->cumulative[n - 1] + state->centroids[n - 1].weight / 2.0;
+    if (target >= lastCenter)
+    {
+        double tail = state->totalWeight - lastCenter;
+        return state->centroids[n - 1].mean + (state->max - state->centroids[n - 1].mean) * (tail > 0.0 ? (target - lastCenter) / tail : 1.0);
+    }
+    size_t lo = 0, hi = n - 1;
+    while (hi - lo > 1)
+    {
+        size_t mid = (lo + hi) / 2;
+        if (state->cumulative[mid] + state->centroids[mid].weight / 2.0 <= target)
+        {
+            lo = mid;
+        }
+        else
+        {
+            hi = mid;
+        }
+    }
+    double left = state->cumulative[lo] + state->centroids[lo].weight / 2.0;
+    double right = state->cumulative[hi] + state->centroids[hi].weight / 2.0;
+    double t = (target - left) / (right - left);
+    return state->centroids[lo].mean + t * (state->centroids[hi].mean - state->centroids[lo].mean);
+}
+
+double QuantileSketchCdf(const QuantileSketchState *state, double value)
+{
+    size_t n = state->count;
+    if (n == 0)
+    {
+        return NAN;
+    }
+    if (value < state->min)
+    {
+        return 0.0;
+    }
+    if (value >= state->max)
+    {
+        return 1.0;
+    }
+    double total = state->totalWeight;
+    const QuantileCentroid *c = state->centroids;
+    double firstCenter = c[0].weight / 2.0;
+    if (value < c[0].mean)
+    {
+        double span = c[0].mean - state->min;
+        return (span > 0.0 ? (value - state->min) / span : 1.0) * firstCenter / total;
+    }
+    double lastCenter = state->cumulative[n - 1] + c[n - 1].weight / 2.0;
+    if (value >= c[n - 1].mean)
+    {
+        double span = state->max - c[n - 1].mean;
+        return (lastCenter + (span > 0.0 ? (value - c[n - 1].mean) / span : 0.0) * (total - lastCenter)) / total;
+    }
+    // The last centroid whose mean is not above the value
+    size_t lo = 0, hi = n - 1;
+    while (hi - lo > 1)
+    {
+        size_t mid = (lo + hi) / 2;
+        if (c[mid].mean <= value)
+        {
+            lo = mid;
+        }
+        else
+        {
+            hi = mid;
+        }
+    }
+    double left = state->cumulative[lo] + c[lo].weight / 2.0;
+    double right = state->cumulative[hi] + c[hi].weight / 2.0;
+    double span = c[hi].mean - c[lo].mean;
+    double t = span > 0.0 ? (value - c[lo].mean) / span : 0.5;
+    return (left + t * (right - left)) / total;
+}
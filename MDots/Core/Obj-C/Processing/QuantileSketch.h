@@ -0,0 +1,78 @@
+//
+//  QuantileSketch.h
+//  MDots
+//
+//  Created by Estela Alvarez on 18/10/26.
+//
+
+#ifndef QuantileSketch_h
+#define QuantileSketch_h
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// Portable C99 mergeable quantile sketch (merging t-digest with the arcsine scale function).
+/// Values are buffered and merged into weighted centroids that are small near the tails, so extreme
+/// percentiles stay accurate. Two sketches built on different threads merge into one of the same accuracy.
+/// Fixed size, no allocation; a sketch is not thread safe, use one per thread and merge.
+
+/// The most centroids a sketch keeps
+#define QUANTILE_SKETCH_CAPACITY 256
+/// The values buffered before they are merged into the centroids
+#define QUANTILE_SKETCH_BUFFER 512
+
+/// A weighted centroid
+typedef struct
+{
+    double mean;
+    double weight;
+} QuantileCentroid;
+
+/// The state of one sketch
+typedef struct
+{
+    /// The accuracy parameter, at most QUANTILE_SKETCH_CAPACITY / 2
+    double compression;
+    double totalWeight;
+    double min;
+    double max;
+    /// Merged centroids, sorted by mean
+    size_t count;
+    QuantileCentroid centroids[QUANTILE_SKETCH_CAPACITY];
+    /// Weight of the centroids before each one, valid once flushed
+    double cumulative[QUANTILE_SKETCH_CAPACITY];
+    /// Values not merged yet
+    size_t buffered;
+    QuantileCentroid buffer[QUANTILE_SKETCH_BUFFER];
+} QuantileSketchState;
+
+/// Resets a sketch.
+/// @param compression The accuracy parameter, e.g. 100 (about 1% of a percentile at the median and far better at the tails).
+void QuantileSketchInit(QuantileSketchState *state, double compression);
+
+/// Adds one value.
+void QuantileSketchAdd(QuantileSketchState *state, double value, double weight);
+
+/// Adds every value of another sketch.
+void QuantileSketchMerge(QuantileSketchState *state, const QuantileSketchState *other);
+
+/// Merges the buffered values so the sketch can be queried.
+void QuantileSketchFlush(QuantileSketchState *state);
+
+/// The total weight added.
+double QuantileSketchWeight(const QuantileSketchState *state);
+
+/// The value at a quantile, in [0, 1]. Needs a flushed sketch. NAN if empty.
+double QuantileSketchQuantile(const QuantileSketchState *state, double q);
+
+/// The share of the weight below a value, in [0, 1], by binary search over the centroids. Needs a flushed sketch. NAN if empty.
+double QuantileSketchCdf(const QuantileSketchState *state, double value);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* QuantileSketch_h */
@@ -0,0 +1,62 @@
+//
+//  RepetitionCounter.h
+//  MDots
+//
+//  Created by Estela Alvarez on 18/10/26.
+//
+
+#import <Foundation/Foundation.h>
+#import "SessionStore.h"
+#import "RepetitionSegmenter.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+/// Extracts the test metric from a sample, e.g. the absolute pitch for a lunge.
+typedef double (^RepetitionMetricBlock)(const SessionSample *sample);
+
+/// @class RepetitionCounter
+/// @discussion Segments the repetitions of a multi-repetition trial as the samples of one device stream in (`RepetitionSegmenter.c`), so the best repetition is kept whenever STOP is tapped. Samples must be added from one queue at a time; `count` can be read from any thread.
+@interface RepetitionCounter : NSObject
+
+/// The number of repetitions detected so far.
+@property (assign, atomic, readonly) NSUInteger count;
+
+/// The metric of the Lunge test: the absolute pitch of the thigh, in degrees.
++ (RepetitionMetricBlock)lungeMetric;
+
+/// Creates a counter with the default parameters.
+/// @param metric The test metric.
+/// ```objc
+/// RepetitionCounter *counter = [[RepetitionCounter alloc] initWithMetric:[RepetitionCounter lungeMetric]];
+/// ```
+- (instancetype)initWithMetric:(RepetitionMetricBlock)metric;
+
+/// Creates a counter.
+/// @param metric The test metric.
+/// @param params The segmenter parameters, in the unit of the metric.
+- (instancetype)initWithMetric:(RepetitionMetricBlock)metric params:(RepetitionSegmenterParams)params NS_DESIGNATED_INITIALIZER;
+
+- (instancetype)init NS_UNAVAILABLE;
+
+/// Adds one sample.
+/// @param sample The sample.
+/// @return YES if the sample completed a repetition.
+- (BOOL)addSample:(const SessionSample *)sample;
+
+/// Adds every stored sample of a device, e.g. after a recording is exported.
+/// @param store The session store.
+/// @param address The device mac address.
+- (void)addSamplesFromStore:(SessionStore *)store address:(NSString *)address;
+
+/// The metric value of the highest repetition.
+/// @param value The peak value out.
+/// @return NO if no repetition was detected.
+- (BOOL)getBestPeak:(double *)value;
+
+/// The repetitions for upload: count, best and median (indexes into reps), and per repetition its peak, amplitude, duration and symmetry.
+/// @return The summary, or nil if no repetition was detected.
+- (nullable NSDictionary<NSString *, id> *)summary;
+
+@end
+
+NS_ASSUME_NONNULL_END
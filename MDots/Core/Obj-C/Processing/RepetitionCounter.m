@@ -0,0 +1,114 @@
+//
+//  RepetitionCounter.m
+//  MDots
+//
+//  Created by Estela Alvarez on 18/10/26.
+//
+
+#import "RepetitionCounter.h"
+
+@interface RepetitionCounter ()
+{
+    RepetitionSegmenterState _state;
+}
+
+@property (assign, atomic) NSUInteger count;
+@property (copy, nonatomic) RepetitionMetricBlock metric;
+@property (assign, nonatomic) BOOL started;
+@property (assign, nonatomic) UInt32 lastTimeStamp;
+/// Seconds since the first sample
+@property (assign, nonatomic) double time;
+
+@end
+
+@implementation RepetitionCounter
+
++ (RepetitionMetricBlock)lungeMetric
+{
+    return ^double(const SessionSample *sample) {
+        return fabs(sample->euler[1]);
+    };
+}
+
+- (instancetype)initWithMetric:(RepetitionMetricBlock)metric
+{
+    RepetitionSegmenterParams params;
+    RepetitionSegmenterParamsDefault(&params);
+    return [self initWithMetric:metric params:params];
+}
+
+- (instancetype)initWithMetric:(RepetitionMetricBlock)metric params:(RepetitionSegmenterParams)params
+{
+    if (self = [super init])
+    {
+        _metric = [metric copy];
+        RepetitionSegmenterInit(&_state, &params);
+    }
+    return self;
+}
+
+- (BOOL)addSample:(const SessionSample *)sample
+{
+    if (self.started)
+    {
+        // Timestamps are in microseconds and wrap around
+        self.time += (UInt32)(sample->timeStamp - self.lastTimeStamp) * 1e-6;
+    }
+    self.started = YES;
+    self.lastTimeStamp = sample->timeStamp;
+    if (!RepetitionSegmenterAdd(&_state, self.time, self.metric(sample)))
+    {
+        return NO;
+    }
+    self.count = _state.count;
+    return YES;
+}
+
+- (void)addSamplesFromStore:(SessionStore *)store address:(NSString *)address
+{
+    [store enumerateSamplesForAddress:address usingBlock:^(const SessionSample *samples, NSUInteger count) {
+        for (NSUInteger i = 0; i < count; i++)
+        {
+            [self addSample:&samples[i]];
+        }
+    }];
+}
+
+- (BOOL)getBestPeak:(double *)value
+{
+    long best = RepetitionSegmenterBestIndex(&_state);
+    if (best < 0)
+    {
+        return NO;
+    }
+    *value = _state.reps[best].peakValue;
+    return YES;
+}
+
+- (nullable NSDictionary<NSString *, id> *)summary
+{
+    size_t recorded = RepetitionSegmenterRecordedCount(&_state);
+    if (recorded == 0)
+    {
+        return nil;
+    }
+    NSMutableArray *reps = [NSMutableArray arrayWithCapacity:recorded];
+    for (size_t i = 0; i < recorded; i++)
+    {
+        const RepetitionRecord *rep = &_state.reps[i];
+        [reps addObject:@{
+            @"peak": @(rep->peakValue),
+            @"amplitude": @(rep->amplitude),
+            @"duration": @(rep->endTime - rep->startTime),
+            @"symmetry": @(rep->symmetry),
+        }];
+    }
+    return @{
+        @"count": @(_state.count),
+        @"best": @(RepetitionSegmenterBestIndex(&_state)),
+        @"median": @(RepetitionSegmenterMedianIndex(&_state)),
+        @"reps": reps,
+    };
+}
+
+@end
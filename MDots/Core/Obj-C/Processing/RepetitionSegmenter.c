@@ -0,0 +1,193 @@
+//
+//  RepetitionSegmenter.c
+//  MDots
+//
+//  Created by Estela Alvarez on 18/10/26.
+//
+
+#include "RepetitionSegmenter.h"
+#include <math.h>
+#include <string.h>
+
+/// The phases of a repetition
+enum
+{
+    /// At rest, following the bottom of the signal
+    kPhaseRest = 0,
+    /// Above enterThreshold, following the peak
+    kPhaseActive,
+    /// Back within exitThreshold, waiting for the signal to stop falling
+    kPhaseSettling,
+};
+
+void RepetitionSegmenterParamsDefault(RepetitionSegmenterParams *params)
+{
+    params->enterThreshold = 15.0;
+    params->exitThreshold = 5.0;
+    params->restRate = 3.0;
+    params->smoothing = 0.08;
+    params->minDuration = 0.4;
+}
+
+void RepetitionSegmenterInit(RepetitionSegmenterState *state, const RepetitionSegmenterParams *params)
+{
+    memset(state, 0, sizeof(*state));
+    state->params = *params;
+    state->phase = kPhaseRest;
+}
+
+/// Records the current repetition.
+/// @return 1 if it was long enough to keep.
+static int FinishRepetition(RepetitionSegmenterState *state, double time)
+{
+    double duration = time - state->onsetTime;
+    if (duration < state->params.minDuration)
+    {
+        return 0;
+    }
+    if (state->count < REPETITION_SEGMENTER_MAX_REPS)
+    {
+        RepetitionRecord *rep = &state->reps[state->count];
+        double rise = state->peakTime - state->onsetTime;
+        double fall = time - state->peakTime;
+        rep->startTime = state->onsetTime;
+        rep->peakTime = state->peakTime;
+        rep->endTime = time;
+        rep->startValue = state->onsetValue;
+        rep->peakValue = state->peakValue;
+        rep->amplitude = state->peakValue - state->onsetValue;
+        rep->symmetry = (rise > 0.0 && fall > 0.0) ? fmin(rise, fall) / fmax(rise, fall) : 0.0;
+    }
+    state->count++;
+    return 1;
+}
+
+int RepetitionSegmenterAdd(RepetitionSegmenterState *state, double time, double value)
+{
+    if (!state->initialized)
+    {
+        state->initialized = 1;
+        state->lastTime = time;
+        state->smoothed = value;
+        state->derivative = 0.0;
+        state->onsetTime = time;
+        state->onsetValue = value;
+        return 0;
+    }
+    double dt = time - state->lastTime;
+    if (dt <= 0.0)
+    {
+        return 0;
+    }
+    state->lastTime = time;
+    
+    // One pole low pass on the signal, then on its finite difference
+    double alpha = dt / (state->params.smoothing + dt);
+    double previous = state->smoothed;
+    state->smoothed += alpha * (value - state->smoothed);
+    double previousDerivative = state->derivative;
+    state->derivative += alpha * ((state->smoothed - previous) / dt - state->derivative);
+    int risingCrossing = previousDerivative <= 0.0 && state->derivative > 0.0;
+    int fallingCrossing = previousDerivative > 0.0 && state->derivative <= 0.0;
+    double s = state->smoothed;
+    
+    switch (state->phase)
+    {
+        case kPhaseRest:
+            // The start is the bottom the signal last rose from
+            if (s < state->onsetValue || risingCrossing)
+            {
+                state->onsetTime = time;
+                state->onsetValue = s;
+            }
+            if (s - state->onsetValue > state->params.enterThreshold)
+            {
+                state->phase = kPhaseActive;
+                state->peakTime = time;
+                state->peakValue = s;
+            }
+            return 0;
+        case kPhaseActive:
+            if (fallingCrossing && s > state->peakValue)
+            {
+                state->peakTime = time;
+                state->peakValue = s;
+            }
+            else if (s > state->peakValue && state->derivative > 0.0)
+            {
+                // Still climbing, the falling crossing will confirm the peak
+                state->peakTime = time;
+                state->peakValue = s;
+            }
+            if (s - state->onsetValue < state->params.exitThreshold)
+            {
+                state->phase = kPhaseSettling;
+            }
+            return 0;
+        default:
+        {
+            if (s - state->onsetValue > state->params.enterThreshold)
+            {
+                // Rose again before coming to rest, same repetition
+                state->phase = kPhaseActive;
+                return 0;
+            }
+            if (state->derivative < -state->params.restRate)
+            {
+                return 0;
+            }
+            int kept = FinishRepetition(state, time);
+            state->phase = kPhaseRest;
+            state->onsetTime = time;
+            state->onsetValue = s;
+            return kept;
+        }
+    }
+}
+
+size_t RepetitionSegmenterRecordedCount(const RepetitionSegmenterState *state)
+{
+    return state->count < REPETITION_SEGMENTER_MAX_REPS ? state->count : REPETITION_SEGMENTER_MAX_REPS;
+}
+
+long RepetitionSegmenterBestIndex(const RepetitionSegmenterState *state)
+{
+    long best = -1;
+    size_t recorded = RepetitionSegmenterRecordedCount(state);
+    for (size_t i = 0; i < recorded; i++)
+    {
+        if (best < 0 || state->reps[i].amplitude > state->reps[best].amplitude)
+        {
+            best = (long)i;
+        }
+    }
+    return best;
+}
+
+long RepetitionSegmenterMedianIndex(const RepetitionSegmenterState *state)
+{
+    size_t recorded = RepetitionSegmenterRecordedCount(state);
+    if (recorded == 0)
+    {
+        return -1;
+    }
+    // The repetition with as many smaller amplitudes as the median rank, ties broken by index
+    size_t rank = (recorded - 1) / 2;
+    for (size_t i = 0; i < recorded; i++)
+    {
+        size_t below = 0;
+        for (size_t j = 0; j < recorded; j++)
+        {
+            double a = state->reps[j].amplitude, b = state->reps[i].amplitude;
+            if (a < b || (a == b && j < i))
+            {
+                below++;
+            }
+        }
+        if (below == rank)
+        {
+            return (long)i;
+        }
+    }
+    return -1;
+}
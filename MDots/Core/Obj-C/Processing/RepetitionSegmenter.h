@@ -0,0 +1,100 @@
+//
+//  RepetitionSegmenter.h
+//  MDots
+//
+//  Created by Estela Alvarez on 18/10/26.
+//
+
+#ifndef RepetitionSegmenter_h
+#define RepetitionSegmenter_h
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// Portable C99 streaming repetition segmentation of a test metric (e.g. the thigh angle of a lunge).
+/// Each sample is smoothed and differentiated; a repetition starts at the last rising zero crossing of the
+/// derivative before the signal climbs enterThreshold above it, peaks at the highest falling zero crossing,
+/// and ends once the signal is back within exitThreshold of its start and has stopped falling.
+/// Constant time per sample, a fixed size record per repetition, no allocation.
+
+/// The most repetitions kept per trial, later ones are counted but not recorded
+#define REPETITION_SEGMENTER_MAX_REPS 64
+
+/// The segmenter parameters
+typedef struct
+{
+    /// Rise above the start value that makes a repetition, in signal units
+    double enterThreshold;
+    /// Distance to the start value under which a repetition is back at rest (below enterThreshold)
+    double exitThreshold;
+    /// Falling rate under which the signal has stopped, in signal units per second
+    double restRate;
+    /// Time constant of the signal and derivative smoothing, in seconds
+    double smoothing;
+    /// Shortest repetition kept, in seconds
+    double minDuration;
+} RepetitionSegmenterParams;
+
+/// One repetition
+typedef struct
+{
+    double startTime;
+    double peakTime;
+    double endTime;
+    double startValue;
+    double peakValue;
+    /// Peak rise over the start value
+    double amplitude;
+    /// Shorter over longer of the rise and fall times, 1 for a symmetric repetition
+    double symmetry;
+} RepetitionRecord;
+
+/// The state of one signal
+typedef struct
+{
+    RepetitionSegmenterParams params;
+    int phase;
+    int initialized;
+    double lastTime;
+    double smoothed;
+    double derivative;
+    /// Candidate start: the bottom before the current rise
+    double onsetTime;
+    double onsetValue;
+    double peakTime;
+    double peakValue;
+    /// Repetitions detected, may exceed REPETITION_SEGMENTER_MAX_REPS
+    size_t count;
+    RepetitionRecord reps[REPETITION_SEGMENTER_MAX_REPS];
+} RepetitionSegmenterState;
+
+/// Fills in the default parameters for angles in degrees (enter 15, exit 5, rest rate 3 /s, smoothing 0.08 s, min duration 0.4 s).
+void RepetitionSegmenterParamsDefault(RepetitionSegmenterParams *params);
+
+/// Resets a segmenter.
+void RepetitionSegmenterInit(RepetitionSegmenterState *state, const RepetitionSegmenterParams *params);
+
+/// Adds one sample.
+/// @param state The segmenter.
+/// @param time The sample time in seconds, increasing.
+/// @param value The metric value.
+/// @return 1 if the sample completed a repetition, then the last recorded one.
+int RepetitionSegmenterAdd(RepetitionSegmenterState *state, double time, double value);
+
+/// The number of recorded repetitions (at most REPETITION_SEGMENTER_MAX_REPS).
+size_t RepetitionSegmenterRecordedCount(const RepetitionSegmenterState *state);
+
+/// The index of the recorded repetition with the largest amplitude, or -1 if there is none.
+long RepetitionSegmenterBestIndex(const RepetitionSegmenterState *state);
+
+/// The index of the recorded repetition with the median amplitude (the lower one for an even count), or -1 if there is none.
+long RepetitionSegmenterMedianIndex(const RepetitionSegmenterState *state);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* RepetitionSegmenter_h */
@@ -0,0 +1,117 @@
+//
+//  RobustStatistics.c
+//  MDots
+//
+//  Created by Estela Alvarez on 18/10/26.
+//
+
+#include "RobustStatistics.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+static int CompareDoubles(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+/// The median of values already sorted.
+static double SortedMedian(const double *sorted, size_t count)
+{
+    return count % 2 ? sorted[count / 2] : 0.5 * (sorted[count / 2 - 1] + sorted[count / 2]);
+}
+
+double RobustMedian(const double *values, size_t count, double *scratch)
+{
+    memcpy(scratch, values, count * sizeof(double));
+    qsort(scratch, count, sizeof(double), CompareDoubles);
+    return SortedMedian(scratch, count);
+}
+
+size_t RobustRejectOutliers(const double *values, size_t count, double threshold, unsigned char *accepted, double *scratch)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        accepted[i] = 1;
+    }
+    if (count < 3)
+    {
+        return count;
+    }
+    double median = RobustMedian(values, count, scratch);
+    double meanDeviation = 0.0;
+    for (size_t i = 0; i < count; i++)
+    {
+        scratch[i] = fabs(values[i] - median);
+        meanDeviation += scratch[i];
+    }
+    meanDeviation /= (double)count;
+    qsort(scratch, count, sizeof(double), CompareDoubles);
+    double mad = SortedMedian(scratch, count);
+    // Both scales make a normal sample's deviations comparable to its standard deviation
+    double scale = mad > 0.0 ? mad / 0.6745 : meanDeviation * 1.253314;
+    if (scale <= 0.0)
+    {
+        return count;
+    }
+    size_t kept = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        accepted[i] = fabs(values[i] - median) / scale <= threshold;
+        kept += accepted[i];
+    }
+    return kept;
+}
+
+int RobustSummarize(const double *values, const unsigned char *accepted, size_t count, double trimFraction, RobustSummary *summary, double *scratch)
+{
+    size_t n = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        if (accepted == NULL || accepted[i])
+        {
+            scratch[n++] = values[i];
+        }
+    }
+    memset(summary, 0, sizeof(*summary));
+    if (n == 0)
+    {
+        return 0;
+    }
+    qsort(scratch, n, sizeof(double), CompareDoubles);
+    summary->accepted = n;
+    summary->median = SortedMedian(scratch, n);
+    
+    double sum = 0.0;
+    for (size_t i = 0; i < n; i++)
+    {
+        sum += scratch[i];
+    }
+    summary->mean = sum / (double)n;
+    double squares = 0.0;
+    for (size_t i = 0; i < n; i++)
+    {
+        double d = scratch[i] - summary->mean;
+        squares += d * d;
+    }
+    summary->standardDeviation = n > 1 ? sqrt(squares / (double)(n - 1)) : 0.0;
+    summary->coefficientOfVariation = summary->mean != 0.0 ? summary->standardDeviation / fabs(summary->mean) : 0.0;
+    
+    if (trimFraction < 0.0)
+    {
+        trimFraction = 0.0;
+    }
+    size_t cut = (size_t)floor(trimFraction * (double)n);
+    if (2 * cut >= n)
+    {
+        cut = (n - 1) / 2;
+    }
+    double trimmed = 0.0;
+    for (size_t i = cut; i < n - cut; i++)
+    {
+        trimmed += scratch[i];
+    }
+    summary->trimmedMean = trimmed / (double)(n - 2 * cut);
+    return 1;
+}
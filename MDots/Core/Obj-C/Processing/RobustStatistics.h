@@ -0,0 +1,61 @@
+//
+//  RobustStatistics.h
+//  MDots
+//
+//  Created by Estela Alvarez on 18/10/26.
+//
+
+#ifndef RobustStatistics_h
+#define RobustStatistics_h
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// Portable C99 robust statistics for the handful of values of repeated trials. No allocation, the caller passes the scratch space.
+
+/// The summary of the accepted values
+typedef struct
+{
+    double median;
+    double trimmedMean;
+    double mean;
+    double standardDeviation;
+    /// Standard deviation over the absolute mean, 0 if the mean is 0
+    double coefficientOfVariation;
+    size_t accepted;
+} RobustSummary;
+
+/// The median of some values.
+/// @param values The values (count).
+/// @param count The number of values, > 0.
+/// @param scratch Work space (count), sorted on return.
+double RobustMedian(const double *values, size_t count, double *scratch);
+
+/// Flags the outliers by their modified z-score 0.6745 * |x - median| / MAD, with the mean absolute deviation
+/// (times 1.2533) standing in when more than half of the values are equal. Nothing is rejected below 3 values.
+/// @param values The values (count).
+/// @param count The number of values.
+/// @param threshold The modified z-score above which a value is an outlier, 3.5 is customary.
+/// @param accepted Out (count): 1 for a kept value, 0 for an outlier.
+/// @param scratch Work space (count).
+/// @return The number of kept values.
+size_t RobustRejectOutliers(const double *values, size_t count, double threshold, unsigned char *accepted, double *scratch);
+
+/// Summarizes the accepted values.
+/// @param values The values (count).
+/// @param accepted The flags of RobustRejectOutliers (count), or NULL to take every value.
+/// @param count The number of values.
+/// @param trimFraction The share of values cut from each end for the trimmed mean, from 0 to 0.5.
+/// @param summary The summary out.
+/// @param scratch Work space (count).
+/// @return 0 if no value is accepted.
+int RobustSummarize(const double *values, const unsigned char *accepted, size_t count, double trimFraction, RobustSummary *summary, double *scratch);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* RobustStatistics_h */
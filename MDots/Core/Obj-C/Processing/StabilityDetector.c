@@ -0,0 +1,112 @@
+//
+//  StabilityDetector.c
+//  MDots
+//
+//  Created by Estela Alvarez on 18/10/26.
+//
+
+#include "StabilityDetector.h"
+#include <math.h>
+#include <string.h>
+
+void StabilityDetectorParamsDefault(StabilityDetectorParams *params)
+{
+    params->window = 1.5;
+    params->maxStdDev = 1.0;
+    params->maxSlope = 1.0;
+    params->minExcursion = 10.0;
+}
+
+void StabilityDetectorInit(StabilityDetectorState *state, const StabilityDetectorParams *params)
+{
+    memset(state, 0, sizeof(*state));
+    state->params = *params;
+}
+
+/// Recomputes the running sums from the window, called every capacity samples.
+static void RefreshSums(StabilityDetectorState *state)
+{
+    double sum = 0.0, sumOfSquares = 0.0, sumOfTimes = 0.0, sumOfTimeSquares = 0.0, sumOfProducts = 0.0;
+    for (size_t i = 0; i < state->count; i++)
+    {
+        size_t index = (state->head + i) % STABILITY_DETECTOR_CAPACITY;
+        double v = state->values[index];
+        double t = state->times[index] - state->startTime;
+        sum += v;
+        sumOfSquares += v * v;
+        sumOfTimes += t;
+        sumOfTimeSquares += t * t;
+        sumOfProducts += t * v;
+    }
+    state->sum = sum;
+    state->sumOfSquares = sumOfSquares;
+    state->sumOfTimes = sumOfTimes;
+    state->sumOfTimeSquares = sumOfTimeSquares;
+    state->sumOfProducts = sumOfProducts;
+    state->sinceRefresh = 0;
+}
+
+int StabilityDetectorAdd(StabilityDetectorState *state, double time, double value, double *heldValue)
+{
+    if (!state->initialized)
+    {
+        state->initialized = 1;
+        state->startValue = value;
+        state->startTime = time;
+    }
+    double v = value - state->startValue;
+    double t = time - state->startTime;
+    
+    // Drop the samples older than the window, and the oldest one if the ring is full
+    while (state->count > 0
+           && (time - state->times[state->head] > state->params.window || state->count == STABILITY_DETECTOR_CAPACITY))
+    {
+        double old = state->values[state->head];
+        double oldTime = state->times[state->head] - state->startTime;
+        state->sum -= old;
+        state->sumOfSquares -= old * old;
+        state->sumOfTimes -= oldTime;
+        state->sumOfTimeSquares -= oldTime * oldTime;
+        state->sumOfProducts -= oldTime * old;
+        state->head = (state->head + 1) % STABILITY_DETECTOR_CAPACITY;
+        state->count--;
+    }
+    size_t tail = (state->head + state->count) % STABILITY_DETECTOR_CAPACITY;
+    state->times[tail] = time;
+    state->values[tail] = v;
+    state->count++;
+    state->sum += v;
+    state->sumOfSquares += v * v;
+    state->sumOfTimes += t;
+    state->sumOfTimeSquares += t * t;
+    state->sumOfProducts += t * v;
+    if (++state->sinceRefresh >= STABILITY_DETECTOR_CAPACITY)
+    {
+        RefreshSums(state);
+    }
+    
+    // The window must span (nearly) its full length
+    double span = time - state->times[state->head];
+    if (state->count < 2 || span < state->params.window * 0.95)
+    {
+        return 0;
+    }
+    double n = (double)state->count;
+    double mean = state->sum / n;
+    double variance = state->sumOfSquares / n - mean * mean;
+    if (variance > state->params.maxStdDev * state->params.maxStdDev || fabs(mean) < state->params.minExcursion)
+    {
+        return 0;
+    }
+    // A slow movement can stay within maxStdDev over the window, its trend gives it away
+    double timeSpread = n * state->sumOfTimeSquares - state->sumOfTimes * state->sumOfTimes;
+    if (timeSpread > 0.0 && fabs(n * state->sumOfProducts - state->sumOfTimes * state->sum) > state->params.maxSlope * timeSpread)
+    {
+        return 0;
+    }
+    if (heldValue)
+    {
+        *heldValue = mean + state->startValue;
+    }
+    return 1;
+}
@@ -0,0 +1,79 @@
+//
+//  StabilityDetector.h
+//  MDots
+//
+//  Created by Estela Alvarez on 18/10/26.
+//
+
+#ifndef StabilityDetector_h
+#define StabilityDetector_h
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// Portable C99 detection of a held position in a streamed test metric (e.g. the end position of a stretch).
+/// Keeps the mean, variance and trend of the last `window` seconds with running sums over a ring buffer, so each
+/// sample costs constant time. The position is held once the window is full, its standard deviation is
+/// under maxStdDev, its trend under maxSlope, so a slow continuous movement does not trigger, and its mean
+/// is at least minExcursion away from the value the trial started at, so the resting pose before the movement does not trigger.
+/// `Benchmarks/StabilityReplayBench.c` replays synthetic trials to measure the hit and false trigger rates.
+
+/// The most samples a window can hold (2 s at 120 Hz)
+#define STABILITY_DETECTOR_CAPACITY 256
+
+/// The detector parameters
+typedef struct
+{
+    /// How long the position must be held, in seconds
+    double window;
+    /// Largest standard deviation of the metric over the window, in metric units
+    double maxStdDev;
+    /// Largest least squares slope of the metric over the window, in metric units per second
+    double maxSlope;
+    /// Smallest distance of the held position from the start value, in metric units
+    double minExcursion;
+} StabilityDetectorParams;
+
+/// The state of one signal
+typedef struct
+{
+    StabilityDetectorParams params;
+    int initialized;
+    /// The first value, also the offset of the running sums to keep them small
+    double startValue;
+    double times[STABILITY_DETECTOR_CAPACITY];
+    double values[STABILITY_DETECTOR_CAPACITY];
+    size_t head;
+    size_t count;
+    double sum;
+    double sumOfSquares;
+    /// Sums of the times, relative to the first sample, for the slope
+    double sumOfTimes;
+    double sumOfTimeSquares;
+    double sumOfProducts;
+    double startTime;
+    /// Samples since the sums were last recomputed, to bound the rounding drift
+    size_t sinceRefresh;
+} StabilityDetectorState;
+
+/// Fills in the default parameters for angles in degrees (window 1.5 s, max std dev 1.0, max slope 1.0 per second, min excursion 10).
+void StabilityDetectorParamsDefault(StabilityDetectorParams *params);
+
+/// Resets a detector.
+void StabilityDetectorInit(StabilityDetectorState *state, const StabilityDetectorParams *params);
+
+/// Adds one sample.
+/// @param state The detector.
+/// @param time The sample time in seconds, increasing.
+/// @param value The metric value.
+/// @return 1 if the position is held, with the window mean in *heldValue (may be NULL).
+int StabilityDetectorAdd(StabilityDetectorState *state, double time, double value, double *heldValue);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* StabilityDetector_h */
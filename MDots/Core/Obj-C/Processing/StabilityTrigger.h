@@ -0,0 +1,53 @@
+//
+//  StabilityTrigger.h
+//  MDots
+//
+//  Created by Estela Alvarez on 18/10/26.
+//
+
+#import <Foundation/Foundation.h>
+#import "SessionStore.h"
+#import "StabilityDetector.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+/// Extracts the watched metric from a sample.
+typedef double (^StabilityMetricBlock)(const SessionSample *sample);
+
+/// @class StabilityTrigger
+/// @discussion Watches the sensor that moves during a test and fires once the patient holds the end position (`StabilityDetector.c`), so a trial can capture and stop without a STOP tap. Each test has its own kernel: the watched body segment, the metric and the detector parameters. Samples must be added from one queue at a time; `triggered` can be read from any thread.
+@interface StabilityTrigger : NSObject
+
+/// The index of the watched segment in `+[BodySegmentMap requiredSegmentsForTestType:side:]`.
+@property (assign, nonatomic, readonly) NSUInteger segmentIndex;
+
+/// Whether the position was held.
+@property (assign, atomic, readonly) BOOL triggered;
+
+/// The mean metric over the held window, valid once triggered.
+@property (assign, atomic, readonly) double heldValue;
+
+/// The kernel of a test: Sit and Reach watches the pelvis pitch, Lunge the thigh pitch, Hip Rotation the shank roll.
+/// @param testType The test type.
+/// @return The trigger, or nil for a test without a kernel.
+/// ```objc
+/// StabilityTrigger *trigger = [StabilityTrigger triggerForTestType:@"Lunge"];
+/// ```
++ (nullable instancetype)triggerForTestType:(NSString *)testType;
+
+/// Creates a trigger.
+/// @param segmentIndex The index of the watched segment among the test segments.
+/// @param metric The watched metric.
+/// @param params The detector parameters, in the unit of the metric.
+- (instancetype)initWithSegmentIndex:(NSUInteger)segmentIndex metric:(StabilityMetricBlock)metric params:(StabilityDetectorParams)params NS_DESIGNATED_INITIALIZER;
+
+- (instancetype)init NS_UNAVAILABLE;
+
+/// Adds one sample of the watched sensor. Does nothing once triggered.
+/// @param sample The sample.
+/// @return YES for the sample that fires the trigger.
+- (BOOL)addSample:(const SessionSample *)sample;
+
+@end
+
+NS_ASSUME_NONNULL_END
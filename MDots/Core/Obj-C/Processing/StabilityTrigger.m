@@ -0,0 +1,90 @@
+//
+//  StabilityTrigger.m
+//  MDots
+//
+//  Created by Estela Alvarez on 18/10/26.
+//
+
+#import "StabilityTrigger.h"
+
+@interface StabilityTrigger ()
+{
+    StabilityDetectorState _state;
+}
+
+@property (assign, atomic) BOOL triggered;
+@property (assign, atomic) double heldValue;
+@property (copy, nonatomic) StabilityMetricBlock metric;
+@property (assign, nonatomic) BOOL started;
+@property (assign, nonatomic) UInt32 lastTimeStamp;
+/// Seconds since the first sample
+@property (assign, nonatomic) double time;
+
+@end
+
+@implementation StabilityTrigger
+
++ (nullable instancetype)triggerForTestType:(NSString *)testType
+{
+    StabilityDetectorParams params;
+    StabilityDetectorParamsDefault(&params);
+    if ([testType isEqualToString:@"Sit and Reach"])
+    {
+        // The trunk leans forward and stays at full reach
+        params.window = 2.0;
+        return [[StabilityTrigger alloc] initWithSegmentIndex:0 metric:^double(const SessionSample *sample) {
+            return sample->euler[1];
+        } params:params];
+    }
+    else if ([testType isEqualToString:@"Lunge"])
+    {
+        return [[StabilityTrigger alloc] initWithSegmentIndex:0 metric:^double(const SessionSample *sample) {
+            return fabs(sample->euler[1]);
+        } params:params];
+    }
+    else if ([testType isEqualToString:@"Hip Rotation"])
+    {
+        // The shank swings sideways, smaller excursions than the other tests
+        params.minExcursion = 5.0;
+        return [[StabilityTrigger alloc] initWithSegmentIndex:1 metric:^double(const SessionSample *sample) {
+            return sample->euler[0];
+        } params:params];
+    }
+    return nil;
+}
+
+- (instancetype)initWithSegmentIndex:(NSUInteger)segmentIndex metric:(StabilityMetricBlock)metric params:(StabilityDetectorParams)params
+{
+    if (self = [super init])
+    {
+        _segmentIndex = segmentIndex;
+        _metric = [metric copy];
+        StabilityDetectorInit(&_state, &params);
+    }
+    return self;
+}
+
+- (BOOL)addSample:(const SessionSample *)sample
+{
+    if (self.triggered)
+    {
+        return NO;
+    }
+    if (self.started)
+    {
+        // Timestamps are in microseconds and wrap around
+        self.time += (UInt32)(sample->timeStamp - self.lastTimeStamp) * 1e-6;
+    }
+    self.started = YES;
+    self.lastTimeStamp = sample->timeStamp;
+    double held;
+    if (!StabilityDetectorAdd(&_state, self.time, self.metric(sample), &held))
+    {
+        return NO;
+    }
+    self.heldValue = held;
+    self.triggered = YES;
+    return YES;
+}
+
+@end
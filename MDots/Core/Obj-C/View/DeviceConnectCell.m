@@ -9,6 +9,7 @@
 #import "DeviceConnectCell.h"
 #import "UIDeviceCategory.h"
 #import "UIViewCategory.h"
+#import "BodySegmentMap.h"
 #import <MovellaDotSdk/DotDevice.h>
 
 @interface DeviceConnectCell ()
@@ -92,7 +93,15 @@
         case CBPeripheralStateConnected:
         {
             [self.connectButton setOn:YES];
-            self.tagLabel.text = device.displayName;
+            BodySegment segment = [[BodySegmentMap sharedMap] segmentForAddress:device.macAddress];
+            if (segment == BodySegmentUnassigned)
+            {
+                self.tagLabel.text = device.displayName;
+            }
+            else
+            {
+                self.tagLabel.text = [NSString stringWithFormat:@"%@ (%@)", device.displayName, BodySegmentDisplayName(segment)];
+            }
             if (device.battery.chargeState)
             {
                 self.batteryLabel.text = [NSString stringWithFormat:@"%zd%@ Charging" , device.battery.value, @"%"];
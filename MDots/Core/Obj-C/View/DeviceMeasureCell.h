@@ -7,6 +7,7 @@
 
 #import <UIKit/UIKit.h>
 #import <MovellaDotSdk/DotDevice.h>
+#import "SessionStore.h"
 
 NS_ASSUME_NONNULL_BEGIN
 
@@ -15,6 +16,10 @@ NS_ASSUME_NONNULL_BEGIN
 @property (strong, nonatomic) DotDevice *device;
 @property (strong, nonatomic) UILabel *orientationLabel;
 
+/// Shows the orientation of a sample. Must be called on the main queue.
+/// @param sample The sample to show.
+- (void)refreshSample:(SessionSample)sample;
+
 + (NSString *)cellIdentifier;
 + (CGFloat)cellHeight;
 
@@ -8,6 +8,7 @@
 #import "DeviceMeasureCell.h"
 #import "UIDeviceCategory.h"
 #import "UIViewCategory.h"
+#import "BodySegmentMap.h"
 
 @interface DeviceMeasureCell ()
 
@@ -70,18 +71,22 @@
 
 - (void)setDevice:(DotDevice *)device
 {
-    __weak __typeof(self) wself  = self;
     _device = device;
-    self.nameLabel.text = device.displayName;
-    [device setDidParsePlotDataBlock:^(DotPlotData * _Nonnull plotData) {
-        [wself refreshData:plotData];
-    }];
-    
+    BodySegment segment = [[BodySegmentMap sharedMap] segmentForAddress:device.macAddress];
+    if (segment == BodySegmentUnassigned)
+    {
+        self.nameLabel.text = device.displayName;
+    }
+    else
+    {
+        self.nameLabel.text = [NSString stringWithFormat:@"%@ (%@)", device.displayName, BodySegmentDisplayName(segment)];
+    }
+    self.orientationLabel.text = @"-, -, -";
 }
 
-- (void)refreshData:(DotPlotData *)plotData
+- (void)refreshSample:(SessionSample)sample
 {
-    self.orientationLabel.text = [NSString stringWithFormat:@"%f, %f, %f", plotData.euler0, plotData.euler1, plotData.euler2];
+    self.orientationLabel.text = [NSString stringWithFormat:@"%f, %f, %f", sample.euler[0], sample.euler[1], sample.euler[2]];
 }
 
 
@@ -16,6 +16,8 @@ struct MovementData: Codable, Hashable, Identifiable {
     var side: String
     var testDate: Date
     var value: Double
+    /// `false` when packet loss during the trial makes the value unreliable, `nil` for results without loss statistics.
+    var trusted: Bool?
 }
 
 /// View for displaying and managing a patient's movement data history.
@@ -40,7 +42,10 @@ struct HistoryView: View {
                 }
             }
             .onChange(of: testType){ newValue in
-                UserManager.shared.fetchData(patient_id: id, testType: newValue.rawValue) { fetchedData in self.data = fetchedData }
+                UserManager.shared.fetchData(patient_id: id, testType: newValue.rawValue) { fetchedData in
+                    self.data = fetchedData
+                    UserManager.shared.reconcileRollups(patient_id: id, testType: newValue.rawValue, data: fetchedData)
+                }
             }
             .pickerStyle(.menu)
             .padding()
@@ -62,6 +67,10 @@ struct HistoryView: View {
                             Text("Value: \(item.value)")
                                 .padding()
                                 .cornerRadius(8)
+                            if item.trusted == false {
+                                Image(systemName: "exclamationmark.triangle")
+                                    .foregroundColor(.orange)
+                            }
                         }
                         Spacer()
                         Button(action: {
@@ -89,7 +98,10 @@ struct HistoryView: View {
             }
         }
         .onAppear{
-            UserManager.shared.fetchData(patient_id: id, testType: testType.rawValue) { fetchedData in self.data = fetchedData }
+            UserManager.shared.fetchData(patient_id: id, testType: testType.rawValue) { fetchedData in
+                self.data = fetchedData
+                UserManager.shared.reconcileRollups(patient_id: id, testType: testType.rawValue, data: fetchedData)
+            }
         }
         .navigationBarTitleDisplayMode(.inline)
         .padding()
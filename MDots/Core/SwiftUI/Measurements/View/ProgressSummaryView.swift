@@ -0,0 +1,133 @@
+//
+//  ProgressSummaryView.swift
+//  MDots
+//
+//  Created by Estela Alvarez on 18/10/26.
+//
+
+import SwiftUI
+
+/// Model for the rollup summary document of a patient, written by `PatientRollup` with every test.
+struct RollupSummary: Codable {
+    var series: [String: RollupSeries]
+    /// Limb symmetry per test and rotation, keyed by `AsymmetryIndex.pairKey(forTestType:side:)`.
+    var asymmetry: [String: AsymmetrySeries]?
+}
+
+/// Model for the rollup of one test type and side.
+struct RollupSeries: Codable, Hashable {
+    var count: Int
+    var last: Double
+    var lastDate: Date
+    var min: Double
+    var max: Double
+    var mean: Double
+    var ewma: Double
+    /// Least squares trend in degrees per day.
+    var slopePerDay: Double
+    /// Monthly buckets keyed "yyyy-MM".
+    var months: [String: RollupMonth]?
+}
+
+/// Model for the limb symmetry of one test, one value per day both sides were measured.
+struct AsymmetrySeries: Codable, Hashable {
+    var count: Int
+    /// Limb symmetry index of the last pair, 100 * weaker / stronger.
+    var last: Double
+    var lastDate: Date
+    var mean: Double
+    var min: Double
+    /// Least squares trend of the index in percent per day.
+    var slopePerDay: Double
+    var left: Double
+    var right: Double
+    /// Positive when the right side reaches further, in percent.
+    var bias: Double
+}
+
+/// Model for the results of one month.
+struct RollupMonth: Codable, Hashable {
+    var count: Int
+    var mean: Double
+}
+
+/// View summarizing the progress of a patient per test type and side, from the rollup document alone.
+struct ProgressSummaryView: View {
+    let series: [String: RollupSeries]
+    let asymmetry: [String: AsymmetrySeries]
+    /// Percentile of the last result of a series in the cohort, by series key.
+    let percentiles: [String: Double]
+
+    var body: some View {
+        VStack(alignment: .leading, spacing: 8) {
+            Text("Progress:")
+                .foregroundColor(.primary)
+                .font(.headline)
+            if series.isEmpty {
+                Text("No measures yet")
+                    .foregroundColor(.secondary)
+            }
+            ForEach(series.keys.sorted(), id: \.self) { key in
+                if let item = series[key] {
+                    HStack {
+                        Text(formattedKey(key))
+                            .font(.subheadline)
+                        Spacer()
+                        Text("\(formatDouble(value: item.last)) º")
+                            .foregroundColor(.secondary)
+                        Image(systemName: trendSymbol(item.slopePerDay))
+                            .foregroundColor(.blue)
+                        if let percentile = percentiles[key] {
+                            Text("P\(Int(percentile.rounded()))")
+                                .font(.caption)
+                                .foregroundColor(.secondary)
+                        }
+                        Text("(\(item.count))")
+                            .font(.caption)
+                            .foregroundColor(.secondary)
+                    }
+                }
+            }
+            ForEach(asymmetry.keys.sorted(), id: \.self) { key in
+                if let item = asymmetry[key] {
+                    HStack {
+                        Text("\(formattedKey(key)) symmetry")
+                            .font(.subheadline)
+                        Spacer()
+                        Text("\(formatDouble(value: item.last)) %")
+                            .foregroundColor(item.last < 90 ? .orange : .secondary)
+                        Image(systemName: trendSymbol(item.slopePerDay))
+                            .foregroundColor(.blue)
+                        Text("L \(formatDouble(value: item.left)) º / R \(formatDouble(value: item.right)) º")
+                            .font(.caption)
+                            .foregroundColor(.secondary)
+                    }
+                }
+            }
+        }
+    }
+}
+
+extension ProgressSummaryView {
+    /// Formats a series key, e.g. "Lunge:L" as "Lunge L".
+    ///
+    /// - Parameter key: The series key.
+    /// - Returns: A readable name.
+    private func formattedKey(_ key: String) -> String {
+        return key.replacingOccurrences(of: ":", with: " ")
+    }
+
+    /// Picks an arrow for the trend, flat below one degree per month.
+    ///
+    /// - Parameter slopePerDay: The trend in degrees per day.
+    /// - Returns: An SF Symbol name.
+    private func trendSymbol(_ slopePerDay: Double) -> String {
+        let slopePerMonth = slopePerDay * 30
+        if slopePerMonth > 1 {
+            return "arrow.up.right"
+        } else if slopePerMonth < -1 {
+            return "arrow.down.right"
+        }
+        return "arrow.right"
+    }
+}
@@ -66,6 +66,8 @@ struct PatientDetailView: View {
             Text(patient.observations)
                 .foregroundColor(.secondary)
             
+            ProgressSummaryView(series: viewModel.rollups, asymmetry: viewModel.asymmetry, percentiles: viewModel.percentiles)
+            
             //let testtype: TestType = .isquio
             
             NavigationLink(destination: HistoryView(id: patient.id ?? "")) {
@@ -140,6 +142,9 @@ struct PatientDetailView: View {
                }
             Spacer()
         }
+        .onAppear {
+            viewModel.loadRollups(patient: patient)
+        }
         .navigationTitle("Patient Details")
         .padding(25)
         .frame(maxWidth: .infinity, alignment: .leading)
@@ -12,6 +12,9 @@ import Foundation
 class PatientDetailViewModel: ObservableObject {
     
     @Published private(set) var user: DBUser? = nil
+    @Published private(set) var rollups: [String: RollupSeries] = [:]
+    @Published private(set) var asymmetry: [String: AsymmetrySeries] = [:]
+    @Published private(set) var percentiles: [String: Double] = [:]
     
     /// It fetches the authenticated user's data from the AuthManager and UserManager.
     func loadCurrentUser() async throws {
@@ -28,4 +31,34 @@ class PatientDetailViewModel: ObservableObject {
         
         try await UserManager.shared.deletePatient(user: user, patientID: patientID)
     }
+    
+    /// Loads the rollup series and asymmetry of the patient with a single document read, then places the last results in the cohort.
+    func loadRollups(patient: Patient) {
+        UserManager.shared.fetchRollupSummary(patient_id: patient.id ?? "") { summary in
+            self.rollups = summary?.series ?? [:]
+            self.asymmetry = summary?.asymmetry ?? [:]
+            self.loadPercentiles(patient: patient)
+        }
+    }
+    
+    /// Computes the percentile of the last result of every series among the clinician's patients of the same age and height band.
+    /// The norms of each test type are built once and cached by `CohortAnalytics`.
+    private func loadPercentiles(patient: Patient) {
+        let testTypes = Set(rollups.keys.compactMap { $0.split(separator: ":").first.map(String.init) })
+        for testType in testTypes {
+            CohortAnalytics.shared().loadNorms(forTestType: testType) { norms in
+                guard let norms = norms else {
+                    return
+                }
+                for (key, series) in self.rollups where key.hasPrefix(testType + ":") {
+                    let side = String(key.dropFirst(testType.count + 1))
+                    let age = series.lastDate.timeIntervalSince(patient.birthDate) / (365.25 * 86400)
+                    let percentile = norms.percentile(ofValue: series.last, side: side, age: age, height: Double(patient.height))
+                    if !percentile.isNaN {
+                        self.percentiles[key] = percentile
+                    }
+                }
+            }
+        }
+    }
 }
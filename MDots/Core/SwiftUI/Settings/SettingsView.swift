@@ -26,6 +26,8 @@ struct SettingsView: View {
                 credentialsSection
             }
             
+            exportSection
+            
             Button("Sign out"){
                 Task {
                     do {
@@ -106,6 +108,37 @@ extension SettingsView {
     }
 }
 
+extension SettingsView {
+
+    /// A section for exporting every patient's results to CSV files.
+    private var exportSection: some View {
+        Section {
+            if let progress = viewModel.exportProgress {
+                ProgressView("Exporting...", value: progress)
+                Button("Stop export") {
+                    viewModel.cancelExport()
+                }
+            } else {
+                Button("Export all results") {
+                    viewModel.exportResults(resume: false)
+                }
+                if viewModel.canResumeExport {
+                    Button("Resume export") {
+                        viewModel.exportResults(resume: true)
+                    }
+                }
+            }
+            if !viewModel.exportFiles.isEmpty {
+                ShareLink(items: viewModel.exportFiles) {
+                    Text("Share \(viewModel.exportFiles.count) CSV file(s)")
+                }
+            }
+        } header: {
+            Text("Data")
+        }
+    }
+}
+
 #Preview {
     NavigationStack {
         SettingsView(showSignUpView: .constant(false))
@@ -17,6 +17,17 @@ final class SettingsViewModel : ObservableObject {
     /// The authentication providers available to the current user.
     @Published var authProviders: [AuthProviderOptions] = []
     
+    /// The progress of the bulk export, `nil` when no export is running.
+    @Published var exportProgress: Float? = nil
+    
+    /// The CSV files of the last finished export.
+    @Published var exportFiles: [URL] = []
+    
+    /// Whether an interrupted export can be resumed.
+    @Published var canResumeExport = BulkExporter.resumableExport() != nil
+    
+    private let exporter = BulkExporter(testTypes: TestType.allCases.map { $0.rawValue })
+    
     /// Retrieves the authentication providers for the current user
     func getAuthProviders() {
         if let providers = try? AuthManager.shared.getProviders() {
@@ -67,6 +78,32 @@ final class SettingsViewModel : ObservableObject {
 
     }
     
+    /// Exports every test of every patient to CSV files, or resumes the last interrupted export.
+    ///
+    /// - Parameter resume: Whether to resume the last interrupted export.
+    func exportResults(resume: Bool) {
+        exportProgress = 0
+        exportFiles = []
+        exporter.export(toDirectory: resume ? BulkExporter.resumableExport() : nil, progress: { [weak self] progress in
+            self?.exportProgress = progress
+        }) { [weak self] directory, error in
+            self?.exportProgress = nil
+            self?.canResumeExport = BulkExporter.resumableExport() != nil
+            if let error = error {
+                print(error)
+            }
+            if let directory = directory {
+                let files = (try? FileManager.default.contentsOfDirectory(at: directory, includingPropertiesForKeys: nil)) ?? []
+                self?.exportFiles = files.filter { $0.pathExtension == "csv" }.sorted { $0.lastPathComponent < $1.lastPathComponent }
+            }
+        }
+    }
+    
+    /// Stops the running export, which can be resumed later.
+    func cancelExport() {
+        exporter.cancel()
+    }
+    
     /// Reauthenticates the current user with the specified password asynchronously.
     ///
     /// - Parameter password: The password for reauthentication.
@@ -0,0 +1,430 @@
+//
+//  AnimatedImageView.swift
+//  MDots
+//
+//  Created by Estela Alvarez on 18/10/26.
+//
+
+import Foundation
+import ImageIO
+import UIKit
+
+/// A least recently used cache of decoded animation frames, shared by every `AnimatedImageView`.
+///
+/// The cache is bounded by the bytes of the decoded frames rather than their number, and is emptied on a memory warning.
+final class AnimatedFrameCache {
+
+    static let shared = AnimatedFrameCache()
+
+    /// The most decoded bytes kept. Defaults to 32 MB.
+    var costLimit = 32 * 1024 * 1024 {
+        didSet {
+            lock.lock()
+            trim()
+            lock.unlock()
+        }
+    }
+
+    /// A cached frame in the recency list.
+    private final class Node {
+        let key: String
+        let image: CGImage
+        let cost: Int
+        var newer: Node?
+        var older: Node?
+
+        init(key: String, image: CGImage) {
+            self.key = key
+            self.image = image
+            self.cost = image.bytesPerRow * image.height
+        }
+    }
+
+    private var nodes: [String: Node] = [:]
+    private var newest: Node?
+    private var oldest: Node?
+    private var totalCost = 0
+    private let lock = NSLock()
+
+    /// Initializes the shared cache, which empties itself on memory warnings.
+    private init() {
+        NotificationCenter.default.addObserver(forName: UIApplication.didReceiveMemoryWarningNotification, object: nil, queue: nil) { [weak self] _ in
+            self?.removeAll()
+        }
+    }
+
+    /// Returns a cached frame and marks it as the most recently used.
+    ///
+    /// - Parameter key: The frame key.
+    /// - Returns: The frame, or `nil` if it is not cached.
+    func image(forKey key: String) -> CGImage? {
+        lock.lock()
+        defer { lock.unlock() }
+        guard let node = nodes[key] else {
+            return nil
+        }
+        unlink(node)
+        pushNewest(node)
+        return node.image
+    }
+
+    /// Caches a frame, evicting the least recently used ones over the cost limit.
+    ///
+    /// - Parameters:
+    ///   - image: The decoded frame.
+    ///   - key: The frame key.
+    func setImage(_ image: CGImage, forKey key: String) {
+        lock.lock()
+        defer { lock.unlock() }
+        if let node = nodes[key] {
+            unlink(node)
+            totalCost -= node.cost
+        }
+        let node = Node(key: key, image: image)
+        nodes[key] = node
+        totalCost += node.cost
+        pushNewest(node)
+        trim()
+    }
+
+    /// Removes every cached frame.
+    func removeAll() {
+        lock.lock()
+        nodes.removeAll()
+        newest = nil
+        oldest = nil
+        totalCost = 0
+        lock.unlock()
+    }
+
+    private func unlink(_ node: Node) {
+        node.newer?.older = node.older
+        node.older?.newer = node.newer
+        if newest === node {
+            newest = node.older
+        }
+        if oldest === node {
+            oldest = node.newer
+        }
+        node.newer = nil
+        node.older = nil
+    }
+
+    private func pushNewest(_ node: Node) {
+        node.older = newest
+        newest?.newer = node
+        newest = node
+        if oldest == nil {
+            oldest = node
+        }
+    }
+
+    /// Evicts the oldest frames until the cache fits its limit. Called with the lock held.
+    private func trim() {
+        while totalCost > costLimit, let node = oldest {
+            unlink(node)
+            nodes[node.key] = nil
+            totalCost -= node.cost
+        }
+    }
+}
+
+/// The frames of an animated image file, read incrementally with ImageIO.
+///
+/// Only the headers are read when the source is created; each frame is decoded on demand, downsampled to the requested size.
+/// Reads GIF and animated WebP. Not thread safe, use it from one queue.
+final class AnimatedImageSource {
+
+    /// The largest channel spread, out of 255, of a pixel inverted by the tint pass. Matches `Media/transcode.py`.
+    static let neutralThreshold = 40
+
+    /// The number of frames.
+    let frameCount: Int
+    /// The display time of each frame, in seconds.
+    let delays: [TimeInterval]
+    /// The size of the image in pixels.
+    let pixelSize: CGSize
+    private let source: CGImageSource
+
+    /// Opens an animated image file.
+    ///
+    /// - Parameter url: The file URL.
+    init?(url: URL) {
+        guard let source = CGImageSourceCreateWithURL(url as CFURL, [kCGImageSourceShouldCache: false] as CFDictionary),
+              CGImageSourceGetCount(source) > 0 else {
+            return nil
+        }
+        self.source = source
+        self.frameCount = CGImageSourceGetCount(source)
+        var delays: [TimeInterval] = []
+        var pixelSize = CGSize.zero
+        for index in 0..<frameCount {
+            let properties = CGImageSourceCopyPropertiesAtIndex(source, index, nil) as? [CFString: Any]
+            if index == 0 {
+                pixelSize = CGSize(width: properties?[kCGImagePropertyPixelWidth] as? Double ?? 0,
+                                   height: properties?[kCGImagePropertyPixelHeight] as? Double ?? 0)
+            }
+            let delay: Double
+            if let webP = properties?[kCGImagePropertyWebPDictionary] as? [CFString: Any] {
+                delay = webP[kCGImagePropertyWebPUnclampedDelayTime] as? Double ?? webP[kCGImagePropertyWebPDelayTime] as? Double ?? 0.1
+            } else {
+                let gif = properties?[kCGImagePropertyGIFDictionary] as? [CFString: Any]
+                delay = gif?[kCGImagePropertyGIFUnclampedDelayTime] as? Double ?? gif?[kCGImagePropertyGIFDelayTime] as? Double ?? 0.1
+            }
+            // Like browsers, near zero delays play at 10 fps
+            delays.append(delay < 0.011 ? 0.1 : delay)
+        }
+        self.delays = delays
+        self.pixelSize = pixelSize
+    }
+
+    /// Decodes one frame, downsampled so its longest side is at most `maxPixelSize`.
+    ///
+    /// - Parameters:
+    ///   - index: The frame index.
+    ///   - maxPixelSize: The longest side of the decoded frame, in pixels.
+    ///   - tinted: Whether to apply the dark mode tint pass.
+    /// - Returns: The decoded frame.
+    func frame(at index: Int, maxPixelSize: Int, tinted: Bool = false) -> CGImage? {
+        let options: [CFString: Any] = [
+            kCGImageSourceCreateThumbnailFromImageAlways: true,
+            kCGImageSourceCreateThumbnailWithTransform: true,
+            kCGImageSourceShouldCacheImmediately: true,
+            kCGImageSourceThumbnailMaxPixelSize: maxPixelSize
+        ]
+        guard let image = CGImageSourceCreateThumbnailAtIndex(source, index, options as CFDictionary) else {
+            return nil
+        }
+        return tinted ? AnimatedImageSource.tint(image) : image
+    }
+
+    /// The dark mode tint pass: inverts the neutral pixels, the line art, and keeps the colored ones.
+    ///
+    /// - Parameter image: A decoded frame.
+    /// - Returns: The tinted frame.
+    private static func tint(_ image: CGImage) -> CGImage? {
+        let width = image.width
+        let height = image.height
+        guard let context = CGContext(data: nil, width: width, height: height, bitsPerComponent: 8, bytesPerRow: 0,
+                                      space: CGColorSpaceCreateDeviceRGB(),
+                                      bitmapInfo: CGImageAlphaInfo.premultipliedLast.rawValue),
+              let data = context.data else {
+            return nil
+        }
+        context.draw(image, in: CGRect(x: 0, y: 0, width: width, height: height))
+        let bytesPerRow = context.bytesPerRow
+        let pixels = data.bindMemory(to: UInt8.self, capacity: bytesPerRow * height)
+        for y in 0..<height {
+            let row = pixels + y * bytesPerRow
+            for x in 0..<width {
+                let pixel = row + x * 4
+                let r = Int(pixel[0]), g = Int(pixel[1]), b = Int(pixel[2]), a = Int(pixel[3])
+                // Premultiplied, so the threshold scales with alpha and inverting is a - c
+                if max(r, g, b) - min(r, g, b) < neutralThreshold * a / 255 {
+                    pixel[0] = UInt8(a - r)
+                    pixel[1] = UInt8(a - g)
+                    pixel[2] = UInt8(a - b)
+                }
+            }
+        }
+        return context.makeImage()
+    }
+}
+
+/// A view that plays an animated image from the bundle, an animated WebP or a GIF.
+///
+/// Frames are decoded one ahead on a background queue at the size the view is displayed, shared through `AnimatedFrameCache`,
+/// and shown by a display link that only runs while the view is in a window.
+final class AnimatedImageView: UIView {
+
+    /// The display link target, weak so the link does not keep the view alive.
+    private final class DisplayLinkProxy {
+        weak var view: AnimatedImageView?
+
+        init(view: AnimatedImageView) {
+            self.view = view
+        }
+
+        @objc func step(_ link: CADisplayLink) {
+            view?.step(link)
+        }
+    }
+
+    /// The bundle resource shown, without its extension.
+    private(set) var resourceName: String?
+    /// Whether the frames get the dark mode tint pass.
+    private(set) var tinted = false
+    private var source: AnimatedImageSource?
+    private var displayLink: CADisplayLink?
+    private let queue = DispatchQueue(label: "AnimatedImageView", qos: .userInitiated)
+    /// Invalidates the decodes of a previous resource or size
+    private var generation = 0
+    private var frameIndex = 0
+    private var elapsed: TimeInterval = 0
+    private var maxPixelSize = 0
+    private var decoding = false
+    /// The next frame, decoded and waiting for its time
+    private var pendingFrame: (index: Int, image: CGImage)?
+
+    override init(frame: CGRect) {
+        super.init(frame: frame)
+        layer.contentsGravity = .resizeAspect
+        isUserInteractionEnabled = false
+    }
+
+    required init?(coder: NSCoder) {
+        super.init(coder: coder)
+        layer.contentsGravity = .resizeAspect
+    }
+
+    deinit {
+        displayLink?.invalidate()
+    }
+
+    override var intrinsicContentSize: CGSize {
+        return source?.pixelSize ?? CGSize(width: UIView.noIntrinsicMetric, height: UIView.noIntrinsicMetric)
+    }
+
+    /// Shows an animated image of the bundle. Does nothing if it is already shown, so SwiftUI updates never restart the animation.
+    ///
+    /// - Parameters:
+    ///   - name: The resource name, without the extension.
+    ///   - tinted: Whether to apply the dark mode tint pass.
+    func setResource(_ name: String, tinted: Bool = false) {
+        guard name != resourceName || tinted != self.tinted else {
+            return
+        }
+        resourceName = name
+        self.tinted = tinted
+        source = nil
+        resetPlayback()
+        layer.contents = nil
+        let generation = self.generation
+        queue.async { [weak self] in
+            let url = Bundle.main.url(forResource: name, withExtension: "webp") ?? Bundle.main.url(forResource: name, withExtension: "gif")
+            let source = url.flatMap { AnimatedImageSource(url: $0) }
+            DispatchQueue.main.async {
+                guard let self = self, generation == self.generation else {
+                    return
+                }
+                if source == nil {
+                    print("Error: Animated image \(name) not found")
+                }
+                self.source = source
+                self.invalidateIntrinsicContentSize()
+                self.requestFrame(0)
+                self.updateAnimating()
+            }
+        }
+    }
+
+    override func layoutSubviews() {
+        super.layoutSubviews()
+        // Sizes are rounded up so small layout changes reuse the cached frames
+        let scale = window?.screen.scale ?? UIScreen.main.scale
+        let longest = Int((max(bounds.width, bounds.height) * scale).rounded(.up))
+        let size = longest > 0 ? (longest + 63) / 64 * 64 : 0
+        if size != maxPixelSize {
+            maxPixelSize = size
+            generation += 1
+            decoding = false
+            pendingFrame = nil
+            requestFrame(frameIndex)
+        }
+    }
+
+    override func didMoveToWindow() {
+        super.didMoveToWindow()
+        updateAnimating()
+    }
+
+    /// Drops the playback state and the decodes in flight.
+    private func resetPlayback() {
+        generation += 1
+        frameIndex = 0
+        elapsed = 0
+        decoding = false
+        pendingFrame = nil
+    }
+
+    /// Runs the display link while the view is in a window and has more than one frame.
+    private func updateAnimating() {
+        let animating = window != nil && (source?.frameCount ?? 0) > 1
+        if animating && displayLink == nil {
+            let link = CADisplayLink(target: DisplayLinkProxy(view: self), selector: #selector(DisplayLinkProxy.step(_:)))
+            link.preferredFrameRateRange = CAFrameRateRange(minimum: 10, maximum: 30, preferred: 30)
+            link.add(to: .main, forMode: .common)
+            displayLink = link
+        } else if !animating, let link = displayLink {
+            link.invalidate()
+            displayLink = nil
+        }
+    }
+
+    /// Advances the animation once the current frame has been shown for its delay, if the next frame is decoded.
+    private func step(_ link: CADisplayLink) {
+        guard let source = source else {
+            return
+        }
+        elapsed += link.targetTimestamp - link.timestamp
+        guard elapsed >= source.delays[frameIndex] else {
+            return
+        }
+        let next = (frameIndex + 1) % source.frameCount
+        guard let pending = pendingFrame, pending.index == next else {
+            // Late decode: hold the current frame
+            requestFrame(next)
+            return
+        }
+        layer.contents = pending.image
+        pendingFrame = nil
+        elapsed = min(elapsed - source.delays[frameIndex], source.delays[next])
+        frameIndex = next
+        requestFrame((next + 1) % source.frameCount)
+    }
+
+    /// Gets a frame from the shared cache, or decodes it on the background queue.
+    ///
+    /// - Parameter index: The frame index.
+    private func requestFrame(_ index: Int) {
+        guard let source = source, let name = resourceName, maxPixelSize > 0, !decoding else {
+            return
+        }
+        let size = maxPixelSize
+        let tinted = self.tinted
+        let key = "\(name)|\(tinted)|\(size)|\(index)"
+        if let image = AnimatedFrameCache.shared.image(forKey: key) {
+            deliver(image, index: index)
+            return
+        }
+        decoding = true
+        let generation = self.generation
+        queue.async { [weak self] in
+            let image = source.frame(at: index, maxPixelSize: size, tinted: tinted)
+            if let image = image {
+                AnimatedFrameCache.shared.setImage(image, forKey: key)
+            }
+            DispatchQueue.main.async {
+                guard let self = self, generation == self.generation else {
+                    return
+                }
+                self.decoding = false
+                if let image = image {
+                    self.deliver(image, index: index)
+                }
+            }
+        }
+    }
+
+    /// Shows the current frame right away, keeps the next one until its time.
+    private func deliver(_ image: CGImage, index: Int) {
+        if index == frameIndex {
+            layer.contents = image
+            if let source = source, source.frameCount > 1 {
+                requestFrame((index + 1) % source.frameCount)
+            }
+        } else {
+            pendingFrame = (index, image)
+        }
+    }
+}
@@ -7,59 +7,45 @@
 
 import Foundation
 import SwiftUI
-import WebKit
 
 
-/// A view that displays a GIF image using a `WKWebView`.
+/// A view that displays an instruction animation using an `AnimatedImageView`.
 ///
 /// This struct conforms to the `UIViewRepresentable` protocol, allowing it to be used as a SwiftUI view.
-/// It supports both light and dark mode by appending "Dark" to the image name when in dark mode.
+/// Each animation ships once, as the animated WebP made by `Media/transcode.py`; dark mode draws it with a tint pass.
+/// Frames are decoded natively in the background at display size; state changes never reload the image.
 struct GifImage: UIViewRepresentable {
     private var name: String
     @Environment(\.colorScheme) private var colorScheme
 
     /// Initializes a `GifImage` view with the specified image name.
     ///
-    /// - Parameter name: The name of the GIF image file (without the extension).
+    /// - Parameter name: The name of the animation file (without the extension).
     init(_ name: String) {
         self.name = name
     }
 
-    /// Creates and configures the `WKWebView` to display the GIF image.
+    /// Creates the `AnimatedImageView` that plays the animation.
     ///
     /// - Parameter context: The context for coordinating with the SwiftUI view.
-    /// - Returns: A configured `WKWebView` instance.
-    func makeUIView(context: Context) -> WKWebView {
-        let webView = WKWebView()
-        webView.isOpaque = false // Set the web view's background to transparent
-        webView.backgroundColor = UIColor.clear // Set the background color to clear
-
-        var imageName = name
-        if colorScheme == .dark {
-            // Append "Dark" to the image name if in dark mode
-            imageName += "Dark"
-        }
-        
-        let url = Bundle.main.url(forResource: imageName, withExtension: "gif")!
-        let data = try! Data(contentsOf: url)
-        webView.load(
-            data,
-            mimeType: "image/gif",
-            characterEncodingName: "UTF-8",
-            baseURL: url.deletingLastPathComponent()
-        )
-        webView.scrollView.isScrollEnabled = false
-
-        return webView
+    /// - Returns: A configured `AnimatedImageView` instance.
+    func makeUIView(context: Context) -> AnimatedImageView {
+        let imageView = AnimatedImageView()
+        // Let SwiftUI size the view, the intrinsic size only gives the aspect ratio
+        imageView.setContentCompressionResistancePriority(.defaultLow, for: .horizontal)
+        imageView.setContentCompressionResistancePriority(.defaultLow, for: .vertical)
+        imageView.setResource(name, tinted: colorScheme == .dark)
+        return imageView
     }
 
-    /// Updates the `WKWebView` when the SwiftUI view's state changes.
+    /// Updates the `AnimatedImageView` when the SwiftUI view's state changes.
+    /// Only a different image or color scheme switches the resource.
     ///
     /// - Parameters:
-    ///   - uiView: The `WKWebView` instance to update.
+    ///   - uiView: The `AnimatedImageView` instance to update.
     ///   - context: The context for coordinating with the SwiftUI view.
-    func updateUIView(_ uiView: WKWebView, context: Context) {
-        uiView.reload()
+    func updateUIView(_ uiView: AnimatedImageView, context: Context) {
+        uiView.setResource(name, tinted: colorScheme == .dark)
     }
 
 }
@@ -0,0 +1,146 @@
+#!/usr/bin/env python3
+"""Transcode the instruction GIFs into the compact animated WebP assets shipped in the app.
+
+Usage: python3 Media/transcode.py [--report-only]
+
+Reads the masters in Media/Instructions (`<Test><Page>Gif.gif` and its `Dark` variant), writes one
+`MDots/Instructions/<Test><Page>Gif.webp` per page and rewrites Media/REPORT.md with the before/after
+sizes, decode times and the error of the dark tint pass against the dark master.
+
+Only the light master is encoded; the app draws the dark variant with `AnimatedImageView`'s tint pass,
+which inverts the neutral (line art) pixels and keeps the colored ones. Keep `NEUTRAL_THRESHOLD` in sync
+with `AnimatedImageSource.neutralThreshold`.
+
+Requires Pillow built with WebP support (`pip install pillow`). Run it whenever a master changes and
+commit the regenerated assets together with the report.
+"""
+import glob
+import os
+import sys
+import time
+
+from PIL import Image, ImageSequence, features
+
+ROOT = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+MASTERS = os.path.join(ROOT, 'Media', 'Instructions')
+ASSETS = os.path.join(ROOT, 'MDots', 'Instructions')
+REPORT = os.path.join(ROOT, 'Media', 'REPORT.md')
+
+# Lossy color with near lossless alpha; the encoder stores each frame as the rectangle that changed
+# from the previous one, lossless or lossy, whichever is smaller.
+WEBP_OPTIONS = dict(lossless=False, quality=75, alpha_quality=90, method=6, allow_mixed=True, minimize_size=True)
+# Largest channel spread, out of 255, of a pixel inverted by the dark tint pass
+NEUTRAL_THRESHOLD = 40
+DECODE_RUNS = 3
+
+
+def read_frames(path):
+    """Returns the composited RGBA frames of an animation and their durations in milliseconds."""
+    image = Image.open(path)
+    frames, durations = [], []
+    for frame in ImageSequence.Iterator(image):
+        frames.append(frame.convert('RGBA'))
+        durations.append(frame.info.get('duration', 100))
+    return frames, durations
+
+
+def decode_time(path):
+    """Returns the best time, in milliseconds per frame, to decode every frame of an animation."""
+    best = None
+    for _ in range(DECODE_RUNS):
+        start = time.perf_counter()
+        image = Image.open(path)
+        count = 0
+        for frame in ImageSequence.Iterator(image):
+            frame.convert('RGBA').load()
+            count += 1
+        elapsed = (time.perf_counter() - start) * 1000 / count
+        best = elapsed if best is None else min(best, elapsed)
+    return best
+
+
+def tint(frame):
+    """Applies the dark mode tint pass: inverts the neutral pixels, keeps the colored ones."""
+    pixels = []
+    for r, g, b, a in frame.getdata():
+        if max(r, g, b) - min(r, g, b) < NEUTRAL_THRESHOLD:
+            r, g, b = 255 - r, 255 - g, 255 - b
+        pixels.append((r, g, b, a))
+    tinted = Image.new('RGBA', frame.size)
+    tinted.putdata(pixels)
+    return tinted
+
+
+def tint_error(light, dark):
+    """Returns the mean channel error, out of 255, of the tinted first light frame against the dark master."""
+    total, count = 0, 0
+    for p, q in zip(tint(light).getdata(), dark.getdata()):
+        if p[3] == 0 and q[3] == 0:
+            continue
+        total += max(abs(p[0] - q[0]), abs(p[1] - q[1]), abs(p[2] - q[2]), abs(p[3] - q[3]))
+        count += 1
+    return total / max(count, 1)
+
+
+def transcode(master, asset):
+    frames, durations = read_frames(master)
+    frames[0].save(asset, 'WEBP', save_all=True, append_images=frames[1:], duration=durations, loop=0, **WEBP_OPTIONS)
+
+
+def main():
+    if not features.check('webp'):
+        sys.exit('Pillow was built without WebP support')
+    report_only = '--report-only' in sys.argv
+    os.makedirs(ASSETS, exist_ok=True)
+    rows = []
+    for master in sorted(glob.glob(os.path.join(MASTERS, '*Gif.gif'))):
+        name = os.path.splitext(os.path.basename(master))[0]
+        dark = os.path.join(MASTERS, name + 'Dark.gif')
+        asset = os.path.join(ASSETS, name + '.webp')
+        if not report_only:
+            print('Transcoding %s' % name)
+            transcode(master, asset)
+        light_frames, _ = read_frames(master)
+        dark_frames, _ = read_frames(dark)
+        width, height = light_frames[0].size
+        rows.append(dict(name=name,
+                         frames=len(light_frames),
+                         size='%dx%d' % (width, height),
+                         before=os.path.getsize(master) + os.path.getsize(dark),
+                         after=os.path.getsize(asset),
+                         gif_decode=decode_time(master),
+                         webp_decode=decode_time(asset),
+                         error=tint_error(light_frames[0], dark_frames[0])))
+    write_report(rows)
+
+
+def write_report(rows):
+    before = sum(row['before'] for row in rows)
+    after = sum(row['after'] for row in rows)
+    lines = [
+        '# Instruction media report',
+        '',
+        'Generated by `Media/transcode.py`. Before is the light and dark GIF of each page, after is the single',
+        'animated WebP shipped in `MDots/Instructions`. Decode times are the best of %d full decodes with Pillow' % DECODE_RUNS,
+        'on the machine that ran the script, per full resolution frame; on device ImageIO decodes downsampled',
+        'frames one at a time. Tint error is the mean channel difference, out of 255, between the tinted first',
+        'frame and the first frame of the dark master.',
+        '',
+        '| Page | Frames | Size | Before (KB) | After (KB) | Saved | GIF decode (ms/frame) | WebP decode (ms/frame) | Tint error |',
+        '|---|---:|---:|---:|---:|---:|---:|---:|---:|',
+    ]
+    for row in rows:
+        lines.append('| %s | %d | %s | %.0f | %.0f | %.0f%% | %.1f | %.1f | %.1f |' % (
+            row['name'], row['frames'], row['size'], row['before'] / 1024, row['after'] / 1024,
+            100 * (1 - row['after'] / row['before']), row['gif_decode'], row['webp_decode'], row['error']))
+    lines += [
+        '| **Total** | | | **%.0f** | **%.0f** | **%.0f%%** | | | |' % (before / 1024, after / 1024, 100 * (1 - after / before)),
+        '',
+    ]
+    with open(REPORT, 'w') as report:
+        report.write('\n'.join(lines))
+    print('Before %.0f KB, after %.0f KB' % (before / 1024, after / 1024))
+
+
+if __name__ == '__main__':
+    main()